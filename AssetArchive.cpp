@@ -0,0 +1,483 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: AssetArchive.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "AssetArchive.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sys/stat.h>
+#include "Compressor.h"
+
+namespace
+{
+	// A compressed entry has to be decompressed on every load, so it is only kept when it saves this much.
+	const uint64_t s_minSavingDivisor = 8;
+
+	const size_t s_maxNameLength = 65535;
+
+	AssetArchive s_mountedArchive;
+	bool s_mounted = false;
+
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	int CompareName(const char* a, size_t aLength, const char* b, size_t bLength)
+	{
+		int order = memcmp(a, b, std::min(aLength, bLength));
+
+		if (order != 0)
+		{
+			return order;
+		}
+
+		return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+	}
+
+	bool GetModifiedTime(const char* path, int64_t& modifiedTime)
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if (_stat64(path, &info) != 0)
+		{
+			return false;
+		}
+#else
+		struct stat info;
+		if (stat(path, &info) != 0)
+		{
+			return false;
+		}
+#endif
+
+		modifiedTime = (int64_t)info.st_mtime;
+
+		return true;
+	}
+
+	bool WritePadding(FILE* file, uint64_t& position, uint64_t alignment)
+	{
+		static const char zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+		uint64_t padding = AlignUp(position, alignment) - position;
+
+		position += padding;
+
+		return padding == 0 || fwrite(zeros, (size_t)padding, 1, file) == 1;
+	}
+
+	bool WriteBytes(FILE* file, uint64_t& position, const void* data, size_t size)
+	{
+		position += size;
+
+		return size == 0 || fwrite(data, size, 1, file) == 1;
+	}
+
+	struct PackedEntry
+	{
+		std::string name;
+		std::unique_ptr<MappedFile> file;
+		std::vector<unsigned char> compressed;
+		AssetArchiveEntry entry;
+	};
+}
+
+// 64 bit multiplicative hash, eight bytes per step.
+uint64_t HashAssetBytes(const char* data, size_t size)
+{
+	const uint64_t prime = 0x100000001b3ull;
+	uint64_t hash = 0xcbf29ce484222325ull ^ (uint64_t)size;
+	size_t i;
+
+	for (i = 0; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+
+	for (; i < size; i++)
+	{
+		hash = (hash ^ (unsigned char)data[i]) * prime;
+	}
+
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+bool NormalizeAssetName(const char* name, std::string& normalized)
+{
+	normalized.clear();
+
+	while (name[0] == '.' && (name[1] == '/' || name[1] == '\\'))
+	{
+		name += 2;
+	}
+
+	for (; *name; name++)
+	{
+		char c = *name;
+
+		if (c == '\\')
+		{
+			c = '/';
+		}
+		else if (c >= 'A' && c <= 'Z')
+		{
+			c = (char)(c - 'A' + 'a');
+		}
+
+		normalized.push_back(c);
+	}
+
+	return !normalized.empty() && normalized.size() <= s_maxNameLength;
+}
+
+AssetArchive::AssetArchive()
+{
+	m_header = 0;
+	m_entries = 0;
+	m_names = 0;
+}
+
+AssetArchive::~AssetArchive()
+{
+}
+
+bool AssetArchive::Open(const char* path)
+{
+	const AssetArchiveHeader* header;
+	const AssetArchiveEntry* entries;
+	uint64_t size;
+	uint32_t i;
+
+	Close();
+
+	if (!m_file.Open(path))
+	{
+		return false;
+	}
+
+	size = m_file.GetSize();
+	header = reinterpret_cast<const AssetArchiveHeader*>(m_file.GetData());
+
+	if (size < sizeof(AssetArchiveHeader) || header->magic != ASSET_ARCHIVE_MAGIC || header->version != ASSET_ARCHIVE_VERSION ||
+		header->alignment != ASSET_ARCHIVE_ALIGNMENT || header->tocOffset % ASSET_ARCHIVE_ALIGNMENT != 0 || header->tocOffset > size ||
+		(size - header->tocOffset) / sizeof(AssetArchiveEntry) < header->entryCount || header->namesOffset > size || size - header->namesOffset < header->namesSize)
+	{
+		Close();
+		return false;
+	}
+
+	entries = reinterpret_cast<const AssetArchiveEntry*>(m_file.GetData() + header->tocOffset);
+
+	// Loaders use what Find returns without checking it again, and the search relies on the order.
+	for (i = 0; i < header->entryCount; i++)
+	{
+		const AssetArchiveEntry& entry = entries[i];
+		bool compressed = (entry.flags & ASSET_ENTRY_COMPRESSED) != 0;
+
+		if (entry.offset > size || size - entry.offset < entry.storedSize || (uint64_t)entry.nameOffset + entry.nameLength > header->namesSize ||
+			entry.nameLength == 0 || (entry.flags & ~ASSET_ENTRY_COMPRESSED) != 0 || (!compressed && entry.storedSize != entry.size))
+		{
+			Close();
+			return false;
+		}
+
+		if (i > 0 && CompareName(m_file.GetData() + header->namesOffset + entries[i - 1].nameOffset, entries[i - 1].nameLength,
+			m_file.GetData() + header->namesOffset + entry.nameOffset, entry.nameLength) >= 0)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	m_header = header;
+	m_entries = entries;
+	m_names = m_file.GetData() + header->namesOffset;
+
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	m_file.Close();
+	m_header = 0;
+	m_entries = 0;
+	m_names = 0;
+
+	return;
+}
+
+const AssetArchiveEntry* AssetArchive::Find(const char* name) const
+{
+	std::string normalized;
+	uint32_t first, count;
+
+	if (!m_header || !NormalizeAssetName(name, normalized))
+	{
+		return 0;
+	}
+
+	// Lower bound over the sorted table.
+	first = 0;
+	count = m_header->entryCount;
+	while (count > 0)
+	{
+		uint32_t step = count / 2;
+		const AssetArchiveEntry& entry = m_entries[first + step];
+
+		if (CompareName(m_names + entry.nameOffset, entry.nameLength, normalized.data(), normalized.size()) < 0)
+		{
+			first += step + 1;
+			count -= step + 1;
+		}
+		else
+		{
+			count = step;
+		}
+	}
+
+	if (first < m_header->entryCount &&
+		CompareName(m_names + m_entries[first].nameOffset, m_entries[first].nameLength, normalized.data(), normalized.size()) == 0)
+	{
+		return &m_entries[first];
+	}
+
+	return 0;
+}
+
+const AssetArchiveEntry* AssetArchive::Find(const wchar_t* name) const
+{
+	std::string narrow;
+
+	// Every name in the archive is plain ASCII, so anything else cannot be in it.
+	for (; *name; name++)
+	{
+		if ((unsigned int)*name >= 128)
+		{
+			return 0;
+		}
+		narrow.push_back((char)*name);
+	}
+
+	return Find(narrow.c_str());
+}
+
+unsigned int AssetArchive::GetEntryCount() const
+{
+	return m_header ? m_header->entryCount : 0;
+}
+
+const AssetArchiveEntry& AssetArchive::GetEntry(unsigned int index) const
+{
+	return m_entries[index];
+}
+
+std::string AssetArchive::GetName(const AssetArchiveEntry& entry) const
+{
+	return std::string(m_names + entry.nameOffset, entry.nameLength);
+}
+
+const char* AssetArchive::GetStoredData(const AssetArchiveEntry& entry) const
+{
+	return m_file.GetData() + entry.offset;
+}
+
+bool AssetArchive::Read(const AssetArchiveEntry& entry, void* destination) const
+{
+	if (entry.flags & ASSET_ENTRY_COMPRESSED)
+	{
+		return DecompressBlock(GetStoredData(entry), (size_t)entry.storedSize, destination, (size_t)entry.size);
+	}
+
+	if (entry.size > 0)
+	{
+		memcpy(destination, GetStoredData(entry), (size_t)entry.size);
+	}
+
+	return true;
+}
+
+bool MountAssetArchive(const char* path)
+{
+	s_mounted = s_mountedArchive.Open(path);
+
+	return s_mounted;
+}
+
+void UnmountAssetArchive()
+{
+	s_mountedArchive.Close();
+	s_mounted = false;
+
+	return;
+}
+
+const AssetArchive* GetMountedAssetArchive()
+{
+	return s_mounted ? &s_mountedArchive : 0;
+}
+
+bool WriteAssetArchive(const char* path, const std::vector<AssetArchiveInput>& inputs, bool compress, AssetArchiveReport* report)
+{
+	std::vector<PackedEntry> entries(inputs.size());
+	std::vector<AssetArchiveEntry> toc;
+	std::vector<size_t> order;
+	std::string names, temporaryPath;
+	AssetArchiveHeader header;
+	AssetArchiveReport totals;
+	uint64_t offset, position;
+	FILE* file;
+	bool written;
+	size_t i;
+
+	memset(&totals, 0, sizeof(totals));
+
+	for (i = 0; i < inputs.size(); i++)
+	{
+		PackedEntry& packed = entries[i];
+		AssetArchiveEntry& entry = packed.entry;
+		const char* data;
+		size_t size;
+
+		if (!NormalizeAssetName(inputs[i].name.c_str(), packed.name))
+		{
+			return false;
+		}
+
+		packed.file.reset(new MappedFile());
+		if (!packed.file->Open(inputs[i].path.c_str()))
+		{
+			return false;
+		}
+
+		data = packed.file->GetData();
+		size = packed.file->GetSize();
+
+		memset(&entry, 0, sizeof(entry));
+		entry.size = size;
+		entry.storedSize = size;
+		entry.hash = HashAssetBytes(data, size);
+		if (!GetModifiedTime(inputs[i].path.c_str(), entry.modifiedTime))
+		{
+			return false;
+		}
+
+		if (compress && size > 0)
+		{
+			size_t compressedSize = CompressBlock(data, size, packed.compressed);
+
+			if (compressedSize > 0 && compressedSize <= size - size / s_minSavingDivisor)
+			{
+				entry.storedSize = compressedSize;
+				entry.flags = ASSET_ENTRY_COMPRESSED;
+				totals.compressedCount++;
+			}
+			else
+			{
+				std::vector<unsigned char>().swap(packed.compressed);
+			}
+		}
+
+		totals.inputBytes += size;
+		totals.storedBytes += entry.storedSize;
+	}
+
+	// The table is sorted by name for the search, the data stays in the order it was given, which
+	// is the order the game loads it in, so startup reads the archive front to back.
+	order.resize(entries.size());
+	for (i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&entries](size_t a, size_t b)
+	{
+		return entries[a].name < entries[b].name;
+	});
+
+	for (i = 0; i + 1 < order.size(); i++)
+	{
+		if (entries[order[i]].name == entries[order[i + 1]].name)
+		{
+			return false;
+		}
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = ASSET_ARCHIVE_MAGIC;
+	header.version = ASSET_ARCHIVE_VERSION;
+	header.entryCount = (uint32_t)entries.size();
+	header.alignment = ASSET_ARCHIVE_ALIGNMENT;
+	header.tocOffset = AlignUp(sizeof(header), ASSET_ARCHIVE_ALIGNMENT);
+	header.namesOffset = header.tocOffset + entries.size() * sizeof(AssetArchiveEntry);
+
+	for (size_t index : order)
+	{
+		entries[index].entry.nameOffset = (uint32_t)names.size();
+		entries[index].entry.nameLength = (uint16_t)entries[index].name.size();
+		names += entries[index].name;
+	}
+	header.namesSize = names.size();
+
+	offset = header.namesOffset + header.namesSize;
+	for (PackedEntry& packed : entries)
+	{
+		offset = AlignUp(offset, ASSET_ARCHIVE_ALIGNMENT);
+		packed.entry.offset = offset;
+		offset += packed.entry.storedSize;
+	}
+
+	for (size_t index : order)
+	{
+		toc.push_back(entries[index].entry);
+	}
+
+	temporaryPath = std::string(path) + ".tmp";
+	file = fopen(temporaryPath.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	position = 0;
+	written = WriteBytes(file, position, &header, sizeof(header));
+	written = written && WritePadding(file, position, ASSET_ARCHIVE_ALIGNMENT);
+	written = written && WriteBytes(file, position, toc.data(), toc.size() * sizeof(AssetArchiveEntry));
+	written = written && WriteBytes(file, position, names.data(), names.size());
+
+	for (const PackedEntry& packed : entries)
+	{
+		const void* data = packed.compressed.empty() ? (const void*)packed.file->GetData() : (const void*)packed.compressed.data();
+
+		written = written && WritePadding(file, position, ASSET_ARCHIVE_ALIGNMENT);
+		written = written && WriteBytes(file, position, data, (size_t)packed.entry.storedSize);
+	}
+
+	written = (fclose(file) == 0) && written;
+	if (!written)
+	{
+		remove(temporaryPath.c_str());
+		return false;
+	}
+
+	remove(path);
+	if (rename(temporaryPath.c_str(), path) != 0)
+	{
+		remove(temporaryPath.c_str());
+		return false;
+	}
+
+	if (report)
+	{
+		totals.entryCount = (unsigned int)entries.size();
+		totals.archiveBytes = position;
+		*report = totals;
+	}
+
+	return true;
+}
@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: AssetArchive.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _ASSETARCHIVE_H_
+#define _ASSETARCHIVE_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// One file holding every asset the game loads by name, so startup maps a single file instead of
+// opening and seeking through a hundred, and reads it front to back. The header is followed by the
+// table of contents, sorted by name for a binary search, then the names, then each entry's bytes.
+// The table and every entry start on an ASSET_ARCHIVE_ALIGNMENT boundary, so arrays inside a stored
+// entry, e.g. a cooked mesh's, keep the alignment they were written with.
+//
+// Entries are stored as they are, and used in place from the mapping, unless the block compressor
+// (see Compressor.h) makes them clearly smaller; the .obj text does, the cooked meshes and textures
+// mostly do not. Names are relative to the game's working directory, lower case, with '/' separators.
+const uint32_t ASSET_ARCHIVE_MAGIC = 0x4b415042;	// "BPAK"
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const uint32_t ASSET_ARCHIVE_ALIGNMENT = 64;
+
+const uint16_t ASSET_ENTRY_COMPRESSED = 1;	// the stored bytes are one CompressBlock block
+
+struct AssetArchiveHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t alignment;
+	uint64_t tocOffset;		// entryCount AssetArchiveEntry
+	uint64_t namesOffset;
+	uint64_t namesSize;
+	uint64_t reserved[3];
+};
+
+struct AssetArchiveEntry
+{
+	uint64_t offset;		// of the stored bytes, from the start of the archive
+	uint64_t storedSize;
+	uint64_t size;			// once decompressed
+	uint64_t hash;			// HashAssetBytes of the decompressed bytes
+	int64_t modifiedTime;	// of the file that was packed
+	uint32_t nameOffset;	// into the names, which are not terminated
+	uint16_t nameLength;
+	uint16_t flags;			// ASSET_ENTRY_*
+};
+
+// The 64 bit hash cooked blobs identify their source revision with, see CookedMeshSource.
+uint64_t HashAssetBytes(const char* data, size_t size);
+
+// Lower cases a name and turns it into the form the table is sorted by; false if it cannot be an entry's name.
+bool NormalizeAssetName(const char* name, std::string& normalized);
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: AssetArchive
+////////////////////////////////////////////////////////////////////////////////
+class AssetArchive
+{
+public:
+	AssetArchive();
+	~AssetArchive();
+
+	// Maps the archive and checks every entry lies inside it.
+	bool Open(const char* path);
+	void Close();
+
+	// Null when the archive has no entry of that name. The wide form is for the names D3D loaders take.
+	const AssetArchiveEntry* Find(const char* name) const;
+	const AssetArchiveEntry* Find(const wchar_t* name) const;
+
+	unsigned int GetEntryCount() const;
+	const AssetArchiveEntry& GetEntry(unsigned int index) const;
+	std::string GetName(const AssetArchiveEntry& entry) const;
+
+	// The bytes as they are in the archive, compressed or not.
+	const char* GetStoredData(const AssetArchiveEntry& entry) const;
+
+	// Copies or decompresses an entry into destination, which holds entry.size bytes.
+	bool Read(const AssetArchiveEntry& entry, void* destination) const;
+
+private:
+	AssetArchive(const AssetArchive&);
+	AssetArchive& operator=(const AssetArchive&);
+
+private:
+	MappedFile m_file;
+	const AssetArchiveHeader* m_header;
+	const AssetArchiveEntry* m_entries;
+	const char* m_names;
+};
+
+// The archive loaders look in before the working directory (see MappedFile::OpenAsset). Mount it
+// before any loading starts and leave it mounted while anything read from it is still open.
+bool MountAssetArchive(const char* path);
+void UnmountAssetArchive();
+const AssetArchive* GetMountedAssetArchive();
+
+struct AssetArchiveInput
+{
+	std::string name;		// as the game asks for it
+	std::string path;		// where to read it from now
+};
+
+struct AssetArchiveReport
+{
+	unsigned int entryCount;
+	unsigned int compressedCount;
+	uint64_t inputBytes;
+	uint64_t storedBytes;	// entry bytes only
+	uint64_t archiveBytes;	// padding and table of contents included
+};
+
+// Packs the files into one archive, written next to path and renamed over it once complete.
+bool WriteAssetArchive(const char* path, const std::vector<AssetArchiveInput>& inputs, bool compress, AssetArchiveReport* report);
+
+#endif
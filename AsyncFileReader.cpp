@@ -0,0 +1,647 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: AsyncFileReader.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "AsyncFileReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#define ASYNC_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef ASYNC_IO_URING
+// The submission and completion rings shared with the kernel, set up with the raw system calls
+// so there is no library to depend on.
+struct IoUring
+{
+	int fd;
+	void* sqRing;
+	size_t sqRingSize;
+	void* cqRing;
+	size_t cqRingSize;
+	io_uring_sqe* sqes;
+	size_t sqesSize;
+	unsigned int* sqTail;
+	unsigned int* sqMask;
+	unsigned int* sqArray;
+	unsigned int* cqHead;
+	unsigned int* cqTail;
+	unsigned int* cqMask;
+	io_uring_cqe* cqes;
+};
+#else
+struct IoUring
+{
+};
+#endif
+
+namespace
+{
+	// Positioned reads block their thread, so more threads than this only add contention.
+	const unsigned int s_maxReaderThreads = 8;
+
+	typedef std::chrono::steady_clock Clock;
+
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	const intptr_t s_invalidHandle = -1;
+
+	intptr_t OpenForReading(const char* filename, uint64_t& size)
+	{
+#ifdef _WIN32
+		LARGE_INTEGER fileSize;
+		HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return s_invalidHandle;
+		}
+
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			CloseHandle(file);
+			return s_invalidHandle;
+		}
+
+		size = (uint64_t)fileSize.QuadPart;
+
+		return (intptr_t)file;
+#else
+		struct stat info;
+		int file = open(filename, O_RDONLY);
+
+		if (file < 0)
+		{
+			return s_invalidHandle;
+		}
+
+		if (fstat(file, &info) != 0)
+		{
+			close(file);
+			return s_invalidHandle;
+		}
+
+		size = (uint64_t)info.st_size;
+
+		return file;
+#endif
+	}
+
+	void CloseForReading(intptr_t handle)
+	{
+#ifdef _WIN32
+		CloseHandle((HANDLE)handle);
+#else
+		close((int)handle);
+#endif
+	}
+
+	// Blocks until size bytes at offset are read, short reads included.
+	bool ReadAt(intptr_t handle, char* data, size_t size, uint64_t offset)
+	{
+		while (size > 0)
+		{
+#ifdef _WIN32
+			OVERLAPPED overlapped;
+			DWORD read = 0;
+
+			memset(&overlapped, 0, sizeof(overlapped));
+			overlapped.Offset = (DWORD)offset;
+			overlapped.OffsetHigh = (DWORD)(offset >> 32);
+			if (!ReadFile((HANDLE)handle, data, (DWORD)size, &read, &overlapped) || read == 0)
+			{
+				return false;
+			}
+#else
+			ssize_t read = pread((int)handle, data, size, (off_t)offset);
+
+			if (read < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (read <= 0)
+			{
+				return false;
+			}
+#endif
+			data += read;
+			size -= (size_t)read;
+			offset += (uint64_t)read;
+		}
+
+		return true;
+	}
+
+#ifdef ASYNC_IO_URING
+	void DestroyRing(IoUring* ring)
+	{
+		if (ring->sqes)
+		{
+			munmap(ring->sqes, ring->sqesSize);
+		}
+		if (ring->cqRing && ring->cqRing != ring->sqRing)
+		{
+			munmap(ring->cqRing, ring->cqRingSize);
+		}
+		if (ring->sqRing)
+		{
+			munmap(ring->sqRing, ring->sqRingSize);
+		}
+		if (ring->fd >= 0)
+		{
+			close(ring->fd);
+		}
+
+		delete ring;
+	}
+
+	IoUring* CreateRing(unsigned int entries)
+	{
+		io_uring_params params;
+		IoUring* ring = new IoUring();
+		char* sq;
+		char* cq;
+
+		memset(&params, 0, sizeof(params));
+		ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+		if (ring->fd < 0)
+		{
+			DestroyRing(ring);
+			return 0;
+		}
+
+		ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+		ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			ring->sqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+		}
+
+		ring->sqRing = mmap(0, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+		if (ring->sqRing == MAP_FAILED)
+		{
+			ring->sqRing = 0;
+			DestroyRing(ring);
+			return 0;
+		}
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			ring->cqRing = ring->sqRing;
+		}
+		else
+		{
+			ring->cqRing = mmap(0, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+			if (ring->cqRing == MAP_FAILED)
+			{
+				ring->cqRing = 0;
+				DestroyRing(ring);
+				return 0;
+			}
+		}
+
+		ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		ring->sqes = (io_uring_sqe*)mmap(0, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+		if (ring->sqes == MAP_FAILED)
+		{
+			ring->sqes = 0;
+			DestroyRing(ring);
+			return 0;
+		}
+
+		sq = (char*)ring->sqRing;
+		cq = (char*)ring->cqRing;
+		ring->sqTail = (unsigned int*)(sq + params.sq_off.tail);
+		ring->sqMask = (unsigned int*)(sq + params.sq_off.ring_mask);
+		ring->sqArray = (unsigned int*)(sq + params.sq_off.array);
+		ring->cqHead = (unsigned int*)(cq + params.cq_off.head);
+		ring->cqTail = (unsigned int*)(cq + params.cq_off.tail);
+		ring->cqMask = (unsigned int*)(cq + params.cq_off.ring_mask);
+		ring->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+		return ring;
+	}
+#endif
+}
+
+AsyncFileReader::AsyncFileReader()
+{
+	m_tasks = 0;
+	m_queueDepth = 0;
+	m_ring = 0;
+	m_bufferSize = 0;
+	m_queueDepthSum = 0.0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	Shutdown();
+}
+
+bool AsyncFileReader::Initialize(TaskPool& tasks, unsigned int queueDepth, bool allowIoUring)
+{
+	Shutdown();
+
+	m_tasks = &tasks;
+	m_queueDepth = std::max(1u, queueDepth);
+
+#ifdef ASYNC_IO_URING
+	if (allowIoUring)
+	{
+		m_ring = CreateRing(m_queueDepth);
+	}
+#else
+	(void)allowIoUring;
+#endif
+
+	return true;
+}
+
+void AsyncFileReader::Shutdown()
+{
+#ifdef ASYNC_IO_URING
+	if (m_ring)
+	{
+		DestroyRing(m_ring);
+	}
+#endif
+	m_ring = 0;
+
+	m_files.clear();
+	m_chunks.clear();
+	ReleaseBuffers();
+	m_tasks = 0;
+
+	return;
+}
+
+void AsyncFileReader::Queue(const char* filename, Completion onComplete)
+{
+	File file;
+
+	file.filename = filename;
+	file.onComplete = std::move(onComplete);
+	file.handle = s_invalidHandle;
+	file.data = 0;
+	file.size = 0;
+	file.pendingChunks = 0;
+	file.failed = false;
+	m_files.push_back(std::move(file));
+
+	return;
+}
+
+bool AsyncFileReader::Flush()
+{
+	Clock::time_point start;
+	bool succeeded;
+
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_queueDepthSum = 0.0;
+
+	if (!m_tasks)
+	{
+		return false;
+	}
+
+	if (OpenFiles())
+	{
+		start = Clock::now();
+		if (m_ring)
+		{
+			ReadWithIoUring();
+		}
+		else
+		{
+			ReadWithThreads();
+		}
+		m_stats.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	CloseFiles();
+	m_tasks->Wait();
+
+	m_stats.fileCount = (unsigned int)m_files.size();
+	for (const File& file : m_files)
+	{
+		if (file.failed)
+		{
+			m_stats.failedCount++;
+		}
+	}
+	m_stats.averageQueueDepth = m_stats.readCount ? m_queueDepthSum / m_stats.readCount : 0.0;
+
+	succeeded = m_stats.failedCount == 0;
+	m_files.clear();
+	m_chunks.clear();
+
+	return succeeded;
+}
+
+void AsyncFileReader::ReleaseBuffers()
+{
+	m_buffer.reset();
+	m_bufferSize = 0;
+
+	return;
+}
+
+bool AsyncFileReader::IsUsingIoUring() const
+{
+	return m_ring != 0;
+}
+
+const AsyncReadStats& AsyncFileReader::GetStats() const
+{
+	return m_stats;
+}
+
+bool AsyncFileReader::OpenFiles()
+{
+	uint64_t total = 0, offset;
+	char* base;
+	size_t i;
+
+	for (File& file : m_files)
+	{
+		file.handle = OpenForReading(file.filename.c_str(), file.size);
+		file.failed = (file.handle == s_invalidHandle);
+		if (!file.failed)
+		{
+			total += AlignUp(file.size, ASYNC_READ_ALIGNMENT);
+		}
+	}
+
+	// One allocation for the whole batch, so no read waits on the allocator, reused by later batches that fit.
+	if (total + ASYNC_READ_ALIGNMENT > m_bufferSize)
+	{
+		m_buffer.reset();
+		m_bufferSize = (size_t)total + ASYNC_READ_ALIGNMENT;
+		m_buffer.reset(new char[m_bufferSize]);
+	}
+	base = (char*)AlignUp((uint64_t)(uintptr_t)m_buffer.get(), ASYNC_READ_ALIGNMENT);
+
+	offset = 0;
+	for (i = 0; i < m_files.size(); i++)
+	{
+		File& file = m_files[i];
+		uint64_t position;
+
+		if (file.failed)
+		{
+			continue;
+		}
+
+		file.data = base + offset;
+		offset += AlignUp(file.size, ASYNC_READ_ALIGNMENT);
+
+		for (position = 0; position < file.size; position += ASYNC_READ_CHUNK_SIZE)
+		{
+			Chunk chunk;
+			chunk.file = i;
+			chunk.offset = position;
+			chunk.size = (size_t)std::min<uint64_t>(ASYNC_READ_CHUNK_SIZE, file.size - position);
+			m_chunks.push_back(chunk);
+			file.pendingChunks++;
+		}
+		m_stats.bytes += file.size;
+	}
+
+	// Files with nothing to read are finished already.
+	for (File& file : m_files)
+	{
+		if (file.failed || file.pendingChunks == 0)
+		{
+			File* finished = &file;
+			m_tasks->Run([finished]() { finished->onComplete(finished->failed ? 0 : finished->data, finished->failed ? 0 : (size_t)finished->size); });
+		}
+	}
+
+	return !m_chunks.empty();
+}
+
+void AsyncFileReader::CloseFiles()
+{
+	for (File& file : m_files)
+	{
+		if (file.handle != s_invalidHandle)
+		{
+			CloseForReading(file.handle);
+			file.handle = s_invalidHandle;
+		}
+	}
+
+	return;
+}
+
+void AsyncFileReader::FinishChunk(const Chunk& chunk, bool succeeded)
+{
+	File* file = &m_files[chunk.file];
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!succeeded)
+		{
+			file->failed = true;
+		}
+
+		if (--file->pendingChunks > 0)
+		{
+			return;
+		}
+	}
+
+	m_tasks->Run([file]() { file->onComplete(file->failed ? 0 : file->data, file->failed ? 0 : (size_t)file->size); });
+
+	return;
+}
+
+void AsyncFileReader::RecordIssue(unsigned int inFlight)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_stats.readCount++;
+	m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, inFlight);
+	m_queueDepthSum += inFlight;
+
+	return;
+}
+
+void AsyncFileReader::ReadWithIoUring()
+{
+#ifdef ASYNC_IO_URING
+	std::vector<iovec> vectors(m_chunks.size());
+	std::vector<size_t> retries;
+	size_t next = 0;
+	unsigned int inFlight = 0;
+
+	while (next < m_chunks.size() || !retries.empty() || inFlight > 0)
+	{
+		unsigned int submitted = 0;
+		unsigned int head, tail;
+		int entered;
+
+		// Short reads go back in first, then new chunks in file order, up to the queue depth.
+		while (inFlight < m_queueDepth && (!retries.empty() || next < m_chunks.size()))
+		{
+			size_t index;
+			unsigned int sqTail = *m_ring->sqTail;
+			unsigned int slot = sqTail & *m_ring->sqMask;
+			io_uring_sqe* sqe = &m_ring->sqes[slot];
+
+			if (!retries.empty())
+			{
+				index = retries.back();
+				retries.pop_back();
+			}
+			else
+			{
+				index = next++;
+			}
+
+			const Chunk& chunk = m_chunks[index];
+			vectors[index].iov_base = m_files[chunk.file].data + chunk.offset;
+			vectors[index].iov_len = chunk.size;
+
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_READV;
+			sqe->fd = (int)m_files[chunk.file].handle;
+			sqe->addr = (uint64_t)(uintptr_t)&vectors[index];
+			sqe->len = 1;
+			sqe->off = chunk.offset;
+			sqe->user_data = index;
+
+			m_ring->sqArray[slot] = slot;
+			__atomic_store_n(m_ring->sqTail, sqTail + 1, __ATOMIC_RELEASE);
+
+			inFlight++;
+			submitted++;
+			RecordIssue(inFlight);
+		}
+
+		entered = (int)syscall(__NR_io_uring_enter, m_ring->fd, submitted, 1, IORING_ENTER_GETEVENTS, 0, 0);
+		if (entered < 0 && errno != EINTR)
+		{
+			// The ring is unusable; whatever has not arrived is read the slow way.
+			break;
+		}
+
+		head = *m_ring->cqHead;
+		tail = __atomic_load_n(m_ring->cqTail, __ATOMIC_ACQUIRE);
+		while (head != tail)
+		{
+			const io_uring_cqe* cqe = &m_ring->cqes[head & *m_ring->cqMask];
+			size_t index = (size_t)cqe->user_data;
+			Chunk& chunk = m_chunks[index];
+
+			inFlight--;
+			head++;
+
+			if (cqe->res == -EINTR || cqe->res == -EAGAIN)
+			{
+				retries.push_back(index);
+			}
+			else if (cqe->res > 0 && (size_t)cqe->res < chunk.size)
+			{
+				chunk.offset += (uint64_t)cqe->res;
+				chunk.size -= (size_t)cqe->res;
+				retries.push_back(index);
+			}
+			else
+			{
+				FinishChunk(chunk, cqe->res > 0);
+				chunk.size = 0;
+			}
+		}
+		__atomic_store_n(m_ring->cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	// Only reached with chunks left after the ring failed: the reads still in flight may land at any
+	// time, so the ring is torn down first, then everything unfinished is read again.
+	if (next < m_chunks.size() || !retries.empty() || inFlight > 0)
+	{
+		size_t index;
+
+		DestroyRing(m_ring);
+		m_ring = 0;
+
+		for (index = 0; index < m_chunks.size(); index++)
+		{
+			if (index < next && m_chunks[index].size == 0)
+			{
+				continue;
+			}
+			RecordIssue(1);
+			FinishChunk(m_chunks[index], ReadAt(m_files[m_chunks[index].file].handle, m_files[m_chunks[index].file].data + m_chunks[index].offset,
+				m_chunks[index].size, m_chunks[index].offset));
+		}
+	}
+#endif
+
+	return;
+}
+
+void AsyncFileReader::ReadWithThreads()
+{
+	std::vector<std::thread> readers;
+	std::atomic<size_t> next(0);
+	std::atomic<unsigned int> inFlight(0);
+	unsigned int threadCount, i;
+
+	auto reader = [this, &next, &inFlight]()
+	{
+		size_t index;
+
+		while ((index = next++) < m_chunks.size())
+		{
+			const Chunk& chunk = m_chunks[index];
+			bool read;
+
+			RecordIssue(++inFlight);
+			read = ReadAt(m_files[chunk.file].handle, m_files[chunk.file].data + chunk.offset, chunk.size, chunk.offset);
+			inFlight--;
+
+			FinishChunk(chunk, read);
+		}
+	};
+
+	threadCount = (unsigned int)std::min<size_t>(std::min(m_queueDepth, s_maxReaderThreads), m_chunks.size());
+	for (i = 1; i < threadCount; i++)
+	{
+		readers.push_back(std::thread(reader));
+	}
+	reader();
+
+	for (std::thread& thread : readers)
+	{
+		thread.join();
+	}
+
+	return;
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: AsyncFileReader.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _ASYNCFILEREADER_H_
+#define _ASYNCFILEREADER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "TaskPool.h"
+
+// Reads a batch of whole files with many reads in flight at once instead of one file after the
+// other. Every file of a batch lands in one buffer allocated up front, each on an
+// ASYNC_READ_ALIGNMENT boundary, and is read in chunks of at most ASYNC_READ_CHUNK_SIZE bytes.
+// A file is handed to its completion on the task pool as soon as its last chunk arrives, so
+// parsing and decoding overlap the reads still in flight.
+//
+// On Linux the reads go through an io_uring submission queue of queueDepth entries. Where that is
+// not available (other systems, old kernels, sandboxes that block it) a few reader threads doing
+// positioned reads keep several in flight instead.
+const size_t ASYNC_READ_ALIGNMENT = 4096;
+const size_t ASYNC_READ_CHUNK_SIZE = 1 << 20;
+
+struct IoUring;
+
+struct AsyncReadStats
+{
+	unsigned int fileCount;
+	unsigned int failedCount;
+	unsigned int readCount;			// chunk reads issued, resubmitted short reads included
+	unsigned int maxQueueDepth;		// most reads in flight at once
+	double averageQueueDepth;		// reads in flight, sampled as each read is issued
+	uint64_t bytes;
+	double milliseconds;			// from the first read issued to the last one completed
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: AsyncFileReader
+////////////////////////////////////////////////////////////////////////////////
+class AsyncFileReader
+{
+public:
+	// Gets the file's bytes, or null data when it could not be opened or read.
+	typedef std::function<void(const char* data, size_t size)> Completion;
+
+	AsyncFileReader();
+	~AsyncFileReader();
+
+	// Completions run on tasks. allowIoUring false always uses the reader threads.
+	bool Initialize(TaskPool& tasks, unsigned int queueDepth = 32, bool allowIoUring = true);
+	void Shutdown();
+
+	void Queue(const char* filename, Completion onComplete);
+
+	// Reads every queued file and returns once all their completions have run. The bytes stay valid
+	// until the next Flush or ReleaseBuffers. False if any file failed.
+	bool Flush();
+	void ReleaseBuffers();
+
+	bool IsUsingIoUring() const;
+	const AsyncReadStats& GetStats() const;	// of the last Flush
+
+private:
+	struct File
+	{
+		std::string filename;
+		Completion onComplete;
+		intptr_t handle;
+		char* data;
+		uint64_t size;
+		unsigned int pendingChunks;
+		bool failed;
+	};
+
+	struct Chunk
+	{
+		size_t file;
+		uint64_t offset;
+		size_t size;
+	};
+
+	bool OpenFiles();
+	void CloseFiles();
+	void FinishChunk(const Chunk& chunk, bool succeeded);
+	void ReadWithIoUring();
+	void ReadWithThreads();
+	void RecordIssue(unsigned int inFlight);
+
+private:
+	AsyncFileReader(const AsyncFileReader&);
+	AsyncFileReader& operator=(const AsyncFileReader&);
+
+private:
+	TaskPool* m_tasks;
+	unsigned int m_queueDepth;
+	IoUring* m_ring;
+	std::vector<File> m_files;
+	std::vector<Chunk> m_chunks;
+	std::unique_ptr<char[]> m_buffer;	// not cleared, every byte of it is read over; kept for the next batch
+	size_t m_bufferSize;
+	std::mutex m_mutex;
+	AsyncReadStats m_stats;
+	double m_queueDepthSum;
+};
+
+#endif
@@ -0,0 +1,283 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Compressor.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "Compressor.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	const size_t s_minMatch = 4;
+	const size_t s_maxOffset = 65535;
+	const unsigned int s_hashBits = 16;
+
+	// Matches stop this far from the end, so the match finder can always read a whole word.
+	const size_t s_endMargin = 8;
+
+	inline uint32_t Read32(const unsigned char* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t Hash(uint32_t value)
+	{
+		return (value * 2654435761u) >> (32 - s_hashBits);
+	}
+
+	void WriteLength(std::vector<unsigned char>& out, size_t length)
+	{
+		while (length >= 255)
+		{
+			out.push_back(255);
+			length -= 255;
+		}
+		out.push_back((unsigned char)length);
+
+		return;
+	}
+
+	bool ReadLength(const unsigned char*& ip, const unsigned char* end, size_t& length)
+	{
+		unsigned char byte;
+
+		do
+		{
+			if (ip >= end)
+			{
+				return false;
+			}
+			byte = *ip++;
+			length += byte;
+		} while (byte == 255);
+
+		return true;
+	}
+
+	void WriteSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+	{
+		size_t literalNibble = literalCount < 15 ? literalCount : 15;
+		size_t matchNibble = 0;
+
+		if (matchLength > 0)
+		{
+			matchNibble = (matchLength - s_minMatch) < 15 ? (matchLength - s_minMatch) : 15;
+		}
+
+		out.push_back((unsigned char)((literalNibble << 4) | matchNibble));
+		if (literalNibble == 15)
+		{
+			WriteLength(out, literalCount - 15);
+		}
+		out.insert(out.end(), literals, literals + literalCount);
+
+		if (matchLength > 0)
+		{
+			out.push_back((unsigned char)(offset & 0xff));
+			out.push_back((unsigned char)(offset >> 8));
+			if (matchNibble == 15)
+			{
+				WriteLength(out, matchLength - s_minMatch - 15);
+			}
+		}
+
+		return;
+	}
+}
+
+size_t CompressBlock(const void* data, size_t size, std::vector<unsigned char>& out)
+{
+	const unsigned char* input = static_cast<const unsigned char*>(data);
+	const unsigned char* end = input + size;
+	const unsigned char* matchLimit = size > s_endMargin ? end - s_endMargin : input;
+	const unsigned char* ip = input;
+	const unsigned char* anchor = input;
+	std::vector<uint32_t> table((size_t)1 << s_hashBits, 0);
+	size_t start = out.size();
+
+	// Position 0 doubles as "empty", which only costs a missed match against the first bytes.
+	while (ip < matchLimit)
+	{
+		uint32_t value = Read32(ip);
+		uint32_t hash = Hash(value);
+		const unsigned char* candidate = input + table[hash];
+		size_t matchLength;
+
+		table[hash] = (uint32_t)(ip - input);
+
+		if (candidate >= ip || (size_t)(ip - candidate) > s_maxOffset || Read32(candidate) != value)
+		{
+			ip++;
+			continue;
+		}
+
+		// Grow the match forwards as far as the margin allows, and backwards over the literals.
+		matchLength = s_minMatch;
+		while (ip + matchLength < matchLimit && candidate[matchLength] == ip[matchLength])
+		{
+			matchLength++;
+		}
+		while (ip > anchor && candidate > input && ip[-1] == candidate[-1])
+		{
+			ip--;
+			candidate--;
+			matchLength++;
+		}
+
+		WriteSequence(out, anchor, (size_t)(ip - anchor), (size_t)(ip - candidate), matchLength);
+		ip += matchLength;
+		anchor = ip;
+
+		// Give too short a match no chance of overflowing the output.
+		if (out.size() - start >= size)
+		{
+			out.resize(start);
+			return 0;
+		}
+	}
+
+	WriteSequence(out, anchor, (size_t)(end - anchor), 0, 0);
+
+	if (out.size() - start >= size)
+	{
+		out.resize(start);
+		return 0;
+	}
+
+	return out.size() - start;
+}
+
+bool DecompressBlock(const void* data, size_t size, void* destination, size_t decodedSize)
+{
+	const unsigned char* ip = static_cast<const unsigned char*>(data);
+	const unsigned char* end = ip + size;
+	unsigned char* output = static_cast<unsigned char*>(destination);
+	unsigned char* op = output;
+	unsigned char* outputEnd = output + decodedSize;
+
+	while (ip < end)
+	{
+		unsigned char token = *ip++;
+		size_t literalCount = token >> 4;
+		size_t matchLength = token & 15;
+		size_t offset;
+		const unsigned char* match;
+
+		// Short sequences far from both ends, the common case, are copied with fixed size moves
+		// that may run past the sequence; what follows overwrites the extra bytes.
+		if (literalCount < 15 && matchLength < 15 && end - ip >= 32 && outputEnd - op >= 32)
+		{
+			memcpy(op, ip, 16);
+			ip += literalCount;
+			op += literalCount;
+
+			offset = ip[0] | ((size_t)ip[1] << 8);
+			ip += 2;
+			matchLength += s_minMatch;
+
+			if (offset >= 8 && offset <= (size_t)(op - output))
+			{
+				match = op - offset;
+				memcpy(op, match, 8);
+				memcpy(op + 8, match + 8, 8);
+				memcpy(op + 16, match + 16, 2);
+				op += matchLength;
+				continue;
+			}
+
+			if (offset == 0 || offset > (size_t)(op - output))
+			{
+				return false;
+			}
+
+			match = op - offset;
+			while (matchLength > 0)
+			{
+				*op++ = *match++;
+				matchLength--;
+			}
+			continue;
+		}
+
+		if (literalCount == 15 && !ReadLength(ip, end, literalCount))
+		{
+			return false;
+		}
+
+		if (literalCount > (size_t)(end - ip) || literalCount > (size_t)(outputEnd - op))
+		{
+			return false;
+		}
+
+		// Short runs are copied 16 bytes at a time when both buffers have the room; the bytes past
+		// the run are overwritten by what follows.
+		if (literalCount <= 16 && end - ip >= 16 && outputEnd - op >= 16)
+		{
+			memcpy(op, ip, 16);
+		}
+		else
+		{
+			memcpy(op, ip, literalCount);
+		}
+		ip += literalCount;
+		op += literalCount;
+
+		// Only the last sequence ends after its literals.
+		if (ip == end)
+		{
+			break;
+		}
+
+		if (end - ip < 2)
+		{
+			return false;
+		}
+		offset = ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+
+		if (matchLength == 15 && !ReadLength(ip, end, matchLength))
+		{
+			return false;
+		}
+		matchLength += s_minMatch;
+
+		if (offset == 0 || offset > (size_t)(op - output) || matchLength > (size_t)(outputEnd - op))
+		{
+			return false;
+		}
+		match = op - offset;
+
+		if (offset == 1)
+		{
+			// A run of one byte, the usual match in filtered data.
+			memset(op, *match, matchLength);
+			op += matchLength;
+		}
+		else if (offset >= 8 && (size_t)(outputEnd - op) >= matchLength + 8)
+		{
+			// Every chunk reads bytes written before it, so eight at a time is safe, overshooting included.
+			unsigned char* matchEnd = op + matchLength;
+
+			do
+			{
+				memcpy(op, match, 8);
+				op += 8;
+				match += 8;
+			} while (op < matchEnd);
+			op = matchEnd;
+		}
+		else
+		{
+			// Overlapping copies repeat the last offset bytes, which only a byte by byte copy does.
+			while (matchLength > 0)
+			{
+				*op++ = *match++;
+				matchLength--;
+			}
+		}
+	}
+
+	return op == outputEnd;
+}
@@ -0,0 +1,28 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: Compressor.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _COMPRESSOR_H_
+#define _COMPRESSOR_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <vector>
+
+// General purpose byte compression for cooked assets: LZ77 with a 64 KB window and no entropy
+// coding, so decoding is little more than memcpy. Each block is a run of sequences, each a token
+// byte (literal count in the high nibble, match length - 4 in the low one, 15 meaning more length
+// bytes follow), the literals, then a 16 bit little endian match offset and the extra match length
+// bytes. The last sequence has literals only. Blocks do not record their decoded size; the
+// container that stores one does.
+
+// Appends the compressed form of data to out and returns its size, or 0 when it would not be
+// smaller than size, in which case out is left as it was and the bytes are best stored as they are.
+size_t CompressBlock(const void* data, size_t size, std::vector<unsigned char>& out);
+
+// Fails unless the block decodes to exactly decodedSize bytes without reading or writing out of bounds.
+bool DecompressBlock(const void* data, size_t size, void* destination, size_t decodedSize);
+
+#endif
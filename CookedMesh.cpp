@@ -0,0 +1,567 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: CookedMesh.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "CookedMesh.h"
+#include "AssetArchive.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <vector>
+
+namespace
+{
+	// Vertex and index arrays start on this boundary inside the blob.
+	const uint64_t s_cookedMeshAlignment = 16;
+
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Whether bytes bytes from offset lie inside a blob of size bytes, without the sum wrapping.
+	inline bool InBlob(uint64_t offset, uint64_t bytes, uint64_t size)
+	{
+		return offset <= size && bytes <= size - offset;
+	}
+
+	// What an encoded stream says it decodes to, 0 when it is too short to say.
+	uint64_t GetDecodedSize(const char* stream, uint64_t bytes)
+	{
+		MeshStreamHeader header;
+
+		if (bytes < sizeof(header))
+		{
+			return 0;
+		}
+
+		memcpy(&header, stream, sizeof(header));
+
+		return header.filteredSize;
+	}
+
+	// Length of the directory part of a path, separator included.
+	size_t GetDirectoryLength(const char* path)
+	{
+		const char* slash = strrchr(path, '/');
+		const char* backslash = strrchr(path, '\\');
+
+		if (backslash && (!slash || backslash > slash))
+		{
+			slash = backslash;
+		}
+
+		return slash ? (size_t)(slash - path + 1) : 0;
+	}
+
+	// Same write-then-rename as WriteCookedMesh.
+	bool WriteFileAtomically(const char* path, const void* data, size_t size)
+	{
+		std::string temporaryPath;
+		FILE* file;
+		bool written;
+
+		temporaryPath = std::string(path) + ".tmp";
+		file = fopen(temporaryPath.c_str(), "wb");
+		if (!file)
+		{
+			return false;
+		}
+
+		written = fwrite(data, size, 1, file) == 1;
+		written = (fclose(file) == 0) && written;
+
+		if (!written)
+		{
+			remove(temporaryPath.c_str());
+			return false;
+		}
+
+		remove(path);
+		if (rename(temporaryPath.c_str(), path) != 0)
+		{
+			remove(temporaryPath.c_str());
+			return false;
+		}
+
+		return true;
+	}
+}
+
+bool CookMesh(const ObjMesh& obj, MeshLayout layout, const MeshCookOptions& options, MeshData& mesh, MeshCookReport* report)
+{
+	MeshData unpacked;
+	bool packed = (layout == MESH_LAYOUT_NORMALMAP_PACKED);
+	bool proxy = (layout == MESH_LAYOUT_SHADOWMAP && options.shadowProxyError > 0.0f);
+	float proxyError = 0.0f;
+
+	if (report)
+	{
+		memset(report, 0, sizeof(*report));
+	}
+
+	if (!BuildMesh(obj, packed ? MESH_LAYOUT_NORMALMAP : layout, mesh))
+	{
+		return false;
+	}
+
+	// The depth pass only needs the silhouette to within a fraction of a texel, so the shadow map
+	// layout is simplified before anything is built on its triangles.
+	if (proxy)
+	{
+		if (report)
+		{
+			report->shadowProxy.sourceVertexCount = mesh.vertexCount;
+			report->shadowProxy.sourceTriangleCount = (unsigned int)(mesh.indices.size() / 3);
+		}
+
+		proxyError = BuildShadowProxy(mesh, options.shadowProxyError);
+
+		if (report)
+		{
+			report->shadowProxy.error = proxyError;
+		}
+	}
+
+	// The optimiser reads float positions, so it runs before quantization.
+	if (options.optimize)
+	{
+		OptimizeMesh(mesh, report ? &report->optimize : 0);
+	}
+
+	// The levels share the optimised vertex array, so they are simplified after it is final.
+	if (options.generateLods)
+	{
+		GenerateLods(mesh);
+
+		// Each level is measured against the proxy, which is itself this far from the .obj.
+		for (MeshLod& lod : mesh.lods)
+		{
+			lod.error += proxyError;
+		}
+	}
+
+	// Clustering reorders each level's triangles and reads float positions for the bounds.
+	if (options.buildClusters)
+	{
+		BuildClusters(mesh);
+	}
+
+	if (packed)
+	{
+		if (report)
+		{
+			unpacked = mesh;
+		}
+
+		if (!QuantizeMesh(mesh))
+		{
+			return false;
+		}
+
+		if (report)
+		{
+			report->quantization = MeasureQuantizationError(unpacked, mesh);
+		}
+	}
+
+	return true;
+}
+
+bool GetCookedMeshSource(const char* filename, CookedMeshSource& source)
+{
+	const AssetArchive* archive = GetMountedAssetArchive();
+	const AssetArchiveEntry* entry;
+	MappedFile file;
+
+	// A packed file's stamp was taken when it was packed, so nothing has to be read to get it.
+	entry = archive ? archive->Find(filename) : 0;
+	if (entry)
+	{
+		source.size = entry->size;
+		source.modifiedTime = entry->modifiedTime;
+		source.hash = entry->hash;
+		return true;
+	}
+
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(filename, &info) != 0)
+	{
+		return false;
+	}
+#else
+	struct stat info;
+	if (stat(filename, &info) != 0)
+	{
+		return false;
+	}
+#endif
+
+	if (!file.Open(filename))
+	{
+		return false;
+	}
+
+	source.size = (uint64_t)info.st_size;
+	source.modifiedTime = (int64_t)info.st_mtime;
+	source.hash = HashAssetBytes(file.GetData(), file.GetSize());
+
+	return true;
+}
+
+bool GetCookedMeshSource(const char* filename, const char* data, size_t size, CookedMeshSource& source)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(filename, &info) != 0)
+	{
+		return false;
+	}
+#else
+	struct stat info;
+	if (stat(filename, &info) != 0)
+	{
+		return false;
+	}
+#endif
+
+	source.size = (uint64_t)size;
+	source.modifiedTime = (int64_t)info.st_mtime;
+	source.hash = HashAssetBytes(data, size);
+
+	return true;
+}
+
+std::string GetCookedMeshPath(const char* filename, MeshLayout layout)
+{
+	std::string path(filename);
+
+	switch (layout)
+	{
+	case MESH_LAYOUT_NORMALMAP:
+		path += ".nm32.mesh";
+		break;
+	case MESH_LAYOUT_NORMALMAP_PACKED:
+		path += ".nm.mesh";
+		break;
+	case MESH_LAYOUT_SHADOWMAP:
+		path += ".sm.mesh";
+		break;
+	default:
+		path += ".mesh";
+		break;
+	}
+
+	return path;
+}
+
+bool WriteCookedMesh(const char* path, const MeshData& mesh, const CookedMeshSource& source, CookedMeshEncoding encoding)
+{
+	CookedMeshHeader header;
+	std::string temporaryPath;
+	static const char padding[s_cookedMeshAlignment] = {};
+	std::vector<unsigned char> vertices, indices;
+	const void* vertexData;
+	uint64_t vertexBytes, indexBytes, clusterBytes;
+	unsigned int indexSize;
+	FILE* file;
+	bool written;
+
+	indexSize = GetIndexSize(mesh.vertexCount);
+	clusterBytes = (uint64_t)mesh.clusters.size() * sizeof(MeshCluster);
+
+	if (encoding == COOKED_MESH_RAW)
+	{
+		// Stored at the width they are bound with, so the runtime can upload them straight from the mapping.
+		vertexData = mesh.vertices.data();
+		vertexBytes = (uint64_t)mesh.vertexCount * mesh.vertexStride;
+		indices.resize((size_t)mesh.indices.size() * indexSize);
+		PackIndices(mesh.indices.data(), mesh.indices.size(), indexSize, indices.data());
+	}
+	else
+	{
+		EncodeVertexStream(mesh.vertices.data(), mesh.vertexCount, mesh.vertexStride, GetVertexChannelSize(mesh.layout), encoding == COOKED_MESH_COMPRESSED, vertices);
+		EncodeIndexStream(mesh.indices.data(), mesh.indices.size(), indexSize, encoding == COOKED_MESH_COMPRESSED, indices);
+		vertexData = vertices.data();
+		vertexBytes = vertices.size();
+	}
+	indexBytes = indices.size();
+
+	memset(&header, 0, sizeof(header));
+	header.magic = COOKED_MESH_MAGIC;
+	header.version = COOKED_MESH_VERSION;
+	header.layout = (uint32_t)mesh.layout;
+	header.vertexStride = mesh.vertexStride;
+	header.vertexCount = mesh.vertexCount;
+	header.indexCount = (uint32_t)mesh.indices.size();
+	header.indexSize = indexSize;
+	header.source = source;
+	memcpy(header.boundsMin, mesh.boundsMin, sizeof(header.boundsMin));
+	memcpy(header.boundsMax, mesh.boundsMax, sizeof(header.boundsMax));
+	memcpy(header.boundsCenter, mesh.boundsCenter, sizeof(header.boundsCenter));
+	header.boundsRadius = mesh.boundsRadius;
+	header.quantization = mesh.quantization;
+	header.lodCount = (uint32_t)std::min(mesh.lods.size(), (size_t)MESH_MAX_LODS);
+	memcpy(header.lods, mesh.lods.data(), header.lodCount * sizeof(MeshLod));
+	header.clusterCount = (uint32_t)mesh.clusters.size();
+	header.encoding = (uint32_t)encoding;
+	header.vertexBytes = vertexBytes;
+	header.indexBytes = indexBytes;
+	header.vertexOffset = AlignUp(sizeof(header), s_cookedMeshAlignment);
+	header.indexOffset = AlignUp(header.vertexOffset + vertexBytes, s_cookedMeshAlignment);
+	header.clusterOffset = AlignUp(header.indexOffset + indexBytes, s_cookedMeshAlignment);
+
+	// Write next to the destination and swap it in, so a reader never maps a half written blob.
+	temporaryPath = std::string(path) + ".tmp";
+	file = fopen(temporaryPath.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	written = fwrite(&header, sizeof(header), 1, file) == 1;
+	written = written && fwrite(padding, 1, (size_t)(header.vertexOffset - sizeof(header)), file) == header.vertexOffset - sizeof(header);
+	written = written && (vertexBytes == 0 || fwrite(vertexData, (size_t)vertexBytes, 1, file) == 1);
+	written = written && fwrite(padding, 1, (size_t)(header.indexOffset - header.vertexOffset - vertexBytes), file) == header.indexOffset - header.vertexOffset - vertexBytes;
+	written = written && (indexBytes == 0 || fwrite(indices.data(), (size_t)indexBytes, 1, file) == 1);
+	written = written && fwrite(padding, 1, (size_t)(header.clusterOffset - header.indexOffset - indexBytes), file) == header.clusterOffset - header.indexOffset - indexBytes;
+	written = written && (clusterBytes == 0 || fwrite(mesh.clusters.data(), (size_t)clusterBytes, 1, file) == 1);
+	written = (fclose(file) == 0) && written;
+
+	if (!written)
+	{
+		remove(temporaryPath.c_str());
+		return false;
+	}
+
+	remove(path);
+	if (rename(temporaryPath.c_str(), path) != 0)
+	{
+		remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+std::string GetMeshInstancePath(const char* filename)
+{
+	return std::string(filename) + ".instance";
+}
+
+std::string GetMeshInstanceReference(const char* filename, const MeshInstanceRecord& record)
+{
+	return std::string(filename, GetDirectoryLength(filename)) + record.reference;
+}
+
+bool WriteMeshInstance(const char* filename, const CookedMeshSource& source, const char* referenceFilename, const CookedMeshSource& referenceSource, const float transform[16])
+{
+	MeshInstanceRecord record;
+	size_t directoryLength, referenceDirectoryLength;
+
+	directoryLength = GetDirectoryLength(filename);
+	referenceDirectoryLength = GetDirectoryLength(referenceFilename);
+	if (directoryLength != referenceDirectoryLength || strncmp(filename, referenceFilename, directoryLength) != 0 ||
+		strlen(referenceFilename + referenceDirectoryLength) >= sizeof(record.reference))
+	{
+		return false;
+	}
+
+	memset(&record, 0, sizeof(record));
+	record.magic = MESH_INSTANCE_MAGIC;
+	record.version = MESH_INSTANCE_VERSION;
+	record.source = source;
+	record.referenceSource = referenceSource;
+	strcpy(record.reference, referenceFilename + referenceDirectoryLength);
+	memcpy(record.transform, transform, sizeof(record.transform));
+
+	return WriteFileAtomically(GetMeshInstancePath(filename).c_str(), &record, sizeof(record));
+}
+
+bool ReadMeshInstance(const char* filename, const CookedMeshSource& source, MeshInstanceRecord& record)
+{
+	MappedFile file;
+
+	if (!file.OpenAsset(GetMeshInstancePath(filename).c_str()) || file.GetSize() != sizeof(record))
+	{
+		return false;
+	}
+
+	memcpy(&record, file.GetData(), sizeof(record));
+
+	if (record.magic != MESH_INSTANCE_MAGIC || record.version != MESH_INSTANCE_VERSION || !SameCookedMeshSource(record.source, source) ||
+		memchr(record.reference, 0, sizeof(record.reference)) == 0 || record.reference[0] == 0)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool SameCookedMeshSource(const CookedMeshSource& a, const CookedMeshSource& b)
+{
+	return a.size == b.size && a.modifiedTime == b.modifiedTime && a.hash == b.hash;
+}
+
+CookedMeshFile::CookedMeshFile()
+{
+	m_header = 0;
+}
+
+CookedMeshFile::~CookedMeshFile()
+{
+}
+
+bool CookedMeshFile::Open(const char* path, const CookedMeshSource& source)
+{
+	const CookedMeshHeader* header;
+	uint64_t size;
+	const MeshCluster* clusters;
+	uint32_t level, cluster;
+
+	Close();
+
+	if (!m_file.OpenAsset(path))
+	{
+		return false;
+	}
+
+	size = m_file.GetSize();
+	header = reinterpret_cast<const CookedMeshHeader*>(m_file.GetData());
+
+	if (size < sizeof(CookedMeshHeader) || header->magic != COOKED_MESH_MAGIC || header->version != COOKED_MESH_VERSION)
+	{
+		Close();
+		return false;
+	}
+
+	// A blob cooked from an older revision of the .obj is ignored and cooked again.
+	if (!SameCookedMeshSource(header->source, source))
+	{
+		Close();
+		return false;
+	}
+
+	if (header->layout >= MESH_LAYOUT_COUNT || header->vertexStride != GetVertexStride((MeshLayout)header->layout) || header->indexSize != GetIndexSize(header->vertexCount) ||
+		header->encoding > COOKED_MESH_COMPRESSED || header->vertexOffset < sizeof(CookedMeshHeader) || !InBlob(header->vertexOffset, header->vertexBytes, size) ||
+		!InBlob(header->indexOffset, header->indexBytes, size) || !InBlob(header->clusterOffset, (uint64_t)header->clusterCount * sizeof(MeshCluster), size))
+	{
+		Close();
+		return false;
+	}
+
+	// Raw arrays are used in place, so they have to be exactly as long as the counts say.
+	if (header->encoding == COOKED_MESH_RAW && (header->vertexBytes != (uint64_t)header->vertexCount * header->vertexStride ||
+		header->indexBytes != (uint64_t)header->indexCount * header->indexSize))
+	{
+		Close();
+		return false;
+	}
+
+	// Encoded arrays are decoded into buffers sized from the counts, so the counts have to be what
+	// the streams decode to before anything is allocated for them.
+	if (header->encoding != COOKED_MESH_RAW &&
+		(GetDecodedSize(m_file.GetData() + header->vertexOffset, header->vertexBytes) != (uint64_t)header->vertexCount * header->vertexStride ||
+		GetDecodedSize(m_file.GetData() + header->indexOffset, header->indexBytes) != (uint64_t)header->indexCount * header->indexSize))
+	{
+		Close();
+		return false;
+	}
+
+	if (header->lodCount > MESH_MAX_LODS || !(header->boundsRadius >= 0.0f))
+	{
+		Close();
+		return false;
+	}
+
+	for (level = 0; level < header->lodCount; level++)
+	{
+		if (header->lods[level].indexCount % 3 != 0 || (uint64_t)header->lods[level].indexOffset + header->lods[level].indexCount > header->indexCount ||
+			(uint64_t)header->lods[level].clusterOffset + header->lods[level].clusterCount > header->clusterCount)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	// Cluster ranges are drawn as they are, so one running past the indices would read past the index buffer.
+	clusters = reinterpret_cast<const MeshCluster*>(m_file.GetData() + header->clusterOffset);
+	for (cluster = 0; cluster < header->clusterCount; cluster++)
+	{
+		if (clusters[cluster].indexCount % 3 != 0 || (uint64_t)clusters[cluster].indexOffset + clusters[cluster].indexCount > header->indexCount)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	m_header = header;
+
+	if (header->encoding != COOKED_MESH_RAW && !Decode())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void CookedMeshFile::Close()
+{
+	m_file.Close();
+	m_header = 0;
+	m_vertices.clear();
+	m_indices.clear();
+
+	return;
+}
+
+const CookedMeshHeader& CookedMeshFile::GetHeader() const
+{
+	return *m_header;
+}
+
+const void* CookedMeshFile::GetVertices() const
+{
+	if (m_header->encoding != COOKED_MESH_RAW)
+	{
+		return m_vertices.data();
+	}
+
+	return m_file.GetData() + m_header->vertexOffset;
+}
+
+const void* CookedMeshFile::GetIndices() const
+{
+	if (m_header->encoding != COOKED_MESH_RAW)
+	{
+		return m_indices.data();
+	}
+
+	return m_file.GetData() + m_header->indexOffset;
+}
+
+const MeshCluster* CookedMeshFile::GetClusters() const
+{
+	return reinterpret_cast<const MeshCluster*>(m_file.GetData() + m_header->clusterOffset);
+}
+
+// Decodes both arrays of an encoded blob into m_vertices and m_indices.
+bool CookedMeshFile::Decode()
+{
+	std::vector<unsigned char> scratch;
+
+	m_vertices.resize((size_t)m_header->vertexCount * m_header->vertexStride);
+	m_indices.resize((size_t)m_header->indexCount * m_header->indexSize);
+
+	if (!DecodeVertexStream(m_file.GetData() + m_header->vertexOffset, (size_t)m_header->vertexBytes, m_header->vertexCount, m_header->vertexStride,
+		m_vertices.data(), scratch))
+	{
+		return false;
+	}
+
+	return DecodeIndexStream(m_file.GetData() + m_header->indexOffset, (size_t)m_header->indexBytes, m_header->indexCount, m_header->indexSize,
+		m_indices.data(), scratch);
+}
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: CookedMesh.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _COOKEDMESH_H_
+#define _COOKEDMESH_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "MeshBuilder.h"
+#include "MeshClusterizer.h"
+#include "MeshCodec.h"
+#include "MeshInstancer.h"
+#include "MeshOptimizer.h"
+#include "MeshQuantizer.h"
+#include "MeshSimplifier.h"
+
+// A cooked mesh is a binary blob holding one layout of one .obj: header, then the vertex array,
+// then the 16 or 32 bit index array holding every level of detail back to back, then the clusters
+// of every level. The two arrays are stored either exactly as they are uploaded, or as MeshCodec
+// streams that are decoded on open. It is only reused while the .obj it was cooked from still
+// has the same size, modification time and content hash.
+const uint32_t COOKED_MESH_MAGIC = 0x48534D43;	// "CMSH"
+const uint32_t COOKED_MESH_VERSION = 10;
+
+enum CookedMeshEncoding
+{
+	COOKED_MESH_RAW = 0,		// uploaded straight from the mapping
+	COOKED_MESH_ENCODED = 1,	// filtered MeshCodec streams
+	COOKED_MESH_COMPRESSED = 2	// filtered and, where it pays off, compressed MeshCodec streams
+};
+
+// Identifies the exact .obj a blob was cooked from.
+struct CookedMeshSource
+{
+	uint64_t size;
+	int64_t modifiedTime;
+	uint64_t hash;
+};
+
+struct CookedMeshHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t layout;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	uint32_t lodCount;		// 0 when the mesh was cooked without levels of detail
+	uint32_t clusterCount;	// 0 when the mesh was cooked without clusters
+	uint32_t encoding;		// CookedMeshEncoding
+	CookedMeshSource source;
+	float boundsMin[3];
+	float boundsMax[3];
+	float boundsCenter[3];
+	float boundsRadius;
+	MeshQuantization quantization;
+	MeshLod lods[MESH_MAX_LODS];
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t clusterOffset;
+	uint64_t vertexBytes;	// as stored, encoded or not
+	uint64_t indexBytes;
+};
+
+struct MeshCookOptions
+{
+	bool optimize;		// vertex cache, overdraw and vertex fetch order
+	bool generateLods;	// coarser levels of detail after the full detail triangles, see MeshSimplifier.h
+	bool buildClusters;	// cullable clusters in every level, see MeshClusterizer.h
+	float shadowProxyError;	// shadow map layout only: simplified within this many model units first, see BuildShadowProxy; 0 keeps every triangle
+};
+
+struct ShadowProxyReport
+{
+	unsigned int sourceVertexCount;		// welded, before simplification
+	unsigned int sourceTriangleCount;
+	float error;
+};
+
+struct MeshCookReport
+{
+	MeshOptimizeReport optimize;
+	QuantizationError quantization;	// packed layouts only
+	ShadowProxyReport shadowProxy;	// shadow map layout with a proxy error only
+};
+
+// Everything between a parsed .obj and the vertices and indices that are uploaded: builds the
+// float layout, reduces a shadow map layout to its shadow caster proxy, optimises it, generates
+// its levels of detail, splits them into clusters and quantizes it when a packed layout is asked
+// for. report may be null.
+bool CookMesh(const ObjMesh& obj, MeshLayout layout, const MeshCookOptions& options, MeshData& mesh, MeshCookReport* report);
+
+// Reads the size and modification time of the .obj and hashes its contents, or takes all three
+// from the table of contents when the .obj is in the mounted asset archive.
+bool GetCookedMeshSource(const char* filename, CookedMeshSource& source);
+
+// Same for an .obj whose contents have been read already, which are hashed instead of mapping it again.
+bool GetCookedMeshSource(const char* filename, const char* data, size_t size, CookedMeshSource& source);
+
+// Where the blob for one layout of an .obj lives, e.g. "igloo.obj" -> "igloo.obj.sm.mesh".
+std::string GetCookedMeshPath(const char* filename, MeshLayout layout);
+
+bool WriteCookedMesh(const char* path, const MeshData& mesh, const CookedMeshSource& source, CookedMeshEncoding encoding);
+
+// An .obj that is another .obj of the same directory moved rigidly, see MeshInstancer.h, gets an
+// instance record instead of blobs of its own: the reference's name and the transform that
+// carries the reference onto it. It is only used while both files are the revisions it was made from.
+const uint32_t MESH_INSTANCE_MAGIC = 0x534E494D;	// "MINS"
+const uint32_t MESH_INSTANCE_VERSION = 1;
+
+struct MeshInstanceRecord
+{
+	uint32_t magic;
+	uint32_t version;
+	CookedMeshSource source;
+	CookedMeshSource referenceSource;
+	char reference[256];	// file name of the reference, without its directory
+	float transform[16];	// reference model space -> this .obj's model space, DirectXMath row vectors
+};
+
+// Where the record for an .obj lives, e.g. "deadwood2.obj" -> "deadwood2.obj.instance".
+std::string GetMeshInstancePath(const char* filename);
+
+// The reference's path, in the directory of filename.
+std::string GetMeshInstanceReference(const char* filename, const MeshInstanceRecord& record);
+
+// Fails if the reference lives in another directory than filename.
+bool WriteMeshInstance(const char* filename, const CookedMeshSource& source, const char* referenceFilename, const CookedMeshSource& referenceSource, const float transform[16]);
+
+// Fails if the record is missing, corrupt, from another format version, or stale with respect to source.
+// The caller still has to compare record.referenceSource with the reference it finds.
+bool ReadMeshInstance(const char* filename, const CookedMeshSource& source, MeshInstanceRecord& record);
+
+bool SameCookedMeshSource(const CookedMeshSource& a, const CookedMeshSource& b);
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: CookedMeshFile
+////////////////////////////////////////////////////////////////////////////////
+
+// Memory mapped view of a cooked mesh. The vertex and index pointers point straight into the
+// mapping of a raw blob, or at the arrays an encoded one was decoded into, and stay valid until
+// the file is closed.
+class CookedMeshFile
+{
+public:
+	CookedMeshFile();
+	~CookedMeshFile();
+
+	// Fails if the blob is missing, corrupt, from another format version, or stale with
+	// respect to source. Encoded blobs are decoded here, on the calling thread.
+	bool Open(const char* path, const CookedMeshSource& source);
+	void Close();
+
+	const CookedMeshHeader& GetHeader() const;
+	const void* GetVertices() const;
+	const void* GetIndices() const;
+	const MeshCluster* GetClusters() const;
+
+private:
+	bool Decode();
+
+private:
+	MappedFile m_file;
+	const CookedMeshHeader* m_header;
+	std::vector<unsigned char> m_vertices;	// decoded arrays, empty for a raw blob
+	std::vector<unsigned char> m_indices;
+};
+
+#endif
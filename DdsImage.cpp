@@ -0,0 +1,425 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: DdsImage.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "DdsImage.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const uint32_t s_ddsMagic = 0x20534444;	// "DDS "
+
+	const uint32_t s_pixelFormatFourCC = 0x4;
+	const uint32_t s_pixelFormatRgb = 0x40;
+	const uint32_t s_pixelFormatLuminance = 0x20000;
+	const uint32_t s_pixelFormatAlpha = 0x2;
+	const uint32_t s_pixelFormatBumpDuDv = 0x80000;
+
+	const uint32_t s_headerFlagsTexture = 0x1007;	// caps, height, width, pixel format
+	const uint32_t s_headerFlagsMipMapCount = 0x20000;
+	const uint32_t s_headerFlagsPitch = 0x8;
+	const uint32_t s_headerFlagsLinearSize = 0x80000;
+	const uint32_t s_headerFlagsVolume = 0x800000;
+	const uint32_t s_capsTexture = 0x1000;
+	const uint32_t s_capsComplex = 0x8;
+	const uint32_t s_capsMipMap = 0x400000;
+	const uint32_t s_caps2Cubemap = 0x200;
+	const uint32_t s_caps2AllFaces = 0xfc00;
+	const uint32_t s_caps2Volume = 0x200000;
+	const uint32_t s_miscTextureCube = 0x4;
+
+	// D3D 11 limits.
+	const uint32_t s_maxMipLevels = 15;
+	const uint32_t s_max1DSize = 16384;
+	const uint32_t s_max2DSize = 16384;
+	const uint32_t s_max3DSize = 2048;
+	const uint32_t s_maxArraySize = 2048;
+
+	struct DdsPixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t rBitMask;
+		uint32_t gBitMask;
+		uint32_t bBitMask;
+		uint32_t aBitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		DdsPixelFormat pixelFormat;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	struct DdsHeaderDx10
+	{
+		uint32_t format;
+		uint32_t dimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+
+	inline uint32_t FourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) | ((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+	}
+
+	inline bool HasMasks(const DdsPixelFormat& format, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		return format.rBitMask == r && format.gBitMask == g && format.bBitMask == b && format.aBitMask == a;
+	}
+
+	// The DXGI format of a file without the DX10 header, for the layouts DirectXTK's loader takes as
+	// they are; the ones it has to convert come back unknown.
+	uint32_t GetLegacyFormat(const DdsPixelFormat& format)
+	{
+		if (format.flags & s_pixelFormatRgb)
+		{
+			switch (format.rgbBitCount)
+			{
+			case 32:
+				if (HasMasks(format, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DDS_FORMAT_R8G8B8A8_UNORM;
+				if (HasMasks(format, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) return DDS_FORMAT_B8G8R8A8_UNORM;
+				if (HasMasks(format, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000)) return DDS_FORMAT_B8G8R8X8_UNORM;
+				if (HasMasks(format, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) return 35;	// R16G16_UNORM
+				if (HasMasks(format, 0xffffffff, 0x00000000, 0x00000000, 0x00000000)) return 41;	// R32_FLOAT
+				break;
+			case 16:
+				if (HasMasks(format, 0x7c00, 0x03e0, 0x001f, 0x8000)) return 86;	// B5G5R5A1_UNORM
+				if (HasMasks(format, 0xf800, 0x07e0, 0x001f, 0x0000)) return 85;	// B5G6R5_UNORM
+				if (HasMasks(format, 0x0f00, 0x00f0, 0x000f, 0xf000)) return 115;	// B4G4R4A4_UNORM
+				break;
+			}
+		}
+		else if (format.flags & s_pixelFormatLuminance)
+		{
+			if (format.rgbBitCount == 8 && HasMasks(format, 0xff, 0, 0, 0)) return DDS_FORMAT_R8_UNORM;
+			if (format.rgbBitCount == 16 && HasMasks(format, 0xffff, 0, 0, 0)) return 56;		// R16_UNORM
+			if (format.rgbBitCount == 16 && HasMasks(format, 0x00ff, 0, 0, 0xff00)) return DDS_FORMAT_R8G8_UNORM;
+		}
+		else if (format.flags & s_pixelFormatAlpha)
+		{
+			if (format.rgbBitCount == 8) return DDS_FORMAT_A8_UNORM;
+		}
+		else if (format.flags & s_pixelFormatBumpDuDv)
+		{
+			if (format.rgbBitCount == 16 && HasMasks(format, 0x00ff, 0xff00, 0, 0)) return 51;					// R8G8_SNORM
+			if (format.rgbBitCount == 32 && HasMasks(format, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return 31;	// R8G8B8A8_SNORM
+			if (format.rgbBitCount == 32 && HasMasks(format, 0x0000ffff, 0xffff0000, 0, 0)) return 37;			// R16G16_SNORM
+		}
+		else if (format.flags & s_pixelFormatFourCC)
+		{
+			if (format.fourCC == FourCC('D', 'X', 'T', '1')) return DDS_FORMAT_BC1_UNORM;
+			if (format.fourCC == FourCC('D', 'X', 'T', '2') || format.fourCC == FourCC('D', 'X', 'T', '3')) return DDS_FORMAT_BC2_UNORM;
+			if (format.fourCC == FourCC('D', 'X', 'T', '4') || format.fourCC == FourCC('D', 'X', 'T', '5')) return DDS_FORMAT_BC3_UNORM;
+			if (format.fourCC == FourCC('A', 'T', 'I', '1') || format.fourCC == FourCC('B', 'C', '4', 'U')) return DDS_FORMAT_BC4_UNORM;
+			if (format.fourCC == FourCC('B', 'C', '4', 'S')) return 81;	// BC4_SNORM
+			if (format.fourCC == FourCC('A', 'T', 'I', '2') || format.fourCC == FourCC('B', 'C', '5', 'U')) return DDS_FORMAT_BC5_UNORM;
+			if (format.fourCC == FourCC('B', 'C', '5', 'S')) return 84;	// BC5_SNORM
+
+			// Old D3DFORMAT values stored as the FourCC.
+			switch (format.fourCC)
+			{
+			case 36: return 11;		// R16G16B16A16_UNORM
+			case 110: return 13;	// R16G16B16A16_SNORM
+			case 111: return 54;	// R16_FLOAT
+			case 112: return 34;	// R16G16_FLOAT
+			case 113: return 10;	// R16G16B16A16_FLOAT
+			case 114: return 41;	// R32_FLOAT
+			case 115: return 16;	// R32G32_FLOAT
+			case 116: return 2;		// R32G32B32A32_FLOAT
+			}
+		}
+
+		return DDS_FORMAT_UNKNOWN;
+	}
+
+	// Bytes per 4x4 block of the block compressed formats, 0 for the others.
+	uint32_t GetBlockBytes(uint32_t format)
+	{
+		if ((format >= 70 && format <= 72) || (format >= 79 && format <= 81))
+		{
+			return 8;		// BC1, BC4
+		}
+		if ((format >= 73 && format <= 78) || (format >= 82 && format <= 84) || (format >= 94 && format <= 99))
+		{
+			return 16;		// BC2, BC3, BC5, BC6H, BC7
+		}
+
+		return 0;
+	}
+
+	// Bits per pixel of the uncompressed formats with one pixel per element, 0 for the others.
+	uint32_t GetBitsPerPixel(uint32_t format)
+	{
+		if (format >= 1 && format <= 4) return 128;
+		if (format >= 5 && format <= 8) return 96;
+		if (format >= 9 && format <= 22) return 64;
+		if ((format >= 23 && format <= 47) || format == 67 || (format >= 87 && format <= 93)) return 32;
+		if ((format >= 48 && format <= 59) || format == 85 || format == 86 || format == 115) return 16;
+		if (format >= 60 && format <= 65) return 8;
+
+		return 0;
+	}
+}
+
+bool GetDdsSurfacePitch(uint32_t format, uint32_t width, uint32_t height, size_t& rowPitch, size_t& slicePitch)
+{
+	uint32_t blockBytes = GetBlockBytes(format);
+	uint32_t bitsPerPixel = GetBitsPerPixel(format);
+
+	if (blockBytes)
+	{
+		rowPitch = (size_t)((width + 3) / 4) * blockBytes;
+		slicePitch = rowPitch * ((height + 3) / 4);
+		return true;
+	}
+
+	if (bitsPerPixel)
+	{
+		rowPitch = ((size_t)width * bitsPerPixel + 7) / 8;
+		slicePitch = rowPitch * height;
+		return true;
+	}
+
+	return false;
+}
+
+bool IsDdsBlockCompressed(uint32_t format)
+{
+	return GetBlockBytes(format) != 0;
+}
+
+bool ParseDds(const char* data, size_t size, DdsImage& image)
+{
+	DdsHeader header;
+	DdsHeaderDx10 extension;
+	const char* surface;
+	const char* end = data + size;
+	uint32_t magic, item, itemCount, mip, maxSize;
+	size_t offset;
+
+	image.surfaces.clear();
+
+	if (size < sizeof(magic) + sizeof(header))
+	{
+		return false;
+	}
+
+	memcpy(&magic, data, sizeof(magic));
+	memcpy(&header, data + sizeof(magic), sizeof(header));
+	offset = sizeof(magic) + sizeof(header);
+
+	if (magic != s_ddsMagic || header.size != sizeof(DdsHeader) || header.pixelFormat.size != sizeof(DdsPixelFormat) ||
+		header.width == 0 || header.height == 0)
+	{
+		return false;
+	}
+
+	image.width = header.width;
+	image.height = header.height;
+	image.depth = 1;
+	image.mipCount = header.mipMapCount ? header.mipMapCount : 1;
+	image.arraySize = 1;
+	image.cube = false;
+
+	if ((header.pixelFormat.flags & s_pixelFormatFourCC) && header.pixelFormat.fourCC == FourCC('D', 'X', '1', '0'))
+	{
+		if (size < offset + sizeof(extension))
+		{
+			return false;
+		}
+		memcpy(&extension, data + offset, sizeof(extension));
+		offset += sizeof(extension);
+
+		image.format = extension.format;
+		image.dimension = extension.dimension;
+		image.arraySize = extension.arraySize;
+
+		if (image.arraySize == 0 || image.dimension < DDS_DIMENSION_TEXTURE1D || image.dimension > DDS_DIMENSION_TEXTURE3D)
+		{
+			return false;
+		}
+
+		if (image.dimension == DDS_DIMENSION_TEXTURE1D)
+		{
+			image.height = 1;
+		}
+		else if (image.dimension == DDS_DIMENSION_TEXTURE2D && (extension.miscFlag & s_miscTextureCube))
+		{
+			image.cube = true;
+			image.arraySize *= 6;
+		}
+		else if (image.dimension == DDS_DIMENSION_TEXTURE3D)
+		{
+			if (!(header.flags & s_headerFlagsVolume) || image.arraySize != 1)
+			{
+				return false;
+			}
+			image.depth = header.depth ? header.depth : 1;
+		}
+	}
+	else
+	{
+		image.format = GetLegacyFormat(header.pixelFormat);
+		image.dimension = DDS_DIMENSION_TEXTURE2D;
+
+		if (header.flags & s_headerFlagsVolume)
+		{
+			image.dimension = DDS_DIMENSION_TEXTURE3D;
+			image.depth = header.depth ? header.depth : 1;
+		}
+		else if (header.caps2 & s_caps2Cubemap)
+		{
+			// D3D cannot create a cube map with faces missing.
+			if ((header.caps2 & s_caps2AllFaces) != s_caps2AllFaces)
+			{
+				return false;
+			}
+			image.cube = true;
+			image.arraySize = 6;
+		}
+		else if (header.caps2 & s_caps2Volume)
+		{
+			return false;
+		}
+	}
+
+	maxSize = image.dimension == DDS_DIMENSION_TEXTURE1D ? s_max1DSize : (image.dimension == DDS_DIMENSION_TEXTURE3D ? s_max3DSize : s_max2DSize);
+	if (image.width > maxSize || image.height > maxSize || image.depth > maxSize || image.arraySize > s_maxArraySize * (image.cube ? 6 : 1) ||
+		image.mipCount > s_maxMipLevels || (image.cube && image.width != image.height))
+	{
+		return false;
+	}
+
+	// No mip can be smaller than one pixel, so a full chain has one level per halving of the largest side.
+	for (mip = 1, maxSize = image.width | image.height | image.depth; maxSize > 1; maxSize >>= 1)
+	{
+		mip++;
+	}
+	if (image.mipCount > mip)
+	{
+		return false;
+	}
+
+	itemCount = image.arraySize;
+	surface = data + offset;
+	image.surfaces.reserve((size_t)itemCount * image.mipCount);
+
+	for (item = 0; item < itemCount; item++)
+	{
+		uint32_t width = image.width, height = image.height, depth = image.depth;
+
+		for (mip = 0; mip < image.mipCount; mip++)
+		{
+			DdsSurface level;
+			uint64_t bytes;
+
+			if (!GetDdsSurfacePitch(image.format, width, height, level.rowPitch, level.slicePitch))
+			{
+				image.surfaces.clear();
+				return false;
+			}
+
+			bytes = (uint64_t)level.slicePitch * depth;
+			if (bytes > (uint64_t)(end - surface))
+			{
+				image.surfaces.clear();
+				return false;
+			}
+
+			level.data = surface;
+			level.width = width;
+			level.height = height;
+			level.depth = depth;
+			image.surfaces.push_back(level);
+
+			surface += bytes;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+			depth = depth > 1 ? depth / 2 : 1;
+		}
+	}
+
+	return true;
+}
+
+bool WriteDds(const char* filename, const DdsImage& image)
+{
+	DdsHeader header;
+	DdsHeaderDx10 extension;
+	FILE* file;
+	bool written;
+	size_t i;
+
+	if (image.surfaces.empty())
+	{
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(DdsHeader);
+	header.flags = s_headerFlagsTexture | s_headerFlagsMipMapCount;
+	header.flags |= GetBlockBytes(image.format) ? s_headerFlagsLinearSize : s_headerFlagsPitch;
+	header.height = image.height;
+	header.width = image.width;
+	header.pitchOrLinearSize = (uint32_t)(GetBlockBytes(image.format) ? image.surfaces[0].slicePitch : image.surfaces[0].rowPitch);
+	header.depth = image.depth;
+	header.mipMapCount = image.mipCount;
+	header.pixelFormat.size = sizeof(DdsPixelFormat);
+	header.pixelFormat.flags = s_pixelFormatFourCC;
+	header.pixelFormat.fourCC = FourCC('D', 'X', '1', '0');
+	header.caps = s_capsTexture | (image.mipCount > 1 ? s_capsMipMap | s_capsComplex : 0);
+
+	memset(&extension, 0, sizeof(extension));
+	extension.format = image.format;
+	extension.dimension = image.dimension;
+	extension.arraySize = image.cube ? image.arraySize / 6 : image.arraySize;
+
+	if (image.dimension == DDS_DIMENSION_TEXTURE3D)
+	{
+		header.flags |= s_headerFlagsVolume;
+		header.caps2 = s_caps2Volume;
+		header.caps |= s_capsComplex;
+	}
+	else if (image.cube)
+	{
+		header.caps2 = s_caps2Cubemap | s_caps2AllFaces;
+		header.caps |= s_capsComplex;
+		extension.miscFlag = s_miscTextureCube;
+	}
+
+	file = fopen(filename, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	written = fwrite(&s_ddsMagic, sizeof(s_ddsMagic), 1, file) == 1;
+	written = written && fwrite(&header, sizeof(header), 1, file) == 1;
+	written = written && fwrite(&extension, sizeof(extension), 1, file) == 1;
+	for (i = 0; written && i < image.surfaces.size(); i++)
+	{
+		const DdsSurface& surface = image.surfaces[i];
+
+		written = fwrite(surface.data, surface.slicePitch * surface.depth, 1, file) == 1;
+	}
+
+	return (fclose(file) == 0) && written;
+}
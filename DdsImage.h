@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: DdsImage.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _DDSIMAGE_H_
+#define _DDSIMAGE_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The layout of a .dds file already in memory: its header checked and every surface located, so
+// the surfaces can be handed to D3D as the initial data of a texture without copying them. Kept
+// free of any D3D/pch dependency so the texture tools can use it outside the game; formats are
+// DXGI_FORMAT values and dimensions D3D11_RESOURCE_DIMENSION values.
+const uint32_t DDS_FORMAT_UNKNOWN = 0;
+const uint32_t DDS_FORMAT_R8G8B8A8_UNORM = 28;
+const uint32_t DDS_FORMAT_R8G8B8A8_UNORM_SRGB = 29;
+const uint32_t DDS_FORMAT_R8G8_UNORM = 49;
+const uint32_t DDS_FORMAT_R8_UNORM = 61;
+const uint32_t DDS_FORMAT_A8_UNORM = 65;
+const uint32_t DDS_FORMAT_BC1_UNORM = 71;
+const uint32_t DDS_FORMAT_BC1_UNORM_SRGB = 72;
+const uint32_t DDS_FORMAT_BC2_UNORM = 74;
+const uint32_t DDS_FORMAT_BC2_UNORM_SRGB = 75;
+const uint32_t DDS_FORMAT_BC3_UNORM = 77;
+const uint32_t DDS_FORMAT_BC3_UNORM_SRGB = 78;
+const uint32_t DDS_FORMAT_BC4_UNORM = 80;
+const uint32_t DDS_FORMAT_BC5_UNORM = 83;
+const uint32_t DDS_FORMAT_B8G8R8A8_UNORM = 87;
+const uint32_t DDS_FORMAT_B8G8R8X8_UNORM = 88;
+const uint32_t DDS_FORMAT_B8G8R8A8_UNORM_SRGB = 91;
+const uint32_t DDS_FORMAT_BC7_UNORM = 98;
+const uint32_t DDS_FORMAT_BC7_UNORM_SRGB = 99;
+
+const uint32_t DDS_DIMENSION_TEXTURE1D = 2;
+const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+const uint32_t DDS_DIMENSION_TEXTURE3D = 4;
+
+struct DdsSurface
+{
+	const char* data;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	size_t rowPitch;		// bytes per row of pixels, or of 4x4 blocks in the block compressed formats
+	size_t slicePitch;		// bytes per depth slice
+};
+
+struct DdsImage
+{
+	uint32_t dimension;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	uint32_t mipCount;
+	uint32_t arraySize;		// cube faces included, as D3D counts them
+	bool cube;
+	std::vector<DdsSurface> surfaces;	// every mip of the first item, then of the next, the order D3D numbers subresources in
+};
+
+// Fails on anything D3D 11 could not create from the file as it is: bad headers, sizes past D3D's
+// limits, surfaces running past the data, and formats without a fixed pitch (the packed YUV ones)
+// or with no DXGI equivalent (24 bit RGB, paletted). Those are left to DirectXTK's converting loader.
+bool ParseDds(const char* data, size_t size, DdsImage& image);
+
+// Writes the image with the DX10 header, whatever its format, the surfaces in the order they are in.
+bool WriteDds(const char* filename, const DdsImage& image);
+
+// Bytes per row and per slice of one surface; false for formats ParseDds does not lay out.
+bool GetDdsSurfacePitch(uint32_t format, uint32_t width, uint32_t height, size_t& rowPitch, size_t& slicePitch);
+
+// Whether the format is stored in 4x4 blocks, whose textures D3D wants a multiple of 4 across.
+bool IsDdsBlockCompressed(uint32_t format);
+
+#endif
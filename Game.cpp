@@ -13,7 +13,6 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-
 Game::Game() noexcept(false)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
@@ -21,6 +20,7 @@ Game::Game() noexcept(false)
     m_ParticleSystem = 0;
     m_ParticleShader = 0;
     m_CameraMiniMapHeight = 7.0f;
+    m_textureBudget = 128ull * 1024 * 1024;
     firePosX = -42.32f;
     firePosY = 2.0f;
     firePosZ = -18.12f;
@@ -44,6 +44,14 @@ void Game::Initialize(HWND window, int width, int height)
     m_deviceResources->SetWindow(window, width, height);
 
     m_deviceResources->CreateDeviceResources();
+
+    // Everything the scene loads by name comes from one mapped file when the packer has built it,
+    // see Tools/AssetCooker. Without it every asset is opened from the working directory.
+    if (MountAssetArchive("assets.pak"))
+    {
+        OutputDebugStringA("Loading assets from assets.pak\n");
+    }
+
     CreateDeviceDependentResources();
 
     m_deviceResources->CreateWindowSizeDependentResources();
@@ -278,7 +286,11 @@ void Game::Update(DX::StepTimer const& timer)
     }
 #endif
 
-  
+    // Textures follow what this frame will draw, see TextureStreamer.h.
+    m_textures.BeginFrame();
+    RequestTextureFootprints();
+    m_textures.Update();
+
 	if (m_input.Quit())
 	{
 		ExitGame();
@@ -344,143 +356,169 @@ void Game::Render()
 	
     /* Ground */
     m_BasicShaderPairTiling.EnableShader(context);
-    m_BasicShaderPairTiling.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texSnow.Get(), m_texSnowNormal.Get(), m_shadowResourceView.Get());
-    m_GroundBoxNM.Render(context);
+    m_BasicShaderPairTiling.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texSnow), m_textures.Get(m_texSnowNormal), m_shadowResourceView.Get());
+    m_GroundBoxNM.Render(context, m_world, m_view, m_projection);
 
     // Turn shaders with no specular highlight on
     m_BasicShaderPairNoSpec.EnableShader(context);
    
     /* Mountains */
 	// mountain1
-	m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texSnowMountain.Get(), m_texSnowMountainNormalMap.Get(), m_shadowResourceView.Get());
-	m_Mountain1NM.Render(context);    
+	m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texSnowMountain), m_textures.Get(m_texSnowMountainNormalMap), m_shadowResourceView.Get());
+	m_Mountain1NM.Render(context, m_world, m_view, m_projection);    
     // mountain2
-    m_Mountain2NM.Render(context);
+    m_Mountain2NM.Render(context, m_world, m_view, m_projection);
     // glacier1
-    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texGlacier.Get(), m_texGlacierNormalMap.Get(), m_shadowResourceView.Get());
-    m_Glacier1NM.Render(context);
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texGlacier), m_textures.Get(m_texGlacierNormalMap), m_shadowResourceView.Get());
+    m_Glacier1NM.Render(context, m_world, m_view, m_projection);
     // glacier2
-    m_Glacier2NM.Render(context);
+    m_Glacier2NM.Render(context, m_world, m_view, m_projection);
 
     /* Deadwoods */
+    // Copies of one log, each drawn through its own instance transform.
     // deadwood1
-    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texDeadwood.Get(), m_texDeadwoodNormal.Get(), m_shadowResourceView.Get());
-    m_Deadwood1NM.Render(context);
+    m_world = m_Deadwood1NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood1NM.Render(context, m_world, m_view, m_projection);
     // deadwood2
-    m_Deadwood2NM.Render(context);
+    m_world = m_Deadwood2NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood2NM.Render(context, m_world, m_view, m_projection);
     // deadwood3
-    m_Deadwood3NM.Render(context);
+    m_world = m_Deadwood3NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood3NM.Render(context, m_world, m_view, m_projection);
     // deadwood4
-    m_Deadwood4NM.Render(context);
+    m_world = m_Deadwood4NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood4NM.Render(context, m_world, m_view, m_projection);
     // deadwood5
-    m_Deadwood5NM.Render(context);
+    m_world = m_Deadwood5NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood5NM.Render(context, m_world, m_view, m_projection);
     // deadwood6
-    m_Deadwood6NM.Render(context);
+    m_world = m_Deadwood6NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood6NM.Render(context, m_world, m_view, m_projection);
     // deadwood7
-    m_Deadwood7NM.Render(context);
+    m_world = m_Deadwood7NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood7NM.Render(context, m_world, m_view, m_projection);
     // deadwood8
-    m_Deadwood8NM.Render(context);
+    m_world = m_Deadwood8NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood8NM.Render(context, m_world, m_view, m_projection);
     // deadwood9
-    m_Deadwood9NM.Render(context);
+    m_world = m_Deadwood9NM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
+    m_Deadwood9NM.Render(context, m_world, m_view, m_projection);
+    m_world = SimpleMath::Matrix::Identity;
 
     //* Camp */
     // igloo
     m_BasicShaderPairNoSpecNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texIgloo.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texIgloo), m_shadowResourceView.Get());
     m_CampIgloo.Render(context);
     // crow
     m_BasicShaderPairNoSpec.EnableShader(context);
-    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texCrow.Get(), m_texCrowNormal.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texCrow), m_textures.Get(m_texCrowNormal), m_shadowResourceView.Get());
     m_CampCrowNM.Render(context);
     // dirty snow patch
     m_BasicShaderPairNoSpecNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texTerrain.Get(), m_shadowResourceView.Get());
-    m_CampSnow.Render(context);
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texTerrain), m_shadowResourceView.Get());
+    m_CampSnow.Render(context, m_world, m_view, m_projection);
     // stone
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texCampStones.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texCampStones), m_shadowResourceView.Get());
     m_CampStones.Render(context);
     // tree stones
     m_BasicShaderPairNoSpec.EnableShader(context);
-    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texCampTreeStones.Get(), m_texCampTreeStonesNormal.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texCampTreeStones), m_textures.Get(m_texCampTreeStonesNormal), m_shadowResourceView.Get());
     m_CampTreeStonesNM.Render(context);
     // tree
-    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texDeadwood.Get(), m_texDeadwoodNormal.Get(), m_shadowResourceView.Get());
+    m_world = m_CampDeadwoodNM.GetInstanceTransform();
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_textures.Get(m_texDeadwoodNormal), m_shadowResourceView.Get());
     m_CampDeadwoodNM.Render(context);
+    m_world = SimpleMath::Matrix::Identity;
     // ice border
     m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texSnow.Get(), m_texSnowNormal.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texSnow), m_textures.Get(m_texSnowNormal), m_shadowResourceView.Get());
     m_CampIceBorderNM.Render(context);    
     // ice
     m_BasicShaderPairIce.EnableShader(context);
-    m_BasicShaderPairIce.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texIce.Get(), m_texIceNormal.Get(), m_shadowResourceView.Get(), m_texFog.Get());    
+    m_BasicShaderPairIce.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texIce), m_textures.Get(m_texIceNormal), m_shadowResourceView.Get(), m_textures.Get(m_texFog));    
     m_CampIceNM.Render(context);
     // estus flask
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texEF.Get(), m_texEFNormal.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texEF), m_textures.Get(m_texEFNormal), m_shadowResourceView.Get());
     m_CampEstusNM.Render(context);    
 
     /* Bonfire */
     // stones
     m_BasicShaderPairNoSpec.EnableShader(context);
-    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfStones.Get(), m_texBfStonesNormal.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfStones), m_textures.Get(m_texBfStonesNormal), m_shadowResourceView.Get());
     m_BfStonesNM.Render(context);
     // ash
-    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfAsh.Get(), m_texBfAshNormal.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpec.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfAsh), m_textures.Get(m_texBfAshNormal), m_shadowResourceView.Get());
     m_BfAshNM.Render(context);
     // skulls
     m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfSkulls.Get(), m_texBfSkullsNormal.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfSkulls), m_textures.Get(m_texBfSkullsNormal), m_shadowResourceView.Get());
     m_BfSkullsNM.Render(context);
     // bones
     m_BasicShaderPairNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfBones.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfBones), m_shadowResourceView.Get());
     m_BfBones.Render(context);
     // blade
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfBlade.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfBlade), m_shadowResourceView.Get());
     m_BfBlade.Render(context);
     // hilt
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfHilt.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfHilt), m_shadowResourceView.Get());
     m_BfHilt.Render(context);
     
     /*Foliage*/
     // deadbush1
     m_BasicShaderPairNoSpecNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageDeadBush.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageDeadBush), m_shadowResourceView.Get());
     m_FoliageDeadBush1.Render(context);
     // deadbush2
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageDeadBush.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageDeadBush), m_shadowResourceView.Get());
     m_FoliageDeadBush2.Render(context);
     // deadbush3
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageDeadBush.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageDeadBush), m_shadowResourceView.Get());
     m_FoliageDeadBush3.Render(context);
     // fern
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageFern.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageFern), m_shadowResourceView.Get());
     m_FoliageFern.Render(context);
     // grass1
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_world = m_FoliageGrass1.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass1.Render(context);
     // grass2
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_world = m_FoliageGrass2.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass2.Render(context);
     // grass3
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_world = m_FoliageGrass3.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass3.Render(context);
     // grass4
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_world = m_FoliageGrass4.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass4.Render(context);
+    m_world = SimpleMath::Matrix::Identity;
     // grass5
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass5.Render(context);
     // grass6
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass6.Render(context);
     // grass7
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass7.Render(context);
     // grass8
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass8.Render(context);
     // grass9
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass9.Render(context);
 
     /* Particle System */
@@ -488,7 +526,7 @@ void Game::Render()
     //// Put the particle system vertex and index buffers on the graphics pipeline to prepare them for drawing.
     //m_ParticleSystem->Render(context);
     //// Render the model using the texture shader.
-    //m_ParticleShader->Render(context, m_ParticleSystem->GetIndexCount(), &m_world, &m_view, &m_projection, m_texStar.Get());
+    //m_ParticleShader->Render(context, m_ParticleSystem->GetIndexCount(), &m_world, &m_view, &m_projection, m_textures.Get(m_texStar));
 
     /* Fire */
     DirectX::SimpleMath::Vector3 scrollSpeeds, scales;
@@ -523,7 +561,7 @@ void Game::Render()
     
     m_BasicShaderPairFire.EnableShader(context);
     m_BasicShaderPairFire.SetShaderParameters(context, &m_world, &m_view, &m_projection,
-           m_texFire.Get(), m_texFireNoise.Get(), m_texFireAlpha.Get(), time, scrollSpeeds,
+           m_textures.Get(m_texFire), m_textures.Get(m_texFireNoise), m_textures.Get(m_texFireAlpha), time, scrollSpeeds,
            scales, distortion1, distortion2, distortion3, distortionScale, distortionBias);
     m_Fire.Render(context);
 
@@ -571,33 +609,54 @@ void Game::RenderShadowMap()
 
     /* Mountains */
     // mountain1
-    m_Mountain1SM.Render(context);
+    m_Mountain1SM.Render(context, m_world, m_LightView, m_LightProjection);
     // mountain2
-    m_Mountain2SM.Render(context);
+    m_Mountain2SM.Render(context, m_world, m_LightView, m_LightProjection);
     // glacier1
-    m_Glacier1SM.Render(context);
+    m_Glacier1SM.Render(context, m_world, m_LightView, m_LightProjection);
     // glacier2
-    m_Glacier2SM.Render(context);
+    m_Glacier2SM.Render(context, m_world, m_LightView, m_LightProjection);
 
     /* Deadwoods */
+    // Copies of one log, each drawn through its own instance transform.
     // deadwood1
-    m_Deadwood1SM.Render(context);
+    m_world = m_Deadwood1SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood1SM.Render(context, m_world, m_LightView, m_LightProjection);
     // deadwood2
-    m_Deadwood2SM.Render(context);
+    m_world = m_Deadwood2SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood2SM.Render(context, m_world, m_LightView, m_LightProjection);
     // deadwood3
-    m_Deadwood3SM.Render(context);
+    m_world = m_Deadwood3SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood3SM.Render(context, m_world, m_LightView, m_LightProjection);
     // deadwood4
-    m_Deadwood4SM.Render(context);
+    m_world = m_Deadwood4SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood4SM.Render(context, m_world, m_LightView, m_LightProjection);
     // deadwood5
-    m_Deadwood5SM.Render(context);
+    m_world = m_Deadwood5SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood5SM.Render(context, m_world, m_LightView, m_LightProjection);
     // deadwood6
-    m_Deadwood6SM.Render(context);
+    m_world = m_Deadwood6SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood6SM.Render(context, m_world, m_LightView, m_LightProjection);
     // deadwood7
-    m_Deadwood7SM.Render(context);
+    m_world = m_Deadwood7SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood7SM.Render(context, m_world, m_LightView, m_LightProjection);
     // deadwood8
-    m_Deadwood8SM.Render(context);
+    m_world = m_Deadwood8SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood8SM.Render(context, m_world, m_LightView, m_LightProjection);
     // deadwood9
-    m_Deadwood9SM.Render(context);
+    m_world = m_Deadwood9SM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
+    m_Deadwood9SM.Render(context, m_world, m_LightView, m_LightProjection);
+    m_world = SimpleMath::Matrix::Identity;
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
 
     //* Camp */
     // igloo
@@ -605,13 +664,17 @@ void Game::RenderShadowMap()
     // crow
     m_CampCrowSM.Render(context);
     // dirty snow patch
-    m_CampSnowSM.Render(context);
+    m_CampSnowSM.Render(context, m_world, m_LightView, m_LightProjection);
     // stone
     m_CampStonesSM.Render(context);
     // tree stones
     m_CampTreeStonesSM.Render(context);
     // tree
+    m_world = m_CampDeadwoodSM.GetInstanceTransform();
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
     m_CampDeadwoodSM.Render(context);
+    m_world = SimpleMath::Matrix::Identity;
+    m_BasicShaderPairShadowMap.SetShaderParameters(context, &m_world, &m_LightView, &m_LightProjection);
     // estus flask
     m_CampEstusSM.Render(context);
 
@@ -652,141 +715,170 @@ void Game::RenderMiniMap(DirectX::SimpleMath::Vector4 pLightPosition[], DirectX:
     // Clear the render to texture.
     m_MiniMapTexture->clearRenderTarget(context, 0.0f, 0.0f, 1.0f, 1.0f);
 
+    // Its variants are made the first time it is drawn.
+    BuildDeferredVariants(context);
+
     /* Render the whole scene, minus sky box, without normal mapping*/
     
     m_world = SimpleMath::Matrix::Identity;
 
     /* Ground */
     m_BasicShaderPairTilingNoNormalMap.EnableShader(context);
-    m_BasicShaderPairTilingNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texSnow.Get(), m_shadowResourceView.Get());
-    m_GroundBox.Render(context);
+    m_BasicShaderPairTilingNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texSnow), m_shadowResourceView.Get());
+    m_GroundBox.Render(context, m_world, m_map_view, m_projection);
 
     // Turn shaders with no specular highlight on
     m_BasicShaderPairNoSpecNoNormalMap.EnableShader(context);
 
     /* Mountains */
     // mountain1
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texSnowMountain.Get(), m_shadowResourceView.Get());
-    m_Mountain1.Render(context);
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texSnowMountain), m_shadowResourceView.Get());
+    m_Mountain1.Render(context, m_world, m_map_view, m_projection);
     // mountain2
-    m_Mountain2.Render(context);
+    m_Mountain2.Render(context, m_world, m_map_view, m_projection);
     // glacier1
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texGlacier.Get(), m_shadowResourceView.Get());
-    m_Glacier1.Render(context);
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texGlacier), m_shadowResourceView.Get());
+    m_Glacier1.Render(context, m_world, m_map_view, m_projection);
     // glacier2
-    m_Glacier2.Render(context);
+    m_Glacier2.Render(context, m_world, m_map_view, m_projection);
 
     /* Deadwoods */
+    // Copies of one log, each drawn through its own instance transform.
     // deadwood1
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texDeadwood.Get(), m_shadowResourceView.Get());
-    m_Deadwood1.Render(context);
+    m_world = m_Deadwood1.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood1.Render(context, m_world, m_map_view, m_projection);
     // deadwood2
-    m_Deadwood2.Render(context);
+    m_world = m_Deadwood2.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood2.Render(context, m_world, m_map_view, m_projection);
     // deadwood3
-    m_Deadwood3.Render(context);
+    m_world = m_Deadwood3.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood3.Render(context, m_world, m_map_view, m_projection);
     // deadwood4
-    m_Deadwood4.Render(context);
+    m_world = m_Deadwood4.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood4.Render(context, m_world, m_map_view, m_projection);
     // deadwood5
-    m_Deadwood5.Render(context);
+    m_world = m_Deadwood5.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood5.Render(context, m_world, m_map_view, m_projection);
     // deadwood6
-    m_Deadwood6.Render(context);
+    m_world = m_Deadwood6.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood6.Render(context, m_world, m_map_view, m_projection);
     // deadwood7
-    m_Deadwood7.Render(context);
+    m_world = m_Deadwood7.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood7.Render(context, m_world, m_map_view, m_projection);
     // deadwood8
-    m_Deadwood8.Render(context);
+    m_world = m_Deadwood8.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood8.Render(context, m_world, m_map_view, m_projection);
     // deadwood9
-    m_Deadwood9.Render(context);
+    m_world = m_Deadwood9.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_Deadwood9.Render(context, m_world, m_map_view, m_projection);
+    m_world = SimpleMath::Matrix::Identity;
 
     //* Camp */
     // igloo
     m_BasicShaderPairNoSpecNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texIgloo.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texIgloo), m_shadowResourceView.Get());
     m_CampIgloo.Render(context);
     // crow
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texCrow.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texCrow), m_shadowResourceView.Get());
     m_CampCrow.Render(context);
     // dirty snow patch
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texTerrain.Get(), m_shadowResourceView.Get());
-    m_CampSnow.Render(context);
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texTerrain), m_shadowResourceView.Get());
+    m_CampSnow.Render(context, m_world, m_map_view, m_projection);
     // stone
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texCampStones.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texCampStones), m_shadowResourceView.Get());
     m_CampStones.Render(context);
     // tree stones
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texCampTreeStones.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texCampTreeStones), m_shadowResourceView.Get());
     m_CampTreeStones.Render(context);
     // tree
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texDeadwood.Get(), m_shadowResourceView.Get());
-    m_CampDeadwood.Render(context);    
+    m_world = m_CampDeadwood.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texDeadwood), m_shadowResourceView.Get());
+    m_CampDeadwood.Render(context);
+    m_world = SimpleMath::Matrix::Identity;    
     // ice
     m_BasicShaderPairNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texIce.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texIce), m_shadowResourceView.Get());
     m_CampIce.Render(context);
     // estus flask
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texEF.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texEF), m_shadowResourceView.Get());
     m_CampEstus.Render(context);    
 
     /* Bonfire */
     // stones
     m_BasicShaderPairNoSpecNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfStones.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfStones), m_shadowResourceView.Get());
     m_BfStones.Render(context);
     // ash
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfAsh.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfAsh), m_shadowResourceView.Get());
     m_BfAsh.Render(context);
     // skulls
     m_BasicShaderPairNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfSkulls.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfSkulls), m_shadowResourceView.Get());
     m_BfSkulls.Render(context);
     // bones    
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfBones.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfBones), m_shadowResourceView.Get());
     m_BfBones.Render(context);
     // blade
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfBlade.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfBlade), m_shadowResourceView.Get());
     m_BfBlade.Render(context);
     // hilt
-    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texBfHilt.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texBfHilt), m_shadowResourceView.Get());
     m_BfHilt.Render(context);
 
     /*Foliage*/
     // deadbush1
     m_BasicShaderPairNoSpecNoNormalMap.EnableShader(context);
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageDeadBush.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageDeadBush), m_shadowResourceView.Get());
     m_FoliageDeadBush1.Render(context);
     // deadbush2
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageDeadBush.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageDeadBush), m_shadowResourceView.Get());
     m_FoliageDeadBush2.Render(context);
     // deadbush3
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageDeadBush.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageDeadBush), m_shadowResourceView.Get());
     m_FoliageDeadBush3.Render(context);
     // fern
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageFern.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageFern), m_shadowResourceView.Get());
     m_FoliageFern.Render(context);
     // grass1
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_world = m_FoliageGrass1.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass1.Render(context);
     // grass2
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_world = m_FoliageGrass2.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass2.Render(context);
     // grass3
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_world = m_FoliageGrass3.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass3.Render(context);
     // grass4
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_world = m_FoliageGrass4.GetInstanceTransform();
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass4.Render(context);
+    m_world = SimpleMath::Matrix::Identity;
     // grass5
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass5.Render(context);
     // grass6
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass6.Render(context);
     // grass7
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass7.Render(context);
     // grass8
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass8.Render(context);
     // grass9
-    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_texFoliageGrass.Get(), m_shadowResourceView.Get());
+    m_BasicShaderPairNoSpecNoNormalMap.SetShaderParameters(context, &m_world, &m_map_view, &m_projection, &m_Light, pLightPosition, pLightColor, &m_Camera01, m_textures.Get(m_texFoliageGrass), m_shadowResourceView.Get());
     m_FoliageGrass9.Render(context);
 
 	// Reset the render target back to the original back buffer and not the render to texture anymore.	
@@ -905,190 +997,204 @@ void Game::CreateDeviceDependentResources()
     m_sky = GeometricPrimitive::CreateGeoSphere(context, 2.f, 3, false /*invert for being inside the shape*/);
     m_effect = std::make_unique<SkyboxEffect>(device);
     m_sky->CreateInputLayout(m_effect.get(), m_skyInputLayout.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"skybox.dds", nullptr, m_cubemap.ReleaseAndGetAddressOf());
-    m_effect->SetTexture(m_cubemap.Get());
 
+    /* Loading */
+    // Models, shaders and textures do not depend on each other and the device is free threaded, so
+    // they are read, parsed, cooked and created on every core at once. The time each took is
+    // written to the debug output.
+    TaskPool loader;
+    TaskPhase modelPhase, shaderPhase, texturePhase, instancePhase;
+    TextureLoadReport textureReport;
+    TextureStreamStats textureStats;
+    std::chrono::steady_clock::time_point loadStart;
+    char timings[512];
+
+    auto loadShader = [&loader, &shaderPhase](std::function<void()> initialize)
+    {
+        loader.Run([initialize, &shaderPhase]() { initialize(); shaderPhase.End(); });
+    };
+
+    loadStart = std::chrono::steady_clock::now();
+    loader.Initialize();
+    m_textures.Initialize(device, loader, &texturePhase, m_textureBudget);
+
+    /* Models */
+    // Every file is parsed once and each render pass variant (plain for the minimap, normal mapped
+    // for the main pass, positions only for the shadow map) is built from that one result.
+    // Each variant is cooked to a .mesh blob next to its .obj, later runs map that instead of parsing.
+    // A plain variant next to a normal mapped one only serves the minimap and waits for it to be drawn.
     /* Ground */
-    m_GroundBoxNM.normalMapping = true;
-    m_GroundBoxNM.InitializeModel(device, "ground_box.obj");    
-
-    /* Surrounding mountains */        
-    m_Mountain1NM.normalMapping = true;
-    m_Mountain1NM.InitializeModel(device, "mountain1.obj");
-    m_Mountain2NM.normalMapping = true;
-    m_Mountain2NM.InitializeModel(device, "mountain2.obj");
-    m_Glacier1NM.normalMapping = true;
-    m_Glacier1NM.InitializeModel(device, "glacier1.obj");
-    m_Glacier2NM.normalMapping = true;
-    m_Glacier2NM.InitializeModel(device, "glacier2.obj");
+    QueueModelVariants("ground_box.obj", &m_GroundBox, &m_GroundBoxNM, nullptr);
+
+    /* Surrounding mountains */
+    QueueModelVariants("mountain1.obj", &m_Mountain1, &m_Mountain1NM, &m_Mountain1SM);
+    QueueModelVariants("mountain2.obj", &m_Mountain2, &m_Mountain2NM, &m_Mountain2SM);
+    QueueModelVariants("glacier1.obj", &m_Glacier1, &m_Glacier1NM, &m_Glacier1SM);
+    QueueModelVariants("glacier2.obj", &m_Glacier2, &m_Glacier2NM, &m_Glacier2SM);
 
     /* Deadwoods */
-    m_Deadwood1NM.normalMapping = true;
-    m_Deadwood1NM.InitializeModel(device, "deadwood1.obj");
-    m_Deadwood2NM.normalMapping = true;
-    m_Deadwood2NM.InitializeModel(device, "deadwood2.obj");
-    m_Deadwood3NM.normalMapping = true;
-    m_Deadwood3NM.InitializeModel(device, "deadwood3.obj");
-    m_Deadwood4NM.normalMapping = true;
-    m_Deadwood4NM.InitializeModel(device, "deadwood4.obj");
-    m_Deadwood5NM.normalMapping = true;
-    m_Deadwood5NM.InitializeModel(device, "deadwood5.obj");
-    m_Deadwood6NM.normalMapping = true;
-    m_Deadwood6NM.InitializeModel(device, "deadwood6.obj");
-    m_Deadwood7NM.normalMapping = true;
-    m_Deadwood7NM.InitializeModel(device, "deadwood7.obj");
-    m_Deadwood8NM.normalMapping = true;
-    m_Deadwood8NM.InitializeModel(device, "deadwood8.obj");
-    m_Deadwood9NM.normalMapping = true;
-    m_Deadwood9NM.InitializeModel(device, "deadwood9.obj");
+    QueueModelVariants("deadwood1.obj", &m_Deadwood1, &m_Deadwood1NM, &m_Deadwood1SM, true);
+    QueueModelVariants("deadwood2.obj", &m_Deadwood2, &m_Deadwood2NM, &m_Deadwood2SM, true);
+    QueueModelVariants("deadwood3.obj", &m_Deadwood3, &m_Deadwood3NM, &m_Deadwood3SM, true);
+    QueueModelVariants("deadwood4.obj", &m_Deadwood4, &m_Deadwood4NM, &m_Deadwood4SM, true);
+    QueueModelVariants("deadwood5.obj", &m_Deadwood5, &m_Deadwood5NM, &m_Deadwood5SM, true);
+    QueueModelVariants("deadwood6.obj", &m_Deadwood6, &m_Deadwood6NM, &m_Deadwood6SM, true);
+    QueueModelVariants("deadwood7.obj", &m_Deadwood7, &m_Deadwood7NM, &m_Deadwood7SM, true);
+    QueueModelVariants("deadwood8.obj", &m_Deadwood8, &m_Deadwood8NM, &m_Deadwood8SM, true);
+    QueueModelVariants("deadwood9.obj", &m_Deadwood9, &m_Deadwood9NM, &m_Deadwood9SM, true);
 
     /* Camp */
-    m_CampIgloo.InitializeModel(device, "igloo.obj");
-    m_CampCrowNM.normalMapping = true;
-    m_CampCrowNM.InitializeModel(device, "crow.obj");
-    m_CampSnow.InitializeModel(device, "camp_snow.obj");
-    m_CampStones.InitializeModel(device, "camp_stones.obj");  
-    m_CampTreeStonesNM.normalMapping = true;
-    m_CampTreeStonesNM.InitializeModel(device, "camp_tree_stones.obj");
-    m_CampDeadwoodNM.normalMapping = true;
-    m_CampDeadwoodNM.InitializeModel(device, "camp_deadwood.obj");
-    m_CampIceBorderNM.normalMapping = true;
-    m_CampIceBorderNM.InitializeModel(device, "ice_border.obj");
-    m_CampIceNM.normalMapping = true;
-    m_CampIceNM.InitializeModel(device, "ice.obj");
-    m_CampEstusNM.normalMapping = true;
-    m_CampEstusNM.InitializeModel(device, "estus.obj");
-    
+    QueueModelVariants("igloo.obj", &m_CampIgloo, nullptr, &m_CampIglooSM);
+    QueueModelVariants("crow.obj", &m_CampCrow, &m_CampCrowNM, &m_CampCrowSM);
+    QueueModelVariants("camp_snow.obj", &m_CampSnow, nullptr, &m_CampSnowSM);
+    QueueModelVariants("camp_stones.obj", &m_CampStones, nullptr, &m_CampStonesSM);
+    QueueModelVariants("camp_tree_stones.obj", &m_CampTreeStones, &m_CampTreeStonesNM, &m_CampTreeStonesSM);
+    QueueModelVariants("camp_deadwood.obj", &m_CampDeadwood, &m_CampDeadwoodNM, &m_CampDeadwoodSM, true);
+    QueueModelVariants("ice_border.obj", &m_CampIceBorder, &m_CampIceBorderNM, &m_CampIceBorderSM);
+    QueueModelVariants("ice.obj", &m_CampIce, &m_CampIceNM, &m_CampIceSM);
+    QueueModelVariants("estus.obj", &m_CampEstus, &m_CampEstusNM, &m_CampEstusSM);
+
     /* Bonfire */
-    m_BfStonesNM.normalMapping = true;
-    m_BfStonesNM.InitializeModel(device, "bf_stones.obj");
-    m_BfAshNM.normalMapping = true;
-    m_BfAshNM.InitializeModel(device, "bf_ash.obj");
-    m_BfSkullsNM.normalMapping = true;
-    m_BfSkullsNM.InitializeModel(device, "bf_skulls.obj");
-    m_BfBones.InitializeModel(device, "bf_bones.obj");
-    m_BfBlade.InitializeModel(device, "bf_blade.obj");
-    m_BfHilt.InitializeModel(device, "bf_hilt.obj");
+    QueueModelVariants("bf_stones.obj", &m_BfStones, &m_BfStonesNM, &m_BfStonesSM);
+    QueueModelVariants("bf_ash.obj", &m_BfAsh, &m_BfAshNM, &m_BfAshSM);
+    QueueModelVariants("bf_skulls.obj", &m_BfSkulls, &m_BfSkullsNM, &m_BfSkullsSM);
+    QueueModelVariants("bf_bones.obj", &m_BfBones, nullptr, &m_BfBonesSM);
+    QueueModelVariants("bf_blade.obj", &m_BfBlade, nullptr, &m_BfBladeSM);
+    QueueModelVariants("bf_hilt.obj", &m_BfHilt, nullptr, &m_BfHiltSM);
 
     /* Foliage */
-    m_FoliageDeadBush1.InitializeModel(device, "foliage_deadbush1.obj");
-    m_FoliageDeadBush2.InitializeModel(device, "foliage_deadbush2.obj");
-    m_FoliageDeadBush3.InitializeModel(device, "foliage_deadbush3.obj");
-    m_FoliageFern.InitializeModel(device, "foliage_fern.obj");
-    m_FoliageGrass1.InitializeModel(device, "foliage_grass1.obj");
-    m_FoliageGrass2.InitializeModel(device, "foliage_grass2.obj");
-    m_FoliageGrass3.InitializeModel(device, "foliage_grass3.obj");
-    m_FoliageGrass4.InitializeModel(device, "foliage_grass4.obj");
-    m_FoliageGrass5.InitializeModel(device, "foliage_grass5.obj");
-    m_FoliageGrass6.InitializeModel(device, "foliage_grass6.obj");
-    m_FoliageGrass7.InitializeModel(device, "foliage_grass7.obj");
-    m_FoliageGrass8.InitializeModel(device, "foliage_grass8.obj");
-    m_FoliageGrass9.InitializeModel(device, "foliage_grass9.obj");
-	
+    QueueModelVariants("foliage_deadbush1.obj", &m_FoliageDeadBush1, nullptr, nullptr);
+    QueueModelVariants("foliage_deadbush2.obj", &m_FoliageDeadBush2, nullptr, nullptr);
+    QueueModelVariants("foliage_deadbush3.obj", &m_FoliageDeadBush3, nullptr, nullptr);
+    QueueModelVariants("foliage_fern.obj", &m_FoliageFern, nullptr, nullptr);
+    QueueModelVariants("foliage_grass1.obj", &m_FoliageGrass1, nullptr, nullptr, true);
+    QueueModelVariants("foliage_grass2.obj", &m_FoliageGrass2, nullptr, nullptr, true);
+    QueueModelVariants("foliage_grass3.obj", &m_FoliageGrass3, nullptr, nullptr, true);
+    QueueModelVariants("foliage_grass4.obj", &m_FoliageGrass4, nullptr, nullptr, true);
+    QueueModelVariants("foliage_grass5.obj", &m_FoliageGrass5, nullptr, nullptr);
+    QueueModelVariants("foliage_grass6.obj", &m_FoliageGrass6, nullptr, nullptr);
+    QueueModelVariants("foliage_grass7.obj", &m_FoliageGrass7, nullptr, nullptr);
+    QueueModelVariants("foliage_grass8.obj", &m_FoliageGrass8, nullptr, nullptr);
+    QueueModelVariants("foliage_grass9.obj", &m_FoliageGrass9, nullptr, nullptr);
+
+    modelPhase.Begin();
+    StartModelLoads(device, loader, modelPhase);
+
     /* Shaders */
-    m_BasicShaderPair.InitStandard(device, L"light_vs.cso", L"light_ps.cso", D3D11_TEXTURE_ADDRESS_WRAP);    
-    m_BasicShaderPairTiling.InitStandard(device, L"light_vs_tiling.cso", L"light_ps.cso", D3D11_TEXTURE_ADDRESS_WRAP); // Shader pair that tiles textures
-    m_BasicShaderPairTilingNoNormalMap.InitStandard(device, L"light_vs_tiling_nonormalmap.cso", L"light_ps_nonormalmap.cso", D3D11_TEXTURE_ADDRESS_WRAP); // Shader pair that tiles textures, no normal mapping
-    m_BasicShaderPairNoSpec.InitStandard(device, L"light_vs.cso", L"light_ps_nospec.cso", D3D11_TEXTURE_ADDRESS_WRAP); // Shader pair that does not add specular highlights
-    m_BasicShaderPairNoSpecNoNormalMap.InitStandard(device, L"light_vs_nonormalmap.cso", L"light_ps_nospec_nonormalmap.cso", D3D11_TEXTURE_ADDRESS_WRAP); // Shader pair that does not compute specular highlights or bump normals
-    m_BasicShaderPairNoNormalMap.InitStandard(device, L"light_vs_nonormalmap.cso", L"light_ps_nonormalmap.cso", D3D11_TEXTURE_ADDRESS_WRAP); // Shader pair that does not compute bump normals    
-    m_BasicShaderPairShadowMap.InitStandard(device, L"light_vs_shadowmap.cso", L"light_ps_shadowmap.cso"); // Shader pair that renders just the vertex position in light space
-    m_BasicShaderPairIce.InitStandard(device, L"light_vs_ice.cso", L"light_ps_ice.cso", D3D11_TEXTURE_ADDRESS_WRAP); // Shader pair that uses normal map to offset sampling of diffuse texture
-    m_BasicShaderPairFire.InitStandard(device, L"fire_vs.cso", L"fire_ps.cso"); // Shader pair that produce fire effect
+    shaderPhase.Begin();
+    loadShader([=]() { m_BasicShaderPair.InitStandard(device, L"light_vs.cso", L"light_ps.cso", D3D11_TEXTURE_ADDRESS_WRAP); });
+    loadShader([=]() { m_BasicShaderPairTiling.InitStandard(device, L"light_vs_tiling.cso", L"light_ps.cso", D3D11_TEXTURE_ADDRESS_WRAP); }); // Shader pair that tiles textures
+    loadShader([=]() { m_BasicShaderPairTilingNoNormalMap.InitStandard(device, L"light_vs_tiling_nonormalmap.cso", L"light_ps_nonormalmap.cso", D3D11_TEXTURE_ADDRESS_WRAP); }); // Shader pair that tiles textures, no normal mapping
+    loadShader([=]() { m_BasicShaderPairNoSpec.InitStandard(device, L"light_vs.cso", L"light_ps_nospec.cso", D3D11_TEXTURE_ADDRESS_WRAP); }); // Shader pair that does not add specular highlights
+    loadShader([=]() { m_BasicShaderPairNoSpecNoNormalMap.InitStandard(device, L"light_vs_nonormalmap.cso", L"light_ps_nospec_nonormalmap.cso", D3D11_TEXTURE_ADDRESS_WRAP); }); // Shader pair that does not compute specular highlights or bump normals
+    loadShader([=]() { m_BasicShaderPairNoNormalMap.InitStandard(device, L"light_vs_nonormalmap.cso", L"light_ps_nonormalmap.cso", D3D11_TEXTURE_ADDRESS_WRAP); }); // Shader pair that does not compute bump normals
+    loadShader([=]() { m_BasicShaderPairShadowMap.InitStandard(device, L"light_vs_shadowmap.cso", L"light_ps_shadowmap.cso"); }); // Shader pair that renders just the vertex position in light space
+    loadShader([=]() { m_BasicShaderPairIce.InitStandard(device, L"light_vs_ice.cso", L"light_ps_ice.cso", D3D11_TEXTURE_ADDRESS_WRAP); }); // Shader pair that uses normal map to offset sampling of diffuse texture
+    loadShader([=]() { m_BasicShaderPairFire.InitStandard(device, L"fire_vs.cso", L"fire_ps.cso"); }); // Shader pair that produce fire effect
 
 	/* Textures */
-    CreateDDSTextureFromFile(device, L"snow_diffuse.dds", nullptr, m_texSnow.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"snow_normal.dds", nullptr, m_texSnowNormal.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"snow_mountain_upscale.dds", nullptr, m_texSnowMountain.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"snow_mountain_normal.dds", nullptr, m_texSnowMountainNormalMap.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"glacier.dds", nullptr, m_texGlacier.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"glacier_normal.dds", nullptr, m_texGlacierNormalMap.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"deadwood.dds", nullptr, m_texDeadwood.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"deadwood_normal.dds", nullptr, m_texDeadwoodNormal.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"igloo.dds", nullptr, m_texIgloo.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"crow.dds", nullptr, m_texCrow.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"crow_normal.dds", nullptr, m_texCrowNormal.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"terrain.dds", nullptr, m_texTerrain.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"camp_stones.dds", nullptr, m_texCampStones.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"camp_tree_stones.dds", nullptr, m_texCampTreeStones.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"camp_tree_stones_normal.dds", nullptr, m_texCampTreeStonesNormal.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"ice_desat.dds", nullptr, m_texIce.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"ice_normal.dds", nullptr, m_texIceNormal.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"bf_stones.dds", nullptr, m_texBfStones.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"bf_stones_normal.dds", nullptr, m_texBfStonesNormal.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"bf_ash.dds", nullptr, m_texBfAsh.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"bf_ash_normal.dds", nullptr, m_texBfAshNormal.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"bf_skulls.dds", nullptr, m_texBfSkulls.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"bf_skulls_normal.dds", nullptr, m_texBfSkullsNormal.ReleaseAndGetAddressOf());
-    CreateDDSTextureFromFile(device, L"bf_bones.dds", nullptr, m_texBfBones.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"bf_blade.dds", nullptr, m_texBfBlade.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"bf_hilt.dds", nullptr, m_texBfHilt.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"foliage_fern.dds", nullptr, m_texFoliageFern.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"foliage_deadbush.dds", nullptr, m_texFoliageDeadBush.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"foliage_grass.dds", nullptr, m_texFoliageGrass.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"estus_diffuse.dds", nullptr, m_texEF.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"estus_normal.dds", nullptr, m_texEFNormal.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"ice.dds", nullptr, m_texIce.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"star.dds", nullptr, m_texStar.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"fire01.dds", nullptr, m_texFire.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"noise01.dds", nullptr, m_texFireNoise.ReleaseAndGetAddressOf()); 
-	CreateDDSTextureFromFile(device, L"alpha01.dds", nullptr, m_texFireAlpha.ReleaseAndGetAddressOf());         
-	CreateDDSTextureFromFile(device, L"fog.dds", nullptr, m_texFog.ReleaseAndGetAddressOf());         
-    m_MiniMapTexture = new RenderTexture(device, 300, 240, 1, 2);	//for render to texture mini-map view
+    // Each texture is created from its mapped file on a task of its own, the ones that stream from
+    // their smallest levels alone, see TextureStreamer.h. The sky and the fire are drawn whole.
+    texturePhase.Begin();
+    m_cubemap = m_textures.Load(L"skybox.dds", true);
+    m_texSnow = m_textures.Load(L"snow_diffuse.dds");
+    m_texSnowNormal = m_textures.Load(L"snow_normal.dds");
+    m_texSnowMountain = m_textures.Load(L"snow_mountain_upscale.dds");
+    m_texSnowMountainNormalMap = m_textures.Load(L"snow_mountain_normal.dds");
+    m_texGlacier = m_textures.Load(L"glacier.dds");
+    m_texGlacierNormalMap = m_textures.Load(L"glacier_normal.dds");
+    m_texDeadwood = m_textures.Load(L"deadwood.dds");
+    m_texDeadwoodNormal = m_textures.Load(L"deadwood_normal.dds");
+    m_texIgloo = m_textures.Load(L"igloo.dds");
+    m_texCrow = m_textures.Load(L"crow.dds");
+    m_texCrowNormal = m_textures.Load(L"crow_normal.dds");
+    m_texTerrain = m_textures.Load(L"terrain.dds");
+    m_texCampStones = m_textures.Load(L"camp_stones.dds");
+    m_texCampTreeStones = m_textures.Load(L"camp_tree_stones.dds");
+    m_texCampTreeStonesNormal = m_textures.Load(L"camp_tree_stones_normal.dds");
+    m_texIceNormal = m_textures.Load(L"ice_normal.dds");
+    m_texBfStones = m_textures.Load(L"bf_stones.dds");
+    m_texBfStonesNormal = m_textures.Load(L"bf_stones_normal.dds");
+    m_texBfAsh = m_textures.Load(L"bf_ash.dds");
+    m_texBfAshNormal = m_textures.Load(L"bf_ash_normal.dds");
+    m_texBfSkulls = m_textures.Load(L"bf_skulls.dds");
+    m_texBfSkullsNormal = m_textures.Load(L"bf_skulls_normal.dds");
+    m_texBfBones = m_textures.Load(L"bf_bones.dds");
+    m_texBfBlade = m_textures.Load(L"bf_blade.dds");
+    m_texBfHilt = m_textures.Load(L"bf_hilt.dds");
+    m_texFoliageFern = m_textures.Load(L"foliage_fern.dds");
+    m_texFoliageDeadBush = m_textures.Load(L"foliage_deadbush.dds");
+    m_texFoliageGrass = m_textures.Load(L"foliage_grass.dds");
+    m_texEF = m_textures.Load(L"estus_diffuse.dds");
+    m_texEFNormal = m_textures.Load(L"estus_normal.dds");
+    m_texIce = m_textures.Load(L"ice.dds");
+    m_texStar = m_textures.Load(L"star.dds");
+    m_texFire = m_textures.Load(L"fire01.dds", true);
+    m_texFireNoise = m_textures.Load(L"noise01.dds", true);
+    m_texFireAlpha = m_textures.Load(L"alpha01.dds", true);
+    m_texFog = m_textures.Load(L"fog.dds");
+
+    m_textures.Finish(&textureReport);
+    m_effect->SetTexture(m_textures.Get(m_cubemap));
+
+    // Copies share their reference's buffers once every reference is uploaded.
+    instancePhase.Begin();
+    FinishModelLoads(device, loader);
+    instancePhase.End();
+    loader.Shutdown();
+
+    // The main pass's models and what they are drawn with, as in Render. The minimap's are too small
+    // on screen to ask for more than the tails.
+    m_textureUses.clear();
+    AddTextureUse(&m_GroundBoxNM, 500.0f, m_texSnow, m_texSnowNormal);
+    AddTextureUse(&m_Mountain1NM, 1.0f, m_texSnowMountain, m_texSnowMountainNormalMap);
+    AddTextureUse(&m_Mountain2NM, 1.0f, m_texSnowMountain, m_texSnowMountainNormalMap);
+    AddTextureUse(&m_Glacier1NM, 1.0f, m_texGlacier, m_texGlacierNormalMap);
+    AddTextureUse(&m_Glacier2NM, 1.0f, m_texGlacier, m_texGlacierNormalMap);
+    for (ModelClass* deadwood : { &m_Deadwood1NM, &m_Deadwood2NM, &m_Deadwood3NM, &m_Deadwood4NM, &m_Deadwood5NM, &m_Deadwood6NM, &m_Deadwood7NM, &m_Deadwood8NM, &m_Deadwood9NM, &m_CampDeadwoodNM })
+    {
+        AddTextureUse(deadwood, 1.0f, m_texDeadwood, m_texDeadwoodNormal);
+    }
+    AddTextureUse(&m_CampIgloo, 1.0f, m_texIgloo);
+    AddTextureUse(&m_CampCrowNM, 1.0f, m_texCrow, m_texCrowNormal);
+    AddTextureUse(&m_CampSnow, 1.0f, m_texTerrain);
+    AddTextureUse(&m_CampStones, 1.0f, m_texCampStones);
+    AddTextureUse(&m_CampTreeStonesNM, 1.0f, m_texCampTreeStones, m_texCampTreeStonesNormal);
+    AddTextureUse(&m_CampIceBorderNM, 1.0f, m_texSnow, m_texSnowNormal);
+    AddTextureUse(&m_CampIceNM, 1.0f, m_texIce, m_texIceNormal, m_texFog);
+    AddTextureUse(&m_CampEstusNM, 1.0f, m_texEF, m_texEFNormal);
+    AddTextureUse(&m_BfStonesNM, 1.0f, m_texBfStones, m_texBfStonesNormal);
+    AddTextureUse(&m_BfAshNM, 1.0f, m_texBfAsh, m_texBfAshNormal);
+    AddTextureUse(&m_BfSkullsNM, 1.0f, m_texBfSkulls, m_texBfSkullsNormal);
+    AddTextureUse(&m_BfBones, 1.0f, m_texBfBones);
+    AddTextureUse(&m_BfBlade, 1.0f, m_texBfBlade);
+    AddTextureUse(&m_BfHilt, 1.0f, m_texBfHilt);
+    for (ModelClass* deadbush : { &m_FoliageDeadBush1, &m_FoliageDeadBush2, &m_FoliageDeadBush3 })
+    {
+        AddTextureUse(deadbush, 1.0f, m_texFoliageDeadBush);
+    }
+    AddTextureUse(&m_FoliageFern, 1.0f, m_texFoliageFern);
+    for (ModelClass* grass : { &m_FoliageGrass1, &m_FoliageGrass2, &m_FoliageGrass3, &m_FoliageGrass4, &m_FoliageGrass5, &m_FoliageGrass6, &m_FoliageGrass7, &m_FoliageGrass8, &m_FoliageGrass9 })
+    {
+        AddTextureUse(grass, 1.0f, m_texFoliageGrass);
+    }
 
-    /* Shadow Map */    
-    //Load models for shadow map render pass (vertices array with only position property)
-    m_Mountain1SM.shadowMapping = true;    
-    m_Mountain1SM.InitializeModel(device, "mountain1.obj");
-    m_Mountain2SM.shadowMapping = true;
-    m_Mountain2SM.InitializeModel(device, "mountain2.obj");
-    m_Glacier1SM.shadowMapping = true;
-    m_Glacier1SM.InitializeModel(device, "glacier1.obj");
-    m_Glacier2SM.shadowMapping = true;
-    m_Glacier2SM.InitializeModel(device, "glacier2.obj");
-    m_Deadwood1SM.shadowMapping = true;
-    m_Deadwood1SM.InitializeModel(device, "deadwood1.obj");
-    m_Deadwood2SM.shadowMapping = true;
-    m_Deadwood2SM.InitializeModel(device, "deadwood2.obj");
-    m_Deadwood3SM.shadowMapping = true;
-    m_Deadwood3SM.InitializeModel(device, "deadwood3.obj");
-    m_Deadwood4SM.shadowMapping = true;
-    m_Deadwood4SM.InitializeModel(device, "deadwood4.obj");
-    m_Deadwood5SM.shadowMapping = true;
-    m_Deadwood5SM.InitializeModel(device, "deadwood5.obj");
-    m_Deadwood6SM.shadowMapping = true;
-    m_Deadwood6SM.InitializeModel(device, "deadwood6.obj");
-    m_Deadwood7SM.shadowMapping = true;
-    m_Deadwood7SM.InitializeModel(device, "deadwood7.obj");
-    m_Deadwood8SM.shadowMapping = true;
-    m_Deadwood8SM.InitializeModel(device, "deadwood8.obj");
-    m_Deadwood9SM.shadowMapping = true;
-    m_Deadwood9SM.InitializeModel(device, "deadwood9.obj");
-    m_CampIglooSM.InitializeModel(device, "igloo.obj");
-    m_CampCrowSM.shadowMapping = true;
-    m_CampCrowSM.InitializeModel(device, "crow.obj");
-    m_CampSnowSM.InitializeModel(device, "camp_snow.obj");
-    m_CampStonesSM.InitializeModel(device, "camp_stones.obj");
-    m_CampTreeStonesSM.shadowMapping = true;
-    m_CampTreeStonesSM.InitializeModel(device, "camp_tree_stones.obj");
-    m_CampDeadwoodSM.shadowMapping = true;
-    m_CampDeadwoodSM.InitializeModel(device, "camp_deadwood.obj");
-    m_CampIceBorderSM.shadowMapping = true;
-    m_CampIceBorderSM.InitializeModel(device, "ice_border.obj");
-    m_CampIceSM.shadowMapping = true;
-    m_CampIceSM.InitializeModel(device, "ice.obj");
-    m_CampEstusSM.shadowMapping = true;
-    m_CampEstusSM.InitializeModel(device, "estus.obj");
-    m_BfStonesSM.shadowMapping = true;
-    m_BfStonesSM.InitializeModel(device, "bf_stones.obj");
-    m_BfAshSM.shadowMapping = true;
-    m_BfAshSM.InitializeModel(device, "bf_ash.obj");
-    m_BfSkullsSM.shadowMapping = true;
-    m_BfSkullsSM.InitializeModel(device, "bf_skulls.obj");
-    m_BfBonesSM.InitializeModel(device, "bf_bones.obj");
-    m_BfBladeSM.InitializeModel(device, "bf_blade.obj");
-    m_BfHiltSM.InitializeModel(device, "bf_hilt.obj");
+    sprintf_s(timings, "Loading: models %.1f ms, shaders %.1f ms, textures %.1f ms, instances %.1f ms, %.1f ms in all on %u threads\n",
+        modelPhase.GetMilliseconds(), shaderPhase.GetMilliseconds(), texturePhase.GetMilliseconds(), instancePhase.GetMilliseconds(),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count(), std::max(1u, std::thread::hardware_concurrency()));
+    OutputDebugStringA(timings);
+    sprintf_s(timings, "Loading: %u textures, %.1f MB, %u through DirectXTK's loader, %u failed, largest single texture %.1f ms (%ls)\n",
+        textureReport.textureCount, textureReport.bytes / (1024.0 * 1024.0), textureReport.fallbackCount, textureReport.failedCount,
+        textureReport.slowestMilliseconds, textureReport.slowestFilename.c_str());
+    OutputDebugStringA(timings);
+    m_textures.GetStats(textureStats);
+    sprintf_s(timings, "Loading: %u of the textures stream, the rest are whole; %.1f MB resident of a %.1f MB budget\n",
+        textureStats.streamedCount, textureStats.residentBytes / (1024.0 * 1024.0), textureStats.budgetBytes / (1024.0 * 1024.0));
+    OutputDebugStringA(timings);
 
+    m_MiniMapTexture = new RenderTexture(device, 300, 240, 1, 2);	//for render to texture mini-map view
+
+    /* Shadow Map */
     D3D11_TEXTURE2D_DESC shadowMapDesc;
     ZeroMemory(&shadowMapDesc, sizeof(D3D11_TEXTURE2D_DESC));
     shadowMapDesc.Format = DXGI_FORMAT_R24G8_TYPELESS;
@@ -1140,31 +1246,6 @@ void Game::CreateDeviceDependentResources()
 
     device->CreateRasterizerState(&shadowRenderStateDesc, &m_shadowRenderState);
 
-    /* Load non normal mapping versions (no tangent or binormals in vertices array) of models for minimap render pass */
-    m_GroundBox.InitializeModel(device, "ground_box.obj");
-    m_Mountain1.InitializeModel(device, "mountain1.obj");
-    m_Mountain2.InitializeModel(device, "mountain2.obj");
-    m_Glacier1.InitializeModel(device, "glacier1.obj");
-    m_Glacier2.InitializeModel(device, "glacier2.obj");
-    m_Deadwood1.InitializeModel(device, "deadwood1.obj");
-    m_Deadwood2.InitializeModel(device, "deadwood2.obj");
-    m_Deadwood3.InitializeModel(device, "deadwood3.obj");
-    m_Deadwood4.InitializeModel(device, "deadwood4.obj");
-    m_Deadwood5.InitializeModel(device, "deadwood5.obj");
-    m_Deadwood6.InitializeModel(device, "deadwood6.obj");
-    m_Deadwood7.InitializeModel(device, "deadwood7.obj");
-    m_Deadwood8.InitializeModel(device, "deadwood8.obj");
-    m_Deadwood9.InitializeModel(device, "deadwood9.obj");
-    m_CampCrow.InitializeModel(device, "crow.obj");
-    m_CampTreeStones.InitializeModel(device, "camp_tree_stones.obj");
-    m_CampDeadwood.InitializeModel(device, "camp_deadwood.obj");
-    m_CampIceBorder.InitializeModel(device, "ice_border.obj");
-    m_CampIce.InitializeModel(device, "ice.obj");
-    m_CampEstus.InitializeModel(device, "estus.obj");
-    m_BfStones.InitializeModel(device, "bf_ash.obj");
-    m_BfAsh.InitializeModel(device, "bf_stones.obj");
-    m_BfSkulls.InitializeModel(device, "bf_skulls.obj");
-    
     /* Particle System */
     m_ParticleShader = new ShaderParticles;
     m_ParticleShader->InitStandard(device, L"particle_vs.cso", L"particle_ps.cso");
@@ -1172,6 +1253,390 @@ void Game::CreateDeviceDependentResources()
     m_ParticleSystem->Initialize(device);
 }
 
+// Queues every render pass variant of a model to be built from a single parse of its file.
+// Variants that no pass draws are passed as nullptr. An instanced model may end up drawing
+// from the buffers of a model queued before it, so its passes put GetInstanceTransform()
+// in front of the world matrix. A plain variant queued with a normal mapped one is not loaded
+// here; BuildDeferredVariants makes it from the normal mapped one when a pass first draws it.
+void Game::QueueModelVariants(const char* filename, ModelClass* plain, ModelClass* normalMapped, ModelClass* shadowMapped, bool instanced)
+{
+    ModelLoad load;
+    int i;
+
+    if (normalMapped)
+    {
+        normalMapped->normalMapping = true;
+    }
+
+    if (shadowMapped)
+    {
+        // The depth pass only reads positions.
+        shadowMapped->shadowMapping = true;
+    }
+
+    load.filename = filename;
+    load.variants[0] = normalMapped ? nullptr : plain;
+    load.variants[1] = normalMapped;
+    load.variants[2] = shadowMapped;
+    load.instanced = instanced;
+    load.found = false;
+    load.instanceKey = 0;
+    load.hasRecord = false;
+    load.reference = -1;
+    load.releasedBytes = 0;
+    load.deferred = normalMapped ? plain : nullptr;
+    for (i = 0; i < 3; i++)
+    {
+        load.pending[i] = false;
+        load.shared[i] = false;
+    }
+
+    m_modelLoads.push_back(load);
+}
+
+// Loads every queued file on the loader's threads. The queue must not change until FinishModelLoads.
+void Game::StartModelLoads(ID3D11Device* device, TaskPool& loader, TaskPhase& phase)
+{
+    for (ModelLoad& load : m_modelLoads)
+    {
+        loader.Run([this, device, &load, &phase]() { LoadModel(device, load); phase.End(); });
+    }
+}
+
+// Hashes the file and builds each variant, from its cooked mesh when that is current. An instanced
+// file may be a moved copy of one queued before it, which is only known once every file has been
+// looked at, so it stops at the parse and FinishModelLoads does the rest.
+void Game::LoadModel(ID3D11Device* device, ModelLoad& load)
+{
+    int i;
+
+    if (!GetCookedMeshSource(load.filename.c_str(), load.source))
+    {
+        return;
+    }
+    load.found = true;
+
+    // The cooker found this file to be a copy, it waits for its reference.
+    if (load.instanced && ReadMeshInstance(load.filename.c_str(), load.source, load.record))
+    {
+        load.hasRecord = true;
+        for (i = 0; i < 3; i++)
+        {
+            load.pending[i] = (load.variants[i] != nullptr);
+        }
+        return;
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        if (!load.variants[i])
+        {
+            continue;
+        }
+
+        if (!load.instanced)
+        {
+            BuildModelVariant(device, load, i);
+            continue;
+        }
+
+        if (load.variants[i]->InitializeCooked(device, load.filename.c_str(), load.source))
+        {
+            continue;
+        }
+
+        if (!load.mesh)
+        {
+            load.mesh = m_meshCache.Load(load.filename.c_str(), 1);
+            if (!load.mesh)
+            {
+                return;
+            }
+        }
+        load.pending[i] = true;
+    }
+
+    if (load.mesh)
+    {
+        load.instanceKey = CalculateInstanceKey(*load.mesh);
+    }
+}
+
+// Uploads one variant from its cooked mesh if that is current, otherwise parses the .obj once for
+// every variant that needs it and cooks this layout. The loader already runs a file per thread,
+// so the parse stays on this one.
+void Game::BuildModelVariant(ID3D11Device* device, ModelLoad& load, int variant)
+{
+    ModelClass* model = load.variants[variant];
+
+    if (model->InitializeCooked(device, load.filename.c_str(), load.source))
+    {
+        return;
+    }
+
+    if (!load.mesh)
+    {
+        load.mesh = m_meshCache.Load(load.filename.c_str(), 1);
+        if (!load.mesh)
+        {
+            return;
+        }
+    }
+
+    if (model->InitializeModel(device, *load.mesh))
+    {
+        // Failing to cook only costs the next run a parse. Either way the buffers hold the mesh now.
+        model->SaveCooked(load.filename.c_str(), load.source);
+        load.releasedBytes += model->ReleaseMeshData();
+    }
+}
+
+// Decides in queue order which instanced files are moved copies of a file queued before them,
+// builds what is still missing on the loader's threads and then shares the references' buffers.
+void Game::FinishModelLoads(ID3D11Device* device, TaskPool& loader)
+{
+    char released[MAX_PATH + 64];
+    size_t releasedBytes;
+    int index, i;
+
+    for (index = 0; index < (int)m_modelLoads.size(); index++)
+    {
+        ModelLoad& load = m_modelLoads[index];
+
+        if (!load.pending[0] && !load.pending[1] && !load.pending[2])
+        {
+            continue;
+        }
+
+        load.reference = FindInstanceReference(index);
+        if (load.reference < 0)
+        {
+            continue;
+        }
+
+        // A variant the reference does not have is built as usual.
+        for (i = 0; i < 3; i++)
+        {
+            if (load.pending[i] && m_modelLoads[load.reference].variants[i])
+            {
+                load.pending[i] = false;
+                load.shared[i] = true;
+            }
+        }
+    }
+
+    for (ModelLoad& load : m_modelLoads)
+    {
+        if (load.pending[0] || load.pending[1] || load.pending[2])
+        {
+            loader.Run([this, device, &load]()
+            {
+                for (int variant = 0; variant < 3; variant++)
+                {
+                    if (load.pending[variant])
+                    {
+                        BuildModelVariant(device, load, variant);
+                    }
+                }
+            });
+        }
+    }
+    loader.Wait();
+
+    // Every reference is uploaded now. Should one have failed, its copies are built after all.
+    for (ModelLoad& load : m_modelLoads)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            if (load.shared[i] && !load.variants[i]->InitializeInstance(*m_modelLoads[load.reference].variants[i], SimpleMath::Matrix(load.record.transform)))
+            {
+                BuildModelVariant(device, load, i);
+            }
+        }
+    }
+
+    // Models built from an .obj only held on to their CPU copies until they were cooked.
+    releasedBytes = 0;
+    for (const ModelLoad& load : m_modelLoads)
+    {
+        if (load.releasedBytes > 0)
+        {
+            sprintf_s(released, "Released %.1f KB of mesh data after uploading %s\n", load.releasedBytes / 1024.0, load.filename.c_str());
+            OutputDebugStringA(released);
+            releasedBytes += load.releasedBytes;
+        }
+    }
+    if (releasedBytes > 0)
+    {
+        sprintf_s(released, "Released %.1f MB of mesh data in all\n", releasedBytes / (1024.0 * 1024.0));
+        OutputDebugStringA(released);
+    }
+
+    // Copies come after their references, so a reference's deferred variant is built before theirs.
+    m_deferredVariants.clear();
+    for (const ModelLoad& load : m_modelLoads)
+    {
+        if (!load.deferred || !load.variants[1])
+        {
+            continue;
+        }
+
+        DeferredVariant deferred;
+        deferred.model = load.deferred;
+        deferred.source = load.variants[1];
+        deferred.reference = load.shared[1] ? m_modelLoads[load.reference].deferred : nullptr;
+        deferred.transform = load.shared[1] ? SimpleMath::Matrix(load.record.transform) : SimpleMath::Matrix::Identity;
+        m_deferredVariants.push_back(deferred);
+    }
+
+    // All variants are built, the parsed meshes are no longer needed.
+    m_meshCache.Clear();
+    m_modelLoads.clear();
+}
+
+// Builds the variants QueueModelVariants deferred, from the uploaded normal mapped buffers rather
+// than the files. A moved copy shares its reference's new buffers, like its normal mapped variant.
+void Game::BuildDeferredVariants(ID3D11DeviceContext* context)
+{
+    std::chrono::steady_clock::time_point start;
+    char built[128];
+    unsigned int count;
+
+    if (m_deferredVariants.empty())
+    {
+        return;
+    }
+
+    start = std::chrono::steady_clock::now();
+    count = 0;
+    for (const DeferredVariant& deferred : m_deferredVariants)
+    {
+        if ((deferred.reference && deferred.model->InitializeInstance(*deferred.reference, deferred.transform)) ||
+            deferred.model->InitializeVariant(context, *deferred.source))
+        {
+            count++;
+        }
+    }
+
+    sprintf_s(built, "Built %u of %u deferred model variants in %.1f ms\n", count, (unsigned int)m_deferredVariants.size(),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    OutputDebugStringA(built);
+
+    m_deferredVariants.clear();
+}
+
+// The load queued before index that it is a moved copy of, or -1: the one its instance record
+// names or, when it was parsed, one parsed before it whose geometry fits. A fit is written out
+// as an instance record so the next run does not need the parse. Instances are never references
+// themselves: whatever matches one matches its reference too.
+int Game::FindInstanceReference(int index)
+{
+    ModelLoad& load = m_modelLoads[index];
+    std::string referenceFilename;
+    int reference;
+
+    if (load.hasRecord)
+    {
+        referenceFilename = GetMeshInstanceReference(load.filename.c_str(), load.record);
+        for (reference = 0; reference < index; reference++)
+        {
+            const ModelLoad& candidate = m_modelLoads[reference];
+
+            if (candidate.found && candidate.reference < 0 && candidate.filename == referenceFilename &&
+                SameCookedMeshSource(candidate.source, load.record.referenceSource))
+            {
+                return reference;
+            }
+        }
+
+        return -1;
+    }
+
+    if (!load.mesh)
+    {
+        return -1;
+    }
+
+    for (reference = 0; reference < index; reference++)
+    {
+        const ModelLoad& candidate = m_modelLoads[reference];
+
+        if (!candidate.mesh || candidate.reference >= 0 || candidate.instanceKey != load.instanceKey ||
+            !FindRigidTransform(*candidate.mesh, *load.mesh, load.record.transform, nullptr))
+        {
+            continue;
+        }
+
+        // Failing to write the record only costs the next run a parse.
+        WriteMeshInstance(load.filename.c_str(), load.source, candidate.filename.c_str(), candidate.source, load.record.transform);
+
+        return reference;
+    }
+
+    return -1;
+}
+
+void Game::AddTextureUse(ModelClass* model, float repeats, TextureStreamer::Handle texture, TextureStreamer::Handle normalMap, TextureStreamer::Handle extra)
+{
+    TextureUse use;
+
+    use.model = model;
+    use.textureCount = 0;
+    use.repeats = repeats;
+    for (TextureStreamer::Handle handle : { texture, normalMap, extra })
+    {
+        if (handle != UINT32_MAX)
+        {
+            use.textures[use.textureCount++] = handle;
+        }
+    }
+
+    m_textureUses.push_back(use);
+}
+
+// Gives the streamer the pixels one repeat of each texture covers on every model in view. A model's
+// textures are taken to span its bounding sphere, seen from the sphere's nearest point, so a model
+// the camera is close to or inside asks for the most.
+void Game::RequestTextureFootprints()
+{
+    DirectX::BoundingSphere sphere;
+    SimpleMath::Matrix viewProjection = m_view * m_projection;
+    SimpleMath::Vector3 eye = m_Camera01.getPosition();
+    RECT output = m_deviceResources->GetOutputSize();
+    float planes[6][4], distance, pixels, pixelsPerUnit;
+    unsigned int i;
+    int plane;
+
+    ExtractFrustumPlanes(&viewProjection._11, planes);
+
+    // Pixels across per world unit at a distance of one.
+    pixelsPerUnit = m_projection._22 * float(output.bottom - output.top) * 0.5f;
+
+    for (const TextureUse& use : m_textureUses)
+    {
+        use.model->GetBoundingSphere().Transform(sphere, use.model->GetInstanceTransform());
+
+        for (plane = 0; plane < 6; plane++)
+        {
+            if (planes[plane][0] * sphere.Center.x + planes[plane][1] * sphere.Center.y + planes[plane][2] * sphere.Center.z + planes[plane][3] < -sphere.Radius)
+            {
+                break;
+            }
+        }
+        if (plane < 6)
+        {
+            continue;
+        }
+
+        distance = std::max(SimpleMath::Vector3::Distance(eye, SimpleMath::Vector3(sphere.Center)) - sphere.Radius, 0.01f);
+        pixels = pixelsPerUnit * 2.0f * sphere.Radius / (distance * use.repeats);
+        for (i = 0; i < use.textureCount; i++)
+        {
+            m_textures.RequestFootprint(use.textures[i], pixels);
+        }
+    }
+}
+
 // Allocate all memory resources that change on a window SizeChanged event.
 void Game::CreateWindowSizeDependentResources()
 {
@@ -1209,7 +1674,8 @@ void Game::OnDeviceLost()
     m_sky.reset();
     m_effect.reset();
     m_skyInputLayout.Reset();
-    m_cubemap.Reset();
+    m_textures.Shutdown();
+    m_textureUses.clear();
     m_ParticleSystem->Shutdown();
     delete m_ParticleSystem;  
 }
@@ -5,12 +5,16 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
+#include "AssetArchive.h"
 #include "Shader.h"
 #include "ShaderShadowMap.h"
 #include "ShaderNormalMap.h"
 #include "ShaderParticles.h"
 #include "ShaderIce.h"
 #include "modelclass.h"
+#include "MeshCache.h"
+#include "TaskPool.h"
+#include "TextureStreamer.h"
 #include "Light.h"
 #include "Input.h"
 #include "Camera.h"
@@ -61,6 +65,43 @@ private:
 		DirectX::XMMATRIX projection;
 	};
 
+	// One .obj and the render pass variants built from it, see QueueModelVariants.
+	struct ModelLoad
+	{
+		std::string filename;
+		ModelClass* variants[3];				// plain, normal mapped, shadow mapped
+		bool instanced;
+		bool found;
+		CookedMeshSource source;
+		std::shared_ptr<const ObjMesh> mesh;	// only when the .obj was parsed
+		uint64_t instanceKey;
+		bool hasRecord;
+		MeshInstanceRecord record;
+		bool pending[3];						// still to be built once every file has been looked at
+		bool shared[3];							// drawn from the reference's buffers
+		int reference;							// the load this one is a moved copy of, -1 when none
+		size_t releasedBytes;					// CPU copies of the variants freed once cooked
+		ModelClass* deferred;					// plain variant left to BuildDeferredVariants, nullptr when none
+	};
+
+	// A plain variant built from its file's normal mapped one the first time a pass draws it.
+	struct DeferredVariant
+	{
+		ModelClass* model;
+		ModelClass* source;
+		ModelClass* reference;					// the deferred variant of the file this is a moved copy of, nullptr when none
+		DirectX::SimpleMath::Matrix transform;	// from the reference's, as the copy's normal mapped variant
+	};
+
+	// A model of the main pass and the textures it is drawn with, whose footprints go to the streamer.
+	struct TextureUse
+	{
+		ModelClass* model;
+		TextureStreamer::Handle textures[3];
+		unsigned int textureCount;
+		float repeats;							// times the texture tiles across the model, see light_vs_tiling.hlsl
+	};
+
     void Update(DX::StepTimer const& timer);
     void Render();
     void RenderShadowMap();
@@ -68,6 +109,15 @@ private:
     void Clear();
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
+    void QueueModelVariants(const char* filename, ModelClass* plain, ModelClass* normalMapped, ModelClass* shadowMapped, bool instanced = false);
+    void StartModelLoads(ID3D11Device* device, TaskPool& loader, TaskPhase& phase);
+    void FinishModelLoads(ID3D11Device* device, TaskPool& loader);
+    void LoadModel(ID3D11Device* device, ModelLoad& load);
+    void BuildModelVariant(ID3D11Device* device, ModelLoad& load, int variant);
+    int FindInstanceReference(int index);
+    void BuildDeferredVariants(ID3D11DeviceContext* context);
+    void AddTextureUse(ModelClass* model, float repeats, TextureStreamer::Handle texture, TextureStreamer::Handle normalMap = UINT32_MAX, TextureStreamer::Handle extra = UINT32_MAX);
+    void RequestTextureFootprints();
 
 
     // Device resources.
@@ -105,7 +155,7 @@ private:
     std::unique_ptr<DirectX::GeometricPrimitive>                            m_sky;
     std::unique_ptr<SkyboxEffect>                                           m_effect;
     Microsoft::WRL::ComPtr<ID3D11InputLayout>                               m_skyInputLayout;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_cubemap;
+    TextureStreamer::Handle                                                 m_cubemap;
 
     //Shadow mapping
     Microsoft::WRL::ComPtr <ID3D11RasterizerState>                          m_shadowRenderState;
@@ -156,45 +206,48 @@ private:
     //Particle system
     ShaderParticles*                                                        m_ParticleShader;
     ParticleSystemClass*                                                    m_ParticleSystem;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texStar;    
+    TextureStreamer::Handle                                                 m_texStar;    
 
 	//textures 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texture1;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texSnowMountain;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texSnowMountainNormalMap;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texSnow;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texSnowNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texGlacier;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texGlacierNormalMap;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texDeadwood;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texDeadwoodNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texIgloo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texCrow;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texCrowNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texTerrain;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texCampStones;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texCampTreeStones;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texCampTreeStonesNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texIce;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texIceNormal;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfStones;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfStonesNormal;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfAsh;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfAshNormal;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfSkulls;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfSkullsNormal;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfBones;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfBlade;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texBfHilt;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texFoliageDeadBush;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texFoliageFern;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texFoliageGrass;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texEF;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texEFNormal;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texFire;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texFireNoise;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texFireAlpha;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texFog;
+	TextureStreamer::Handle                                                 m_texSnowMountain;
+	TextureStreamer::Handle                                                 m_texSnowMountainNormalMap;
+	TextureStreamer::Handle                                                 m_texSnow;
+	TextureStreamer::Handle                                                 m_texSnowNormal;
+	TextureStreamer::Handle                                                 m_texGlacier;
+	TextureStreamer::Handle                                                 m_texGlacierNormalMap;
+	TextureStreamer::Handle                                                 m_texDeadwood;
+	TextureStreamer::Handle                                                 m_texDeadwoodNormal;
+	TextureStreamer::Handle                                                 m_texIgloo;
+	TextureStreamer::Handle                                                 m_texCrow;
+	TextureStreamer::Handle                                                 m_texCrowNormal;
+	TextureStreamer::Handle                                                 m_texTerrain;
+	TextureStreamer::Handle                                                 m_texCampStones;
+	TextureStreamer::Handle                                                 m_texCampTreeStones;
+	TextureStreamer::Handle                                                 m_texCampTreeStonesNormal;
+	TextureStreamer::Handle                                                 m_texIce;
+	TextureStreamer::Handle                                                 m_texIceNormal;
+    TextureStreamer::Handle                                                 m_texBfStones;
+    TextureStreamer::Handle                                                 m_texBfStonesNormal;
+    TextureStreamer::Handle                                                 m_texBfAsh;
+    TextureStreamer::Handle                                                 m_texBfAshNormal;
+    TextureStreamer::Handle                                                 m_texBfSkulls;
+    TextureStreamer::Handle                                                 m_texBfSkullsNormal;
+    TextureStreamer::Handle                                                 m_texBfBones;
+    TextureStreamer::Handle                                                 m_texBfBlade;
+    TextureStreamer::Handle                                                 m_texBfHilt;
+    TextureStreamer::Handle                                                 m_texFoliageDeadBush;
+    TextureStreamer::Handle                                                 m_texFoliageFern;
+    TextureStreamer::Handle                                                 m_texFoliageGrass;
+    TextureStreamer::Handle                                                 m_texEF;
+    TextureStreamer::Handle                                                 m_texEFNormal;
+    TextureStreamer::Handle                                                 m_texFire;
+    TextureStreamer::Handle                                                 m_texFireNoise;
+    TextureStreamer::Handle                                                 m_texFireAlpha;
+    TextureStreamer::Handle                                                 m_texFog;
+    TextureStreamer                                                         m_textures;
+    uint64_t                                                                m_textureBudget;
+    std::vector<TextureUse>                                                 m_textureUses;
 
 
 	//Shaders
@@ -208,6 +261,9 @@ private:
     ShaderFire                                                              m_BasicShaderPairFire;
 	
     //Models    
+    MeshCache                                                               m_meshCache;
+    std::vector<ModelLoad>                                                  m_modelLoads;
+    std::vector<DeferredVariant>                                            m_deferredVariants;
     ModelClass                                                              m_Fire;
     ModelClass                                                              m_GroundBox;
     ModelClass                                                              m_GroundBoxNM;
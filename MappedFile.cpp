@@ -0,0 +1,208 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MappedFile.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MappedFile.h"
+#include "AssetArchive.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	m_data = 0;
+	m_size = 0;
+	m_archived = false;
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = 0;
+#else
+	m_file = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+#ifdef _WIN32
+	LARGE_INTEGER fileSize;
+
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	if (!GetFileSizeEx(m_file, &fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	m_size = (size_t)fileSize.QuadPart;
+
+	// An empty file cannot be mapped, leave the view null.
+	if (m_size == 0)
+	{
+		return true;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+#else
+	struct stat fileInfo;
+
+	m_file = open(filename, O_RDONLY);
+	if (m_file < 0)
+	{
+		return false;
+	}
+
+	if (fstat(m_file, &fileInfo) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = (size_t)fileInfo.st_size;
+
+	// An empty file cannot be mapped, leave the view null.
+	if (m_size == 0)
+	{
+		return true;
+	}
+
+	void* view = mmap(0, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (view == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	// The whole file is read front to back, let the kernel read ahead aggressively.
+	madvise(view, m_size, MADV_SEQUENTIAL);
+
+	m_data = (const char*)view;
+#endif
+
+	return true;
+}
+
+bool MappedFile::OpenAsset(const char* filename)
+{
+	const AssetArchive* archive = GetMountedAssetArchive();
+	const AssetArchiveEntry* entry;
+
+	Close();
+
+	entry = archive ? archive->Find(filename) : 0;
+	if (!entry)
+	{
+		return Open(filename);
+	}
+
+	if (entry->flags & ASSET_ENTRY_COMPRESSED)
+	{
+		m_buffer.resize((size_t)entry->size);
+		if (!archive->Read(*entry, m_buffer.data()))
+		{
+			std::vector<char>().swap(m_buffer);
+			return false;
+		}
+		m_data = m_buffer.data();
+	}
+	else
+	{
+		m_data = archive->GetStoredData(*entry);
+	}
+
+	m_size = (size_t)entry->size;
+	m_archived = true;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_archived)
+	{
+		std::vector<char>().swap(m_buffer);
+		m_data = 0;
+		m_size = 0;
+		m_archived = false;
+		return;
+	}
+
+#ifdef _WIN32
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+	}
+
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = 0;
+	}
+
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_data)
+	{
+		munmap((void*)m_data, m_size);
+	}
+
+	if (m_file >= 0)
+	{
+		close(m_file);
+		m_file = -1;
+	}
+#endif
+
+	m_data = 0;
+	m_size = 0;
+
+	return;
+}
+
+const char* MappedFile::GetData() const
+{
+	return m_data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MappedFile.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: MappedFile
+////////////////////////////////////////////////////////////////////////////////
+
+// Read-only view of a whole file mapped into the address space.
+// Kept free of any D3D/pch dependency so the mesh tools can use it outside the game.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* filename);
+	void Close();
+
+	// An asset the game loads by name: the mounted asset archive's entry when it has one (see
+	// AssetArchive.h), used in place or decompressed into memory the view owns, else the file.
+	bool OpenAsset(const char* filename);
+
+	const char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+private:
+	const char* m_data;
+	size_t m_size;
+	bool m_archived;			// m_data points into the archive or m_buffer, nothing to unmap
+	std::vector<char> m_buffer;	// a compressed entry, decompressed
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+};
+
+#endif
@@ -0,0 +1,1464 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshBuilder.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshBuilder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MESH_BUILDER_SSE
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__)
+#define MESH_BUILDER_AVX
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if !defined(_MSC_VER) || _MSC_VER >= 1910
+#define MESH_BUILDER_AVX512
+#endif
+#endif
+#endif
+
+namespace
+{
+	// Triangles are processed in blocks this size, small enough for the kernel's results to stay in L1.
+	const size_t s_tangentBlockSize = 64;
+
+	// Floats in one vertex of the normal mapped layout, and in one triangle's frame in a block.
+	const size_t s_vertexFloats = sizeof(MeshVertexNM) / sizeof(float);
+	const size_t s_frameFloats = 8;
+
+	// Kernel results for one block: each triangle's unit tangent and binormal as a row, laid out
+	// like tangent and binormal in a vertex so one add takes a row into a corner, the angle at each
+	// of its corners, 0 for a degenerate triangle, and its texture space handedness. A row starts
+	// with two -0s, which line up with the end of a vertex's normal and leave it as it was, so the
+	// eight wide kernels add a row with one instruction.
+	struct TangentBlock
+	{
+		float frames[s_tangentBlockSize * s_frameFloats];
+		float weights[3][s_tangentBlockSize];
+		signed char handedness[s_tangentBlockSize];
+	};
+
+	template <typename T> T Splat(float x);
+
+	// One lane: the tangent kernels below compiled as plain scalar code, one triangle at a time.
+	struct Float1
+	{
+		float v;
+	};
+
+	// The vertex one corner of the triangle uses.
+	struct Corner1
+	{
+		const float* vertex;
+	};
+
+	template <> inline Float1 Splat<Float1>(float x) { Float1 r = { x }; return r; }
+	inline void Store(float* p, Float1 a) { *p = a.v; }
+	inline Float1 operator+(Float1 a, Float1 b) { a.v += b.v; return a; }
+	inline Float1 operator-(Float1 a, Float1 b) { a.v -= b.v; return a; }
+	inline Float1 operator*(Float1 a, Float1 b) { a.v *= b.v; return a; }
+	inline Float1 operator/(Float1 a, Float1 b) { a.v /= b.v; return a; }
+	inline Float1 MulAdd(Float1 a, Float1 b, Float1 c) { a.v = a.v * b.v + c.v; return a; }
+	inline Float1 MulSub(Float1 a, Float1 b, Float1 c) { a.v = a.v * b.v - c.v; return a; }
+	inline Float1 Sqrt(Float1 a) { a.v = sqrtf(a.v); return a; }
+	inline Float1 InverseSqrt(Float1 a) { a.v = 1.0f / sqrtf(a.v); return a; }
+	inline Float1 Min(Float1 a, Float1 b) { a.v = std::min(a.v, b.v); return a; }
+	inline Float1 Max(Float1 a, Float1 b) { a.v = std::max(a.v, b.v); return a; }
+	inline Float1 Abs(Float1 a) { a.v = fabsf(a.v); return a; }
+	inline Float1 Less(Float1 a, Float1 b) { a.v = (a.v < b.v) ? 1.0f : 0.0f; return a; }
+	inline Float1 And(Float1 a, Float1 b) { a.v = (a.v != 0.0f && b.v != 0.0f) ? 1.0f : 0.0f; return a; }
+	inline Float1 Select(Float1 mask, Float1 a, Float1 b) { return (mask.v != 0.0f) ? a : b; }
+	inline Float1 Keep(Float1 mask, Float1 a) { a.v = (mask.v != 0.0f) ? a.v : 0.0f; return a; }
+	inline void LoadCorner(const MeshVertexNM* vertices, const unsigned int* indices, int corner, Corner1& r) { r.vertex = vertices[indices[corner]].position; }
+	inline Float1 Gather(const Corner1& corner, int component) { Float1 r = { corner.vertex[component] }; return r; }
+
+	// 1 for a positive area, -1 for a negative one, else 0.
+	inline void StoreHandedness(signed char* p, Float1 area)
+	{
+		*p = (area.v > 0.0f) ? 1 : (area.v < 0.0f) ? -1 : 0;
+	}
+
+	// Tangent and binormal, one lane's six floats at p.
+	inline void StoreFrames(float* p, size_t stride, Float1 tx, Float1 ty, Float1 tz, Float1 bx, Float1 by, Float1 bz)
+	{
+		(void)stride;
+		p[0] = tx.v;
+		p[1] = ty.v;
+		p[2] = tz.v;
+		p[3] = bx.v;
+		p[4] = by.v;
+		p[5] = bz.v;
+	}
+
+	// Normal, tangent and binormal of the vertex, three components each.
+	inline void LoadVertexFrames(const MeshVertexNM* v, Float1* n, Float1* t, Float1* b)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			n[axis].v = v->normal[axis];
+			t[axis].v = v->tangent[axis];
+			b[axis].v = v->binormal[axis];
+		}
+	}
+
+	// Adds a frame row times weight to the tangent and binormal at p.
+	inline void AddFrame(float* p, const float* frame, Float1 weight)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			p[i] += frame[2 + i] * weight.v;
+		}
+	}
+
+	// Zeroes the tangent and binormal at p. With SSE the stores are the four and two floats the
+	// wider AddFrames load, which a split store could not forward to them.
+	template <typename T> inline void ClearFrame(float* p)
+	{
+#ifdef MESH_BUILDER_SSE
+		_mm_storeu_ps(p, _mm_setzero_ps());
+		_mm_storel_pi(reinterpret_cast<__m64*>(p + 4), _mm_setzero_ps());
+#else
+		memset(p, 0, 6 * sizeof(float));
+#endif
+	}
+
+	// Bit per triangle of the T's worth at indices with handedness side and a corner marked in sides.
+	template <typename T> inline int MarkedFaces(const unsigned int* indices, const signed char* handedness, const unsigned char* sides, signed char side)
+	{
+		int mask = 0, lane;
+
+		for (lane = 0; lane < (int)(sizeof(T) / sizeof(float)); lane++)
+		{
+			if (handedness[lane] == side && (sides[indices[lane * 3]] | sides[indices[lane * 3 + 1]] | sides[indices[lane * 3 + 2]]) != 0)
+			{
+				mask |= 1 << lane;
+			}
+		}
+
+		return mask;
+	}
+
+	// Four lanes of floats: SSE where the compiler targets it, plain arrays elsewhere. The bounds
+	// kernel and the four wide tangent kernels are written against it.
+#ifdef MESH_BUILDER_SSE
+	struct Float4
+	{
+		__m128 v;
+	};
+
+	inline Float4 Load4(const float* p) { Float4 r = { _mm_loadu_ps(p) }; return r; }
+	inline Float4 Set4(float x) { Float4 r = { _mm_set1_ps(x) }; return r; }
+	inline Float4 Set4(float x, float y, float z, float w) { Float4 r = { _mm_setr_ps(x, y, z, w) }; return r; }
+	template <> inline Float4 Splat<Float4>(float x) { return Set4(x); }
+	inline void Store(float* p, Float4 a) { _mm_storeu_ps(p, a.v); }
+	inline Float4 operator+(Float4 a, Float4 b) { Float4 r = { _mm_add_ps(a.v, b.v) }; return r; }
+	inline Float4 operator-(Float4 a, Float4 b) { Float4 r = { _mm_sub_ps(a.v, b.v) }; return r; }
+	inline Float4 operator*(Float4 a, Float4 b) { Float4 r = { _mm_mul_ps(a.v, b.v) }; return r; }
+	inline Float4 operator/(Float4 a, Float4 b) { Float4 r = { _mm_div_ps(a.v, b.v) }; return r; }
+	inline Float4 Sqrt(Float4 a) { Float4 r = { _mm_sqrt_ps(a.v) }; return r; }
+	inline Float4 InverseSqrt(Float4 a)
+	{
+		__m128 r = _mm_rsqrt_ps(a.v);
+		Float4 x = { _mm_mul_ps(_mm_mul_ps(a.v, r), r) }, e = { r };
+
+		return e * (Set4(1.5f) - Set4(0.5f) * x);
+	}
+	inline Float4 Min(Float4 a, Float4 b) { Float4 r = { _mm_min_ps(a.v, b.v) }; return r; }
+	inline Float4 Max(Float4 a, Float4 b) { Float4 r = { _mm_max_ps(a.v, b.v) }; return r; }
+	inline Float4 Abs(Float4 a) { Float4 r = { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; return r; }
+	inline Float4 Less(Float4 a, Float4 b) { Float4 r = { _mm_cmplt_ps(a.v, b.v) }; return r; }
+	inline Float4 And(Float4 a, Float4 b) { Float4 r = { _mm_and_ps(a.v, b.v) }; return r; }
+	inline Float4 Select(Float4 mask, Float4 a, Float4 b) { Float4 r = { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; return r; }
+	inline Float4 Keep(Float4 mask, Float4 a) { return And(mask, a); }
+	inline Float4 MulAdd(Float4 a, Float4 b, Float4 c) { return a * b + c; }
+	inline Float4 MulSub(Float4 a, Float4 b, Float4 c) { return a * b - c; }
+
+	// Position and texture coordinates of one corner of four triangles.
+	struct Corner4
+	{
+		Float4 component[5];
+	};
+
+	inline void LoadCorner(const MeshVertexNM* vertices, const unsigned int* indices, int corner, Corner4& r)
+	{
+		const float* p[4];
+		__m128 rows[4];
+		int lane;
+
+		for (lane = 0; lane < 4; lane++)
+		{
+			p[lane] = vertices[indices[lane * 3 + corner]].position;
+			rows[lane] = _mm_loadu_ps(p[lane]);
+		}
+
+		_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+		for (lane = 0; lane < 4; lane++)
+		{
+			r.component[lane].v = rows[lane];
+		}
+		r.component[4] = Set4(p[0][4], p[1][4], p[2][4], p[3][4]);
+	}
+
+	// One float of the corner: 0 to 2 are the position, 3 and 4 the texture coordinates.
+	inline Float4 Gather(const Corner4& corner, int component)
+	{
+		return corner.component[component];
+	}
+
+	// The compare masks are -1 where true, so negative less positive is the handedness.
+	inline void StoreHandedness(signed char* p, Float4 area)
+	{
+		__m128i positive = _mm_castps_si128(_mm_cmpgt_ps(area.v, _mm_setzero_ps()));
+		__m128i negative = _mm_castps_si128(_mm_cmplt_ps(area.v, _mm_setzero_ps()));
+		__m128i lanes = _mm_sub_epi32(negative, positive);
+		int packed;
+
+		lanes = _mm_packs_epi32(lanes, lanes);
+		packed = _mm_cvtsi128_si32(_mm_packs_epi16(lanes, lanes));
+		memcpy(p, &packed, 4);
+	}
+
+	// Tangent and binormal of four lanes, transposed to six floats at p, p + stride and so on.
+	inline void StoreFrames(float* p, size_t stride, Float4 tx, Float4 ty, Float4 tz, Float4 bx, Float4 by, Float4 bz)
+	{
+		__m128 rows[4] = { tx.v, ty.v, tz.v, bx.v };
+		__m128 pairs[2] = { _mm_unpacklo_ps(by.v, bz.v), _mm_unpackhi_ps(by.v, bz.v) };
+		int lane;
+
+		_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+		for (lane = 0; lane < 4; lane++)
+		{
+			_mm_storeu_ps(p + lane * stride, rows[lane]);
+			if (lane % 2 == 0)
+			{
+				_mm_storel_pi(reinterpret_cast<__m64*>(p + lane * stride + 4), pairs[lane / 2]);
+			}
+			else
+			{
+				_mm_storeh_pi(reinterpret_cast<__m64*>(p + lane * stride + 4), pairs[lane / 2]);
+			}
+		}
+	}
+
+	// Normal, tangent and binormal of four vertices in a row, three components each. Nine floats
+	// follow one another from the normal on, read as two rows of four and one more.
+	inline void LoadVertexFrames(const MeshVertexNM* v, Float4* n, Float4* t, Float4* b)
+	{
+		__m128 first[4], second[4];
+		int lane;
+
+		for (lane = 0; lane < 4; lane++)
+		{
+			first[lane] = _mm_loadu_ps(v[lane].normal);
+			second[lane] = _mm_loadu_ps(&v[lane].tangent[1]);
+		}
+
+		_MM_TRANSPOSE4_PS(first[0], first[1], first[2], first[3]);
+		_MM_TRANSPOSE4_PS(second[0], second[1], second[2], second[3]);
+		n[0].v = first[0];
+		n[1].v = first[1];
+		n[2].v = first[2];
+		t[0].v = first[3];
+		t[1].v = second[0];
+		t[2].v = second[1];
+		b[0].v = second[2];
+		b[1].v = second[3];
+		b[2] = Set4(v[0].binormal[2], v[1].binormal[2], v[2].binormal[2], v[3].binormal[2]);
+	}
+
+	inline void AddFrame(float* p, const float* frame, Float4 weight)
+	{
+		__m128 pair = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(p + 4));
+
+		pair = _mm_add_ps(pair, _mm_mul_ps(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(frame + 6)), weight.v));
+		_mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(_mm_loadu_ps(frame + 2), weight.v)));
+		_mm_storel_pi(reinterpret_cast<__m64*>(p + 4), pair);
+	}
+#else
+	struct Float4
+	{
+		float v[4];
+	};
+
+	inline Float4 Load4(const float* p) { Float4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+	inline Float4 Set4(float x) { Float4 r = { { x, x, x, x } }; return r; }
+	inline Float4 Set4(float x, float y, float z, float w) { Float4 r = { { x, y, z, w } }; return r; }
+	inline void Store(float* p, Float4 a) { memcpy(p, a.v, sizeof(a.v)); }
+	inline Float4 operator+(Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+	inline Float4 operator-(Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+	inline Float4 operator*(Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+	inline Float4 Min(Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] = std::min(a.v[i], b.v[i]); return a; }
+	inline Float4 Max(Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] = std::max(a.v[i], b.v[i]); return a; }
+#endif
+
+	// Eight lanes of floats with AVX2 and FMA, compiled whatever the build targets and only run
+	// where the CPU has them (see IsMeshSimdSupported). Only MulAdd fuses: GCC left to itself would
+	// fuse du1 * dv2 - du2 * dv1 too, and give collinear texture coordinates an area of rounding noise.
+#ifdef MESH_BUILDER_AVX
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#pragma GCC optimize("fp-contract=off")
+#endif
+	struct Float8
+	{
+		__m256 v;
+	};
+
+	template <> inline Float8 Splat<Float8>(float x) { Float8 r = { _mm256_set1_ps(x) }; return r; }
+	inline void Store(float* p, Float8 a) { _mm256_storeu_ps(p, a.v); }
+	inline Float8 operator+(Float8 a, Float8 b) { Float8 r = { _mm256_add_ps(a.v, b.v) }; return r; }
+	inline Float8 operator-(Float8 a, Float8 b) { Float8 r = { _mm256_sub_ps(a.v, b.v) }; return r; }
+	inline Float8 operator*(Float8 a, Float8 b) { Float8 r = { _mm256_mul_ps(a.v, b.v) }; return r; }
+	inline Float8 operator/(Float8 a, Float8 b) { Float8 r = { _mm256_div_ps(a.v, b.v) }; return r; }
+	inline Float8 MulAdd(Float8 a, Float8 b, Float8 c) { Float8 r = { _mm256_fmadd_ps(a.v, b.v, c.v) }; return r; }
+	inline Float8 MulSub(Float8 a, Float8 b, Float8 c) { Float8 r = { _mm256_fmsub_ps(a.v, b.v, c.v) }; return r; }
+	inline Float8 Sqrt(Float8 a) { Float8 r = { _mm256_sqrt_ps(a.v) }; return r; }
+	inline Float8 InverseSqrt(Float8 a)
+	{
+		__m256 r = _mm256_rsqrt_ps(a.v);
+		__m256 h = _mm256_mul_ps(_mm256_mul_ps(a.v, _mm256_set1_ps(0.5f)), r);
+		Float8 e = { _mm256_mul_ps(r, _mm256_fnmadd_ps(h, r, _mm256_set1_ps(1.5f))) };
+
+		return e;
+	}
+	inline Float8 Min(Float8 a, Float8 b) { Float8 r = { _mm256_min_ps(a.v, b.v) }; return r; }
+	inline Float8 Max(Float8 a, Float8 b) { Float8 r = { _mm256_max_ps(a.v, b.v) }; return r; }
+	inline Float8 Abs(Float8 a) { Float8 r = { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; return r; }
+	inline Float8 Less(Float8 a, Float8 b) { Float8 r = { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; return r; }
+	inline Float8 And(Float8 a, Float8 b) { Float8 r = { _mm256_and_ps(a.v, b.v) }; return r; }
+	inline Float8 Select(Float8 mask, Float8 a, Float8 b) { Float8 r = { _mm256_blendv_ps(b.v, a.v, mask.v) }; return r; }
+	inline Float8 Keep(Float8 mask, Float8 a) { return And(mask, a); }
+
+	// Transposes the four by four blocks in both halves of the rows.
+	inline void Transpose4(__m256* rows)
+	{
+		__m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+		__m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+		__m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+		__m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+
+		rows[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		rows[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		rows[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		rows[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// Four floats at p[lane] and p[lane + 4], lane 0 to 3, as the halves of four rows.
+	inline void LoadRows(const float* const* p, __m256* rows)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			rows[lane] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p[lane])), _mm_loadu_ps(p[lane + 4]), 1);
+		}
+	}
+
+	// The last of the four floats at p[lane] and p[lane + 4], as LoadRows and Transpose4 would leave
+	// it in rows[3], for three shuffles rather than eight.
+	inline __m256 LoadLastColumn(const float* const* p)
+	{
+		__m256 rows[4];
+
+		LoadRows(p, rows);
+		return _mm256_shuffle_ps(_mm256_unpackhi_ps(rows[0], rows[1]), _mm256_unpackhi_ps(rows[2], rows[3]), _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// Position and texture coordinates of one corner of eight triangles. The lanes are loaded four
+	// floats at a time and transposed, which beats a gather per component.
+	struct Corner8
+	{
+		Float8 component[5];
+	};
+
+	inline void LoadCorner(const MeshVertexNM* vertices, const unsigned int* indices, int corner, Corner8& r)
+	{
+		const float* p[8];
+		const float* q[8];
+		__m256 rows[4];
+		int lane;
+
+		for (lane = 0; lane < 8; lane++)
+		{
+			p[lane] = vertices[indices[lane * 3 + corner]].position;
+			q[lane] = p[lane] + 1;
+		}
+
+		LoadRows(p, rows);
+		Transpose4(rows);
+		for (lane = 0; lane < 4; lane++)
+		{
+			r.component[lane].v = rows[lane];
+		}
+		r.component[4].v = LoadLastColumn(q);
+	}
+
+	inline Float8 Gather(const Corner8& corner, int component)
+	{
+		return corner.component[component];
+	}
+
+	inline void StoreHandedness(signed char* p, Float8 area)
+	{
+		__m256i positive = _mm256_castps_si256(_mm256_cmp_ps(area.v, _mm256_setzero_ps(), _CMP_GT_OQ));
+		__m256i negative = _mm256_castps_si256(_mm256_cmp_ps(area.v, _mm256_setzero_ps(), _CMP_LT_OQ));
+		__m256i lanes = _mm256_sub_epi32(negative, positive);
+		__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi16(packed, packed));
+	}
+
+	inline void StoreFrames(float* p, size_t stride, Float8 tx, Float8 ty, Float8 tz, Float8 bx, Float8 by, Float8 bz)
+	{
+		__m256 rows[4] = { tx.v, ty.v, tz.v, bx.v };
+		__m256 pairs[2] = { _mm256_unpacklo_ps(by.v, bz.v), _mm256_unpackhi_ps(by.v, bz.v) };
+		__m128 row, pair;
+		int lane;
+
+		Transpose4(rows);
+		for (lane = 0; lane < 8; lane++)
+		{
+			row = (lane < 4) ? _mm256_castps256_ps128(rows[lane]) : _mm256_extractf128_ps(rows[lane - 4], 1);
+			pair = (lane < 4) ? _mm256_castps256_ps128(pairs[lane % 4 / 2]) : _mm256_extractf128_ps(pairs[lane % 4 / 2], 1);
+			_mm_storeu_ps(p + lane * stride, row);
+			if (lane % 2 == 0)
+			{
+				_mm_storel_pi(reinterpret_cast<__m64*>(p + lane * stride + 4), pair);
+			}
+			else
+			{
+				_mm_storeh_pi(reinterpret_cast<__m64*>(p + lane * stride + 4), pair);
+			}
+		}
+	}
+
+	inline void LoadVertexFrames(const MeshVertexNM* v, Float8* n, Float8* t, Float8* b)
+	{
+		const float* p[8];
+		__m256 first[4], second[4];
+		int lane;
+
+		for (lane = 0; lane < 8; lane++)
+		{
+			p[lane] = v[lane].normal;
+		}
+		LoadRows(p, first);
+		for (lane = 0; lane < 8; lane++)
+		{
+			p[lane] = &v[lane].tangent[1];
+		}
+		LoadRows(p, second);
+		for (lane = 0; lane < 8; lane++)
+		{
+			p[lane] = &v[lane].tangent[2];
+		}
+
+		Transpose4(first);
+		Transpose4(second);
+		n[0].v = first[0];
+		n[1].v = first[1];
+		n[2].v = first[2];
+		t[0].v = first[3];
+		t[1].v = second[0];
+		t[2].v = second[1];
+		b[0].v = second[2];
+		b[1].v = second[3];
+		b[2].v = LoadLastColumn(p);
+	}
+
+	// The whole row in one add, from the last two floats of the normal, which its -0s leave as they were.
+	inline void AddFrame(float* p, const float* frame, Float8 weight)
+	{
+		_mm256_storeu_ps(p - 2, _mm256_fmadd_ps(_mm256_loadu_ps(frame), weight.v, _mm256_loadu_ps(p - 2)));
+	}
+
+	// The same eight floats with the normal's kept, so the first add reads back what this stored.
+	template <> inline void ClearFrame<Float8>(float* p)
+	{
+		_mm256_storeu_ps(p - 2, _mm256_blend_ps(_mm256_loadu_ps(p - 2), _mm256_setzero_ps(), 0xfc));
+	}
+
+	// The corners of eight triangles are three rows of indices; each is blended from the three loads
+	// and put in triangle order before the gather, which reads four bytes of sides at each.
+	template <> inline int MarkedFaces<Float8>(const unsigned int* indices, const signed char* handedness, const unsigned char* sides, signed char side)
+	{
+		const int* base = reinterpret_cast<const int*>(sides);
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + 8));
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + 16));
+		__m256i corner0 = _mm256_blend_epi32(_mm256_blend_epi32(a, b, 0x92), c, 0x24);
+		__m256i corner1 = _mm256_blend_epi32(_mm256_blend_epi32(a, b, 0x24), c, 0x49);
+		__m256i corner2 = _mm256_blend_epi32(_mm256_blend_epi32(a, b, 0x49), c, 0x92);
+		__m256i marks, hands;
+
+		corner0 = _mm256_permutevar8x32_epi32(corner0, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+		corner1 = _mm256_permutevar8x32_epi32(corner1, _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6));
+		corner2 = _mm256_permutevar8x32_epi32(corner2, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+		marks = _mm256_or_si256(_mm256_i32gather_epi32(base, corner0, 1), _mm256_i32gather_epi32(base, corner1, 1));
+		marks = _mm256_and_si256(_mm256_or_si256(marks, _mm256_i32gather_epi32(base, corner2, 1)), _mm256_set1_epi32(0xff));
+		hands = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(handedness)));
+		marks = _mm256_andnot_si256(_mm256_cmpeq_epi32(marks, _mm256_setzero_si256()), _mm256_cmpeq_epi32(hands, _mm256_set1_epi32(side)));
+
+		return _mm256_movemask_ps(_mm256_castsi256_ps(marks));
+	}
+
+	namespace TangentsAvx2
+	{
+		typedef Float8 FloatN;
+		typedef Corner8 CornerN;
+#include "MeshTangentKernels.h"
+	}
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
+
+	// Sixteen lanes with AVX-512F, on the same terms as Float8. The compares give bit masks, which
+	// Less widens back to all-ones lanes so the kernels can keep treating masks as floats.
+#ifdef MESH_BUILDER_AVX512
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma")
+#pragma GCC optimize("fp-contract=off")
+#endif
+	struct Float16
+	{
+		__m512 v;
+	};
+
+	template <> inline Float16 Splat<Float16>(float x) { Float16 r = { _mm512_set1_ps(x) }; return r; }
+	inline void Store(float* p, Float16 a) { _mm512_storeu_ps(p, a.v); }
+	inline Float16 operator+(Float16 a, Float16 b) { Float16 r = { _mm512_add_ps(a.v, b.v) }; return r; }
+	inline Float16 operator-(Float16 a, Float16 b) { Float16 r = { _mm512_sub_ps(a.v, b.v) }; return r; }
+	inline Float16 operator*(Float16 a, Float16 b) { Float16 r = { _mm512_mul_ps(a.v, b.v) }; return r; }
+	inline Float16 operator/(Float16 a, Float16 b) { Float16 r = { _mm512_div_ps(a.v, b.v) }; return r; }
+	inline Float16 MulAdd(Float16 a, Float16 b, Float16 c) { Float16 r = { _mm512_fmadd_ps(a.v, b.v, c.v) }; return r; }
+	inline Float16 MulSub(Float16 a, Float16 b, Float16 c) { Float16 r = { _mm512_fmsub_ps(a.v, b.v, c.v) }; return r; }
+	inline Float16 Sqrt(Float16 a) { Float16 r = { _mm512_sqrt_ps(a.v) }; return r; }
+	inline Float16 InverseSqrt(Float16 a)
+	{
+		__m512 r = _mm512_rsqrt14_ps(a.v);
+		__m512 h = _mm512_mul_ps(_mm512_mul_ps(a.v, _mm512_set1_ps(0.5f)), r);
+		Float16 e = { _mm512_mul_ps(r, _mm512_fnmadd_ps(h, r, _mm512_set1_ps(1.5f))) };
+
+		return e;
+	}
+	inline Float16 Min(Float16 a, Float16 b) { Float16 r = { _mm512_min_ps(a.v, b.v) }; return r; }
+	inline Float16 Max(Float16 a, Float16 b) { Float16 r = { _mm512_max_ps(a.v, b.v) }; return r; }
+	inline Float16 Abs(Float16 a) { Float16 r = { _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(a.v), _mm512_set1_epi32(0x7fffffff))) }; return r; }
+	inline Float16 Less(Float16 a, Float16 b)
+	{
+		Float16 r = { _mm512_castsi512_ps(_mm512_maskz_mov_epi32(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ), _mm512_set1_epi32(-1))) };
+
+		return r;
+	}
+	inline Float16 And(Float16 a, Float16 b) { Float16 r = { _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(a.v), _mm512_castps_si512(b.v))) }; return r; }
+	inline Float16 Select(Float16 mask, Float16 a, Float16 b)
+	{
+		Float16 r = { _mm512_castsi512_ps(_mm512_ternarylogic_epi32(_mm512_castps_si512(mask.v), _mm512_castps_si512(a.v), _mm512_castps_si512(b.v), 0xca)) };
+
+		return r;
+	}
+	inline Float16 Keep(Float16 mask, Float16 a) { return And(mask, a); }
+
+	// Transposes the four by four blocks in each quarter of the rows.
+	inline void Transpose4(__m512* rows)
+	{
+		__m512 t0 = _mm512_unpacklo_ps(rows[0], rows[1]);
+		__m512 t1 = _mm512_unpackhi_ps(rows[0], rows[1]);
+		__m512 t2 = _mm512_unpacklo_ps(rows[2], rows[3]);
+		__m512 t3 = _mm512_unpackhi_ps(rows[2], rows[3]);
+
+		rows[0] = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		rows[1] = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		rows[2] = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		rows[3] = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// Four floats at p[lane], p[lane + 4], p[lane + 8] and p[lane + 12], lane 0 to 3, as the
+	// quarters of four rows.
+	inline void LoadRows(const float* const* p, __m512* rows)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			rows[lane] = _mm512_insertf32x4(_mm512_castps128_ps512(_mm_loadu_ps(p[lane])), _mm_loadu_ps(p[lane + 4]), 1);
+			rows[lane] = _mm512_insertf32x4(rows[lane], _mm_loadu_ps(p[lane + 8]), 2);
+			rows[lane] = _mm512_insertf32x4(rows[lane], _mm_loadu_ps(p[lane + 12]), 3);
+		}
+	}
+
+	// The eight lane LoadLastColumn's, into column; the result alone could not tell the two apart.
+	inline void LoadLastColumn(const float* const* p, __m512& column)
+	{
+		__m512 rows[4];
+
+		LoadRows(p, rows);
+		column = _mm512_shuffle_ps(_mm512_unpackhi_ps(rows[0], rows[1]), _mm512_unpackhi_ps(rows[2], rows[3]), _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	struct Corner16
+	{
+		Float16 component[5];
+	};
+
+	inline void LoadCorner(const MeshVertexNM* vertices, const unsigned int* indices, int corner, Corner16& r)
+	{
+		const float* p[16];
+		const float* q[16];
+		__m512 rows[4];
+		int lane;
+
+		for (lane = 0; lane < 16; lane++)
+		{
+			p[lane] = vertices[indices[lane * 3 + corner]].position;
+			q[lane] = p[lane] + 1;
+		}
+
+		LoadRows(p, rows);
+		Transpose4(rows);
+		for (lane = 0; lane < 4; lane++)
+		{
+			r.component[lane].v = rows[lane];
+		}
+		LoadLastColumn(q, r.component[4].v);
+	}
+
+	inline Float16 Gather(const Corner16& corner, int component)
+	{
+		return corner.component[component];
+	}
+
+	inline void StoreHandedness(signed char* p, Float16 area)
+	{
+		__mmask16 positive = _mm512_cmp_ps_mask(area.v, _mm512_setzero_ps(), _CMP_GT_OQ);
+		__mmask16 negative = _mm512_cmp_ps_mask(area.v, _mm512_setzero_ps(), _CMP_LT_OQ);
+		__m512i lanes = _mm512_mask_mov_epi32(_mm512_maskz_mov_epi32(positive, _mm512_set1_epi32(1)), negative, _mm512_set1_epi32(-1));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_cvtepi32_epi8(lanes));
+	}
+
+	inline void StoreFrames(float* p, size_t stride, Float16 tx, Float16 ty, Float16 tz, Float16 bx, Float16 by, Float16 bz)
+	{
+		__m512 rows[4] = { tx.v, ty.v, tz.v, bx.v };
+		__m512 pairs[2] = { _mm512_unpacklo_ps(by.v, bz.v), _mm512_unpackhi_ps(by.v, bz.v) };
+		__m128 pair;
+		int quarter, lane;
+
+		// The low quarter of each is stored, then the next one rotated down.
+		Transpose4(rows);
+		for (quarter = 0; quarter < 4; quarter++)
+		{
+			for (lane = 0; lane < 4; lane++)
+			{
+				pair = _mm512_castps512_ps128(pairs[lane / 2]);
+				_mm_storeu_ps(p + (quarter * 4 + lane) * stride, _mm512_castps512_ps128(rows[lane]));
+				if (lane % 2 == 0)
+				{
+					_mm_storel_pi(reinterpret_cast<__m64*>(p + (quarter * 4 + lane) * stride + 4), pair);
+				}
+				else
+				{
+					_mm_storeh_pi(reinterpret_cast<__m64*>(p + (quarter * 4 + lane) * stride + 4), pair);
+				}
+				rows[lane] = _mm512_shuffle_f32x4(rows[lane], rows[lane], _MM_SHUFFLE(0, 3, 2, 1));
+			}
+			pairs[0] = _mm512_shuffle_f32x4(pairs[0], pairs[0], _MM_SHUFFLE(0, 3, 2, 1));
+			pairs[1] = _mm512_shuffle_f32x4(pairs[1], pairs[1], _MM_SHUFFLE(0, 3, 2, 1));
+		}
+	}
+
+	inline void LoadVertexFrames(const MeshVertexNM* v, Float16* n, Float16* t, Float16* b)
+	{
+		const float* p[16];
+		__m512 first[4], second[4];
+		int lane;
+
+		for (lane = 0; lane < 16; lane++)
+		{
+			p[lane] = v[lane].normal;
+		}
+		LoadRows(p, first);
+		for (lane = 0; lane < 16; lane++)
+		{
+			p[lane] = &v[lane].tangent[1];
+		}
+		LoadRows(p, second);
+		for (lane = 0; lane < 16; lane++)
+		{
+			p[lane] = &v[lane].tangent[2];
+		}
+
+		Transpose4(first);
+		Transpose4(second);
+		n[0].v = first[0];
+		n[1].v = first[1];
+		n[2].v = first[2];
+		t[0].v = first[3];
+		t[1].v = second[0];
+		t[2].v = second[1];
+		b[0].v = second[2];
+		b[1].v = second[3];
+		LoadLastColumn(p, b[2].v);
+	}
+
+	// A row is eight floats, so the adds, the clears and the marked faces are Float8's.
+	inline void AddFrame(float* p, const float* frame, Float16 weight)
+	{
+		Float8 half = { _mm512_castps512_ps256(weight.v) };
+
+		AddFrame(p, frame, half);
+	}
+
+	template <> inline void ClearFrame<Float16>(float* p)
+	{
+		ClearFrame<Float8>(p);
+	}
+
+	template <> inline int MarkedFaces<Float16>(const unsigned int* indices, const signed char* handedness, const unsigned char* sides, signed char side)
+	{
+		return MarkedFaces<Float8>(indices, handedness, sides, side) | (MarkedFaces<Float8>(indices + 24, handedness + 8, sides, side) << 8);
+	}
+
+	namespace TangentsAvx512
+	{
+		typedef Float16 FloatN;
+		typedef Corner16 CornerN;
+#include "MeshTangentKernels.h"
+	}
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
+
+	namespace TangentsScalar
+	{
+		typedef Float1 FloatN;
+		typedef Corner1 CornerN;
+#include "MeshTangentKernels.h"
+	}
+
+#ifdef MESH_BUILDER_SSE
+	namespace TangentsSse2
+	{
+		typedef Float4 FloatN;
+		typedef Corner4 CornerN;
+#include "MeshTangentKernels.h"
+	}
+#endif
+
+	// One lane width's tangent kernels.
+	struct TangentKernels
+	{
+		void (*sumBlock)(MeshVertexNM* vertices, const unsigned int* indices, const unsigned int* targets, size_t count, TangentBlock& block,
+			unsigned int& zeroed);
+		unsigned int (*lowestIndex)(const unsigned int* indices, size_t count);
+		void (*orthonormalize)(MeshVertexNM* vertices, size_t count);
+		void (*findMarked)(const unsigned int* indices, const signed char* handedness, const unsigned char* sides, size_t count, signed char side,
+			std::vector<unsigned int>& faces);
+	};
+
+	bool HasAvx2()
+	{
+#if !defined(MESH_BUILDER_AVX)
+		return false;
+#elif defined(_MSC_VER)
+		const int fmaAvx = (1 << 12) | (1 << 27) | (1 << 28);	// FMA, OSXSAVE and AVX in ecx of leaf 1
+		int info[4];
+
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		// The OS has to save the YMM registers too.
+		__cpuid(info, 1);
+		if ((info[2] & fmaAvx) != fmaAvx || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+
+	bool HasAvx512()
+	{
+#if !defined(MESH_BUILDER_AVX512)
+		return false;
+#elif defined(_MSC_VER)
+		int info[4];
+
+		// The OS has to save the opmask and all of the ZMM registers too.
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 16)) != 0 && (_xgetbv(0) & 0xe6) == 0xe6;
+#else
+		return __builtin_cpu_supports("avx512f");
+#endif
+	}
+
+	// The widest kernels the CPU can run, found once.
+	MeshSimd GetBestMeshSimd()
+	{
+		static const MeshSimd best = !HasAvx2() ? (
+#ifdef MESH_BUILDER_SSE
+			MESH_SIMD_SSE2
+#else
+			MESH_SIMD_SCALAR
+#endif
+			) : HasAvx512() ? MESH_SIMD_AVX512 : MESH_SIMD_AVX2;
+
+		return best;
+	}
+
+	TangentKernels GetTangentKernels(MeshSimd simd)
+	{
+		TangentKernels kernels = { TangentsScalar::SumBlockTangents, TangentsScalar::LowestIndex, TangentsScalar::OrthonormalizeVertices,
+			TangentsScalar::FindMarkedFaces };
+
+		switch (simd == MESH_SIMD_BEST ? GetBestMeshSimd() : simd)
+		{
+#ifdef MESH_BUILDER_AVX512
+		case MESH_SIMD_AVX512:
+			kernels.sumBlock = TangentsAvx512::SumBlockTangents;
+			kernels.lowestIndex = TangentsAvx512::LowestIndex;
+			kernels.orthonormalize = TangentsAvx512::OrthonormalizeVertices;
+			kernels.findMarked = TangentsAvx512::FindMarkedFaces;
+			break;
+#endif
+#ifdef MESH_BUILDER_AVX
+		case MESH_SIMD_AVX2:
+			kernels.sumBlock = TangentsAvx2::SumBlockTangents;
+			kernels.lowestIndex = TangentsAvx2::LowestIndex;
+			kernels.orthonormalize = TangentsAvx2::OrthonormalizeVertices;
+			kernels.findMarked = TangentsAvx2::FindMarkedFaces;
+			break;
+#endif
+#ifdef MESH_BUILDER_SSE
+		case MESH_SIMD_SSE2:
+			kernels.sumBlock = TangentsSse2::SumBlockTangents;
+			kernels.lowestIndex = TangentsSse2::LowestIndex;
+			kernels.orthonormalize = TangentsSse2::OrthonormalizeVertices;
+			kernels.findMarked = TangentsSse2::FindMarkedFaces;
+			break;
+#endif
+		default:
+			break;
+		}
+
+		return kernels;
+	}
+
+	// Hash of one vertex, read as 32 bit words; every layout is a whole number of floats.
+	inline unsigned int HashVertex(const unsigned char* vertex, unsigned int stride)
+	{
+		unsigned int hash = 2166136261u;
+		unsigned int i, word;
+
+		for (i = 0; i < stride; i += 4)
+		{
+			memcpy(&word, vertex + i, sizeof(word));
+			hash = (hash ^ word) * 16777619u;
+		}
+
+		return hash ^ (hash >> 15);
+	}
+
+	inline void CopyFloat3(float destination[3], const ObjMesh::Float3& source)
+	{
+		destination[0] = source.x;
+		destination[1] = source.y;
+		destination[2] = source.z;
+	}
+
+	inline void CopyFloat2(float destination[2], const ObjMesh::Float2& source)
+	{
+		destination[0] = source.x;
+		destination[1] = source.y;
+	}
+}
+
+MeshData::MeshData()
+{
+	Clear();
+}
+
+void MeshData::Clear()
+{
+	layout = MESH_LAYOUT_PLAIN;
+	unrolledVertexCount = 0;
+	vertexCount = 0;
+	vertexStride = GetVertexStride(layout);
+	vertices.clear();
+	indices.clear();
+	lods.clear();
+	clusters.clear();
+	memset(boundsMin, 0, sizeof(boundsMin));
+	memset(boundsMax, 0, sizeof(boundsMax));
+	memset(boundsCenter, 0, sizeof(boundsCenter));
+	boundsRadius = 0.0f;
+	memset(&quantization, 0, sizeof(quantization));
+	quantization.positionScale[0] = quantization.positionScale[1] = quantization.positionScale[2] = 1.0f;
+	quantization.textureScale[0] = quantization.textureScale[1] = 1.0f;
+}
+
+unsigned int GetVertexStride(MeshLayout layout)
+{
+	switch (layout)
+	{
+	case MESH_LAYOUT_NORMALMAP:
+		return sizeof(MeshVertexNM);
+	case MESH_LAYOUT_SHADOWMAP:
+		return sizeof(MeshVertexSM);
+	case MESH_LAYOUT_NORMALMAP_PACKED:
+		return sizeof(MeshVertexNMPacked);
+	default:
+		return sizeof(MeshVertex);
+	}
+}
+
+unsigned int GetIndexSize(unsigned int vertexCount)
+{
+	return (vertexCount <= 0x10000) ? 2 : 4;
+}
+
+void PackIndices(const unsigned int* indices, size_t count, unsigned int indexSize, void* destination)
+{
+	size_t i;
+
+	if (indexSize == 4)
+	{
+		memcpy(destination, indices, count * sizeof(unsigned int));
+		return;
+	}
+
+	unsigned short* packed = static_cast<unsigned short*>(destination);
+	for (i = 0; i < count; i++)
+	{
+		packed[i] = (unsigned short)indices[i];
+	}
+
+	return;
+}
+
+void PackIndicesInPlace(unsigned int* indices, size_t count, unsigned int indexSize)
+{
+	unsigned char* bytes = reinterpret_cast<unsigned char*>(indices);
+	unsigned short value;
+	size_t i;
+
+	if (indexSize == 4)
+	{
+		return;
+	}
+
+	// Front to back, each index lands at or before bytes that have already been read.
+	for (i = 0; i < count; i++)
+	{
+		value = (unsigned short)indices[i];
+		memcpy(bytes + i * sizeof(value), &value, sizeof(value));
+	}
+
+	return;
+}
+
+void UnpackIndicesInPlace(unsigned int* indices, size_t count, unsigned int indexSize)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(indices);
+	unsigned short value;
+	size_t i;
+
+	if (indexSize == 4)
+	{
+		return;
+	}
+
+	// Back to front, for the same reason.
+	for (i = count; i > 0; i--)
+	{
+		memcpy(&value, bytes + (i - 1) * sizeof(value), sizeof(value));
+		indices[i - 1] = value;
+	}
+
+	return;
+}
+
+bool BuildMesh(const ObjMesh& obj, MeshLayout layout, MeshData& mesh)
+{
+	const std::vector<ObjMesh::Float3>& verts = obj.positions;
+	const std::vector<ObjMesh::Float2>& texCs = obj.texCoords;
+	const std::vector<ObjMesh::Float3>& norms = obj.normals;
+	const std::vector<unsigned int>& faces = obj.faces;
+	unsigned int i;
+
+	// Packed layouts are made from the float ones by QuantizeMesh.
+	if (layout != MESH_LAYOUT_PLAIN && layout != MESH_LAYOUT_NORMALMAP && layout != MESH_LAYOUT_SHADOWMAP)
+	{
+		return false;
+	}
+
+	mesh.Clear();
+	mesh.layout = layout;
+	mesh.vertexStride = GetVertexStride(layout);
+
+	// Create the model using the vertex count that was read in.
+	mesh.vertexCount = (unsigned int)obj.GetTriangleCount() * 3;
+	mesh.unrolledVertexCount = mesh.vertexCount;
+	mesh.vertices.resize((size_t)mesh.vertexCount * mesh.vertexStride);
+	mesh.indices.resize(mesh.vertexCount);
+
+	// "Unroll" the loaded obj information into a list of triangles.
+	for (i = 0; i < mesh.vertexCount; i++)
+	{
+		const unsigned int* corner = &faces[i * 3];
+
+		if (layout == MESH_LAYOUT_PLAIN)
+		{
+			MeshVertex& vertex = mesh.GetVertices<MeshVertex>()[i];
+			CopyFloat3(vertex.position, verts[corner[0]]);
+			CopyFloat2(vertex.texture, texCs[corner[1]]);
+			CopyFloat3(vertex.normal, norms[corner[2]]);
+		}
+		else if (layout == MESH_LAYOUT_NORMALMAP)
+		{
+			MeshVertexNM& vertex = mesh.GetVertices<MeshVertexNM>()[i];
+			CopyFloat3(vertex.position, verts[corner[0]]);
+			CopyFloat2(vertex.texture, texCs[corner[1]]);
+			CopyFloat3(vertex.normal, norms[corner[2]]);
+
+			//tangent and binormals will be calculated after welding
+			memset(vertex.tangent, 0, sizeof(vertex.tangent));
+			memset(vertex.binormal, 0, sizeof(vertex.binormal));
+		}
+		else
+		{
+			MeshVertexSM& vertex = mesh.GetVertices<MeshVertexSM>()[i];
+			CopyFloat3(vertex.position, verts[corner[0]]);
+		}
+
+		mesh.indices[i] = i;
+	}
+
+	// Corners shared between faces are identical once unrolled, so most of them collapse here.
+	WeldMesh(mesh);
+
+	// Tangents are summed over the welded vertices, so they come out smooth across shared corners.
+	if (layout == MESH_LAYOUT_NORMALMAP)
+	{
+		CalculateModelVectors(mesh);
+	}
+
+	CalculateMeshBounds(mesh);
+
+	return true;
+}
+
+void WeldMesh(MeshData& mesh)
+{
+	const unsigned int empty = 0xffffffffu;
+	const unsigned int stride = mesh.vertexStride;
+	std::vector<unsigned int> table;
+	std::vector<unsigned int> remap;
+	unsigned int tableSize, mask, i, slot, welded;
+
+	if (mesh.vertexCount == 0)
+	{
+		return;
+	}
+
+	// Open addressing table of welded vertex numbers, kept at most half full.
+	tableSize = 1;
+	while (tableSize < mesh.vertexCount * 2)
+	{
+		tableSize <<= 1;
+	}
+	mask = tableSize - 1;
+	table.assign(tableSize, empty);
+	remap.resize(mesh.vertexCount);
+
+	// Compact in place: a vertex is only ever moved down to a slot that has already been read.
+	welded = 0;
+	for (i = 0; i < mesh.vertexCount; i++)
+	{
+		const unsigned char* vertex = &mesh.vertices[(size_t)i * stride];
+
+		slot = HashVertex(vertex, stride) & mask;
+		while (table[slot] != empty && memcmp(&mesh.vertices[(size_t)table[slot] * stride], vertex, stride) != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		if (table[slot] == empty)
+		{
+			if (welded != i)
+			{
+				memcpy(&mesh.vertices[(size_t)welded * stride], vertex, stride);
+			}
+			table[slot] = welded;
+			welded++;
+		}
+
+		remap[i] = table[slot];
+	}
+
+	for (i = 0; i < (unsigned int)mesh.indices.size(); i++)
+	{
+		mesh.indices[i] = remap[mesh.indices[i]];
+	}
+
+	mesh.vertexCount = welded;
+	mesh.vertices.resize((size_t)welded * stride);
+	mesh.vertices.shrink_to_fit();
+
+	return;
+}
+
+bool IsMeshSimdSupported(MeshSimd simd)
+{
+	switch (simd)
+	{
+	case MESH_SIMD_SCALAR:
+	case MESH_SIMD_BEST:
+		return true;
+#ifdef MESH_BUILDER_SSE
+	case MESH_SIMD_SSE2:
+		return true;
+	case MESH_SIMD_AVX2:
+		return GetBestMeshSimd() >= MESH_SIMD_AVX2;
+	case MESH_SIMD_AVX512:
+		return GetBestMeshSimd() == MESH_SIMD_AVX512;
+#endif
+	default:
+		return false;
+	}
+}
+
+void CalculateModelVectors(MeshData& mesh, MeshSimd simd)
+{
+	const TangentKernels kernels = GetTangentKernels(simd);
+	TangentBlock block;
+	std::vector<signed char> handedness;
+	std::vector<unsigned char> sides;
+	std::vector<unsigned int> lowest, splits, mirror, faces, others, redo, targets;
+	MeshVertexNM* meshVertices;
+	size_t faceCount, blockCount, rareCount, first, count, i;
+	const void* found;
+	signed char rare;
+	int balance = 0;
+	unsigned int vertexCount, index, split, spare, zeroed = 0, done = 0, last;
+
+	faceCount = mesh.indices.size() / 3;
+	blockCount = (faceCount + s_tangentBlockSize - 1) / s_tangentBlockSize;
+	vertexCount = mesh.vertexCount;
+	meshVertices = mesh.GetVertices<MeshVertexNM>();
+
+	// The -0s each frame row starts with; the kernels only write the rest.
+	for (i = 0; i < s_tangentBlockSize; i++)
+	{
+		block.frames[i * s_frameFloats] = block.frames[i * s_frameFloats + 1] = -0.0f;
+	}
+
+	// The lowest vertex each block and every block after it uses.
+	lowest.resize(blockCount + 1);
+	lowest[blockCount] = vertexCount;
+	for (i = blockCount; i-- > 0;)
+	{
+		first = i * s_tangentBlockSize;
+		count = std::min(s_tangentBlockSize, faceCount - first);
+		lowest[i] = std::min(lowest[i + 1], kernels.lowestIndex(&mesh.indices[first * 3], count * 3));
+	}
+
+	// The tangents and binormals are summed in place, each block's triangles straight into their
+	// corners. The vertices below any a later block uses are done, and are made orthonormal while
+	// they are still in cache, eight at a time so the kernels seldom need their tails.
+	handedness.resize(faceCount);
+	for (i = 0; i < blockCount; i++)
+	{
+		first = i * s_tangentBlockSize;
+		count = std::min(s_tangentBlockSize, faceCount - first);
+		kernels.sumBlock(meshVertices, &mesh.indices[first * 3], &mesh.indices[first * 3], count, block, zeroed);
+		std::copy(block.handedness, block.handedness + count, &handedness[first]);
+
+		last = std::min(lowest[i + 1], zeroed) & ~7u;
+		if (last > done)
+		{
+			kernels.orthonormalize(&meshVertices[done], last - done);
+			done = last;
+		}
+	}
+
+	// And the ones no triangle uses.
+	for (; zeroed < vertexCount; zeroed++)
+	{
+		memset(meshVertices[zeroed].tangent, 0, sizeof(meshVertices[zeroed].tangent));
+		memset(meshVertices[zeroed].binormal, 0, sizeof(meshVertices[zeroed].binormal));
+	}
+
+	kernels.orthonormalize(&meshVertices[done], vertexCount - done);
+
+	// Where the texture is mirrored a vertex is shared by faces of both handedness, whose tangents
+	// have cancelled. Most meshes have none. Only the corners of the faces of the rarer handedness
+	// are marked, and a marked corner of any other face is split. The handedness add up to the
+	// right handed faces less the left handed ones.
+	for (i = 0; i < faceCount; i++)
+	{
+		balance += handedness[i];
+	}
+	rare = (balance < 0) ? 1 : -1;
+
+	for (i = 0; i < faceCount; i++)
+	{
+		found = memchr(&handedness[i], (unsigned char)rare, faceCount - i);
+		if (found == NULL)
+		{
+			break;
+		}
+
+		i = (const signed char*)found - handedness.data();
+		if (sides.empty())
+		{
+			// With three to spare for the four byte reads of the eight wide kernel.
+			sides.assign(vertexCount + 3, 0);
+		}
+		sides[mesh.indices[i * 3]] = sides[mesh.indices[i * 3 + 1]] = sides[mesh.indices[i * 3 + 2]] = 1;
+		faces.push_back((unsigned int)i);
+	}
+
+	if (!faces.empty())
+	{
+		// Without branches, as which corners are marked follows no pattern. Every corner is written to
+		// splits and only a newly split one is kept.
+		kernels.findMarked(mesh.indices.data(), handedness.data(), sides.data(), faceCount, -rare, others);
+		splits.resize(others.size() * 3);
+		split = 0;
+		for (i = 0; i < others.size() * 3; i++)
+		{
+			index = mesh.indices[others[i / 3] * 3 + i % 3];
+			splits[split] = index;
+			split += (sides[index] == 1) ? 1 : 0;
+			sides[index] = (sides[index] != 0) ? 3 : 0;
+		}
+		splits.resize(split);
+
+		// Of the marked faces, only the ones with a split corner are summed again.
+		rareCount = 0;
+		for (i = 0; i < faces.size(); i++)
+		{
+			index = faces[i];
+			if (((sides[mesh.indices[index * 3]] | sides[mesh.indices[index * 3 + 1]] | sides[mesh.indices[index * 3 + 2]]) & 2) != 0)
+			{
+				faces[rareCount++] = index;
+			}
+		}
+		faces.resize(rareCount);
+	}
+
+	if (!splits.empty())
+	{
+		// Each split vertex gets a copy for the faces of the rarer handedness and, after the copies,
+		// a twin for the other faces, and both are summed again from just the faces that use them,
+		// the rarer first. One spare vertex past them takes the corners that are not summed again.
+		// Twins and spare are dropped.
+		std::sort(splits.begin(), splits.end());
+		mirror.assign(vertexCount, 0xffffffffu);
+		for (index = 0; index < split; index++)
+		{
+			mirror[splits[index]] = vertexCount + index;
+		}
+
+		rareCount = faces.size();
+		faces.insert(faces.end(), others.begin(), others.end());
+
+		mesh.vertices.resize((size_t)(vertexCount + split * 2 + 1) * mesh.vertexStride);
+		meshVertices = mesh.GetVertices<MeshVertexNM>();
+		for (index = 0; index < split; index++)
+		{
+			meshVertices[vertexCount + index] = meshVertices[splits[index]];
+			meshVertices[vertexCount + split + index] = meshVertices[splits[index]];
+		}
+		mesh.vertexCount += split;
+		spare = vertexCount + split * 2;
+
+		redo.resize(faces.size() * 3);
+		targets.resize(faces.size() * 3);
+		for (i = 0; i < faces.size() * 3; i++)
+		{
+			index = mesh.indices[faces[i / 3] * 3 + i % 3];
+			if (mirror[index] == 0xffffffffu)
+			{
+				redo[i] = index;
+				targets[i] = spare;
+			}
+			else if (i < rareCount * 3)
+			{
+				redo[i] = targets[i] = mesh.indices[faces[i / 3] * 3 + i % 3] = mirror[index];
+			}
+			else
+			{
+				redo[i] = index;
+				targets[i] = mirror[index] + split;
+			}
+		}
+
+		for (first = 0; first < faces.size(); first += s_tangentBlockSize)
+		{
+			count = std::min(s_tangentBlockSize, faces.size() - first);
+			kernels.sumBlock(meshVertices, &redo[first * 3], &targets[first * 3], count, block, zeroed);
+		}
+
+		kernels.orthonormalize(&meshVertices[vertexCount], split * 2);
+		for (index = 0; index < split; index++)
+		{
+			memcpy(meshVertices[splits[index]].tangent, meshVertices[vertexCount + split + index].tangent, sizeof(meshVertices[index].tangent));
+			memcpy(meshVertices[splits[index]].binormal, meshVertices[vertexCount + split + index].binormal, sizeof(meshVertices[index].binormal));
+		}
+
+		mesh.vertices.resize((size_t)mesh.vertexCount * mesh.vertexStride);
+	}
+
+	return;
+}
+
+void CalculateMeshBounds(MeshData& mesh)
+{
+	const unsigned char* vertices = mesh.vertices.data();
+	const unsigned int stride = mesh.vertexStride;
+	Float4 lo[2], hi[2], cx, cy, cz, dx, dy, dz, farthest;
+	float lanes[4], last[4], radius;
+	unsigned int i;
+	int axis;
+
+	if (mesh.vertexCount == 0)
+	{
+		memset(mesh.boundsMin, 0, sizeof(mesh.boundsMin));
+		memset(mesh.boundsMax, 0, sizeof(mesh.boundsMax));
+		memset(mesh.boundsCenter, 0, sizeof(mesh.boundsCenter));
+		mesh.boundsRadius = 0.0f;
+		return;
+	}
+
+	// Every layout starts with the position, so the stride is all that differs. Each position is
+	// read as four floats, the fourth lane is whatever follows and is ignored; the last vertex is
+	// copied out first so the read stays inside the array.
+	memcpy(last, vertices + (size_t)(mesh.vertexCount - 1) * stride, sizeof(float) * 3);
+	last[3] = last[2];
+	lo[0] = lo[1] = hi[0] = hi[1] = Load4(last);
+	for (i = 0; i + 2 < mesh.vertexCount; i += 2)
+	{
+		Float4 a = Load4(reinterpret_cast<const float*>(vertices + (size_t)i * stride));
+		Float4 b = Load4(reinterpret_cast<const float*>(vertices + (size_t)(i + 1) * stride));
+
+		lo[0] = Min(lo[0], a);
+		hi[0] = Max(hi[0], a);
+		lo[1] = Min(lo[1], b);
+		hi[1] = Max(hi[1], b);
+	}
+	for (; i + 1 < mesh.vertexCount; i++)
+	{
+		Float4 a = Load4(reinterpret_cast<const float*>(vertices + (size_t)i * stride));
+
+		lo[0] = Min(lo[0], a);
+		hi[0] = Max(hi[0], a);
+	}
+
+	Store(lanes, Min(lo[0], lo[1]));
+	memcpy(mesh.boundsMin, lanes, sizeof(mesh.boundsMin));
+	Store(lanes, Max(hi[0], hi[1]));
+	memcpy(mesh.boundsMax, lanes, sizeof(mesh.boundsMax));
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		mesh.boundsCenter[axis] = (mesh.boundsMin[axis] + mesh.boundsMax[axis]) * 0.5f;
+	}
+
+	// Squared distance of four vertices at a time from the centre.
+	cx = Set4(mesh.boundsCenter[0]);
+	cy = Set4(mesh.boundsCenter[1]);
+	cz = Set4(mesh.boundsCenter[2]);
+	farthest = Set4(0.0f);
+	for (i = 0; i + 4 <= mesh.vertexCount; i += 4)
+	{
+		const float* p0 = reinterpret_cast<const float*>(vertices + (size_t)i * stride);
+		const float* p1 = reinterpret_cast<const float*>(vertices + (size_t)(i + 1) * stride);
+		const float* p2 = reinterpret_cast<const float*>(vertices + (size_t)(i + 2) * stride);
+		const float* p3 = reinterpret_cast<const float*>(vertices + (size_t)(i + 3) * stride);
+
+		dx = Set4(p0[0], p1[0], p2[0], p3[0]) - cx;
+		dy = Set4(p0[1], p1[1], p2[1], p3[1]) - cy;
+		dz = Set4(p0[2], p1[2], p2[2], p3[2]) - cz;
+		farthest = Max(farthest, dx * dx + dy * dy + dz * dz);
+	}
+
+	Store(lanes, farthest);
+	radius = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+	for (; i < mesh.vertexCount; i++)
+	{
+		const float* p = reinterpret_cast<const float*>(vertices + (size_t)i * stride);
+		float d[3] = { p[0] - mesh.boundsCenter[0], p[1] - mesh.boundsCenter[1], p[2] - mesh.boundsCenter[2] };
+
+		radius = std::max(radius, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	}
+
+	// Rounding in the subtraction must not leave the farthest vertex just outside.
+	mesh.boundsRadius = sqrtf(radius) * (1.0f + FLT_EPSILON * 4.0f);
+
+	return;
+}
+
+void CalculatePositionRemap(const MeshData& mesh, std::vector<unsigned int>& remap)
+{
+	std::vector<unsigned int> order(mesh.vertexCount);
+	unsigned int i, first;
+
+	auto position = [&mesh](unsigned int vertex)
+	{
+		return reinterpret_cast<const float*>(mesh.vertices.data() + (size_t)vertex * mesh.vertexStride);
+	};
+
+	for (i = 0; i < mesh.vertexCount; i++)
+	{
+		order[i] = i;
+	}
+
+	// Sorting by position puts every vertex next to its twins, lowest index first.
+	std::sort(order.begin(), order.end(), [&position](unsigned int a, unsigned int b)
+	{
+		const float* pa = position(a);
+		const float* pb = position(b);
+		if (pa[0] != pb[0]) return pa[0] < pb[0];
+		if (pa[1] != pb[1]) return pa[1] < pb[1];
+		if (pa[2] != pb[2]) return pa[2] < pb[2];
+		return a < b;
+	});
+
+	remap.resize(mesh.vertexCount);
+	first = 0;
+	for (i = 0; i < mesh.vertexCount; i++)
+	{
+		const float* p = position(order[i]);
+		const float* q = position(order[first]);
+		if (p[0] != q[0] || p[1] != q[1] || p[2] != q[2])
+		{
+			first = i;
+		}
+		remap[order[i]] = order[first];
+	}
+
+	return;
+}
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshBuilder.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MESHBUILDER_H_
+#define _MESHBUILDER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstdint>
+#include <vector>
+#include "ObjParser.h"
+
+// Vertex layouts the shaders consume. They must stay in step with the input layouts in
+// Shader, ShaderNormalMap, ShaderIce and ShaderShadowMap.
+enum MeshLayout
+{
+	MESH_LAYOUT_PLAIN = 0,				// position, texture, normal
+	MESH_LAYOUT_NORMALMAP = 1,			// position, texture, normal, tangent, binormal
+	MESH_LAYOUT_SHADOWMAP = 2,			// position only
+	MESH_LAYOUT_NORMALMAP_PACKED = 3,	// quantized MESH_LAYOUT_NORMALMAP, see MeshQuantizer.h
+	MESH_LAYOUT_COUNT = 4
+};
+
+// Instruction sets the tangent kernels of CalculateModelVectors can run on.
+enum MeshSimd
+{
+	MESH_SIMD_SCALAR = 0,				// one triangle at a time, no intrinsics
+	MESH_SIMD_SSE2 = 1,					// four lanes, where the build targets SSE2
+	MESH_SIMD_AVX2 = 2,					// eight lanes with FMA, where the CPU has them
+	MESH_SIMD_AVX512 = 3,				// sixteen lanes with AVX-512F, where the CPU has it
+	MESH_SIMD_BEST = 4					// the widest of these the CPU runs
+};
+
+struct MeshVertex
+{
+	float position[3];
+	float texture[2];
+	float normal[3];
+};
+
+struct MeshVertexNM
+{
+	float position[3];
+	float texture[2];
+	float normal[3];
+	float tangent[3];
+	float binormal[3];
+};
+
+struct MeshVertexSM
+{
+	float position[3];
+};
+
+struct MeshVertexNMPacked
+{
+	uint16_t position[4];	// xyz dequantized with the mesh's scale and bias, w is the binormal sign (0 = -1, 65535 = +1)
+	uint16_t texture[2];	// dequantized with the mesh's scale and bias
+	int16_t normal[2];		// octahedral
+	int16_t tangent[2];		// octahedral, the binormal is rebuilt as sign * cross(normal, tangent)
+};
+
+// Dequantization constants of a packed mesh: value = unorm * scale + bias.
+struct MeshQuantization
+{
+	float positionScale[3];
+	float positionBias[3];
+	float textureScale[2];
+	float textureBias[2];
+};
+
+// One level of detail: a range of the mesh's index array drawn with the shared vertex array.
+// error is how far, in model units, the level's surface may be from the full detail mesh.
+struct MeshLod
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float error;
+	unsigned int clusterOffset;	// the level's clusters in MeshData::clusters, none until BuildClusters
+	unsigned int clusterCount;
+};
+
+// A run of around 128 neighbouring triangles with bounds for culling it as a whole, see MeshClusterizer.h.
+struct MeshCluster
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float center[3];	// bounding sphere
+	float radius;
+	float coneAxis[3];	// average facing of the triangles
+	float coneCutoff;	// sine of the widest angle between a triangle and coneAxis, 1 if the cone is useless
+};
+
+// Full detail mesh included.
+const unsigned int MESH_MAX_LODS = 4;
+
+////////////////////////////////////////////////////////////////////////////////
+// Struct name: MeshData
+////////////////////////////////////////////////////////////////////////////////
+
+// CPU side vertex and index arrays of one layout, laid out exactly as they are uploaded.
+struct MeshData
+{
+	MeshLayout layout;
+	unsigned int unrolledVertexCount;	// one vertex per face corner, before welding
+	unsigned int vertexCount;
+	unsigned int vertexStride;
+	std::vector<unsigned char> vertices;
+	std::vector<unsigned int> indices;	// full detail triangles, followed by each coarser level's
+	std::vector<MeshLod> lods;			// empty until GenerateLods, then lods[0] is the full detail mesh
+	std::vector<MeshCluster> clusters;	// every level's clusters, in index order
+	float boundsMin[3];
+	float boundsMax[3];
+	float boundsCenter[3];	// bounding sphere, contains every vertex
+	float boundsRadius;
+	MeshQuantization quantization;	// identity unless the layout is packed
+
+	MeshData();
+	void Clear();
+
+	template <typename T> T* GetVertices() { return reinterpret_cast<T*>(vertices.data()); }
+	template <typename T> const T* GetVertices() const { return reinterpret_cast<const T*>(vertices.data()); }
+};
+
+unsigned int GetVertexStride(MeshLayout layout);
+
+// Bytes per index a mesh with this many vertices needs: 16 bit indices whenever every vertex
+// can be addressed with them, 32 bit otherwise.
+unsigned int GetIndexSize(unsigned int vertexCount);
+
+// Copies indices to destination as indexSize byte (2 or 4) values.
+void PackIndices(const unsigned int* indices, size_t count, unsigned int indexSize, void* destination);
+
+// Narrows indices to indexSize byte values in their own storage, which then starts with the
+// count * indexSize packed bytes. UnpackIndicesInPlace widens them back.
+void PackIndicesInPlace(unsigned int* indices, size_t count, unsigned int indexSize);
+void UnpackIndicesInPlace(unsigned int* indices, size_t count, unsigned int indexSize);
+
+// "Unrolls" the parsed obj into a list of triangles in one of the float layouts, welds the result
+// into an indexed mesh, calculates tangents and binormals for the normal mapped layout and
+// calculates the bounds of the positions.
+bool BuildMesh(const ObjMesh& obj, MeshLayout layout, MeshData& mesh);
+
+// Merges vertices whose every attribute is bit-identical (including tangent and binormal in the
+// normal mapped layout) and rewrites the indices to reference the survivors, in first use order.
+void WeldMesh(MeshData& mesh);
+
+// Smooth tangent and binormal for every vertex of an indexed normal mapped mesh: each face's
+// frame is added to its corners weighted by the corner's angle, then made orthonormal around the
+// vertex normal. Faces with degenerate texture coordinates add nothing. Vertices shared by
+// mirrored and unmirrored faces are split, so vertexCount may grow. simd picks the kernels, all
+// of which give the same frames to rounding; AVX2 and AVX-512 are chosen at run time, so the build
+// needs no /arch:AVX2 or /arch:AVX512. TangentTest -t times each against the scalar kernels.
+void CalculateModelVectors(MeshData& mesh, MeshSimd simd = MESH_SIMD_BEST);
+
+// Whether simd can run in this build on this CPU.
+bool IsMeshSimdSupported(MeshSimd simd);
+
+// Box and bounding sphere of the positions of a float layout mesh. The sphere is centred on the
+// box and reaches the furthest vertex.
+void CalculateMeshBounds(MeshData& mesh);
+
+// Maps every vertex of a float layout mesh to the first vertex with a bit-identical position, so
+// vertices split by a texture or normal seam can be treated as one point.
+void CalculatePositionRemap(const MeshData& mesh, std::vector<unsigned int>& remap);
+
+#endif
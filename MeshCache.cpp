@@ -0,0 +1,46 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshCache.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshCache.h"
+
+MeshCache::MeshCache()
+{
+}
+
+MeshCache::~MeshCache()
+{
+}
+
+std::shared_ptr<const ObjMesh> MeshCache::Load(const char* filename, unsigned int threadCount)
+{
+	std::map<std::string, std::shared_ptr<const ObjMesh> >::iterator it;
+	std::shared_ptr<ObjMesh> mesh;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		it = m_meshes.find(filename);
+		if (it != m_meshes.end())
+		{
+			return it->second;
+		}
+	}
+
+	// Parsed outside the lock so other files load meanwhile. Should two threads race on the
+	// same file, the first result stored is the one both get.
+	mesh = std::make_shared<ObjMesh>();
+	if (!LoadObjFile(filename, *mesh, threadCount))
+	{
+		return std::shared_ptr<const ObjMesh>();
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_meshes.insert(std::make_pair(std::string(filename), std::shared_ptr<const ObjMesh>(mesh))).first->second;
+}
+
+void MeshCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_meshes.clear();
+
+	return;
+}
@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshCache.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MESHCACHE_H_
+#define _MESHCACHE_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "ObjParser.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: MeshCache
+////////////////////////////////////////////////////////////////////////////////
+
+// Parses every .obj once per path and hands the same result to every ModelClass
+// variant (plain, normal mapped, shadow map) built from it. Safe to use from several threads.
+class MeshCache
+{
+public:
+	MeshCache();
+	~MeshCache();
+
+	// Returns the parsed mesh, parsing the file on first use. Null if it fails to load.
+	// threadCount is passed on to LoadObjFile.
+	std::shared_ptr<const ObjMesh> Load(const char* filename, unsigned int threadCount = 0);
+
+	// Drops the cache's references. Meshes still held by a caller stay alive until released.
+	void Clear();
+
+private:
+	std::map<std::string, std::shared_ptr<const ObjMesh> > m_meshes;
+	std::mutex m_mutex;
+};
+
+#endif
@@ -0,0 +1,488 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshClusterizer.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshClusterizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "MeshOptimizer.h"
+
+namespace
+{
+	// A triangle facing further than this from the cluster's average (cosine) starts a new cluster.
+	const float s_minimumConeDot = 0.0f;
+
+	// Weight of facing against new vertices when picking the next triangle. One new vertex costs
+	// as much as turning from the cluster's facing by 60 degrees.
+	const float s_coneWeight = 2.0f;
+
+	// Smaller clusters grown from the edge of the previous one are merged into it.
+	const size_t s_minimumClusterTriangles = 16;
+
+	// A cone this wide (cosine of the widest angle to the axis) culls too little to be worth testing.
+	const float s_minimumConeCosine = 0.1f;
+
+	inline const float* GetPosition(const MeshData& mesh, unsigned int vertex)
+	{
+		return reinterpret_cast<const float*>(mesh.vertices.data() + (size_t)vertex * mesh.vertexStride);
+	}
+
+	void UnitTriangleNormal(const MeshData& mesh, const unsigned int* triangle, float normal[3])
+	{
+		const float* p0 = GetPosition(mesh, triangle[0]);
+		const float* p1 = GetPosition(mesh, triangle[1]);
+		const float* p2 = GetPosition(mesh, triangle[2]);
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float length;
+
+		// Counter-clockwise winding faces outwards in the scene's meshes, as it does in the .obj files.
+		normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+		length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length > 0.0f)
+		{
+			normal[0] /= length;
+			normal[1] /= length;
+			normal[2] /= length;
+		}
+	}
+
+	inline float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Greedily grows clusters over one level's triangles and rewrites them in cluster order.
+	// Triangles are neighbours when they share a position, seams do not split clusters.
+	void ClusterizeRange(MeshData& mesh, const std::vector<unsigned int>& position, unsigned int indexOffset, unsigned int indexCount, std::vector<MeshCluster>& clusters)
+	{
+		const unsigned int* indices = &mesh.indices[indexOffset];
+		unsigned int triangleCount = indexCount / 3;
+		std::vector<unsigned int> adjacencyOffsets(mesh.vertexCount + 1, 0);
+		std::vector<unsigned int> adjacency((size_t)triangleCount * 3);
+		std::vector<float> normals((size_t)triangleCount * 3);
+		std::vector<char> emitted(triangleCount, 0);
+		std::vector<unsigned int> positionStamp(mesh.vertexCount, 0);
+		std::vector<unsigned int> candidateStamp(triangleCount, 0);
+		std::vector<unsigned int> candidates, clusterTriangles;
+		std::vector<unsigned int> output;
+		unsigned int i, triangle, seed, nextSeed, stamp, emittedCount;
+		float coneSum[3], coneAxis[3], length;
+		bool seededByPrevious;
+		int corner;
+
+		// Triangles around each position.
+		for (i = 0; i < triangleCount * 3; i++)
+		{
+			adjacencyOffsets[position[indices[i]] + 1]++;
+		}
+		for (i = 0; i < mesh.vertexCount; i++)
+		{
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[fill[position[indices[i]]]++] = i / 3;
+		}
+
+		for (triangle = 0; triangle < triangleCount; triangle++)
+		{
+			UnitTriangleNormal(mesh, &indices[triangle * 3], &normals[triangle * 3]);
+		}
+
+		output.reserve(indexCount);
+		seed = 0;
+		nextSeed = triangleCount;
+		stamp = 0;
+		emittedCount = 0;
+		while (emittedCount < triangleCount)
+		{
+			// Start next to the last cluster where possible, otherwise at the next triangle in the
+			// incoming order, which the vertex cache optimiser already made local.
+			seededByPrevious = nextSeed < triangleCount;
+			if (seededByPrevious)
+			{
+				triangle = nextSeed;
+			}
+			else
+			{
+				while (emitted[seed])
+				{
+					seed++;
+				}
+				triangle = seed;
+			}
+
+			stamp++;
+			clusterTriangles.clear();
+			candidates.clear();
+			memset(coneSum, 0, sizeof(coneSum));
+
+			for (;;)
+			{
+				// Take the triangle and queue its neighbours.
+				emitted[triangle] = 1;
+				emittedCount++;
+				clusterTriangles.push_back(triangle);
+				for (corner = 0; corner < 3; corner++)
+				{
+					unsigned int vertexPosition = position[indices[triangle * 3 + corner]];
+					positionStamp[vertexPosition] = stamp;
+
+					for (i = adjacencyOffsets[vertexPosition]; i < adjacencyOffsets[vertexPosition + 1]; i++)
+					{
+						unsigned int neighbour = adjacency[i];
+						if (!emitted[neighbour] && candidateStamp[neighbour] != stamp)
+						{
+							candidateStamp[neighbour] = stamp;
+							candidates.push_back(neighbour);
+						}
+					}
+				}
+
+				coneSum[0] += normals[triangle * 3 + 0];
+				coneSum[1] += normals[triangle * 3 + 1];
+				coneSum[2] += normals[triangle * 3 + 2];
+				length = sqrtf(Dot(coneSum, coneSum));
+				for (corner = 0; corner < 3; corner++)
+				{
+					coneAxis[corner] = length > 0.0f ? coneSum[corner] / length : 0.0f;
+				}
+
+				// The neighbour that adds the fewest new points and keeps the cone narrowest. Nothing
+				// caps the vertices, the clusters are drawn from the shared vertex buffer. A full
+				// cluster still takes the triangles it encloses, rather than leave them stranded.
+				bool full = clusterTriangles.size() >= MESH_CLUSTER_MAX_TRIANGLES;
+				float bestScore = FLT_MAX;
+				size_t best = candidates.size();
+				for (i = 0; i < candidates.size(); i++)
+				{
+					unsigned int candidate = candidates[i];
+					unsigned int newPositions = 0;
+					float facing;
+
+					for (corner = 0; corner < 3; corner++)
+					{
+						newPositions += (positionStamp[position[indices[candidate * 3 + corner]]] != stamp) ? 1 : 0;
+					}
+
+					facing = Dot(&normals[candidate * 3], coneAxis);
+					if (facing < s_minimumConeDot || (full && newPositions > 0))
+					{
+						continue;
+					}
+
+					float score = (float)newPositions + (1.0f - facing) * s_coneWeight;
+					if (score < bestScore)
+					{
+						bestScore = score;
+						best = i;
+					}
+				}
+
+				// A small piece that is used up, a blade of grass say, carries on into the next triangle
+				// in the incoming order instead of ending a cluster of its own.
+				if (best == candidates.size() && candidates.empty() && !full)
+				{
+					while (seed < triangleCount && emitted[seed])
+					{
+						seed++;
+					}
+					if (seed < triangleCount && Dot(&normals[seed * 3], coneAxis) >= s_minimumConeDot)
+					{
+						triangle = seed;
+						continue;
+					}
+				}
+
+				if (best == candidates.size())
+				{
+					break;
+				}
+
+				triangle = candidates[best];
+				candidates[best] = candidates.back();
+				candidates.pop_back();
+			}
+
+			// Of the triangles left around the cluster, the one with the fewest free neighbours
+			// seeds the next cluster, so pockets are filled before they become clusters of their own.
+			unsigned int fewestNeighbours = 0xffffffffu;
+			nextSeed = triangleCount;
+			for (unsigned int candidate : candidates)
+			{
+				unsigned int neighbours = 0;
+
+				for (corner = 0; corner < 3; corner++)
+				{
+					unsigned int vertexPosition = position[indices[candidate * 3 + corner]];
+					for (i = adjacencyOffsets[vertexPosition]; i < adjacencyOffsets[vertexPosition + 1]; i++)
+					{
+						neighbours += emitted[adjacency[i]] ? 0 : 1;
+					}
+				}
+
+				if (neighbours < fewestNeighbours)
+				{
+					fewestNeighbours = neighbours;
+					nextSeed = candidate;
+				}
+			}
+
+			// A scrap left over next to the previous cluster joins it instead of costing a cull test of its own.
+			if (seededByPrevious && clusterTriangles.size() < s_minimumClusterTriangles)
+			{
+				clusters.back().indexCount += (unsigned int)clusterTriangles.size() * 3;
+			}
+			else
+			{
+				MeshCluster cluster;
+				cluster.indexOffset = indexOffset + (unsigned int)output.size();
+				cluster.indexCount = (unsigned int)clusterTriangles.size() * 3;
+				clusters.push_back(cluster);
+			}
+
+			for (unsigned int clusterTriangle : clusterTriangles)
+			{
+				output.insert(output.end(), &indices[clusterTriangle * 3], &indices[clusterTriangle * 3] + 3);
+			}
+		}
+
+		memcpy(&mesh.indices[indexOffset], output.data(), output.size() * sizeof(unsigned int));
+
+		return;
+	}
+}
+
+void BuildClusters(MeshData& mesh)
+{
+	std::vector<unsigned int> position;
+	MeshLod lod;
+	size_t level, i;
+
+	// Packed vertices have no float positions to bound.
+	if (mesh.layout == MESH_LAYOUT_NORMALMAP_PACKED)
+	{
+		return;
+	}
+
+	if (mesh.lods.empty())
+	{
+		memset(&lod, 0, sizeof(lod));
+		lod.indexCount = (unsigned int)mesh.indices.size();
+		mesh.lods.push_back(lod);
+	}
+
+	CalculatePositionRemap(mesh, position);
+
+	mesh.clusters.clear();
+	for (level = 0; level < mesh.lods.size(); level++)
+	{
+		MeshLod& current = mesh.lods[level];
+
+		current.clusterOffset = (unsigned int)mesh.clusters.size();
+		ClusterizeRange(mesh, position, current.indexOffset, current.indexCount, mesh.clusters);
+		current.clusterCount = (unsigned int)mesh.clusters.size() - current.clusterOffset;
+
+		// Each cluster is small enough to be ordered for the vertex cache on its own.
+		for (i = current.clusterOffset; i < mesh.clusters.size(); i++)
+		{
+			MeshCluster& cluster = mesh.clusters[i];
+			OptimizeVertexCache(&mesh.indices[cluster.indexOffset], cluster.indexCount, mesh.vertexCount);
+			CalculateClusterBounds(mesh, &mesh.indices[cluster.indexOffset], cluster.indexCount, cluster);
+		}
+	}
+
+	return;
+}
+
+void CalculateClusterBounds(const MeshData& mesh, const unsigned int* indices, size_t indexCount, MeshCluster& cluster)
+{
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	float coneSum[3] = { 0.0f, 0.0f, 0.0f };
+	float normal[3], length, radius, minimumDot;
+	size_t i;
+	int axis;
+
+	if (indexCount == 0)
+	{
+		memset(cluster.center, 0, sizeof(cluster.center));
+		cluster.radius = 0.0f;
+		memset(cluster.coneAxis, 0, sizeof(cluster.coneAxis));
+		cluster.coneCutoff = 1.0f;
+		return;
+	}
+
+	// Sphere around the box of the vertices: not the tightest, but never too small.
+	for (i = 0; i < indexCount; i++)
+	{
+		const float* p = GetPosition(mesh, indices[i]);
+		for (axis = 0; axis < 3; axis++)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], p[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], p[axis]);
+		}
+	}
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		cluster.center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+	}
+
+	radius = 0.0f;
+	for (i = 0; i < indexCount; i++)
+	{
+		const float* p = GetPosition(mesh, indices[i]);
+		float d[3] = { p[0] - cluster.center[0], p[1] - cluster.center[1], p[2] - cluster.center[2] };
+		radius = std::max(radius, Dot(d, d));
+	}
+	cluster.radius = sqrtf(radius);
+
+	// Cone around the average facing, as wide as the triangle that strays furthest from it.
+	for (i = 0; i + 3 <= indexCount; i += 3)
+	{
+		UnitTriangleNormal(mesh, &indices[i], normal);
+		coneSum[0] += normal[0];
+		coneSum[1] += normal[1];
+		coneSum[2] += normal[2];
+	}
+
+	length = sqrtf(Dot(coneSum, coneSum));
+	for (axis = 0; axis < 3; axis++)
+	{
+		cluster.coneAxis[axis] = length > 0.0f ? coneSum[axis] / length : 0.0f;
+	}
+
+	minimumDot = 1.0f;
+	for (i = 0; i + 3 <= indexCount; i += 3)
+	{
+		UnitTriangleNormal(mesh, &indices[i], normal);
+		minimumDot = std::min(minimumDot, Dot(normal, cluster.coneAxis));
+	}
+
+	// Every triangle faces away from an eye that sees the axis at less than 90 degrees minus the
+	// cone's half angle, i.e. when cos(angle to the axis) exceeds sin(half angle).
+	cluster.coneCutoff = (minimumDot < s_minimumConeCosine) ? 1.0f : sqrtf(1.0f - minimumDot * minimumDot);
+
+	return;
+}
+
+void ExtractFrustumPlanes(const float matrix[16], float planes[6][4])
+{
+	int plane, row;
+	float length;
+
+	// Gribb and Hartmann: with row vectors clip = p * M, so every clip coordinate is p dotted with
+	// a column of M and every plane is a sum or difference of columns.
+	for (plane = 0; plane < 6; plane++)
+	{
+		for (row = 0; row < 4; row++)
+		{
+			float x = matrix[row * 4 + 0];
+			float y = matrix[row * 4 + 1];
+			float z = matrix[row * 4 + 2];
+			float w = matrix[row * 4 + 3];
+
+			switch (plane)
+			{
+			case 0: planes[plane][row] = w + x; break;	// left
+			case 1: planes[plane][row] = w - x; break;	// right
+			case 2: planes[plane][row] = w + y; break;	// bottom
+			case 3: planes[plane][row] = w - y; break;	// top
+			case 4: planes[plane][row] = z; break;		// near, depth starts at 0
+			default: planes[plane][row] = w - z; break;	// far
+			}
+		}
+
+		length = sqrtf(planes[plane][0] * planes[plane][0] + planes[plane][1] * planes[plane][1] + planes[plane][2] * planes[plane][2]);
+		if (length > 0.0f)
+		{
+			planes[plane][0] /= length;
+			planes[plane][1] /= length;
+			planes[plane][2] /= length;
+			planes[plane][3] /= length;
+		}
+	}
+
+	return;
+}
+
+bool IsClusterVisible(const MeshCluster& cluster, const ClusterCullView& view)
+{
+	float axis[3], toCenter[3], distance;
+	int plane;
+
+	for (plane = 0; plane < 6; plane++)
+	{
+		if (Dot(view.planes[plane], cluster.center) + view.planes[plane][3] < -cluster.radius)
+		{
+			return false;
+		}
+	}
+
+	if (view.facing == CLUSTER_FACING_NONE || cluster.coneCutoff >= 1.0f)
+	{
+		return true;
+	}
+
+	// Culling front faces is culling back faces of the flipped cone.
+	axis[0] = cluster.coneAxis[0];
+	axis[1] = cluster.coneAxis[1];
+	axis[2] = cluster.coneAxis[2];
+	if (view.facing == CLUSTER_FACING_FRONT)
+	{
+		axis[0] = -axis[0];
+		axis[1] = -axis[1];
+		axis[2] = -axis[2];
+	}
+
+	// Every triangle faces away when the eye looks along the axis closely enough, for every point
+	// of the bounding sphere.
+	if (view.orthographic)
+	{
+		return Dot(view.direction, axis) <= cluster.coneCutoff;
+	}
+
+	toCenter[0] = cluster.center[0] - view.eye[0];
+	toCenter[1] = cluster.center[1] - view.eye[1];
+	toCenter[2] = cluster.center[2] - view.eye[2];
+	distance = sqrtf(Dot(toCenter, toCenter));
+
+	return Dot(toCenter, axis) < cluster.coneCutoff * distance + cluster.radius;
+}
+
+size_t CullClusters(const MeshCluster* clusters, size_t count, const ClusterCullView& view, MeshDrawRange* ranges)
+{
+	size_t i, rangeCount;
+
+	rangeCount = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (!IsClusterVisible(clusters[i], view))
+		{
+			continue;
+		}
+
+		// Clusters are stored in index order, so visible neighbours share one draw.
+		if (rangeCount > 0 && ranges[rangeCount - 1].indexOffset + ranges[rangeCount - 1].indexCount == clusters[i].indexOffset)
+		{
+			ranges[rangeCount - 1].indexCount += clusters[i].indexCount;
+		}
+		else
+		{
+			ranges[rangeCount].indexOffset = clusters[i].indexOffset;
+			ranges[rangeCount].indexCount = clusters[i].indexCount;
+			rangeCount++;
+		}
+	}
+
+	return rangeCount;
+}
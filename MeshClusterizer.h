@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshClusterizer.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MESHCLUSTERIZER_H_
+#define _MESHCLUSTERIZER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include "MeshBuilder.h"
+
+// Clusters grow to this many triangles, plus any they enclose or leave too few of to cluster alone.
+const unsigned int MESH_CLUSTER_MAX_TRIANGLES = 128;
+
+// Splits every level of detail of an indexed float layout mesh into clusters of neighbouring
+// triangles that face roughly the same way, rewriting each level's indices so every cluster
+// is a contiguous run, and fills mesh.clusters and the levels' cluster ranges. A mesh without
+// levels of detail gets lods[0] covering all of its indices first.
+void BuildClusters(MeshData& mesh);
+
+// Bounds and cone of the triangles in indices, in the mesh's float positions.
+void CalculateClusterBounds(const MeshData& mesh, const unsigned int* indices, size_t indexCount, MeshCluster& cluster);
+
+// Which triangles the rasterizer throws away in the pass a mesh is culled for.
+enum ClusterFacing
+{
+	CLUSTER_FACING_NONE = 0,	// two sided, only the frustum culls
+	CLUSTER_FACING_BACK = 1,	// facing away from the eye, counter clockwise outwards with clockwise culled
+	CLUSTER_FACING_FRONT = 2	// facing the eye
+};
+
+// A draw's frustum and eye, in the model space of the mesh being drawn.
+struct ClusterCullView
+{
+	float planes[6][4];		// inside where dot(plane.xyz, p) + plane.w >= 0, xyz normalised
+	bool orthographic;
+	float eye[3];			// perspective eye position
+	float direction[3];		// orthographic viewing direction, normalised
+	ClusterFacing facing;
+};
+
+// Frustum planes of a world * view * projection matrix stored the DirectXMath way (row vectors,
+// m[row * 4 + column]) with a 0..1 depth range. Planes are in the space the matrix maps from.
+void ExtractFrustumPlanes(const float matrix[16], float planes[6][4]);
+
+bool IsClusterVisible(const MeshCluster& cluster, const ClusterCullView& view);
+
+// One DrawIndexed worth of indices.
+struct MeshDrawRange
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+};
+
+// Culls count clusters and writes the survivors to ranges, neighbouring clusters merged into one
+// range. ranges needs room for count entries. Returns the number of ranges written.
+size_t CullClusters(const MeshCluster* clusters, size_t count, const ClusterCullView& view, MeshDrawRange* ranges);
+
+#endif
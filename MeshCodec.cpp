@@ -0,0 +1,379 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshCodec.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshCodec.h"
+#include "Compressor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MESH_CODEC_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Vertices wider than this are not a layout this codec knows.
+	const unsigned int s_maxStride = 256;
+
+	// Vertices decoded per block, a few KB of output that stays in L1 between channels.
+	const size_t s_vertexBlockSize = 256;
+
+	inline uint32_t ZigZag(uint32_t delta, unsigned int bits)
+	{
+		uint32_t sign = (delta >> (bits - 1)) & 1;
+		uint32_t mask = (bits == 32) ? 0xffffffffu : ((1u << bits) - 1);
+
+		return ((delta << 1) ^ (0u - sign)) & mask;
+	}
+
+	inline uint32_t UnZigZag(uint32_t value)
+	{
+		return (value >> 1) ^ (0u - (value & 1));
+	}
+
+	void AppendHeader(std::vector<unsigned char>& out, uint8_t kind, uint8_t channelSize, size_t filteredSize)
+	{
+		MeshStreamHeader header;
+
+		header.kind = kind;
+		header.flags = 0;
+		header.channelSize = channelSize;
+		header.reserved = 0;
+		header.filteredSize = (uint32_t)filteredSize;
+		out.insert(out.end(), reinterpret_cast<const unsigned char*>(&header), reinterpret_cast<const unsigned char*>(&header) + sizeof(header));
+
+		return;
+	}
+
+	// Appends the filtered bytes to out after a header, compressed when that makes them smaller.
+	void AppendStream(std::vector<unsigned char>& out, uint8_t kind, uint8_t channelSize, const std::vector<unsigned char>& filtered, bool compress)
+	{
+		size_t headerOffset = out.size();
+		MeshStreamHeader header;
+
+		AppendHeader(out, kind, channelSize, filtered.size());
+
+		if (compress && CompressBlock(filtered.data(), filtered.size(), out) > 0)
+		{
+			memcpy(&header, out.data() + headerOffset, sizeof(header));
+			header.flags |= MESH_STREAM_COMPRESSED;
+			memcpy(out.data() + headerOffset, &header, sizeof(header));
+			return;
+		}
+
+		out.insert(out.end(), filtered.begin(), filtered.end());
+
+		return;
+	}
+
+	// Checks the header and finds the filtered bytes, decompressing them into scratch if need be. The
+	// stream has to filter to filteredSize bytes, which is checked before scratch is sized from it.
+	const unsigned char* OpenStream(const void* data, size_t size, uint8_t kind, uint64_t filteredSize, MeshStreamHeader& header, std::vector<unsigned char>& scratch)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+		if (size < sizeof(header))
+		{
+			return 0;
+		}
+
+		memcpy(&header, bytes, sizeof(header));
+		if (header.kind != kind || (header.flags & ~MESH_STREAM_COMPRESSED) != 0 || header.filteredSize != filteredSize)
+		{
+			return 0;
+		}
+
+		bytes += sizeof(header);
+		size -= sizeof(header);
+
+		if (!(header.flags & MESH_STREAM_COMPRESSED))
+		{
+			return size == header.filteredSize ? bytes : 0;
+		}
+
+		scratch.resize(header.filteredSize);
+		if (!DecompressBlock(bytes, size, scratch.data(), header.filteredSize))
+		{
+			return 0;
+		}
+
+		return scratch.data();
+	}
+
+	// Writes channelCount channels of channelSize bytes from the start of each of count elements,
+	// stride bytes apart, as zigzagged deltas in byte planes: every element's first byte of the
+	// first channel, then every element's second byte and so on. Elements are read little endian,
+	// so a 32 bit index read as a 16 bit channel keeps its low half.
+	void FilterChannels(const void* elements, size_t count, unsigned int stride, unsigned int channelSize, unsigned int channelCount, std::vector<unsigned char>& filtered)
+	{
+		const unsigned char* input = static_cast<const unsigned char*>(elements);
+		uint32_t previous[s_maxStride / 2];
+		unsigned int channel, byte;
+		uint32_t value, delta;
+		size_t element;
+
+		filtered.resize(count * channelSize * channelCount);
+		memset(previous, 0, sizeof(previous));
+
+		for (element = 0; element < count; element++)
+		{
+			for (channel = 0; channel < channelCount; channel++)
+			{
+				value = 0;
+				memcpy(&value, input + element * stride + channel * channelSize, channelSize);
+				delta = ZigZag(value - previous[channel], channelSize * 8);
+				previous[channel] = value;
+
+				for (byte = 0; byte < channelSize; byte++)
+				{
+					filtered[(channel * channelSize + byte) * count + element] = (unsigned char)(delta >> (byte * 8));
+				}
+			}
+		}
+
+		return;
+	}
+
+#ifdef MESH_CODEC_SSE
+	// Undoes the zigzag and sums the deltas of one vector of 32 bit channel values onto running,
+	// which holds the last value in every lane and comes back holding the new last value.
+	inline __m128i UnfilterLanes32(__m128i delta, __m128i& running)
+	{
+		__m128i value = _mm_xor_si128(_mm_srli_epi32(delta, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(delta, _mm_set1_epi32(1))));
+
+		value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+		value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+		value = _mm_add_epi32(value, running);
+		running = _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3));
+
+		return value;
+	}
+
+	inline __m128i UnfilterLanes16(__m128i delta, __m128i& running)
+	{
+		__m128i value = _mm_xor_si128(_mm_srli_epi16(delta, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(delta, _mm_set1_epi16(1))));
+
+		value = _mm_add_epi16(value, _mm_slli_si128(value, 2));
+		value = _mm_add_epi16(value, _mm_slli_si128(value, 4));
+		value = _mm_add_epi16(value, _mm_slli_si128(value, 8));
+		value = _mm_add_epi16(value, running);
+		running = _mm_shufflehi_epi16(value, _MM_SHUFFLE(3, 3, 3, 3));
+		running = _mm_unpackhi_epi64(running, running);
+
+		return value;
+	}
+
+	inline void Store32(unsigned char* output, unsigned int stride, __m128i value)
+	{
+		uint32_t lane;
+
+		// Indices are packed back to back.
+		if (stride == 4)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output), value);
+			return;
+		}
+
+		lane = (uint32_t)_mm_cvtsi128_si32(value);
+		memcpy(output, &lane, 4);
+		lane = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(value, _MM_SHUFFLE(1, 1, 1, 1)));
+		memcpy(output + stride, &lane, 4);
+		lane = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(value, _MM_SHUFFLE(2, 2, 2, 2)));
+		memcpy(output + 2 * stride, &lane, 4);
+		lane = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3)));
+		memcpy(output + 3 * stride, &lane, 4);
+
+		return;
+	}
+
+	inline void Store16(unsigned char* output, unsigned int stride, __m128i value)
+	{
+		uint16_t lane[8];
+		int i;
+
+		if (stride == 2)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output), value);
+			return;
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lane), value);
+		for (i = 0; i < 8; i++)
+		{
+			memcpy(output + i * stride, &lane[i], 2);
+		}
+
+		return;
+	}
+
+	// 16 vertices of a channel at once: the byte planes are interleaved back into values with
+	// unpacks, then undone and summed four (32 bit) or eight (16 bit) lanes at a time.
+	template <typename T> size_t UnfilterChannelSimd(const unsigned char* planes, size_t count, size_t first, size_t last, unsigned char* output, unsigned int stride, uint32_t& previous)
+	{
+		__m128i running, b0, b1, lo, hi;
+		size_t vertex;
+
+		running = (sizeof(T) == 4) ? _mm_set1_epi32((int)previous) : _mm_set1_epi16((short)previous);
+
+		for (vertex = first; vertex + 16 <= last; vertex += 16)
+		{
+			b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + vertex));
+			b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + count + vertex));
+			lo = _mm_unpacklo_epi8(b0, b1);
+			hi = _mm_unpackhi_epi8(b0, b1);
+
+			if (sizeof(T) == 2)
+			{
+				Store16(output + vertex * stride, stride, UnfilterLanes16(lo, running));
+				Store16(output + (vertex + 8) * stride, stride, UnfilterLanes16(hi, running));
+				continue;
+			}
+
+			__m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 2 * count + vertex));
+			__m128i b3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 3 * count + vertex));
+			__m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+			__m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+
+			Store32(output + vertex * stride, stride, UnfilterLanes32(_mm_unpacklo_epi16(lo, lo23), running));
+			Store32(output + (vertex + 4) * stride, stride, UnfilterLanes32(_mm_unpackhi_epi16(lo, lo23), running));
+			Store32(output + (vertex + 8) * stride, stride, UnfilterLanes32(_mm_unpacklo_epi16(hi, hi23), running));
+			Store32(output + (vertex + 12) * stride, stride, UnfilterLanes32(_mm_unpackhi_epi16(hi, hi23), running));
+		}
+
+		previous = (sizeof(T) == 4) ? (uint32_t)_mm_cvtsi128_si32(running) : (uint32_t)(uint16_t)_mm_cvtsi128_si32(running);
+
+		return vertex;
+	}
+#endif
+
+	// One channel of type T of vertices [first, last) back from its byte planes, previous carrying
+	// the channel's running value from block to block.
+	template <typename T> void UnfilterChannel(const unsigned char* planes, size_t count, size_t first, size_t last, unsigned char* output, unsigned int stride, uint32_t& previous)
+	{
+		T value;
+		size_t vertex;
+		unsigned int byte;
+
+		vertex = first;
+#ifdef MESH_CODEC_SSE
+		vertex = UnfilterChannelSimd<T>(planes, count, first, last, output, stride, previous);
+#endif
+
+		value = (T)previous;
+		for (; vertex < last; vertex++)
+		{
+			uint32_t delta = 0;
+
+			for (byte = 0; byte < sizeof(T); byte++)
+			{
+				delta |= (uint32_t)planes[byte * count + vertex] << (byte * 8);
+			}
+
+			value = (T)(value + UnZigZag(delta));
+			memcpy(output + vertex * stride, &value, sizeof(T));
+		}
+		previous = value;
+
+		return;
+	}
+}
+
+unsigned int GetVertexChannelSize(MeshLayout layout)
+{
+	return (layout == MESH_LAYOUT_NORMALMAP_PACKED) ? 2 : 4;
+}
+
+void EncodeIndexStream(const unsigned int* indices, size_t count, unsigned int indexSize, bool compress, std::vector<unsigned char>& out)
+{
+	std::vector<unsigned char> filtered;
+
+	// The indices are a one channel vertex stream of their upload width.
+	FilterChannels(indices, count, sizeof(unsigned int), indexSize, 1, filtered);
+	AppendStream(out, MESH_STREAM_INDICES, (uint8_t)indexSize, filtered, compress);
+
+	return;
+}
+
+void EncodeVertexStream(const void* vertices, size_t count, unsigned int stride, unsigned int channelSize, bool compress, std::vector<unsigned char>& out)
+{
+	std::vector<unsigned char> filtered;
+
+	FilterChannels(vertices, count, stride, channelSize, stride / channelSize, filtered);
+	AppendStream(out, MESH_STREAM_VERTICES, (uint8_t)channelSize, filtered, compress);
+
+	return;
+}
+
+bool DecodeIndexStream(const void* data, size_t size, size_t count, unsigned int indexSize, void* indices, std::vector<unsigned char>& scratch)
+{
+	MeshStreamHeader header;
+	const unsigned char* filtered;
+	uint32_t previous = 0;
+
+	filtered = OpenStream(data, size, MESH_STREAM_INDICES, (uint64_t)count * indexSize, header, scratch);
+	if (!filtered || header.channelSize != indexSize)
+	{
+		return false;
+	}
+
+	if (indexSize == 2)
+	{
+		UnfilterChannel<uint16_t>(filtered, count, 0, count, static_cast<unsigned char*>(indices), 2, previous);
+		return true;
+	}
+
+	if (indexSize == 4)
+	{
+		UnfilterChannel<uint32_t>(filtered, count, 0, count, static_cast<unsigned char*>(indices), 4, previous);
+		return true;
+	}
+
+	return false;
+}
+
+bool DecodeVertexStream(const void* data, size_t size, size_t count, unsigned int stride, void* vertices, std::vector<unsigned char>& scratch)
+{
+	MeshStreamHeader header;
+	const unsigned char* filtered;
+	unsigned char* output = static_cast<unsigned char*>(vertices);
+	uint32_t previous[s_maxStride / 2];
+	unsigned int channelSize, channelCount, channel;
+	size_t first, last;
+
+	filtered = OpenStream(data, size, MESH_STREAM_VERTICES, (uint64_t)count * stride, header, scratch);
+	if (!filtered)
+	{
+		return false;
+	}
+
+	channelSize = header.channelSize;
+	if ((channelSize != 2 && channelSize != 4) || stride == 0 || stride > s_maxStride || stride % channelSize != 0)
+	{
+		return false;
+	}
+
+	channelCount = stride / channelSize;
+	memset(previous, 0, sizeof(previous));
+
+	// A block of vertices at a time and within it a channel at a time, so each step reads a few byte
+	// planes front to back and the block's vertices stay in cache until every channel is written.
+	for (first = 0; first < count; first += s_vertexBlockSize)
+	{
+		last = std::min(first + s_vertexBlockSize, count);
+		for (channel = 0; channel < channelCount; channel++)
+		{
+			if (channelSize == 4)
+			{
+				UnfilterChannel<uint32_t>(filtered + channel * 4 * count, count, first, last, output + channel * 4, stride, previous[channel]);
+			}
+			else
+			{
+				UnfilterChannel<uint16_t>(filtered + channel * 2 * count, count, first, last, output + channel * 2, stride, previous[channel]);
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshCodec.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MESHCODEC_H_
+#define _MESHCODEC_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MeshBuilder.h"
+
+// Compact, lossless encodings of a cooked mesh's vertex and index arrays. Each stream starts with
+// a MeshStreamHeader and is filtered into bytes that compress well, then, when it pays off, put
+// through the general purpose block compressor (see Compressor.h). Vertices are already as
+// small as their layout allows; the packed layout is the quantized one (see MeshQuantizer.h).
+//
+// Both arrays are split into channels: 16 bit ones in the packed layout, 32 bit floats in the
+// others, and the index itself at its upload width. Each channel is stored as its difference from
+// the same channel of the previous element, zigzagged so small negative steps stay small, with all
+// elements' first bytes together, then all second bytes and so on. Neighbouring vertices are close
+// in an optimised mesh and most index steps are short, so the high byte planes are mostly zeros.
+// Decoding turns the planes back into values 16 elements at a time with SSE2 where available.
+const uint8_t MESH_STREAM_INDICES = 1;
+const uint8_t MESH_STREAM_VERTICES = 2;
+
+const uint8_t MESH_STREAM_COMPRESSED = 1;	// the filtered bytes went through CompressBlock
+
+struct MeshStreamHeader
+{
+	uint8_t kind;			// MESH_STREAM_*
+	uint8_t flags;			// MESH_STREAM_COMPRESSED or 0
+	uint8_t channelSize;	// bytes per vertex channel, or the index size the stream decodes to
+	uint8_t reserved;
+	uint32_t filteredSize;	// bytes of the filtered stream, before compression
+};
+
+// Bytes per channel the vertices of a layout are filtered in.
+unsigned int GetVertexChannelSize(MeshLayout layout);
+
+// Append one encoded stream to out; compress false skips the compressor.
+void EncodeIndexStream(const unsigned int* indices, size_t count, unsigned int indexSize, bool compress, std::vector<unsigned char>& out);
+void EncodeVertexStream(const void* vertices, size_t count, unsigned int stride, unsigned int channelSize, bool compress, std::vector<unsigned char>& out);
+
+// Decode straight into the arrays that get uploaded: count indices of the stream's index size,
+// or count vertices of stride bytes. scratch holds the filtered bytes of a compressed stream and
+// can be reused between calls. Fail on anything that does not decode to exactly count elements.
+bool DecodeIndexStream(const void* data, size_t size, size_t count, unsigned int indexSize, void* indices, std::vector<unsigned char>& scratch);
+bool DecodeVertexStream(const void* data, size_t size, size_t count, unsigned int stride, void* vertices, std::vector<unsigned char>& scratch);
+
+#endif
@@ -0,0 +1,294 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshInstancer.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshInstancer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Sweeps of the Jacobi eigen solver; a 4x4 settles in well under ten.
+	const int s_jacobiSweeps = 32;
+
+	uint64_t HashWords(uint64_t hash, const void* data, size_t size)
+	{
+		const uint64_t prime = 0x100000001b3ull;
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		size_t i;
+
+		for (i = 0; i + 4 <= size; i += 4)
+		{
+			uint32_t word;
+			memcpy(&word, bytes + i, sizeof(word));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+
+		for (; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * prime;
+		}
+
+		return hash;
+	}
+
+	// Eigenvalues of the symmetric matrix a end up on its diagonal, the eigenvectors in the columns of v.
+	void JacobiEigen4(double a[4][4], double v[4][4])
+	{
+		int sweep, p, q, k;
+
+		for (p = 0; p < 4; p++)
+		{
+			for (q = 0; q < 4; q++)
+			{
+				v[p][q] = (p == q) ? 1.0 : 0.0;
+			}
+		}
+
+		for (sweep = 0; sweep < s_jacobiSweeps; sweep++)
+		{
+			double offDiagonal = 0.0;
+
+			for (p = 0; p < 3; p++)
+			{
+				for (q = p + 1; q < 4; q++)
+				{
+					offDiagonal += a[p][q] * a[p][q];
+				}
+			}
+
+			if (offDiagonal < 1e-30)
+			{
+				break;
+			}
+
+			for (p = 0; p < 3; p++)
+			{
+				for (q = p + 1; q < 4; q++)
+				{
+					double theta, t, c, s;
+
+					if (a[p][q] == 0.0)
+					{
+						continue;
+					}
+
+					// Rotation in the pq plane that zeroes a[p][q].
+					theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+					t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+					c = 1.0 / sqrt(t * t + 1.0);
+					s = t * c;
+
+					for (k = 0; k < 4; k++)
+					{
+						double akp = a[k][p], akq = a[k][q];
+						a[k][p] = c * akp - s * akq;
+						a[k][q] = s * akp + c * akq;
+					}
+
+					for (k = 0; k < 4; k++)
+					{
+						double apk = a[p][k], aqk = a[q][k];
+						a[p][k] = c * apk - s * aqk;
+						a[q][k] = s * apk + c * aqk;
+					}
+
+					for (k = 0; k < 4; k++)
+					{
+						double vkp = v[k][p], vkq = v[k][q];
+						v[k][p] = c * vkp - s * vkq;
+						v[k][q] = s * vkp + c * vkq;
+					}
+				}
+			}
+		}
+
+		return;
+	}
+}
+
+uint64_t CalculateInstanceKey(const ObjMesh& mesh)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	uint64_t counts[4];
+
+	counts[0] = mesh.positions.size();
+	counts[1] = mesh.texCoords.size();
+	counts[2] = mesh.normals.size();
+	counts[3] = mesh.faces.size();
+
+	hash = HashWords(hash, counts, sizeof(counts));
+	hash = HashWords(hash, mesh.faces.data(), mesh.faces.size() * sizeof(unsigned int));
+	hash = HashWords(hash, mesh.texCoords.data(), mesh.texCoords.size() * sizeof(ObjMesh::Float2));
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+bool FindRigidTransform(const ObjMesh& reference, const ObjMesh& mesh, float transform[16], float* error)
+{
+	double referenceCentroid[3] = { 0.0, 0.0, 0.0 }, meshCentroid[3] = { 0.0, 0.0, 0.0 };
+	double covariance[3][3] = {}, n[4][4], eigenvectors[4][4], rotation[3][3], translation[3];
+	double w, x, y, z, radius, positionError, normalError, length;
+	size_t count, i;
+	int row, column, best;
+
+	count = reference.positions.size();
+	if (count == 0 || count != mesh.positions.size() || reference.normals.size() != mesh.normals.size() ||
+		reference.faces != mesh.faces || reference.texCoords.size() != mesh.texCoords.size())
+	{
+		return false;
+	}
+
+	// Seams are where they are because of the texture, so the coordinates have to be the same bits.
+	if (!reference.texCoords.empty() && memcmp(reference.texCoords.data(), mesh.texCoords.data(), reference.texCoords.size() * sizeof(ObjMesh::Float2)) != 0)
+	{
+		return false;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		referenceCentroid[0] += reference.positions[i].x;
+		referenceCentroid[1] += reference.positions[i].y;
+		referenceCentroid[2] += reference.positions[i].z;
+		meshCentroid[0] += mesh.positions[i].x;
+		meshCentroid[1] += mesh.positions[i].y;
+		meshCentroid[2] += mesh.positions[i].z;
+	}
+
+	for (row = 0; row < 3; row++)
+	{
+		referenceCentroid[row] /= (double)count;
+		meshCentroid[row] /= (double)count;
+	}
+
+	// Cross covariance of the two centred vertex sets.
+	radius = 0.0;
+	for (i = 0; i < count; i++)
+	{
+		double a[3] = { reference.positions[i].x - referenceCentroid[0], reference.positions[i].y - referenceCentroid[1], reference.positions[i].z - referenceCentroid[2] };
+		double b[3] = { mesh.positions[i].x - meshCentroid[0], mesh.positions[i].y - meshCentroid[1], mesh.positions[i].z - meshCentroid[2] };
+
+		for (row = 0; row < 3; row++)
+		{
+			for (column = 0; column < 3; column++)
+			{
+				covariance[row][column] += a[row] * b[column];
+			}
+		}
+
+		radius = std::max(radius, a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+	}
+	radius = sqrt(radius);
+
+	// Horn's closed form: the unit quaternion of the best rotation is the eigenvector of this
+	// matrix with the largest eigenvalue.
+	n[0][0] = covariance[0][0] + covariance[1][1] + covariance[2][2];
+	n[1][1] = covariance[0][0] - covariance[1][1] - covariance[2][2];
+	n[2][2] = -covariance[0][0] + covariance[1][1] - covariance[2][2];
+	n[3][3] = -covariance[0][0] - covariance[1][1] + covariance[2][2];
+	n[0][1] = n[1][0] = covariance[1][2] - covariance[2][1];
+	n[0][2] = n[2][0] = covariance[2][0] - covariance[0][2];
+	n[0][3] = n[3][0] = covariance[0][1] - covariance[1][0];
+	n[1][2] = n[2][1] = covariance[0][1] + covariance[1][0];
+	n[1][3] = n[3][1] = covariance[2][0] + covariance[0][2];
+	n[2][3] = n[3][2] = covariance[1][2] + covariance[2][1];
+
+	JacobiEigen4(n, eigenvectors);
+
+	best = 0;
+	for (row = 1; row < 4; row++)
+	{
+		if (n[row][row] > n[best][best])
+		{
+			best = row;
+		}
+	}
+
+	w = eigenvectors[0][best];
+	x = eigenvectors[1][best];
+	y = eigenvectors[2][best];
+	z = eigenvectors[3][best];
+	length = sqrt(w * w + x * x + y * y + z * z);
+	if (length == 0.0)
+	{
+		return false;
+	}
+	w /= length;
+	x /= length;
+	y /= length;
+	z /= length;
+
+	rotation[0][0] = 1.0 - 2.0 * (y * y + z * z);
+	rotation[0][1] = 2.0 * (x * y - w * z);
+	rotation[0][2] = 2.0 * (x * z + w * y);
+	rotation[1][0] = 2.0 * (x * y + w * z);
+	rotation[1][1] = 1.0 - 2.0 * (x * x + z * z);
+	rotation[1][2] = 2.0 * (y * z - w * x);
+	rotation[2][0] = 2.0 * (x * z - w * y);
+	rotation[2][1] = 2.0 * (y * z + w * x);
+	rotation[2][2] = 1.0 - 2.0 * (x * x + y * y);
+
+	for (row = 0; row < 3; row++)
+	{
+		translation[row] = meshCentroid[row] - (rotation[row][0] * referenceCentroid[0] + rotation[row][1] * referenceCentroid[1] + rotation[row][2] * referenceCentroid[2]);
+	}
+
+	// The fit is the best there is, so it only has to be checked, vertex by vertex.
+	positionError = 0.0;
+	for (i = 0; i < count; i++)
+	{
+		const ObjMesh::Float3& a = reference.positions[i];
+		const ObjMesh::Float3& b = mesh.positions[i];
+		double dx = rotation[0][0] * a.x + rotation[0][1] * a.y + rotation[0][2] * a.z + translation[0] - b.x;
+		double dy = rotation[1][0] * a.x + rotation[1][1] * a.y + rotation[1][2] * a.z + translation[1] - b.y;
+		double dz = rotation[2][0] * a.x + rotation[2][1] * a.y + rotation[2][2] * a.z + translation[2] - b.z;
+
+		positionError = std::max(positionError, dx * dx + dy * dy + dz * dz);
+	}
+	positionError = sqrt(positionError);
+
+	if (positionError > MESH_INSTANCE_POSITION_TOLERANCE * radius)
+	{
+		return false;
+	}
+
+	// Shading has to match too, so the normals must turn with the positions.
+	normalError = 0.0;
+	for (i = 0; i < reference.normals.size(); i++)
+	{
+		const ObjMesh::Float3& a = reference.normals[i];
+		const ObjMesh::Float3& b = mesh.normals[i];
+		double dx = rotation[0][0] * a.x + rotation[0][1] * a.y + rotation[0][2] * a.z - b.x;
+		double dy = rotation[1][0] * a.x + rotation[1][1] * a.y + rotation[1][2] * a.z - b.y;
+		double dz = rotation[2][0] * a.x + rotation[2][1] * a.y + rotation[2][2] * a.z - b.z;
+
+		normalError = std::max(normalError, dx * dx + dy * dy + dz * dz);
+	}
+
+	if (sqrt(normalError) > MESH_INSTANCE_NORMAL_TOLERANCE)
+	{
+		return false;
+	}
+
+	// Row vectors: p' = p * transform, so the rotation goes in transposed.
+	for (row = 0; row < 3; row++)
+	{
+		for (column = 0; column < 3; column++)
+		{
+			transform[row * 4 + column] = (float)rotation[column][row];
+		}
+		transform[row * 4 + 3] = 0.0f;
+		transform[12 + row] = (float)translation[row];
+	}
+	transform[15] = 1.0f;
+
+	if (error)
+	{
+		*error = (float)positionError;
+	}
+
+	return true;
+}
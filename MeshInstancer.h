@@ -0,0 +1,33 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshInstancer.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MESHINSTANCER_H_
+#define _MESHINSTANCER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstdint>
+#include "ObjParser.h"
+
+// Largest distance between a moved reference vertex and the vertex it should land on, as a
+// fraction of the reference's radius around its centroid.
+const float MESH_INSTANCE_POSITION_TOLERANCE = 1e-4f;
+
+// Largest distance between a rotated reference normal and the normal it should land on.
+const float MESH_INSTANCE_NORMAL_TOLERANCE = 2e-3f;
+
+// Hash of everything a rigid transform leaves alone: the array sizes, the face indices and the
+// texture coordinates. Meshes with different keys are never instances of each other.
+uint64_t CalculateInstanceKey(const ObjMesh& mesh);
+
+// Looks for the rotation and translation that carries reference onto mesh vertex for vertex.
+// Both vertex sets are centred on their centroids and the rotation between them is solved in
+// closed form, then every position and normal is checked against it. Fails unless the faces
+// and texture coordinates are identical and everything lands within the tolerances above.
+// transform receives reference model space -> mesh model space, stored the DirectXMath way
+// (row vectors, m[row * 4 + column]). error may be null and receives the largest position error.
+bool FindRigidTransform(const ObjMesh& reference, const ObjMesh& mesh, float transform[16], float* error);
+
+#endif
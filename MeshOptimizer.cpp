@@ -0,0 +1,432 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshOptimizer.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Forsyth scoring. The cache modelled here is larger than the simulated one on purpose, it
+	// only steers the order and real hardware caches are not strict FIFOs.
+	const int s_cacheSize = 32;
+	const float s_cacheDecayPower = 1.5f;
+	const float s_lastTriangleScore = 0.75f;
+	const float s_valenceBoostScale = 2.0f;
+	const float s_valenceBoostPower = 0.5f;
+
+	float VertexScore(int cachePosition, unsigned int remainingTriangles)
+	{
+		float score;
+
+		// A vertex with no triangles left to draw is of no use.
+		if (remainingTriangles == 0)
+		{
+			return -1.0f;
+		}
+
+		score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// The three vertices of the last triangle get a fixed score, so the next triangle
+				// does not simply reuse the same edge and turn the order into a strip.
+				score = s_lastTriangleScore;
+			}
+			else
+			{
+				score = 1.0f - (float)(cachePosition - 3) / (float)(s_cacheSize - 3);
+				score = powf(score, s_cacheDecayPower);
+			}
+		}
+
+		// Prefer vertices with few triangles left, so lone triangles are not left behind.
+		score += s_valenceBoostScale * powf((float)remainingTriangles, -s_valenceBoostPower);
+
+		return score;
+	}
+
+	struct TriangleCluster
+	{
+		size_t start;
+		size_t count;
+		float sortKey;
+	};
+}
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	unsigned int time, misses;
+	size_t i;
+
+	// A vertex is in the FIFO while fewer than cacheSize misses happened since it was loaded.
+	time = cacheSize + 1;
+	misses = 0;
+	for (i = 0; i < indexCount; i++)
+	{
+		unsigned int index = indices[i];
+
+		if (time - cacheTime[index] > cacheSize)
+		{
+			cacheTime[index] = time;
+			time++;
+			misses++;
+		}
+	}
+
+	stats.acmr = (indexCount >= 3) ? (float)misses / (float)(indexCount / 3) : 0.0f;
+	stats.atvr = (vertexCount > 0) ? (float)misses / (float)vertexCount : 0.0f;
+
+	return stats;
+}
+
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, unsigned int vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	std::vector<unsigned int> triangleOffsets(vertexCount + 1, 0);
+	std::vector<unsigned int> vertexTriangles(indexCount);
+	std::vector<unsigned int> remainingTriangles(vertexCount, 0);
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	std::vector<unsigned int> output(indexCount);
+	unsigned int cache[s_cacheSize + 3];
+	unsigned int newCache[s_cacheSize + 3];
+	int cacheCount, newCacheCount;
+	size_t i, outputTriangle, scanCursor;
+	unsigned int vertex, triangle, k;
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangle adjacency of every vertex, as one flat array.
+	for (i = 0; i < indexCount; i++)
+	{
+		remainingTriangles[indices[i]]++;
+	}
+	for (vertex = 0; vertex < vertexCount; vertex++)
+	{
+		triangleOffsets[vertex + 1] = triangleOffsets[vertex] + remainingTriangles[vertex];
+	}
+	{
+		std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (i = 0; i < indexCount; i++)
+		{
+			vertexTriangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+		}
+	}
+
+	for (vertex = 0; vertex < vertexCount; vertex++)
+	{
+		vertexScores[vertex] = VertexScore(-1, remainingTriangles[vertex]);
+	}
+	for (i = 0; i < triangleCount; i++)
+	{
+		triangleScores[i] = vertexScores[indices[i * 3 + 0]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+	}
+
+	cacheCount = 0;
+	scanCursor = 0;
+	triangle = 0;
+	for (outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++)
+	{
+		float bestScore = -1.0f;
+		int bestTriangle = -1;
+		int c;
+
+		// The best candidate is always adjacent to a cached vertex, only when the cache has
+		// nothing left to offer fall back to the next triangle not yet drawn.
+		for (c = 0; c < cacheCount; c++)
+		{
+			vertex = cache[c];
+			for (k = triangleOffsets[vertex]; k < triangleOffsets[vertex] + remainingTriangles[vertex]; k++)
+			{
+				unsigned int candidate = vertexTriangles[k];
+				if (triangleScores[candidate] > bestScore)
+				{
+					bestScore = triangleScores[candidate];
+					bestTriangle = (int)candidate;
+				}
+			}
+		}
+
+		if (bestTriangle < 0)
+		{
+			while (emitted[scanCursor])
+			{
+				scanCursor++;
+			}
+			bestTriangle = (int)scanCursor;
+		}
+
+		triangle = (unsigned int)bestTriangle;
+		emitted[triangle] = 1;
+		memcpy(&output[outputTriangle * 3], &indices[triangle * 3], 3 * sizeof(unsigned int));
+
+		// Drop the triangle from the adjacency of its vertices (only the live prefix is scanned).
+		for (k = 0; k < 3; k++)
+		{
+			unsigned int* list;
+			unsigned int j, count;
+
+			vertex = indices[triangle * 3 + k];
+			list = &vertexTriangles[triangleOffsets[vertex]];
+			count = remainingTriangles[vertex];
+			for (j = 0; j < count; j++)
+			{
+				if (list[j] == triangle)
+				{
+					list[j] = list[count - 1];
+					break;
+				}
+			}
+			remainingTriangles[vertex]--;
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache.
+		newCacheCount = 0;
+		for (k = 0; k < 3; k++)
+		{
+			newCache[newCacheCount++] = indices[triangle * 3 + k];
+		}
+		for (c = 0; c < cacheCount; c++)
+		{
+			vertex = cache[c];
+			if (vertex != newCache[0] && vertex != newCache[1] && vertex != newCache[2])
+			{
+				newCache[newCacheCount++] = vertex;
+			}
+		}
+
+		// Rescore every vertex whose cache position changed, including those pushed out.
+		for (c = 0; c < newCacheCount; c++)
+		{
+			float oldScore, newScore;
+			int position = (c < s_cacheSize) ? c : -1;
+
+			vertex = newCache[c];
+			cachePositions[vertex] = position;
+			oldScore = vertexScores[vertex];
+			newScore = VertexScore(position, remainingTriangles[vertex]);
+			vertexScores[vertex] = newScore;
+
+			for (k = triangleOffsets[vertex]; k < triangleOffsets[vertex] + remainingTriangles[vertex]; k++)
+			{
+				triangleScores[vertexTriangles[k]] += newScore - oldScore;
+			}
+		}
+
+		cacheCount = std::min(newCacheCount, s_cacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+	}
+
+	// A mesh exported strip by strip can already beat the greedy order; it keeps its own then.
+	if (AnalyzeVertexCache(output.data(), indexCount, vertexCount).acmr <= AnalyzeVertexCache(indices, indexCount, vertexCount).acmr)
+	{
+		memcpy(indices, output.data(), indexCount * sizeof(unsigned int));
+	}
+
+	return;
+}
+
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const unsigned char* vertices, unsigned int vertexCount, unsigned int vertexStride, float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	std::vector<TriangleCluster> clusters;
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<unsigned int> output(indexCount);
+	VertexCacheStats cacheOrder, overdrawOrder;
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	unsigned int time;
+	size_t i, t;
+	int axis;
+
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// A cluster starts wherever the cache optimised order had to start over from an empty cache,
+	// i.e. all three vertices of a triangle missed. Reordering whole clusters keeps most of the reuse.
+	time = VERTEX_CACHE_SIMULATION_SIZE + 1;
+	for (t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+
+		for (i = t * 3; i < t * 3 + 3; i++)
+		{
+			unsigned int index = indices[i];
+			if (time - cacheTime[index] > VERTEX_CACHE_SIMULATION_SIZE)
+			{
+				cacheTime[index] = time;
+				time++;
+				misses++;
+			}
+		}
+
+		if (t == 0 || misses == 3)
+		{
+			TriangleCluster cluster = { t, 0, 0.0f };
+			clusters.push_back(cluster);
+		}
+		clusters.back().count++;
+	}
+
+	if (clusters.size() < 2)
+	{
+		return;
+	}
+
+	// Area weighted centroid of the whole mesh.
+	for (t = 0; t < triangleCount; t++)
+	{
+		const float* p0 = reinterpret_cast<const float*>(vertices + (size_t)indices[t * 3 + 0] * vertexStride);
+		const float* p1 = reinterpret_cast<const float*>(vertices + (size_t)indices[t * 3 + 1] * vertexStride);
+		const float* p2 = reinterpret_cast<const float*>(vertices + (size_t)indices[t * 3 + 2] * vertexStride);
+		float e1[3], e2[3], n[3], area;
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			e1[axis] = p1[axis] - p0[axis];
+			e2[axis] = p2[axis] - p0[axis];
+		}
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			meshCentroid[axis] += (p0[axis] + p1[axis] + p2[axis]) * area;
+		}
+		meshArea += area * 3.0f;
+	}
+	if (meshArea > 0.0f)
+	{
+		for (axis = 0; axis < 3; axis++)
+		{
+			meshCentroid[axis] /= meshArea;
+		}
+	}
+
+	// Clusters that face away from the middle of the mesh are on its outside and should go first.
+	for (TriangleCluster& cluster : clusters)
+	{
+		float centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f, length;
+
+		for (t = cluster.start; t < cluster.start + cluster.count; t++)
+		{
+			const float* p0 = reinterpret_cast<const float*>(vertices + (size_t)indices[t * 3 + 0] * vertexStride);
+			const float* p1 = reinterpret_cast<const float*>(vertices + (size_t)indices[t * 3 + 1] * vertexStride);
+			const float* p2 = reinterpret_cast<const float*>(vertices + (size_t)indices[t * 3 + 2] * vertexStride);
+			float e1[3], e2[3], n[3], triangleArea;
+
+			for (axis = 0; axis < 3; axis++)
+			{
+				e1[axis] = p1[axis] - p0[axis];
+				e2[axis] = p2[axis] - p0[axis];
+			}
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			triangleArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (axis = 0; axis < 3; axis++)
+			{
+				centroid[axis] += (p0[axis] + p1[axis] + p2[axis]) * triangleArea;
+				normal[axis] += n[axis];
+			}
+			area += triangleArea * 3.0f;
+		}
+
+		length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		cluster.sortKey = 0.0f;
+		if (area > 0.0f && length > 0.0f)
+		{
+			for (axis = 0; axis < 3; axis++)
+			{
+				cluster.sortKey += (centroid[axis] / area - meshCentroid[axis]) * normal[axis] / length;
+			}
+		}
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const TriangleCluster& a, const TriangleCluster& b) { return a.sortKey > b.sortKey; });
+
+	t = 0;
+	for (const TriangleCluster& cluster : clusters)
+	{
+		memcpy(&output[t * 3], &indices[cluster.start * 3], cluster.count * 3 * sizeof(unsigned int));
+		t += cluster.count;
+	}
+
+	// Only accept the new order if it does not give back too much of the cache optimisation.
+	cacheOrder = AnalyzeVertexCache(indices, indexCount, vertexCount);
+	overdrawOrder = AnalyzeVertexCache(output.data(), indexCount, vertexCount);
+	if (overdrawOrder.acmr <= cacheOrder.acmr * threshold)
+	{
+		memcpy(indices, output.data(), indexCount * sizeof(unsigned int));
+	}
+
+	return;
+}
+
+void OptimizeVertexFetch(MeshData& mesh)
+{
+	const unsigned int unused = 0xffffffffu;
+	std::vector<unsigned int> remap(mesh.vertexCount, unused);
+	std::vector<unsigned char> vertices(mesh.vertices.size());
+	unsigned int next, index;
+	size_t i;
+
+	next = 0;
+	for (i = 0; i < mesh.indices.size(); i++)
+	{
+		index = mesh.indices[i];
+		if (remap[index] == unused)
+		{
+			remap[index] = next;
+			memcpy(&vertices[(size_t)next * mesh.vertexStride], &mesh.vertices[(size_t)index * mesh.vertexStride], mesh.vertexStride);
+			next++;
+		}
+		mesh.indices[i] = remap[index];
+	}
+
+	// Vertices no triangle references are dropped.
+	vertices.resize((size_t)next * mesh.vertexStride);
+	mesh.vertices.swap(vertices);
+	mesh.vertexCount = next;
+
+	return;
+}
+
+void OptimizeMesh(MeshData& mesh, MeshOptimizeReport* report)
+{
+	if (report)
+	{
+		report->before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertexCount);
+	}
+
+	OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertexCount);
+	OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertexCount, mesh.vertexStride);
+	OptimizeVertexFetch(mesh);
+
+	if (report)
+	{
+		report->after = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertexCount);
+	}
+
+	return;
+}
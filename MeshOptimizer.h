@@ -0,0 +1,48 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshOptimizer.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MESHOPTIMIZER_H_
+#define _MESHOPTIMIZER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include "MeshBuilder.h"
+
+// Post-transform vertex cache statistics of an index buffer, simulated with a FIFO cache.
+// ACMR is vertex shader invocations per triangle (0.5 is ideal on a large grid, 3 is unindexed),
+// ATVR is invocations per unique vertex (1 is ideal).
+struct VertexCacheStats
+{
+	float acmr;
+	float atvr;
+};
+
+struct MeshOptimizeReport
+{
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+
+const unsigned int VERTEX_CACHE_SIMULATION_SIZE = 16;
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIMULATION_SIZE);
+
+// Reorders triangles so that vertices are reused while still in the post-transform cache
+// (Forsyth's linear-speed vertex cache optimisation). Keeps the order it is given if the simulated
+// cache does better with that.
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, unsigned int vertexCount);
+
+// Reorders runs of cache-friendly triangles so that outward facing clusters are drawn first and
+// hide the ones behind them. Keeps the cache order if the ACMR would grow by more than threshold.
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const unsigned char* vertices, unsigned int vertexCount, unsigned int vertexStride, float threshold = 1.05f);
+
+// Reorders the vertex array into first use order of the indices so fetches walk memory forwards.
+void OptimizeVertexFetch(MeshData& mesh);
+
+// Runs all three passes over an indexed mesh. report may be null.
+void OptimizeMesh(MeshData& mesh, MeshOptimizeReport* report);
+
+#endif
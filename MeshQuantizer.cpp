@@ -0,0 +1,345 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshQuantizer.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshQuantizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	inline float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	inline void Cross(const float a[3], const float b[3], float result[3])
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	// Returns false (and leaves v alone) if v has no usable direction.
+	inline bool Normalize(float v[3])
+	{
+		float length = sqrtf(Dot(v, v));
+
+		if (!(length > FLT_MIN) || !std::isfinite(length))
+		{
+			return false;
+		}
+
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+
+		return true;
+	}
+
+	inline uint16_t QuantizeUnorm(float value, float scale, float bias)
+	{
+		float unorm = (scale > 0.0f) ? (value - bias) / scale : 0.0f;
+
+		unorm = std::min(std::max(unorm, 0.0f), 1.0f);
+
+		return (uint16_t)(unorm * 65535.0f + 0.5f);
+	}
+
+	inline int16_t QuantizeSnorm(float value)
+	{
+		value = std::min(std::max(value, -1.0f), 1.0f);
+
+		return (int16_t)lrintf(value * 32767.0f);
+	}
+
+	inline float DequantizeSnorm(int16_t value)
+	{
+		// Same as DXGI SNORM: -32768 and -32767 both map to -1.
+		return std::max((float)value / 32767.0f, -1.0f);
+	}
+
+	// Octahedral mapping of a unit vector onto the [-1, 1] square.
+	void EncodeOctahedral(const float v[3], int16_t encoded[2])
+	{
+		float l1 = fabsf(v[0]) + fabsf(v[1]) + fabsf(v[2]);
+		float x = v[0] / l1;
+		float y = v[1] / l1;
+
+		if (v[2] < 0.0f)
+		{
+			float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		}
+
+		encoded[0] = QuantizeSnorm(x);
+		encoded[1] = QuantizeSnorm(y);
+	}
+
+	void DecodeOctahedral(const int16_t encoded[2], float v[3])
+	{
+		float t;
+
+		v[0] = DequantizeSnorm(encoded[0]);
+		v[1] = DequantizeSnorm(encoded[1]);
+		v[2] = 1.0f - fabsf(v[0]) - fabsf(v[1]);
+
+		t = std::max(-v[2], 0.0f);
+		v[0] += (v[0] >= 0.0f) ? -t : t;
+		v[1] += (v[1] >= 0.0f) ? -t : t;
+
+		Normalize(v);
+	}
+
+	// Any unit vector perpendicular to n, for tangents that degenerate texture coordinates left undefined.
+	void Perpendicular(const float n[3], float result[3])
+	{
+		const float xAxis[3] = { 1.0f, 0.0f, 0.0f };
+		const float yAxis[3] = { 0.0f, 1.0f, 0.0f };
+
+		Cross(n, (fabsf(n[0]) < 0.9f) ? xAxis : yAxis, result);
+		Normalize(result);
+	}
+
+	void OrthogonalizeTangent(const float normal[3], float tangent[3])
+	{
+		float along = Dot(normal, tangent);
+		int axis;
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			tangent[axis] -= normal[axis] * along;
+		}
+
+		if (!Normalize(tangent))
+		{
+			Perpendicular(normal, tangent);
+		}
+	}
+
+	float AngleDegrees(const float a[3], const float b[3])
+	{
+		float cosine = std::min(std::max(Dot(a, b), -1.0f), 1.0f);
+
+		return acosf(cosine) * (180.0f / 3.14159265f);
+	}
+}
+
+bool QuantizeMesh(MeshData& mesh)
+{
+	const MeshVertexNM* source;
+	std::vector<unsigned char> packedVertices;
+	MeshVertexNMPacked* packed;
+	MeshQuantization& quantization = mesh.quantization;
+	float textureMin[2] = { FLT_MAX, FLT_MAX };
+	float textureMax[2] = { -FLT_MAX, -FLT_MAX };
+	unsigned int i;
+	int axis;
+
+	if (mesh.layout != MESH_LAYOUT_NORMALMAP)
+	{
+		return false;
+	}
+
+	source = mesh.GetVertices<MeshVertexNM>();
+
+	// Positions are quantized over the mesh bounds, texture coordinates over their own range.
+	CalculateMeshBounds(mesh);
+	for (i = 0; i < mesh.vertexCount; i++)
+	{
+		for (axis = 0; axis < 2; axis++)
+		{
+			textureMin[axis] = std::min(textureMin[axis], source[i].texture[axis]);
+			textureMax[axis] = std::max(textureMax[axis], source[i].texture[axis]);
+		}
+	}
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		quantization.positionBias[axis] = mesh.boundsMin[axis];
+		quantization.positionScale[axis] = mesh.boundsMax[axis] - mesh.boundsMin[axis];
+	}
+	for (axis = 0; axis < 2; axis++)
+	{
+		quantization.textureBias[axis] = (mesh.vertexCount > 0) ? textureMin[axis] : 0.0f;
+		quantization.textureScale[axis] = (mesh.vertexCount > 0) ? textureMax[axis] - textureMin[axis] : 0.0f;
+	}
+
+	packedVertices.resize((size_t)mesh.vertexCount * sizeof(MeshVertexNMPacked));
+	packed = reinterpret_cast<MeshVertexNMPacked*>(packedVertices.data());
+
+	for (i = 0; i < mesh.vertexCount; i++)
+	{
+		float normal[3], tangent[3], binormal[3], rebuilt[3];
+
+		memcpy(normal, source[i].normal, sizeof(normal));
+		memcpy(tangent, source[i].tangent, sizeof(tangent));
+		memcpy(binormal, source[i].binormal, sizeof(binormal));
+
+		if (!Normalize(normal))
+		{
+			normal[0] = 0.0f;
+			normal[1] = 1.0f;
+			normal[2] = 0.0f;
+		}
+
+		// Only an orthonormal frame can be rebuilt from normal, tangent and a sign, so the tangent
+		// loses its component along the normal. A degenerate tangent gets an arbitrary one.
+		OrthogonalizeTangent(normal, tangent);
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			packed[i].position[axis] = QuantizeUnorm(source[i].position[axis], quantization.positionScale[axis], quantization.positionBias[axis]);
+		}
+		for (axis = 0; axis < 2; axis++)
+		{
+			packed[i].texture[axis] = QuantizeUnorm(source[i].texture[axis], quantization.textureScale[axis], quantization.textureBias[axis]);
+		}
+
+		EncodeOctahedral(normal, packed[i].normal);
+		EncodeOctahedral(tangent, packed[i].tangent);
+
+		// Only the handedness of the binormal is kept.
+		Cross(normal, tangent, rebuilt);
+		packed[i].position[3] = (Dot(rebuilt, binormal) < 0.0f) ? 0 : 65535;
+	}
+
+	// A quantized position can be half a step from the float one, the sphere grows to allow for it.
+	mesh.boundsRadius += 0.5f / 65535.0f * sqrtf(quantization.positionScale[0] * quantization.positionScale[0] +
+		quantization.positionScale[1] * quantization.positionScale[1] + quantization.positionScale[2] * quantization.positionScale[2]);
+
+	mesh.layout = MESH_LAYOUT_NORMALMAP_PACKED;
+	mesh.vertexStride = sizeof(MeshVertexNMPacked);
+	mesh.vertices.swap(packedVertices);
+
+	return true;
+}
+
+void UnpackVertex(const MeshVertexNMPacked& packed, const MeshQuantization& quantization, MeshVertexNM& vertex)
+{
+	float sign;
+	int axis;
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		vertex.position[axis] = (float)packed.position[axis] / 65535.0f * quantization.positionScale[axis] + quantization.positionBias[axis];
+	}
+	for (axis = 0; axis < 2; axis++)
+	{
+		vertex.texture[axis] = (float)packed.texture[axis] / 65535.0f * quantization.textureScale[axis] + quantization.textureBias[axis];
+	}
+
+	DecodeOctahedral(packed.normal, vertex.normal);
+	DecodeOctahedral(packed.tangent, vertex.tangent);
+
+	sign = (packed.position[3] != 0) ? 1.0f : -1.0f;
+	Cross(vertex.normal, vertex.tangent, vertex.binormal);
+	for (axis = 0; axis < 3; axis++)
+	{
+		vertex.binormal[axis] *= sign;
+	}
+	Normalize(vertex.binormal);
+
+	return;
+}
+
+bool ConvertVertices(const void* vertices, unsigned int count, MeshLayout from, const MeshQuantization& quantization, MeshLayout to, void* destination)
+{
+	const unsigned char* source = static_cast<const unsigned char*>(vertices);
+	unsigned char* target = static_cast<unsigned char*>(destination);
+	unsigned int fromStride, toStride, i;
+	MeshVertexNMPacked packed;
+	MeshVertexNM unpacked;
+
+	fromStride = GetVertexStride(from);
+	toStride = GetVertexStride(to);
+	if (from == to)
+	{
+		memcpy(target, source, (size_t)count * fromStride);
+		return true;
+	}
+
+	// Only attributes the source has can be kept.
+	if (from == MESH_LAYOUT_SHADOWMAP || (to != MESH_LAYOUT_SHADOWMAP && to != MESH_LAYOUT_PLAIN))
+	{
+		return false;
+	}
+
+	// Every float layout starts with the attributes of the smaller ones, in the same order.
+	for (i = 0; i < count; i++)
+	{
+		if (from == MESH_LAYOUT_NORMALMAP_PACKED)
+		{
+			memcpy(&packed, source + (size_t)i * fromStride, sizeof(packed));
+			UnpackVertex(packed, quantization, unpacked);
+			memcpy(target + (size_t)i * toStride, &unpacked, toStride);
+		}
+		else
+		{
+			memcpy(target + (size_t)i * toStride, source + (size_t)i * fromStride, toStride);
+		}
+	}
+
+	return true;
+}
+
+QuantizationError MeasureQuantizationError(const MeshData& original, const MeshData& packed)
+{
+	QuantizationError error;
+	const MeshVertexNM* source;
+	const MeshVertexNMPacked* encoded;
+	unsigned int i;
+	int axis;
+
+	memset(&error, 0, sizeof(error));
+
+	if (original.layout != MESH_LAYOUT_NORMALMAP || packed.layout != MESH_LAYOUT_NORMALMAP_PACKED || original.vertexCount != packed.vertexCount)
+	{
+		return error;
+	}
+
+	source = original.GetVertices<MeshVertexNM>();
+	encoded = packed.GetVertices<MeshVertexNMPacked>();
+
+	for (i = 0; i < original.vertexCount; i++)
+	{
+		MeshVertexNM decoded;
+		float normal[3], tangent[3], binormal[3];
+
+		UnpackVertex(encoded[i], packed.quantization, decoded);
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			error.position = std::max(error.position, fabsf(decoded.position[axis] - source[i].position[axis]));
+		}
+		for (axis = 0; axis < 2; axis++)
+		{
+			error.texture = std::max(error.texture, fabsf(decoded.texture[axis] - source[i].texture[axis]));
+		}
+
+		// Directions the float mesh never had (NaN tangents) have nothing to be compared with.
+		memcpy(normal, source[i].normal, sizeof(normal));
+		memcpy(tangent, source[i].tangent, sizeof(tangent));
+		memcpy(binormal, source[i].binormal, sizeof(binormal));
+		if (Normalize(normal))
+		{
+			error.normalDegrees = std::max(error.normalDegrees, AngleDegrees(normal, decoded.normal));
+
+			if (Normalize(tangent))
+			{
+				OrthogonalizeTangent(normal, tangent);
+				error.tangentDegrees = std::max(error.tangentDegrees, AngleDegrees(tangent, decoded.tangent));
+			}
+		}
+		if (Normalize(binormal))
+		{
+			error.binormalDegrees = std::max(error.binormalDegrees, AngleDegrees(binormal, decoded.binormal));
+		}
+	}
+
+	return error;
+}
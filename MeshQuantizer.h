@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshQuantizer.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MESHQUANTIZER_H_
+#define _MESHQUANTIZER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include "MeshBuilder.h"
+
+// Largest difference between a float mesh and its packed form, decoded the way the vertex
+// shaders decode it. Position and texture errors are absolute, angles are in degrees.
+struct QuantizationError
+{
+	float position;			// at most half a step, positionScale / 131070, plus float rounding far from the origin
+	float texture;			// at most half a step: textureScale / 131070
+	float normalDegrees;	// under 0.005, the 16 bit octahedral grid
+	float tangentDegrees;	// against the tangent orthogonalized to the normal, also under 0.005
+	float binormalDegrees;	// mostly the frame becoming orthonormal, not quantization
+};
+
+// Converts a MESH_LAYOUT_NORMALMAP mesh to MESH_LAYOUT_NORMALMAP_PACKED (56 -> 20 bytes a vertex):
+// 16 bit positions and texture coordinates over the mesh's range, octahedral normal and tangent,
+// and the binormal replaced by its handedness. The tangent is made orthogonal to the normal
+// first, since only an orthonormal frame can be rebuilt. Vertex order and indices are kept.
+bool QuantizeMesh(MeshData& mesh);
+
+// Decodes one packed vertex back to floats, exactly as light_vs.hlsl and friends do.
+void UnpackVertex(const MeshVertexNMPacked& packed, const MeshQuantization& quantization, MeshVertexNM& vertex);
+
+// Writes count vertices of layout from to destination in layout to, keeping the attributes to has:
+// any layout but the shadow map's can become the plain or the shadow map layout. Packed vertices are
+// decoded with quantization, as UnpackVertex does. Returns false for any other pair.
+bool ConvertVertices(const void* vertices, unsigned int count, MeshLayout from, const MeshQuantization& quantization, MeshLayout to, void* destination);
+
+// Compares every vertex of a packed mesh with the float mesh it was made from.
+QuantizationError MeasureQuantizationError(const MeshData& original, const MeshData& packed);
+
+#endif
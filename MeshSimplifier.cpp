@@ -0,0 +1,949 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshSimplifier.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "MeshOptimizer.h"
+
+namespace
+{
+	// Texture coordinates closer than this count as the same on both sides of an edge.
+	const float s_textureSeamEpsilon = 1e-5f;
+
+	// A triangle whose normal turns further than this (cosine) during a collapse is folding over.
+	const float s_flipCosine = 0.25f;
+
+	// A level that keeps more than this share of the previous level's triangles is not worth its memory.
+	const float s_minimumLodReduction = 0.8f;
+
+	// Each pass applies collapses up to the cost of the candidate at this many times the number
+	// of collapses still needed.
+	const size_t s_passCostQuantile = 2;
+
+	const unsigned int s_noVertex = 0xffffffffu;
+
+	// Sum of squared distances to a set of area weighted planes, as the symmetric 4x4 matrix
+	// (a b c d)^T (a b c d) summed over the planes.
+	struct Quadric
+	{
+		double a00, a01, a02, a03;
+		double a11, a12, a13;
+		double a22, a23;
+		double a33;
+		double weight;
+	};
+
+	void AddPlane(Quadric& q, const double normal[3], double distance, double weight)
+	{
+		q.a00 += weight * normal[0] * normal[0];
+		q.a01 += weight * normal[0] * normal[1];
+		q.a02 += weight * normal[0] * normal[2];
+		q.a03 += weight * normal[0] * distance;
+		q.a11 += weight * normal[1] * normal[1];
+		q.a12 += weight * normal[1] * normal[2];
+		q.a13 += weight * normal[1] * distance;
+		q.a22 += weight * normal[2] * normal[2];
+		q.a23 += weight * normal[2] * distance;
+		q.a33 += weight * distance * distance;
+		q.weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+		q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+		q.a22 += other.a22; q.a23 += other.a23;
+		q.a33 += other.a33;
+		q.weight += other.weight;
+	}
+
+	// Mean squared distance from p to the planes of a and b together.
+	float EvaluateQuadrics(const Quadric& a, const Quadric& b, const float p[3])
+	{
+		Quadric q = a;
+		double x, y, z, sum;
+
+		AddQuadric(q, b);
+		if (q.weight <= 0.0)
+		{
+			return 0.0f;
+		}
+
+		x = p[0];
+		y = p[1];
+		z = p[2];
+		sum = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + q.a33
+			+ 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a03 * x + q.a12 * y * z + q.a13 * y + q.a23 * z);
+
+		return (float)(std::max(sum, 0.0) / q.weight);
+	}
+
+	void TriangleNormal(const float* p0, const float* p1, const float* p2, float normal[3])
+	{
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+		normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	double SegmentDistanceSquared(const double p[3], const double a[3], const double b[3])
+	{
+		double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		double length = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+		double t = 0.0, d[3];
+
+		if (length > 0.0)
+		{
+			t = ((p[0] - a[0]) * ab[0] + (p[1] - a[1]) * ab[1] + (p[2] - a[2]) * ab[2]) / length;
+			t = std::min(std::max(t, 0.0), 1.0);
+		}
+
+		d[0] = p[0] - a[0] - t * ab[0];
+		d[1] = p[1] - a[1] - t * ab[1];
+		d[2] = p[2] - a[2] - t * ab[2];
+
+		return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+	}
+
+	// In doubles: the scene's long thin triangles lose whole model units to cancellation in floats.
+	double TriangleDistanceSquared(const float* point, const float* p0, const float* p1, const float* p2)
+	{
+		const double p[3] = { point[0], point[1], point[2] };
+		const double corners[3][3] = { { p0[0], p0[1], p0[2] }, { p1[0], p1[1], p1[2] }, { p2[0], p2[1], p2[2] } };
+		double normal[3], e1[3], e2[3], length, side, plane;
+		bool inside;
+		int corner, next;
+
+		for (corner = 0; corner < 3; corner++)
+		{
+			e1[corner] = corners[1][corner] - corners[0][corner];
+			e2[corner] = corners[2][corner] - corners[0][corner];
+		}
+		normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		length = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+
+		// Over the inside of the triangle the plane is nearest, otherwise one of the edges.
+		inside = length > 0.0;
+		for (corner = 0; corner < 3 && inside; corner++)
+		{
+			const double* a = corners[corner];
+			const double* b = corners[(corner + 1) % 3];
+			double edge[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			double toPoint[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+
+			side = (edge[1] * toPoint[2] - edge[2] * toPoint[1]) * normal[0] + (edge[2] * toPoint[0] - edge[0] * toPoint[2]) * normal[1] +
+				(edge[0] * toPoint[1] - edge[1] * toPoint[0]) * normal[2];
+			inside = side >= 0.0;
+		}
+
+		if (inside)
+		{
+			plane = (p[0] - corners[0][0]) * normal[0] + (p[1] - corners[0][1]) * normal[1] + (p[2] - corners[0][2]) * normal[2];
+			return plane * plane / length;
+		}
+
+		plane = DBL_MAX;
+		for (corner = 0; corner < 3; corner++)
+		{
+			next = (corner + 1) % 3;
+			plane = std::min(plane, SegmentDistanceSquared(p, corners[corner], corners[next]));
+		}
+
+		return plane;
+	}
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		float cost;
+
+		bool operator<(const Collapse& other) const { return cost < other.cost; }
+	};
+
+	////////////////////////////////////////////////////////////////////////////////
+	// Class name: Simplifier
+	////////////////////////////////////////////////////////////////////////////////
+
+	// Works on position ids (the first vertex at each distinct position) so that vertices split
+	// by a seam move together, and on attribute classes (the first vertex at a position with
+	// the same texture coordinate and a normal within the crease angle) to keep seams intact.
+	// Quadrics carry over between calls to Simplify, so errors are always against the input.
+	// Quadrics only give a mean distance to the planes, so under a maxError every input vertex
+	// also has a position id whose triangles it stays within maxError of, checked per collapse,
+	// and the error is the largest of those distances.
+	class Simplifier
+	{
+	public:
+		Simplifier(const MeshData& mesh, const unsigned int* indices, size_t indexCount);
+
+		size_t Simplify(size_t targetIndexCount, float maxError = FLT_MAX);
+		const unsigned int* GetIndices() const { return m_indices.data(); }
+		float GetError() const { return m_firstPoint.empty() ? sqrtf(m_maxCost) : m_maxDistance; }
+
+	private:
+		const float* GetPosition(unsigned int vertex) const { return reinterpret_cast<const float*>(m_mesh.vertices.data() + (size_t)vertex * m_mesh.vertexStride); }
+		void BuildClasses();
+		void LockBorders();
+		void BuildQuadrics();
+		void BuildAdjacency();
+		void GatherNeighbours(unsigned int position, std::vector<unsigned int>& neighbours) const;
+		unsigned int CountTriangles(unsigned int position) const;
+		bool CanCollapse(unsigned int from, unsigned int to);
+		void ApplyCollapse(unsigned int from, unsigned int to, float cost);
+		void BuildPoints();
+		double FanDistanceSquared(unsigned int point, unsigned int position, unsigned int from, unsigned int to) const;
+		bool StaysWithin(unsigned int from, unsigned int to, float maxError);
+
+		const MeshData& m_mesh;
+		std::vector<unsigned int> m_indices;
+		std::vector<unsigned int> m_position;		// vertex -> position id
+		std::vector<unsigned int> m_class;			// vertex -> attribute class
+		std::vector<char> m_locked;					// per position id
+		std::vector<char> m_dirty;					// per position id, touched by a collapse this pass
+		std::vector<char> m_removed;				// per triangle
+		std::vector<Quadric> m_quadrics;			// per position id
+		std::vector<unsigned int> m_adjacencyOffsets;	// per position id, into m_adjacency
+		std::vector<unsigned int> m_adjacency;			// triangles around each position id
+		std::vector<std::pair<unsigned int, unsigned int> > m_seamMap;	// class at from -> vertex at to, for the collapse being checked
+		std::vector<unsigned int> m_neighboursFrom, m_neighboursTo;
+		std::vector<unsigned int> m_firstPoint;		// per position id, input vertices it stands for, see StaysWithin
+		std::vector<unsigned int> m_nextPoint;		// per input vertex
+		std::vector<std::pair<unsigned int, unsigned int> > m_movedPoints;	// input vertex -> the neighbour it leaves for to, for the collapse being checked
+		size_t m_triangleCount;
+		float m_maxCost;
+		float m_maxDistance;
+	};
+
+	Simplifier::Simplifier(const MeshData& mesh, const unsigned int* indices, size_t indexCount)
+		: m_mesh(mesh), m_indices(indices, indices + indexCount)
+	{
+		m_triangleCount = indexCount / 3;
+		m_indices.resize(m_triangleCount * 3);
+		m_maxCost = 0.0f;
+		m_maxDistance = 0.0f;
+
+		CalculatePositionRemap(m_mesh, m_position);
+		BuildClasses();
+		LockBorders();
+		BuildQuadrics();
+	}
+
+	void Simplifier::BuildClasses()
+	{
+		const float creaseCosine = cosf(MESH_LOD_CREASE_DEGREES * 3.14159265f / 180.0f);
+		std::vector<unsigned int> firstAtPosition(m_mesh.vertexCount, s_noVertex);
+		std::vector<unsigned int> nextAtPosition(m_mesh.vertexCount, s_noVertex);
+		unsigned int vertex, other, position;
+
+		m_class.resize(m_mesh.vertexCount);
+
+		// The shadow map layout has nothing but positions.
+		if (m_mesh.layout == MESH_LAYOUT_SHADOWMAP)
+		{
+			m_class = m_position;
+			return;
+		}
+
+		for (vertex = 0; vertex < m_mesh.vertexCount; vertex++)
+		{
+			const MeshVertex& v = *reinterpret_cast<const MeshVertex*>(GetPosition(vertex));
+			position = m_position[vertex];
+
+			m_class[vertex] = vertex;
+			for (other = firstAtPosition[position]; other != s_noVertex; other = nextAtPosition[other])
+			{
+				const MeshVertex& o = *reinterpret_cast<const MeshVertex*>(GetPosition(other));
+				float cosine = v.normal[0] * o.normal[0] + v.normal[1] * o.normal[1] + v.normal[2] * o.normal[2];
+
+				if (m_class[other] == other && fabsf(v.texture[0] - o.texture[0]) <= s_textureSeamEpsilon && fabsf(v.texture[1] - o.texture[1]) <= s_textureSeamEpsilon && cosine >= creaseCosine)
+				{
+					m_class[vertex] = other;
+					break;
+				}
+			}
+
+			nextAtPosition[vertex] = firstAtPosition[position];
+			firstAtPosition[position] = vertex;
+		}
+
+		return;
+	}
+
+	void Simplifier::LockBorders()
+	{
+		std::unordered_map<uint64_t, unsigned int> edgeUses;
+		size_t triangle;
+		int corner;
+
+		m_locked.assign(m_mesh.vertexCount, 0);
+		edgeUses.reserve(m_triangleCount * 3);
+
+		for (triangle = 0; triangle < m_triangleCount; triangle++)
+		{
+			for (corner = 0; corner < 3; corner++)
+			{
+				unsigned int a = m_position[m_indices[triangle * 3 + corner]];
+				unsigned int b = m_position[m_indices[triangle * 3 + (corner + 1) % 3]];
+				edgeUses[((uint64_t)std::min(a, b) << 32) | std::max(a, b)]++;
+			}
+		}
+
+		// Open borders and edges shared by more than two triangles stay put, the quadrics
+		// know nothing about the gap or the fin on the other side.
+		for (const auto& edge : edgeUses)
+		{
+			if (edge.second != 2)
+			{
+				m_locked[(unsigned int)(edge.first >> 32)] = 1;
+				m_locked[(unsigned int)(edge.first & 0xffffffffu)] = 1;
+			}
+		}
+
+		return;
+	}
+
+	void Simplifier::BuildQuadrics()
+	{
+		Quadric zero;
+		size_t triangle;
+		int corner;
+
+		memset(&zero, 0, sizeof(zero));
+		m_quadrics.assign(m_mesh.vertexCount, zero);
+
+		for (triangle = 0; triangle < m_triangleCount; triangle++)
+		{
+			const float* p0 = GetPosition(m_indices[triangle * 3 + 0]);
+			const float* p1 = GetPosition(m_indices[triangle * 3 + 1]);
+			const float* p2 = GetPosition(m_indices[triangle * 3 + 2]);
+			float normal[3];
+			double unit[3], length, distance;
+
+			TriangleNormal(p0, p1, p2, normal);
+			length = sqrt((double)normal[0] * normal[0] + (double)normal[1] * normal[1] + (double)normal[2] * normal[2]);
+			if (length <= 0.0)
+			{
+				continue;
+			}
+
+			unit[0] = normal[0] / length;
+			unit[1] = normal[1] / length;
+			unit[2] = normal[2] / length;
+			distance = -(unit[0] * p0[0] + unit[1] * p0[1] + unit[2] * p0[2]);
+
+			// Weighted by area, so a large flat face is not outvoted by a fan of slivers.
+			for (corner = 0; corner < 3; corner++)
+			{
+				AddPlane(m_quadrics[m_position[m_indices[triangle * 3 + corner]]], unit, distance, length * 0.5);
+			}
+		}
+
+		return;
+	}
+
+	void Simplifier::BuildAdjacency()
+	{
+		size_t triangle;
+		unsigned int position;
+		int corner;
+
+		m_adjacencyOffsets.assign(m_mesh.vertexCount + 1, 0);
+		for (triangle = 0; triangle < m_triangleCount; triangle++)
+		{
+			for (corner = 0; corner < 3; corner++)
+			{
+				m_adjacencyOffsets[m_position[m_indices[triangle * 3 + corner]] + 1]++;
+			}
+		}
+
+		for (position = 0; position < m_mesh.vertexCount; position++)
+		{
+			m_adjacencyOffsets[position + 1] += m_adjacencyOffsets[position];
+		}
+
+		m_adjacency.resize(m_triangleCount * 3);
+		std::vector<unsigned int> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+		for (triangle = 0; triangle < m_triangleCount; triangle++)
+		{
+			for (corner = 0; corner < 3; corner++)
+			{
+				m_adjacency[fill[m_position[m_indices[triangle * 3 + corner]]]++] = (unsigned int)triangle;
+			}
+		}
+
+		return;
+	}
+
+	void Simplifier::GatherNeighbours(unsigned int position, std::vector<unsigned int>& neighbours) const
+	{
+		unsigned int i, triangle;
+		int corner;
+
+		neighbours.clear();
+		for (i = m_adjacencyOffsets[position]; i < m_adjacencyOffsets[position + 1]; i++)
+		{
+			triangle = m_adjacency[i];
+			if (m_removed[triangle])
+			{
+				continue;
+			}
+
+			for (corner = 0; corner < 3; corner++)
+			{
+				unsigned int other = m_position[m_indices[triangle * 3 + corner]];
+				if (other != position)
+				{
+					neighbours.push_back(other);
+				}
+			}
+		}
+
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+		return;
+	}
+
+	unsigned int Simplifier::CountTriangles(unsigned int position) const
+	{
+		unsigned int i, count = 0;
+
+		for (i = m_adjacencyOffsets[position]; i < m_adjacencyOffsets[position + 1]; i++)
+		{
+			count += m_removed[m_adjacency[i]] ? 0 : 1;
+		}
+
+		return count;
+	}
+
+	bool Simplifier::CanCollapse(unsigned int from, unsigned int to)
+	{
+		const float* target = GetPosition(to);
+		unsigned int i, j, triangle, shared, common;
+		size_t k;
+		int corner, fromCorner, toCorner;
+
+		m_seamMap.clear();
+		shared = 0;
+
+		// Every attribute class at from has to continue along the edge into a distinct class at
+		// to, otherwise the collapse would drag a seam across the surface or shorten it.
+		for (i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; i++)
+		{
+			triangle = m_adjacency[i];
+			if (m_removed[triangle])
+			{
+				continue;
+			}
+
+			fromCorner = toCorner = -1;
+			for (corner = 0; corner < 3; corner++)
+			{
+				unsigned int position = m_position[m_indices[triangle * 3 + corner]];
+				if (position == from) fromCorner = corner;
+				if (position == to) toCorner = corner;
+			}
+
+			if (toCorner < 0)
+			{
+				continue;
+			}
+
+			unsigned int fromClass = m_class[m_indices[triangle * 3 + fromCorner]];
+			unsigned int toVertex = m_indices[triangle * 3 + toCorner];
+			for (k = 0; k < m_seamMap.size(); k++)
+			{
+				if ((m_seamMap[k].first == fromClass) != (m_class[m_seamMap[k].second] == m_class[toVertex]))
+				{
+					return false;
+				}
+			}
+
+			m_seamMap.push_back(std::make_pair(fromClass, toVertex));
+			shared++;
+		}
+
+		if (shared == 0)
+		{
+			return false;
+		}
+
+		for (i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; i++)
+		{
+			triangle = m_adjacency[i];
+			if (m_removed[triangle])
+			{
+				continue;
+			}
+
+			const float* p[3];
+			float before[3], after[3];
+			bool hasTo = false;
+			bool mapped = false;
+
+			for (corner = 0; corner < 3; corner++)
+			{
+				unsigned int vertex = m_indices[triangle * 3 + corner];
+				p[corner] = GetPosition(vertex);
+				if (m_position[vertex] == to)
+				{
+					hasTo = true;
+				}
+				if (m_position[vertex] == from)
+				{
+					fromCorner = corner;
+				}
+			}
+
+			if (hasTo)
+			{
+				continue;
+			}
+
+			for (k = 0; k < m_seamMap.size() && !mapped; k++)
+			{
+				mapped = m_seamMap[k].first == m_class[m_indices[triangle * 3 + fromCorner]];
+			}
+			if (!mapped)
+			{
+				return false;
+			}
+
+			// Reject collapses that fold a triangle over its neighbours.
+			TriangleNormal(p[0], p[1], p[2], before);
+			p[fromCorner] = target;
+			TriangleNormal(p[0], p[1], p[2], after);
+
+			float dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+			float lengths = sqrtf((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) * (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+			if (dot <= s_flipCosine * lengths)
+			{
+				return false;
+			}
+		}
+
+		// Link condition: the edge's end points may only share the neighbours across its own
+		// triangles, anything else would pinch the surface into a non-manifold edge.
+		GatherNeighbours(from, m_neighboursFrom);
+		GatherNeighbours(to, m_neighboursTo);
+		common = 0;
+		for (i = 0, j = 0; i < m_neighboursFrom.size() && j < m_neighboursTo.size();)
+		{
+			if (m_neighboursFrom[i] < m_neighboursTo[j]) i++;
+			else if (m_neighboursFrom[i] > m_neighboursTo[j]) j++;
+			else
+			{
+				// A neighbour left with two triangles would be two triangles back to back, the end of
+				// a closed part folding into a sheet: a tetrahedron is as far as one goes.
+				if (!m_locked[m_neighboursTo[j]] && CountTriangles(m_neighboursTo[j]) <= 3)
+				{
+					return false;
+				}
+				common++;
+				i++;
+				j++;
+			}
+		}
+
+		return common == shared;
+	}
+
+	void Simplifier::ApplyCollapse(unsigned int from, unsigned int to, float cost)
+	{
+		unsigned int i, triangle, point;
+		size_t k;
+		int corner;
+
+		for (i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; i++)
+		{
+			triangle = m_adjacency[i];
+			if (m_removed[triangle])
+			{
+				continue;
+			}
+
+			for (corner = 0; corner < 3; corner++)
+			{
+				m_dirty[m_position[m_indices[triangle * 3 + corner]]] = 1;
+			}
+
+			bool hasTo = false;
+			for (corner = 0; corner < 3; corner++)
+			{
+				hasTo = hasTo || m_position[m_indices[triangle * 3 + corner]] == to;
+			}
+
+			if (hasTo)
+			{
+				m_removed[triangle] = 1;
+				continue;
+			}
+
+			for (corner = 0; corner < 3; corner++)
+			{
+				unsigned int& vertex = m_indices[triangle * 3 + corner];
+				if (m_position[vertex] != from)
+				{
+					continue;
+				}
+
+				for (k = 0; k < m_seamMap.size(); k++)
+				{
+					if (m_seamMap[k].first == m_class[vertex])
+					{
+						vertex = m_seamMap[k].second;
+						break;
+					}
+				}
+			}
+		}
+
+		AddQuadric(m_quadrics[to], m_quadrics[from]);
+		m_maxCost = std::max(m_maxCost, cost);
+
+		// The input vertices from stood for now lie on the triangles of to, see StaysWithin.
+		if (!m_firstPoint.empty() && m_firstPoint[from] != s_noVertex)
+		{
+			for (point = m_firstPoint[from]; m_nextPoint[point] != s_noVertex; point = m_nextPoint[point])
+			{
+			}
+			m_nextPoint[point] = m_firstPoint[to];
+			m_firstPoint[to] = m_firstPoint[from];
+			m_firstPoint[from] = s_noVertex;
+		}
+
+		for (const auto& moved : m_movedPoints)
+		{
+			unsigned int* link = &m_firstPoint[moved.second];
+
+			while (*link != moved.first)
+			{
+				link = &m_nextPoint[*link];
+			}
+			*link = m_nextPoint[moved.first];
+			m_nextPoint[moved.first] = m_firstPoint[to];
+			m_firstPoint[to] = moved.first;
+		}
+		m_movedPoints.clear();
+
+		return;
+	}
+
+	void Simplifier::BuildPoints()
+	{
+		size_t index;
+		unsigned int position;
+
+		// Each position id starts out standing for its own input vertex.
+		m_firstPoint.assign(m_mesh.vertexCount, s_noVertex);
+		m_nextPoint.assign(m_mesh.vertexCount, s_noVertex);
+		for (index = 0; index < m_triangleCount * 3; index++)
+		{
+			position = m_position[m_indices[index]];
+			m_firstPoint[position] = position;
+		}
+
+		return;
+	}
+
+	// Squared distance from an input vertex to the triangles around position once from has
+	// collapsed onto to: the triangles with both go, and from is drawn at to in the rest.
+	double Simplifier::FanDistanceSquared(unsigned int point, unsigned int position, unsigned int from, unsigned int to) const
+	{
+		const unsigned int fans[2] = { position, from };
+		const float* corners[3];
+		double nearest = DBL_MAX;
+		unsigned int fan, i, triangle, vertex;
+		int corner, ends;
+
+		for (fan = 0; fan < (position == to ? 2u : 1u); fan++)
+		{
+			for (i = m_adjacencyOffsets[fans[fan]]; i < m_adjacencyOffsets[fans[fan] + 1]; i++)
+			{
+				triangle = m_adjacency[i];
+				if (m_removed[triangle])
+				{
+					continue;
+				}
+
+				ends = 0;
+				for (corner = 0; corner < 3; corner++)
+				{
+					vertex = m_indices[triangle * 3 + corner];
+					ends += (m_position[vertex] == from || m_position[vertex] == to) ? 1 : 0;
+					corners[corner] = GetPosition(m_position[vertex] == from ? to : vertex);
+				}
+
+				if (ends < 2)
+				{
+					nearest = std::min(nearest, TriangleDistanceSquared(GetPosition(point), corners[0], corners[1], corners[2]));
+				}
+			}
+		}
+
+		return nearest;
+	}
+
+	// Every input vertex that from or its neighbours stand for has to stay within maxError of
+	// their triangles after the collapse; one a neighbour's own triangles no longer cover may pass
+	// to to, which takes over the area of the triangles that go. A neighbour changed earlier in the
+	// pass may be missing triangles from its adjacency, which only makes the check stricter.
+	bool Simplifier::StaysWithin(unsigned int from, unsigned int to, float maxError)
+	{
+		const double limit = (double)maxError * maxError;
+		double distance, worst = 0.0;
+		unsigned int point;
+
+		m_movedPoints.clear();
+		for (point = m_firstPoint[from]; point != s_noVertex; point = m_nextPoint[point])
+		{
+			distance = FanDistanceSquared(point, to, from, to);
+			if (distance > limit)
+			{
+				return false;
+			}
+			worst = std::max(worst, distance);
+		}
+
+		GatherNeighbours(from, m_neighboursFrom);
+		for (unsigned int neighbour : m_neighboursFrom)
+		{
+			for (point = m_firstPoint[neighbour]; point != s_noVertex; point = m_nextPoint[point])
+			{
+				distance = FanDistanceSquared(point, neighbour, from, to);
+				if (distance > limit && neighbour != to)
+				{
+					distance = FanDistanceSquared(point, to, from, to);
+					m_movedPoints.push_back(std::make_pair(point, neighbour));
+				}
+				if (distance > limit)
+				{
+					m_movedPoints.clear();
+					return false;
+				}
+				worst = std::max(worst, distance);
+			}
+		}
+
+		m_maxDistance = std::max(m_maxDistance, (float)sqrt(worst));
+
+		return true;
+	}
+
+	size_t Simplifier::Simplify(size_t targetIndexCount, float maxError)
+	{
+		std::vector<Collapse> collapses;
+		size_t targetTriangles = targetIndexCount / 3;
+		size_t triangle, applied, maxCollapses, next, i;
+		float costLimit, maxCost;
+		bool bounded, raised;
+		int corner;
+
+		// Costs are squared distances.
+		maxCost = maxError < sqrtf(FLT_MAX) ? maxError * maxError : FLT_MAX;
+		bounded = maxCost < FLT_MAX;
+		if (bounded && m_firstPoint.empty())
+		{
+			BuildPoints();
+		}
+
+		while (m_triangleCount > targetTriangles)
+		{
+			BuildAdjacency();
+			m_removed.assign(m_triangleCount, 0);
+			m_dirty.assign(m_mesh.vertexCount, 0);
+
+			// Both directions of every edge that can collapse, cheapest first.
+			collapses.clear();
+			for (triangle = 0; triangle < m_triangleCount; triangle++)
+			{
+				for (corner = 0; corner < 3; corner++)
+				{
+					unsigned int a = m_position[m_indices[triangle * 3 + corner]];
+					unsigned int b = m_position[m_indices[triangle * 3 + (corner + 1) % 3]];
+					Collapse collapse;
+
+					if (!m_locked[a] && CanCollapse(a, b))
+					{
+						collapse.from = a;
+						collapse.to = b;
+						collapse.cost = EvaluateQuadrics(m_quadrics[a], m_quadrics[b], GetPosition(b));
+						collapses.push_back(collapse);
+					}
+					if (!m_locked[b] && CanCollapse(b, a))
+					{
+						collapse.from = b;
+						collapse.to = a;
+						collapse.cost = EvaluateQuadrics(m_quadrics[a], m_quadrics[b], GetPosition(a));
+						collapses.push_back(collapse);
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end());
+
+			// A collapse removes two triangles. Anything next to a collapse waits for the next
+			// pass, its adjacency and validity are stale; the rest stays valid. Costs past the
+			// cheapest few are also left for a later pass, after the cheap ones around them.
+			maxCollapses = (m_triangleCount - targetTriangles + 1) / 2;
+			costLimit = collapses.empty() ? 0.0f : collapses[std::min(collapses.size() - 1, maxCollapses * s_passCostQuantile)].cost;
+			costLimit = std::min(costLimit, maxCost);
+			applied = 0;
+			do
+			{
+				for (i = 0; i < collapses.size() && applied < maxCollapses && collapses[i].cost <= costLimit; i++)
+				{
+					const Collapse& collapse = collapses[i];
+
+					if (m_dirty[collapse.from] || m_dirty[collapse.to])
+					{
+						continue;
+					}
+
+					// The seam map of this collapse, filled in again.
+					CanCollapse(collapse.from, collapse.to);
+					if (bounded && !StaysWithin(collapse.from, collapse.to, maxError))
+					{
+						continue;
+					}
+
+					ApplyCollapse(collapse.from, collapse.to, collapse.cost);
+					applied++;
+				}
+
+				// The cheap collapses can all move the surface too far while dearer ones do not.
+				raised = bounded && applied == 0 && costLimit < maxCost;
+				costLimit = maxCost;
+			} while (raised);
+
+			if (applied == 0)
+			{
+				break;
+			}
+
+			next = 0;
+			for (triangle = 0; triangle < m_triangleCount; triangle++)
+			{
+				if (!m_removed[triangle])
+				{
+					memmove(&m_indices[next * 3], &m_indices[triangle * 3], 3 * sizeof(unsigned int));
+					next++;
+				}
+			}
+			m_triangleCount = next;
+			m_indices.resize(m_triangleCount * 3);
+		}
+
+		return m_triangleCount * 3;
+	}
+}
+
+size_t SimplifyMesh(unsigned int* destination, const unsigned int* indices, size_t indexCount, const MeshData& mesh, size_t targetIndexCount, float* error)
+{
+	size_t count;
+
+	// Packed vertices have no float positions to measure against.
+	if (mesh.layout == MESH_LAYOUT_NORMALMAP_PACKED)
+	{
+		memmove(destination, indices, indexCount * sizeof(unsigned int));
+		if (error)
+		{
+			*error = 0.0f;
+		}
+		return indexCount;
+	}
+
+	Simplifier simplifier(mesh, indices, indexCount);
+	count = simplifier.Simplify(targetIndexCount);
+	memmove(destination, simplifier.GetIndices(), count * sizeof(unsigned int));
+	if (error)
+	{
+		*error = simplifier.GetError();
+	}
+
+	return count;
+}
+
+void GenerateLods(MeshData& mesh, unsigned int levelCount)
+{
+	MeshLod lod;
+	size_t baseCount, offset, count, target;
+	unsigned int level;
+
+	baseCount = mesh.indices.size();
+	mesh.lods.clear();
+	mesh.clusters.clear();
+	memset(&lod, 0, sizeof(lod));
+
+	lod.indexOffset = 0;
+	lod.indexCount = (unsigned int)baseCount;
+	lod.error = 0.0f;
+	mesh.lods.push_back(lod);
+
+	if (levelCount <= 1 || baseCount == 0 || mesh.layout == MESH_LAYOUT_NORMALMAP_PACKED)
+	{
+		return;
+	}
+
+	// One simplifier for the whole chain, so each level starts where the last one stopped and
+	// its error is measured against the full detail surface.
+	Simplifier simplifier(mesh, mesh.indices.data(), baseCount);
+	for (level = 1; level < levelCount; level++)
+	{
+		const MeshLod& previous = mesh.lods.back();
+
+		target = (size_t)(previous.indexCount / 3 * MESH_LOD_REDUCTION) * 3;
+		count = simplifier.Simplify(target);
+		if (count == 0 || count > previous.indexCount * s_minimumLodReduction)
+		{
+			break;
+		}
+
+		offset = mesh.indices.size();
+		mesh.indices.insert(mesh.indices.end(), simplifier.GetIndices(), simplifier.GetIndices() + count);
+		OptimizeVertexCache(&mesh.indices[offset], count, mesh.vertexCount);
+
+		lod.indexOffset = (unsigned int)offset;
+		lod.indexCount = (unsigned int)count;
+		lod.error = simplifier.GetError();
+		mesh.lods.push_back(lod);
+	}
+
+	return;
+}
+
+float BuildShadowProxy(MeshData& mesh, float maxError)
+{
+	size_t count;
+	float error;
+
+	mesh.lods.clear();
+	mesh.clusters.clear();
+	if (mesh.indices.empty() || maxError <= 0.0f || mesh.layout == MESH_LAYOUT_NORMALMAP_PACKED)
+	{
+		return 0.0f;
+	}
+
+	// No triangle count to aim for, only the error bound stops it.
+	Simplifier simplifier(mesh, mesh.indices.data(), mesh.indices.size());
+	count = simplifier.Simplify(0, maxError);
+	error = simplifier.GetError();
+	mesh.indices.assign(simplifier.GetIndices(), simplifier.GetIndices() + count);
+
+	// The collapsed vertices go too, which is where the vertex shader work is saved.
+	OptimizeVertexFetch(mesh);
+
+	return error;
+}
@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshSimplifier.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MESHSIMPLIFIER_H_
+#define _MESHSIMPLIFIER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include "MeshBuilder.h"
+
+// Each level aims for this fraction of the previous level's triangles.
+const float MESH_LOD_REDUCTION = 0.5f;
+
+// Texture coordinate seams and normals further apart than this are kept where they are.
+const float MESH_LOD_CREASE_DEGREES = 30.0f;
+
+// Shadow caster proxies may move their surface by up to half a texel of the scene's shadow map:
+// 2048 texels across the light's 1000 unit wide frustum, see Game::Initialize.
+const float MESH_SHADOW_PROXY_ERROR = 0.5f * 1000.0f / 2048.0f;
+
+// Quadric edge collapse simplification of a float layout mesh. Only the index array changes:
+// vertices are collapsed onto one of their neighbours, so the result draws with the mesh's own
+// vertex buffer. Open borders never move, and a vertex on a texture or normal seam may only slide
+// along that seam. Writes at most indexCount indices to destination and returns how many it
+// wrote, stopping at targetIndexCount or when nothing more can be collapsed. error receives the
+// largest distance, in model units, between the result and the planes of the input. May be
+// called with destination == indices.
+size_t SimplifyMesh(unsigned int* destination, const unsigned int* indices, size_t indexCount, const MeshData& mesh, size_t targetIndexCount, float* error);
+
+// Appends up to levelCount - 1 coarser levels to an indexed float layout mesh, each simplified
+// from the one before and ordered for the vertex cache, and fills mesh.lods. Stops early once a
+// level would no longer lose a meaningful share of the triangles.
+void GenerateLods(MeshData& mesh, unsigned int levelCount = MESH_MAX_LODS);
+
+// Replaces the triangles of an indexed float layout mesh with a simplified copy that no vertex of
+// the input is further than maxError model units from, drops the vertices it no longer uses and
+// puts the rest in first use order. Clears lods and clusters. Meant for the shadow map layout,
+// welded on positions alone, where texture and normal seams do not hold collapses back. Returns
+// how far from the result an input vertex may be, at most maxError.
+float BuildShadowProxy(MeshData& mesh, float maxError);
+
+#endif
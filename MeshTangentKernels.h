@@ -0,0 +1,280 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshTangentKernels.h
+////////////////////////////////////////////////////////////////////////////////
+
+// The tangent kernels of MeshBuilder.cpp, written once against FloatN and CornerN. MeshBuilder.cpp
+// includes this file once per lane width, each time in a namespace of its own that names the two
+// types, and for AVX2 and AVX-512 inside the pragmas that let the compiler use them. So there is no
+// include guard.
+
+// Triangles or vertices per FloatN.
+const size_t s_laneCount = sizeof(FloatN) / sizeof(float);
+
+inline FloatN Dot(FloatN ax, FloatN ay, FloatN az, FloatN bx, FloatN by, FloatN bz)
+{
+	return MulAdd(ax, bx, MulAdd(ay, by, az * bz));
+}
+
+// Largest error about 0.0001 radians, plenty for a weight.
+inline FloatN Acos(FloatN x)
+{
+	FloatN a = Min(Abs(x), Splat<FloatN>(1.0f));
+	FloatN p = MulAdd(a, Splat<FloatN>(-0.0187293f), Splat<FloatN>(0.0742610f));
+	FloatN r;
+
+	p = MulAdd(a, p, Splat<FloatN>(-0.2121144f));
+	p = MulAdd(a, p, Splat<FloatN>(1.5707288f));
+	r = Sqrt(Splat<FloatN>(1.0f) - a) * p;
+
+	return Select(Less(x, Splat<FloatN>(0.0f)), Splat<FloatN>(3.14159265f) - r, r);
+}
+
+// Tangent, binormal, corner angles and handedness of the s_laneCount triangles in indices, written
+// to block at face. A triangle without area in either space gets no weight, rather than the NaNs
+// dividing by its texture space area would give.
+inline void CalculateFaceTangents(const MeshVertexNM* vertices, const unsigned int* indices, TangentBlock& block, size_t face)
+{
+	const FloatN tiny = Splat<FloatN>(1e-20f);
+	const FloatN zero = Splat<FloatN>(0.0f);
+	const FloatN one = Splat<FloatN>(1.0f);
+	CornerN c0, c1, c2;
+	FloatN p0x, p0y, p0z, e1x, e1y, e1z, e2x, e2y, e2z, e3x, e3y, e3z, u0, v0, du1, dv1, du2, dv2;
+	FloatN area, sign, tx, ty, tz, bx, by, bz, tLength, bLength, l1, l2, l3, valid, scale;
+
+	LoadCorner(vertices, indices, 0, c0);
+	LoadCorner(vertices, indices, 1, c1);
+	LoadCorner(vertices, indices, 2, c2);
+	p0x = Gather(c0, 0);
+	p0y = Gather(c0, 1);
+	p0z = Gather(c0, 2);
+	e1x = Gather(c1, 0) - p0x;
+	e1y = Gather(c1, 1) - p0y;
+	e1z = Gather(c1, 2) - p0z;
+	e2x = Gather(c2, 0) - p0x;
+	e2y = Gather(c2, 1) - p0y;
+	e2z = Gather(c2, 2) - p0z;
+	u0 = Gather(c0, 3);
+	v0 = Gather(c0, 4);
+	du1 = Gather(c1, 3) - u0;
+	dv1 = Gather(c1, 4) - v0;
+	du2 = Gather(c2, 3) - u0;
+	dv2 = Gather(c2, 4) - v0;
+	e3x = e2x - e1x;
+	e3y = e2y - e1y;
+	e3z = e2z - e1z;
+
+	// Only the sign of the texture space area survives normalising, so it is never divided by.
+	area = du1 * dv2 - du2 * dv1;
+	sign = Select(Less(area, zero), Splat<FloatN>(-1.0f), one);
+	StoreHandedness(&block.handedness[face], area);
+
+	tx = (dv2 * e1x - dv1 * e2x) * sign;
+	ty = (dv2 * e1y - dv1 * e2y) * sign;
+	tz = (dv2 * e1z - dv1 * e2z) * sign;
+	bx = (du1 * e2x - du2 * e1x) * sign;
+	by = (du1 * e2y - du2 * e1y) * sign;
+	bz = (du1 * e2z - du2 * e1z) * sign;
+
+	tLength = Dot(tx, ty, tz, tx, ty, tz);
+	bLength = Dot(bx, by, bz, bx, by, bz);
+	l1 = Dot(e1x, e1y, e1z, e1x, e1y, e1z);
+	l2 = Dot(e2x, e2y, e2z, e2x, e2y, e2z);
+	l3 = Dot(e3x, e3y, e3z, e3x, e3y, e3z);
+	valid = And(And(Less(tiny, Abs(area)), And(Less(tiny, tLength), Less(tiny, bLength))),
+		And(Less(tiny, l1), And(Less(tiny, l2), Less(tiny, l3))));
+
+	// Invalid lanes are pushed away from zero before the reciprocals and zeroed afterwards.
+	tLength = InverseSqrt(Max(tLength, tiny));
+	bLength = InverseSqrt(Max(bLength, tiny));
+
+	StoreFrames(&block.frames[face * s_frameFloats + 2], s_frameFloats, tx * tLength, ty * tLength, tz * tLength, bx * bLength, by * bLength,
+		bz * bLength);
+
+	// Angle at each corner, between the two edges that meet there.
+	scale = InverseSqrt(Max(l1 * l2, tiny));
+	Store(block.weights[0] + face, Keep(valid, Acos(Dot(e1x, e1y, e1z, e2x, e2y, e2z) * scale)));
+	scale = InverseSqrt(Max(l1 * l3, tiny));
+	Store(block.weights[1] + face, Keep(valid, Acos((zero - Dot(e1x, e1y, e1z, e3x, e3y, e3z)) * scale)));
+	scale = InverseSqrt(Max(l2 * l3, tiny));
+	Store(block.weights[2] + face, Keep(valid, Acos(Dot(e2x, e2y, e2z, e3x, e3y, e3z) * scale)));
+
+	return;
+}
+
+// Adds the frames of count triangles, at most s_tangentBlockSize, to the vertices in targets, each
+// weighted by the angle the triangle spans at that corner; indices are the corners the frames are
+// made from. Lanes past the last triangle repeat one vertex, which is degenerate and weighs nothing.
+// Vertices from zeroed up to the largest target are zeroed first, while the block has them in
+// cache; none of them has been added to yet, whatever the index order.
+void SumBlockTangents(MeshVertexNM* vertices, const unsigned int* indices, const unsigned int* targets, size_t count, TangentBlock& block,
+	unsigned int& zeroed)
+{
+	unsigned int tail[s_laneCount * 3];
+	const unsigned int* corners;
+	unsigned int highest = 0, top, target;
+	size_t i;
+	int corner;
+
+	for (i = 0; i < count; i += s_laneCount)
+	{
+		corners = &indices[i * 3];
+		if (count - i < s_laneCount)
+		{
+			std::fill(tail, tail + s_laneCount * 3, indices[0]);
+			std::copy(&indices[i * 3], &indices[count * 3], tail);
+			corners = tail;
+		}
+		CalculateFaceTangents(vertices, corners, block, i);
+	}
+
+	for (i = 0; i < count * 3; i++)
+	{
+		highest = std::max(highest, targets[i]);
+	}
+	top = std::max(zeroed, highest + 1);
+
+	for (target = zeroed; target < top; target++)
+	{
+		ClearFrame<FloatN>(vertices[target].tangent);
+	}
+	zeroed = top;
+
+	for (i = 0; i < count; i++)
+	{
+		for (corner = 0; corner < 3; corner++)
+		{
+			target = targets[i * 3 + corner];
+			AddFrame(vertices[target].tangent, &block.frames[i * s_frameFloats], Splat<FloatN>(block.weights[corner][i]));
+		}
+	}
+
+	return;
+}
+
+// Smallest of count indices.
+unsigned int LowestIndex(const unsigned int* indices, size_t count)
+{
+	unsigned int lowest = 0xffffffffu;
+	size_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		lowest = std::min(lowest, indices[i]);
+	}
+
+	return lowest;
+}
+
+// Turns the summed tangents of s_laneCount vertices into orthonormal frames around their normals.
+// The binormal is rebuilt from normal and tangent and only keeps the summed binormal's side.
+inline void OrthonormalizeTangents(MeshVertexNM* v)
+{
+	const FloatN tiny = Splat<FloatN>(1e-12f);
+	const FloatN zero = Splat<FloatN>(0.0f);
+	const FloatN one = Splat<FloatN>(1.0f);
+	FloatN n[3], t[3], b[3], nx, ny, nz, tx, ty, tz, length, d, ax, ay, cx, cy, cz, sign, valid, useAxis;
+
+	LoadVertexFrames(v, n, t, b);
+
+	length = Dot(n[0], n[1], n[2], n[0], n[1], n[2]);
+	valid = Less(tiny, length);
+	length = InverseSqrt(Max(length, tiny));
+	nx = Keep(valid, n[0] * length);
+	ny = Select(valid, n[1] * length, one);
+	nz = Keep(valid, n[2] * length);
+
+	// Gram-Schmidt against the normal.
+	d = zero - Dot(nx, ny, nz, t[0], t[1], t[2]);
+	tx = MulAdd(nx, d, t[0]);
+	ty = MulAdd(ny, d, t[1]);
+	tz = MulAdd(nz, d, t[2]);
+
+	// Nothing usable summed (only degenerate faces, or tangents that cancelled): any direction
+	// in the tangent plane, starting from the x axis unless the normal is close to it.
+	length = Dot(tx, ty, tz, tx, ty, tz);
+	useAxis = Less(length, tiny);
+	ax = Keep(Less(Abs(nx), Splat<FloatN>(0.9f)), one);
+	ay = one - ax;
+	d = zero - MulAdd(nx, ax, ny * ay);
+	tx = Select(useAxis, MulAdd(nx, d, ax), tx);
+	ty = Select(useAxis, MulAdd(ny, d, ay), ty);
+	tz = Select(useAxis, nz * d, tz);
+	length = InverseSqrt(Max(Dot(tx, ty, tz, tx, ty, tz), tiny));
+	tx = tx * length;
+	ty = ty * length;
+	tz = tz * length;
+
+	cx = MulSub(ny, tz, nz * ty);
+	cy = MulSub(nz, tx, nx * tz);
+	cz = MulSub(nx, ty, ny * tx);
+	sign = Select(Less(Dot(cx, cy, cz, b[0], b[1], b[2]), zero), Splat<FloatN>(-1.0f), one);
+
+	StoreFrames(v[0].tangent, s_vertexFloats, tx, ty, tz, cx * sign, cy * sign, cz * sign);
+
+	return;
+}
+
+// s_laneCount vertices at a time, the last few through a zeroed copy.
+void OrthonormalizeVertices(MeshVertexNM* vertices, size_t count)
+{
+	MeshVertexNM tail[s_laneCount];
+	MeshVertexNM* v;
+	size_t index;
+
+	for (index = 0; index < count; index += s_laneCount)
+	{
+		v = &vertices[index];
+		if (count - index < s_laneCount)
+		{
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, v, (count - index) * sizeof(MeshVertexNM));
+			v = tail;
+		}
+		OrthonormalizeTangents(v);
+		if (v == tail)
+		{
+			memcpy(&vertices[index], tail, (count - index) * sizeof(MeshVertexNM));
+		}
+	}
+
+	return;
+}
+
+// Appends to faces each of count triangles with handedness side and a corner marked in sides,
+// which has three bytes to spare past the last vertex.
+void FindMarkedFaces(const unsigned int* indices, const signed char* handedness, const unsigned char* sides, size_t count, signed char side,
+	std::vector<unsigned int>& faces)
+{
+	unsigned int tail[s_laneCount * 3];
+	signed char tailHandedness[s_laneCount];
+	const unsigned int* corners;
+	const signed char* hands;
+	size_t i;
+	int mask, lane;
+
+	for (i = 0; i < count; i += s_laneCount)
+	{
+		corners = &indices[i * 3];
+		hands = &handedness[i];
+		if (count - i < s_laneCount)
+		{
+			std::fill(tail, tail + s_laneCount * 3, indices[0]);
+			std::copy(&indices[i * 3], &indices[count * 3], tail);
+			std::fill(tailHandedness, tailHandedness + s_laneCount, 0);
+			std::copy(&handedness[i], &handedness[count], tailHandedness);
+			corners = tail;
+			hands = tailHandedness;
+		}
+
+		mask = MarkedFaces<FloatN>(corners, hands, sides, side);
+		for (lane = 0; mask != 0; lane++, mask >>= 1)
+		{
+			if ((mask & 1) != 0)
+			{
+				faces.push_back((unsigned int)(i + lane));
+			}
+		}
+	}
+
+	return;
+}
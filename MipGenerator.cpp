@@ -0,0 +1,383 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MipGenerator.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MIP_GENERATOR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Output rows per task. Each band filters the source rows it needs itself, so the rows shared
+	// with the next band (the column filter's reach) are filtered twice.
+	const uint32_t s_bandRows = 32;
+
+	const float s_kaiserAlpha = 4.0f;
+	const float s_kaiserRadius = 3.0f;		// in output pixels
+
+	// Linear to sRGB through a table this fine is within rounding of the exact curve even near black.
+	const uint32_t s_encodeTableSize = 1 << 16;
+
+	// For each output pixel along one axis, the first source pixel it reads and the weights of the
+	// ones from there on, stride per output pixel.
+	struct Taps
+	{
+		std::vector<uint32_t> first;
+		std::vector<uint32_t> count;
+		std::vector<float> weights;
+		uint32_t stride;
+	};
+
+	struct Tables
+	{
+		float decode[2][256];					// byte to linear, [gamma corrected]
+		std::unique_ptr<uint8_t[]> encode;		// linear, scaled to s_encodeTableSize - 1, to sRGB byte
+
+		Tables() : encode(new uint8_t[s_encodeTableSize])
+		{
+			uint32_t i;
+
+			for (i = 0; i < 256; i++)
+			{
+				float value = i / 255.0f;
+
+				decode[0][i] = value;
+				decode[1][i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+			}
+
+			for (i = 0; i < s_encodeTableSize; i++)
+			{
+				float value = i / (float)(s_encodeTableSize - 1);
+
+				value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+				encode[i] = (uint8_t)std::min(255.0f, std::floor(value * 255.0f + 0.5f));
+			}
+		}
+	};
+
+	const Tables& GetTables()
+	{
+		static const Tables tables;
+
+		return tables;
+	}
+
+	float BesselI0(float x)
+	{
+		float sum = 1.0f, term = 1.0f, quarter = x * x * 0.25f;
+		int k;
+
+		for (k = 1; k < 32 && term > sum * 1e-8f; k++)
+		{
+			term *= quarter / (float)(k * k);
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	float Kaiser(float x)
+	{
+		float sinc = 1.0f, ratio = x / s_kaiserRadius;
+
+		if (std::fabs(ratio) >= 1.0f)
+		{
+			return 0.0f;
+		}
+		if (x != 0.0f)
+		{
+			sinc = std::sin(3.14159265f * x) / (3.14159265f * x);
+		}
+
+		return sinc * BesselI0(s_kaiserAlpha * std::sqrt(1.0f - ratio * ratio)) / BesselI0(s_kaiserAlpha);
+	}
+
+	void BuildTaps(uint32_t sourceSize, uint32_t destinationSize, MipFilter filter, Taps& taps)
+	{
+		float scale = (float)sourceSize / (float)destinationSize;
+		bool box = filter == MIP_FILTER_BOX || sourceSize == destinationSize;
+		int reach = (int)std::ceil(s_kaiserRadius * scale);
+		uint32_t i, j;
+
+		taps.stride = box ? (uint32_t)std::ceil(scale) + 1 : (uint32_t)(2 * reach + 1);
+		taps.first.resize(destinationSize);
+		taps.count.resize(destinationSize);
+		taps.weights.assign((size_t)destinationSize * taps.stride, 0.0f);
+
+		for (i = 0; i < destinationSize; i++)
+		{
+			float* weights = &taps.weights[(size_t)i * taps.stride];
+			float sum = 0.0f;
+			uint32_t last;
+
+			if (box)
+			{
+				// How much of each source pixel the output pixel covers.
+				float start = i * scale, end = (i + 1) * scale;
+
+				taps.first[i] = (uint32_t)start;
+				for (j = taps.first[i]; j < sourceSize && (float)j < end; j++)
+				{
+					weights[j - taps.first[i]] = std::min(end, (float)j + 1.0f) - std::max(start, (float)j);
+				}
+				last = j;
+			}
+			else
+			{
+				// Sampled at source pixel centres in output pixel units; taps past the edges read the edge pixel.
+				float centre = (i + 0.5f) * scale;
+				int low = (int)std::floor(centre) - reach, high = (int)std::floor(centre) + reach, tap;
+
+				taps.first[i] = (uint32_t)std::max(low, 0);
+				last = (uint32_t)std::min(high, (int)sourceSize - 1) + 1;
+				for (tap = low; tap <= high; tap++)
+				{
+					weights[std::min(std::max(tap, 0), (int)sourceSize - 1) - (int)taps.first[i]] += Kaiser(((float)tap + 0.5f - centre) / scale);
+				}
+			}
+
+			taps.count[i] = last - taps.first[i];
+			for (j = 0; j < taps.count[i]; j++)
+			{
+				sum += weights[j];
+			}
+			for (j = 0; j < taps.count[i]; j++)
+			{
+				weights[j] /= sum;
+			}
+		}
+	}
+
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+		uint8_t* bytes;
+		std::vector<float> linear;	// RGBA per pixel; empty for level 0, read from its bytes
+	};
+
+	void DecodeRow(const uint8_t* bytes, uint32_t width, bool gammaCorrect, float* row)
+	{
+		const Tables& tables = GetTables();
+		const float* colour = tables.decode[gammaCorrect ? 1 : 0];
+		uint32_t x;
+
+		for (x = 0; x < width; x++)
+		{
+			row[x * 4] = colour[bytes[x * 4]];
+			row[x * 4 + 1] = colour[bytes[x * 4 + 1]];
+			row[x * 4 + 2] = colour[bytes[x * 4 + 2]];
+			row[x * 4 + 3] = tables.decode[0][bytes[x * 4 + 3]];
+		}
+	}
+
+	void EncodeRow(const float* row, uint32_t width, bool gammaCorrect, uint8_t* bytes)
+	{
+		const uint8_t* encode = GetTables().encode.get();
+		const float tableScale = (float)(s_encodeTableSize - 1);
+		uint32_t x, c;
+
+		for (x = 0; x < width; x++)
+		{
+			for (c = 0; c < 4; c++)
+			{
+				float value = std::min(1.0f, std::max(0.0f, row[x * 4 + c]));
+
+				bytes[x * 4 + c] = (gammaCorrect && c < 3) ? encode[(uint32_t)(value * tableScale + 0.5f)] : (uint8_t)(value * 255.0f + 0.5f);
+			}
+		}
+	}
+
+	// One row through the horizontal taps, a pixel (four channels) at a time.
+	void FilterRow(const float* source, const Taps& taps, uint32_t width, float* destination)
+	{
+		uint32_t x, k;
+
+		for (x = 0; x < width; x++)
+		{
+			const float* in = source + (size_t)taps.first[x] * 4;
+			const float* weights = &taps.weights[(size_t)x * taps.stride];
+
+#ifdef MIP_GENERATOR_SSE
+			__m128 sum = _mm_setzero_ps();
+
+			for (k = 0; k < taps.count[x]; k++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + k * 4), _mm_set1_ps(weights[k])));
+			}
+			_mm_storeu_ps(destination + x * 4, sum);
+#else
+			float sum[4] = {};
+
+			for (k = 0; k < taps.count[x]; k++)
+			{
+				sum[0] += in[k * 4] * weights[k];
+				sum[1] += in[k * 4 + 1] * weights[k];
+				sum[2] += in[k * 4 + 2] * weights[k];
+				sum[3] += in[k * 4 + 3] * weights[k];
+			}
+			memcpy(destination + x * 4, sum, sizeof(sum));
+#endif
+		}
+	}
+
+	// Adds weight times a row of width pixels into sum.
+	void AccumulateRow(const float* row, float weight, uint32_t width, float* sum)
+	{
+		size_t i = 0, count = (size_t)width * 4;
+
+#ifdef MIP_GENERATOR_SSE
+		__m128 scale = _mm_set1_ps(weight);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(_mm_loadu_ps(row + i), scale)));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			sum[i] += row[i] * weight;
+		}
+	}
+
+	// Output rows [firstRow, lastRow) of destination: the source rows they reach filtered across into
+	// a scratch band, then down.
+	void FilterBand(const Level& source, Level& destination, const Taps& horizontal, const Taps& vertical, bool gammaCorrect, bool keepLinear,
+		uint32_t firstRow, uint32_t lastRow)
+	{
+		uint32_t sourceFirst = vertical.first[firstRow], sourceLast = sourceFirst, y, k;
+		std::vector<float> decoded, band, sum((size_t)destination.width * 4);
+
+		for (y = firstRow; y < lastRow; y++)
+		{
+			sourceLast = std::max(sourceLast, vertical.first[y] + vertical.count[y]);
+		}
+
+		band.resize((size_t)(sourceLast - sourceFirst) * destination.width * 4);
+		if (source.linear.empty())
+		{
+			decoded.resize((size_t)source.width * 4);
+		}
+
+		for (y = sourceFirst; y < sourceLast; y++)
+		{
+			const float* row;
+
+			if (source.linear.empty())
+			{
+				DecodeRow(source.bytes + (size_t)y * source.width * 4, source.width, gammaCorrect, decoded.data());
+				row = decoded.data();
+			}
+			else
+			{
+				row = &source.linear[(size_t)y * source.width * 4];
+			}
+
+			FilterRow(row, horizontal, destination.width, &band[(size_t)(y - sourceFirst) * destination.width * 4]);
+		}
+
+		for (y = firstRow; y < lastRow; y++)
+		{
+			const float* weights = &vertical.weights[(size_t)y * vertical.stride];
+
+			std::fill(sum.begin(), sum.end(), 0.0f);
+			for (k = 0; k < vertical.count[y]; k++)
+			{
+				AccumulateRow(&band[(size_t)(vertical.first[y] + k - sourceFirst) * destination.width * 4], weights[k], destination.width, sum.data());
+			}
+
+			if (keepLinear)
+			{
+				memcpy(&destination.linear[(size_t)y * destination.width * 4], sum.data(), sum.size() * sizeof(float));
+			}
+			EncodeRow(sum.data(), destination.width, gammaCorrect, destination.bytes + (size_t)y * destination.width * 4);
+		}
+	}
+}
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1, size = std::max(width, height);
+
+	while (size > 1)
+	{
+		size >>= 1;
+		count++;
+	}
+
+	return count;
+}
+
+bool GenerateMips(uint8_t* const* levels, uint32_t itemCount, uint32_t width, uint32_t height, uint32_t levelCount, MipFilter filter, bool gammaCorrect,
+	TaskPool* tasks)
+{
+	std::vector<Level> previous(itemCount), current(itemCount);
+	Taps horizontal, vertical;
+	uint32_t level, item, row;
+
+	if (width == 0 || height == 0 || levelCount > GetMipLevelCount(width, height))
+	{
+		return false;
+	}
+
+	GetTables();
+
+	for (item = 0; item < itemCount; item++)
+	{
+		previous[item].width = width;
+		previous[item].height = height;
+		previous[item].bytes = levels[item * levelCount];
+	}
+
+	for (level = 1; level < levelCount; level++)
+	{
+		uint32_t levelWidth = std::max(1u, width >> level), levelHeight = std::max(1u, height >> level);
+		bool keepLinear = level + 1 < levelCount;
+
+		BuildTaps(previous[0].width, levelWidth, filter, horizontal);
+		BuildTaps(previous[0].height, levelHeight, filter, vertical);
+
+		for (item = 0; item < itemCount; item++)
+		{
+			current[item].width = levelWidth;
+			current[item].height = levelHeight;
+			current[item].bytes = levels[item * levelCount + level];
+			current[item].linear.resize(keepLinear ? (size_t)levelWidth * levelHeight * 4 : 0);
+		}
+
+		for (item = 0; item < itemCount; item++)
+		{
+			for (row = 0; row < levelHeight; row += s_bandRows)
+			{
+				const Level& source = previous[item];
+				Level& destination = current[item];
+				uint32_t lastRow = std::min(row + s_bandRows, levelHeight);
+
+				if (tasks)
+				{
+					tasks->Run([&, row, lastRow]() { FilterBand(source, destination, horizontal, vertical, gammaCorrect, keepLinear, row, lastRow); });
+				}
+				else
+				{
+					FilterBand(source, destination, horizontal, vertical, gammaCorrect, keepLinear, row, lastRow);
+				}
+			}
+		}
+		if (tasks)
+		{
+			tasks->Wait();
+		}
+
+		previous.swap(current);
+	}
+
+	return true;
+}
@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MipGenerator.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _MIPGENERATOR_H_
+#define _MIPGENERATOR_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include "TaskPool.h"
+
+// Builds the mip chain of 8 bit RGBA textures on the CPU. Each level is filtered from the one above
+// it, kept in linear light as floats between levels so rounding does not build up down the chain,
+// with a separable filter: a row pass, then a column pass over the rows it produced. One pixel's
+// four channels are one SSE register where there is SSE2.
+//
+//   MIP_FILTER_BOX     the average of the pixels each output pixel covers, the classic 2x2 box for
+//                      even sizes and area weighted for odd ones.
+//   MIP_FILTER_KAISER  a Kaiser windowed sinc three output pixels wide, sharper than the box at the
+//                      cost of a few times the taps; results are clamped, as its negative lobes can
+//                      ring past the source's range.
+//
+// Gamma correct filtering decodes the colour channels from sRGB before filtering and encodes the
+// result again; alpha is always filtered as it is.
+enum MipFilter
+{
+	MIP_FILTER_BOX,
+	MIP_FILTER_KAISER,
+};
+
+// Levels in a full chain, down to 1x1.
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+// levels[item * levelCount + level] is item's level, (width >> level) x (height >> level) pixels
+// (at least 1), in rows with no padding. Level 0 of each item is read and every other level written.
+// tasks, when given, filters bands of rows of every item at once and waits for them; call it from
+// outside the pool's tasks. Each level needs the whole of the one above, so levels go one by one.
+bool GenerateMips(uint8_t* const* levels, uint32_t itemCount, uint32_t width, uint32_t height, uint32_t levelCount, MipFilter filter, bool gammaCorrect,
+	TaskPool* tasks = nullptr);
+
+#endif
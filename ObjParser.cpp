@@ -0,0 +1,623 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: ObjParser.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "ObjParser.h"
+#include "MappedFile.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace
+{
+	enum ObjLineType
+	{
+		OBJ_LINE_OTHER,
+		OBJ_LINE_POSITION,
+		OBJ_LINE_TEXCOORD,
+		OBJ_LINE_NORMAL,
+		OBJ_LINE_FACE
+	};
+
+	// Number of each element found in (or written so far to) a range of the file.
+	struct ObjCounts
+	{
+		size_t positions;
+		size_t texCoords;
+		size_t normals;
+		size_t triangles;
+	};
+
+	// Powers of ten that are exactly representable as a double.
+	const double s_powersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return (unsigned char)(c - '0') < 10;
+	}
+
+	inline const char* SkipBlanks(const char* p, const char* end)
+	{
+		while (p < end && IsBlank(*p))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	inline const char* FindLineEnd(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline : end;
+	}
+
+	// Identifies the keyword at the start of a line and moves p past it.
+	ObjLineType ClassifyLine(const char*& p, const char* lineEnd)
+	{
+		p = SkipBlanks(p, lineEnd);
+
+		if (lineEnd - p < 2)
+		{
+			return OBJ_LINE_OTHER;
+		}
+
+		if (p[0] == 'v')
+		{
+			if (IsBlank(p[1]))
+			{
+				p += 1;
+				return OBJ_LINE_POSITION;
+			}
+			if (lineEnd - p >= 3 && IsBlank(p[2]))
+			{
+				if (p[1] == 't')
+				{
+					p += 2;
+					return OBJ_LINE_TEXCOORD;
+				}
+				if (p[1] == 'n')
+				{
+					p += 2;
+					return OBJ_LINE_NORMAL;
+				}
+			}
+		}
+		else if (p[0] == 'f' && IsBlank(p[1]))
+		{
+			p += 1;
+			return OBJ_LINE_FACE;
+		}
+
+		return OBJ_LINE_OTHER;
+	}
+
+	// Number of "v/vt/vn" groups on a face line. Every group carries exactly two slashes,
+	// which is much cheaper to count than splitting the line into tokens. A trailing comment
+	// ends the count, so slashes inside it are not taken for corners.
+	size_t CountCorners(const char* p, const char* lineEnd)
+	{
+		size_t slashes = 0;
+
+		for (; p < lineEnd && *p != '#'; p++)
+		{
+			slashes += (*p == '/');
+		}
+
+		return slashes / 2;
+	}
+
+	// Decimal to float conversion. Short mantissas with small exponents are exact in a double,
+	// so a single multiply or divide gives the same result as the C runtime. Anything longer
+	// falls back to strtof.
+	bool ParseFloat(const char*& p, const char* lineEnd, float& value)
+	{
+		const char* start;
+		uint64_t mantissa = 0;
+		int significantDigits = 0;
+		int exponent = 0;
+		bool negative = false;
+		bool truncated = false;
+		bool anyDigits = false;
+
+		p = SkipBlanks(p, lineEnd);
+		start = p;
+
+		if (p < lineEnd && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			p++;
+		}
+
+		// Integer part.
+		while (p < lineEnd && IsDigit(*p))
+		{
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0)
+				{
+					significantDigits++;
+				}
+			}
+			else
+			{
+				exponent++;
+				truncated = true;
+			}
+			anyDigits = true;
+			p++;
+		}
+
+		// Fractional part.
+		if (p < lineEnd && *p == '.')
+		{
+			p++;
+			while (p < lineEnd && IsDigit(*p))
+			{
+				if (significantDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0)
+					{
+						significantDigits++;
+					}
+					exponent--;
+				}
+				else
+				{
+					truncated = true;
+				}
+				anyDigits = true;
+				p++;
+			}
+		}
+
+		if (!anyDigits)
+		{
+			return false;
+		}
+
+		// Exponent.
+		if (p < lineEnd && (*p == 'e' || *p == 'E'))
+		{
+			const char* q = p + 1;
+			bool negativeExponent = false;
+			int explicitExponent = 0;
+
+			if (q < lineEnd && (*q == '-' || *q == '+'))
+			{
+				negativeExponent = (*q == '-');
+				q++;
+			}
+
+			if (q < lineEnd && IsDigit(*q))
+			{
+				while (q < lineEnd && IsDigit(*q))
+				{
+					if (explicitExponent < 10000)
+					{
+						explicitExponent = explicitExponent * 10 + (*q - '0');
+					}
+					q++;
+				}
+				exponent += negativeExponent ? -explicitExponent : explicitExponent;
+				p = q;
+			}
+		}
+
+		if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+		{
+			double result = (double)mantissa;
+
+			if (exponent < 0)
+			{
+				result /= s_powersOfTen[-exponent];
+			}
+			else
+			{
+				result *= s_powersOfTen[exponent];
+			}
+
+			value = (float)(negative ? -result : result);
+			return true;
+		}
+
+		std::string token(start, p);
+		value = strtof(token.c_str(), 0);
+
+		return true;
+	}
+
+	// A reference past INT_MAX cannot point at anything in a file the game loads, so it fails the
+	// line like any other malformed index rather than overflowing.
+	bool ParseIndex(const char*& p, const char* lineEnd, long long& value)
+	{
+		bool negative = false;
+		int digit;
+
+		if (p < lineEnd && *p == '-')
+		{
+			negative = true;
+			p++;
+		}
+
+		if (p == lineEnd || !IsDigit(*p))
+		{
+			return false;
+		}
+
+		value = 0;
+		while (p < lineEnd && IsDigit(*p))
+		{
+			digit = *p - '0';
+			if (value > (INT_MAX - digit) / 10)
+			{
+				return false;
+			}
+			value = value * 10 + digit;
+			p++;
+		}
+
+		if (negative)
+		{
+			value = -value;
+		}
+
+		return true;
+	}
+
+	// Converts a one-based (or negative, relative) .obj index to a zero-based one.
+	bool ResolveIndex(long long index, size_t definedSoFar, size_t total, unsigned int& resolved)
+	{
+		long long zeroBased;
+
+		if (index > 0)
+		{
+			zeroBased = index - 1;
+		}
+		else if (index < 0)
+		{
+			zeroBased = (long long)definedSoFar + index;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (zeroBased < 0 || zeroBased >= (long long)total)
+		{
+			return false;
+		}
+
+		resolved = (unsigned int)zeroBased;
+		return true;
+	}
+
+	// Reads one "v/vt/vn" group. Texture coordinates and normals are required by every
+	// vertex layout the game builds, so groups without them are rejected.
+	bool ParseCorner(const char*& p, const char* lineEnd, const ObjCounts& cursor, const ObjCounts& totals, unsigned int corner[3])
+	{
+		long long position, texCoord, normal;
+
+		p = SkipBlanks(p, lineEnd);
+
+		if (!ParseIndex(p, lineEnd, position) || p == lineEnd || *p != '/')
+		{
+			return false;
+		}
+		p++;
+
+		if (!ParseIndex(p, lineEnd, texCoord) || p == lineEnd || *p != '/')
+		{
+			return false;
+		}
+		p++;
+
+		if (!ParseIndex(p, lineEnd, normal))
+		{
+			return false;
+		}
+
+		return ResolveIndex(position, cursor.positions, totals.positions, corner[0]) &&
+			ResolveIndex(texCoord, cursor.texCoords, totals.texCoords, corner[1]) &&
+			ResolveIndex(normal, cursor.normals, totals.normals, corner[2]);
+	}
+
+	void CountLines(const char* p, const char* end, ObjCounts& counts)
+	{
+		memset(&counts, 0, sizeof(counts));
+
+		while (p < end)
+		{
+			const char* lineEnd = FindLineEnd(p, end);
+			const char* q = p;
+
+			switch (ClassifyLine(q, lineEnd))
+			{
+			case OBJ_LINE_POSITION:
+				counts.positions++;
+				break;
+			case OBJ_LINE_TEXCOORD:
+				counts.texCoords++;
+				break;
+			case OBJ_LINE_NORMAL:
+				counts.normals++;
+				break;
+			case OBJ_LINE_FACE:
+			{
+				size_t corners = CountCorners(q, lineEnd);
+				if (corners >= 3)
+				{
+					counts.triangles += corners - 2;
+				}
+				break;
+			}
+			default:
+				break;
+			}
+
+			p = (lineEnd < end) ? lineEnd + 1 : end;
+		}
+	}
+
+	// Parses every line in [p, end) into the pre-sized arrays of the mesh, starting at the
+	// element offsets held in cursor.
+	bool ParseLines(const char* p, const char* end, ObjMesh& mesh, ObjCounts& cursor, const ObjCounts& totals)
+	{
+		while (p < end)
+		{
+			const char* lineEnd = FindLineEnd(p, end);
+			const char* q = p;
+
+			switch (ClassifyLine(q, lineEnd))
+			{
+			case OBJ_LINE_POSITION:
+			{
+				ObjMesh::Float3& position = mesh.positions[cursor.positions++];
+				if (!ParseFloat(q, lineEnd, position.x) || !ParseFloat(q, lineEnd, position.y) || !ParseFloat(q, lineEnd, position.z))
+				{
+					return false;
+				}
+				break;
+			}
+			case OBJ_LINE_TEXCOORD:
+			{
+				ObjMesh::Float2& texCoord = mesh.texCoords[cursor.texCoords++];
+				if (!ParseFloat(q, lineEnd, texCoord.x) || !ParseFloat(q, lineEnd, texCoord.y))
+				{
+					return false;
+				}
+				break;
+			}
+			case OBJ_LINE_NORMAL:
+			{
+				ObjMesh::Float3& normal = mesh.normals[cursor.normals++];
+				if (!ParseFloat(q, lineEnd, normal.x) || !ParseFloat(q, lineEnd, normal.y) || !ParseFloat(q, lineEnd, normal.z))
+				{
+					return false;
+				}
+				break;
+			}
+			case OBJ_LINE_FACE:
+			{
+				unsigned int first[3], previous[3], current[3];
+				size_t corners = CountCorners(q, lineEnd);
+				size_t parsed;
+
+				if (corners < 3)
+				{
+					// Parser error, or not triangle faces
+					return false;
+				}
+
+				if (!ParseCorner(q, lineEnd, cursor, totals, first) || !ParseCorner(q, lineEnd, cursor, totals, previous))
+				{
+					return false;
+				}
+
+				// Fan triangulate anything with more than three corners.
+				for (parsed = 2; parsed < corners; parsed++)
+				{
+					if (!ParseCorner(q, lineEnd, cursor, totals, current))
+					{
+						return false;
+					}
+
+					unsigned int* face = &mesh.faces[cursor.triangles * 9];
+					memcpy(face + 0, first, sizeof(first));
+					memcpy(face + 3, previous, sizeof(previous));
+					memcpy(face + 6, current, sizeof(current));
+					memcpy(previous, current, sizeof(current));
+					cursor.triangles++;
+				}
+
+				// Anything left over means the line did not match the slash count it was sized from.
+				q = SkipBlanks(q, lineEnd);
+				if (q != lineEnd && *q != '#')
+				{
+					return false;
+				}
+				break;
+			}
+			default:
+				break;
+			}
+
+			p = (lineEnd < end) ? lineEnd + 1 : end;
+		}
+
+		return true;
+	}
+
+	// Files are only split when every thread gets at least this much text, below that the
+	// thread start-up costs more than it saves.
+	const size_t s_minChunkSize = 256 * 1024;
+
+	// A newline aligned slice of the file, with its element counts and its offsets into the
+	// arrays of the whole mesh.
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+		ObjCounts counts;
+		ObjCounts cursor;
+		bool succeeded;
+	};
+
+	void SplitIntoChunks(const char* data, size_t size, unsigned int threadCount, std::vector<ObjChunk>& chunks)
+	{
+		const char* end = data + size;
+		const char* begin = data;
+		size_t chunkCount, chunkSize, i;
+
+		if (threadCount == 0)
+		{
+			threadCount = std::thread::hardware_concurrency();
+		}
+
+		chunkCount = size / s_minChunkSize;
+		if (chunkCount > threadCount)
+		{
+			chunkCount = threadCount;
+		}
+		if (chunkCount < 1)
+		{
+			chunkCount = 1;
+		}
+
+		chunkSize = size / chunkCount;
+		chunks.clear();
+
+		for (i = 0; i < chunkCount && begin < end; i++)
+		{
+			ObjChunk chunk;
+			const char* chunkEnd = end;
+
+			// Move each boundary forward to the start of the next line.
+			if (i + 1 < chunkCount && (size_t)(end - begin) > chunkSize)
+			{
+				chunkEnd = FindLineEnd(begin + chunkSize, end);
+				if (chunkEnd < end)
+				{
+					chunkEnd++;
+				}
+			}
+
+			memset(&chunk, 0, sizeof(chunk));
+			chunk.begin = begin;
+			chunk.end = chunkEnd;
+			chunks.push_back(chunk);
+
+			begin = chunkEnd;
+		}
+	}
+
+	// Runs job(i) for every chunk, one thread per chunk, with the first chunk on the calling thread.
+	template <typename Job>
+	void RunChunks(size_t chunkCount, Job job)
+	{
+		std::vector<std::thread> workers;
+		size_t i;
+
+		workers.reserve(chunkCount);
+		for (i = 1; i < chunkCount; i++)
+		{
+			workers.push_back(std::thread(job, i));
+		}
+
+		if (chunkCount > 0)
+		{
+			job(0);
+		}
+
+		for (i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+	}
+
+}
+
+void ObjMesh::Clear()
+{
+	positions.clear();
+	texCoords.clear();
+	normals.clear();
+	faces.clear();
+}
+
+bool LoadObjFile(const char* filename, ObjMesh& mesh, unsigned int threadCount)
+{
+	MappedFile file;
+
+	if (!file.OpenAsset(filename))
+	{
+		mesh.Clear();
+		return false;
+	}
+
+	return ParseObj(file.GetData(), file.GetSize(), mesh, threadCount);
+}
+
+bool ParseObj(const char* data, size_t size, ObjMesh& mesh, unsigned int threadCount)
+{
+	std::vector<ObjChunk> chunks;
+	ObjCounts totals;
+	size_t i;
+
+	mesh.Clear();
+
+	SplitIntoChunks(data, size, threadCount, chunks);
+
+	// First pass only classifies lines so every array can be sized exactly once.
+	RunChunks(chunks.size(), [&chunks](size_t chunk)
+	{
+		CountLines(chunks[chunk].begin, chunks[chunk].end, chunks[chunk].counts);
+	});
+
+	// A prefix sum over the chunk counts gives every chunk its offset into the mesh arrays,
+	// so relative face indices still resolve against the global vertex numbering.
+	memset(&totals, 0, sizeof(totals));
+	for (i = 0; i < chunks.size(); i++)
+	{
+		chunks[i].cursor = totals;
+		totals.positions += chunks[i].counts.positions;
+		totals.texCoords += chunks[i].counts.texCoords;
+		totals.normals += chunks[i].counts.normals;
+		totals.triangles += chunks[i].counts.triangles;
+	}
+
+	mesh.positions.resize(totals.positions);
+	mesh.texCoords.resize(totals.texCoords);
+	mesh.normals.resize(totals.normals);
+	mesh.faces.resize(totals.triangles * 9);
+
+	// Second pass parses the values straight into place, each chunk into its own slice.
+	RunChunks(chunks.size(), [&chunks, &mesh, &totals](size_t chunk)
+	{
+		chunks[chunk].succeeded = ParseLines(chunks[chunk].begin, chunks[chunk].end, mesh, chunks[chunk].cursor, totals);
+	});
+
+	for (i = 0; i < chunks.size(); i++)
+	{
+		if (!chunks[i].succeeded)
+		{
+			mesh.Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
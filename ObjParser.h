@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: ObjParser.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _OBJPARSER_H_
+#define _OBJPARSER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Struct name: ObjMesh
+////////////////////////////////////////////////////////////////////////////////
+
+// Raw contents of a Wavefront .obj file, before it is unrolled into a vertex layout.
+struct ObjMesh
+{
+	struct Float2
+	{
+		float x, y;
+	};
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	std::vector<Float3> positions;
+	std::vector<Float2> texCoords;
+	std::vector<Float3> normals;
+
+	// Three zero-based indices per triangle corner (position, texture coordinate, normal),
+	// so nine per triangle. Polygons are fan triangulated.
+	std::vector<unsigned int> faces;
+
+	size_t GetTriangleCount() const { return faces.size() / 9; }
+	void Clear();
+};
+
+// Memory-maps the file, or its entry in the mounted asset archive, and parses it in place. Returns false if the file cannot be
+// opened, or if a face is malformed or references data that does not exist.
+// Large files are split into newline aligned chunks parsed on up to threadCount threads
+// (0 uses one per hardware thread, 1 keeps everything on the calling thread).
+bool LoadObjFile(const char* filename, ObjMesh& mesh, unsigned int threadCount = 0);
+
+// Parses an .obj held in memory. The buffer does not need to be null terminated.
+bool ParseObj(const char* data, size_t size, ObjMesh& mesh, unsigned int threadCount = 0);
+
+#endif
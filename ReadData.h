@@ -17,11 +17,25 @@
 #include <fstream>
 #include <vector>
 
+#include "AssetArchive.h"
+
 
 namespace DX
 {
     inline std::vector<uint8_t> ReadData(_In_z_ const wchar_t* name)
     {
+        // Shaders packed into the mounted asset archive are read from its mapping
+        const AssetArchive* archive = GetMountedAssetArchive();
+        const AssetArchiveEntry* entry = archive ? archive->Find(name) : nullptr;
+        if (entry)
+        {
+            std::vector<uint8_t> blob(size_t(entry->size));
+            if (!archive->Read(*entry, blob.data()))
+                throw std::exception("ReadData");
+
+            return blob;
+        }
+
         std::ifstream inFile(name, std::ios::in | std::ios::binary | std::ios::ate);
 
 #if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TaskPool.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "TaskPool.h"
+
+TaskPool::TaskPool()
+{
+	m_running = 0;
+	m_stopping = false;
+}
+
+TaskPool::~TaskPool()
+{
+	Shutdown();
+}
+
+void TaskPool::Initialize(unsigned int threadCount)
+{
+	unsigned int i;
+
+	Shutdown();
+
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+
+	m_stopping = false;
+	for (i = 1; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&TaskPool::WorkerLoop, this));
+	}
+
+	return;
+}
+
+void TaskPool::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_taskQueued.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+
+	return;
+}
+
+void TaskPool::Run(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_taskQueued.notify_one();
+
+	return;
+}
+
+void TaskPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	std::exception_ptr exception;
+
+	// Help out until the queue is empty, then wait for the tasks still running elsewhere.
+	while (RunOne(lock))
+	{
+	}
+
+	m_taskFinished.wait(lock, [this]() { return m_tasks.empty() && m_running == 0; });
+
+	exception = m_exception;
+	m_exception = nullptr;
+	lock.unlock();
+
+	if (exception)
+	{
+		std::rethrow_exception(exception);
+	}
+
+	return;
+}
+
+// Takes the next task, if there is one, and runs it with the lock released.
+bool TaskPool::RunOne(std::unique_lock<std::mutex>& lock)
+{
+	std::function<void()> task;
+
+	if (m_tasks.empty())
+	{
+		return false;
+	}
+
+	task = std::move(m_tasks.front());
+	m_tasks.pop_front();
+	m_running++;
+	lock.unlock();
+
+	try
+	{
+		task();
+	}
+	catch (...)
+	{
+		lock.lock();
+		if (!m_exception)
+		{
+			m_exception = std::current_exception();
+		}
+		lock.unlock();
+	}
+
+	lock.lock();
+	m_running--;
+	if (m_tasks.empty() && m_running == 0)
+	{
+		m_taskFinished.notify_all();
+	}
+
+	return true;
+}
+
+void TaskPool::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;)
+	{
+		m_taskQueued.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+		if (m_tasks.empty())
+		{
+			return;
+		}
+
+		RunOne(lock);
+	}
+}
+
+TaskPhase::TaskPhase()
+{
+	m_start = std::chrono::steady_clock::now();
+	m_finish = 0;
+}
+
+void TaskPhase::Begin()
+{
+	m_start = std::chrono::steady_clock::now();
+	m_finish = 0;
+
+	return;
+}
+
+void TaskPhase::End()
+{
+	long long finish = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+	long long previous = m_finish.load();
+
+	while (previous < finish && !m_finish.compare_exchange_weak(previous, finish))
+	{
+	}
+
+	return;
+}
+
+double TaskPhase::GetMilliseconds() const
+{
+	return m_finish.load() / 1e6;
+}
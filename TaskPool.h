@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TaskPool.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TASKPOOL_H_
+#define _TASKPOOL_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TaskPool
+////////////////////////////////////////////////////////////////////////////////
+
+// Worker threads that run queued tasks in the order they were queued. The thread calling Wait
+// runs tasks too, so a pool of one thread runs everything on the caller.
+class TaskPool
+{
+public:
+	TaskPool();
+	~TaskPool();
+
+	// threadCount counts the thread calling Wait, 0 uses one per hardware thread.
+	void Initialize(unsigned int threadCount = 0);
+	void Shutdown();
+
+	void Run(std::function<void()> task);
+
+	// Returns once every task queued so far has finished, rethrowing the first exception a task threw.
+	void Wait();
+
+private:
+	bool RunOne(std::unique_lock<std::mutex>& lock);
+	void WorkerLoop();
+
+private:
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()> > m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_taskQueued;
+	std::condition_variable m_taskFinished;
+	size_t m_running;
+	bool m_stopping;
+	std::exception_ptr m_exception;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TaskPhase
+////////////////////////////////////////////////////////////////////////////////
+
+// Wall clock span of one kind of task, from Begin until the last End, for startup timings.
+class TaskPhase
+{
+public:
+	TaskPhase();
+
+	void Begin();
+	void End();		// called by each task as it finishes, from any thread
+	double GetMilliseconds() const;
+
+private:
+	std::chrono::steady_clock::time_point m_start;
+	std::atomic<long long> m_finish;	// nanoseconds after m_start
+};
+
+#endif
@@ -0,0 +1,1034 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureCodec.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "TextureCodec.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TEXTURE_CODEC_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Block rows encoded per task; a 2048 wide row of blocks is a few hundred microseconds of BC7.
+	const uint32_t s_bandRows = 4;
+
+	// Refits of the endpoints to the picked indices, stopping early once one does not help.
+	const int s_refineIterations = 2;
+
+	const int s_bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// A block's pixels, or a palette's entries, as one plane per channel so that four of them are
+	// compared with one instruction. Channels left out of the comparison are 0 on both sides.
+	struct Planes
+	{
+		float channel[4][16];
+	};
+
+	// Up to 16 entries; FindNearest reads them in fours, so entries past count repeat the last.
+	struct Palette
+	{
+		Planes entries;
+		unsigned int count;
+
+		void Pad()
+		{
+			unsigned int c, i;
+
+			for (c = 0; c < 4; c++)
+			{
+				for (i = count; i < ((count + 3) & ~3u); i++)
+				{
+					entries.channel[c][i] = entries.channel[c][count - 1];
+				}
+			}
+		}
+	};
+
+	void LoadPlanes(const uint8_t* rgba, unsigned int channelMask, Planes& planes)
+	{
+		unsigned int c, i;
+
+		for (c = 0; c < 4; c++)
+		{
+			for (i = 0; i < 16; i++)
+			{
+				planes.channel[c][i] = (channelMask & (1u << c)) ? (float)rgba[i * 4 + c] : 0.0f;
+			}
+		}
+	}
+
+	// Picks each pixel's nearest palette entry, the lowest index on ties, and returns the summed
+	// squared error.
+	float FindNearest(const Planes& pixels, const Palette& palette, uint8_t* indices)
+	{
+		float error = 0.0f;
+		unsigned int i, j;
+
+#ifdef TEXTURE_CODEC_SSE
+		const __m128 four = _mm_set1_ps(4.0f);
+		float laneDistance[4], laneIndex[4];
+
+		for (i = 0; i < 16; i++)
+		{
+			__m128 r = _mm_set1_ps(pixels.channel[0][i]);
+			__m128 g = _mm_set1_ps(pixels.channel[1][i]);
+			__m128 b = _mm_set1_ps(pixels.channel[2][i]);
+			__m128 a = _mm_set1_ps(pixels.channel[3][i]);
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+			__m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+			unsigned int lane, bestLane = 0;
+
+			for (j = 0; j < palette.count; j += 4)
+			{
+				__m128 dr = _mm_sub_ps(r, _mm_loadu_ps(palette.entries.channel[0] + j));
+				__m128 dg = _mm_sub_ps(g, _mm_loadu_ps(palette.entries.channel[1] + j));
+				__m128 db = _mm_sub_ps(b, _mm_loadu_ps(palette.entries.channel[2] + j));
+				__m128 da = _mm_sub_ps(a, _mm_loadu_ps(palette.entries.channel[3] + j));
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+				__m128 closer = _mm_cmplt_ps(distance, best);
+
+				best = _mm_min_ps(distance, best);
+				bestIndex = _mm_or_ps(_mm_and_ps(closer, index), _mm_andnot_ps(closer, bestIndex));
+				index = _mm_add_ps(index, four);
+			}
+
+			_mm_storeu_ps(laneDistance, best);
+			_mm_storeu_ps(laneIndex, bestIndex);
+			for (lane = 1; lane < 4; lane++)
+			{
+				if (laneDistance[lane] < laneDistance[bestLane] || (laneDistance[lane] == laneDistance[bestLane] && laneIndex[lane] < laneIndex[bestLane]))
+				{
+					bestLane = lane;
+				}
+			}
+
+			indices[i] = (uint8_t)laneIndex[bestLane];
+			error += laneDistance[bestLane];
+		}
+#else
+		for (i = 0; i < 16; i++)
+		{
+			float best = FLT_MAX;
+
+			for (j = 0; j < palette.count; j++)
+			{
+				float dr = pixels.channel[0][i] - palette.entries.channel[0][j];
+				float dg = pixels.channel[1][i] - palette.entries.channel[1][j];
+				float db = pixels.channel[2][i] - palette.entries.channel[2][j];
+				float da = pixels.channel[3][i] - palette.entries.channel[3][j];
+				float distance = dr * dr + dg * dg + db * db + da * da;
+
+				if (distance < best)
+				{
+					best = distance;
+					indices[i] = (uint8_t)j;
+				}
+			}
+
+			error += best;
+		}
+#endif
+
+		return error;
+	}
+
+	// Endpoints at the extremes of the included pixels' projections onto their principal axis, found
+	// by power iteration on their covariance.
+	void FitAxis(const Planes& pixels, const bool* included, float endpoints[2][4])
+	{
+		float mean[4] = {}, covariance[4][4] = {}, axis[4], next[4], low = FLT_MAX, high = -FLT_MAX, scale;
+		unsigned int count = 0, c, d, i;
+		int iteration;
+
+		for (i = 0; i < 16; i++)
+		{
+			if (!included || included[i])
+			{
+				for (c = 0; c < 4; c++)
+				{
+					mean[c] += pixels.channel[c][i];
+				}
+				count++;
+			}
+		}
+		if (count == 0)
+		{
+			memset(endpoints, 0, sizeof(float) * 8);
+			return;
+		}
+		for (c = 0; c < 4; c++)
+		{
+			mean[c] /= (float)count;
+		}
+
+		for (i = 0; i < 16; i++)
+		{
+			if (!included || included[i])
+			{
+				for (c = 0; c < 4; c++)
+				{
+					for (d = 0; d < 4; d++)
+					{
+						covariance[c][d] += (pixels.channel[c][i] - mean[c]) * (pixels.channel[d][i] - mean[d]);
+					}
+				}
+			}
+		}
+
+		// Start from the diagonal, which is never orthogonal to the axis of a block whose channels rise together.
+		for (c = 0; c < 4; c++)
+		{
+			axis[c] = covariance[c][c] > 0.0f ? 1.0f : 0.0f;
+		}
+		for (iteration = 0; iteration < 8; iteration++)
+		{
+			scale = 0.0f;
+			for (c = 0; c < 4; c++)
+			{
+				next[c] = covariance[c][0] * axis[0] + covariance[c][1] * axis[1] + covariance[c][2] * axis[2] + covariance[c][3] * axis[3];
+				scale = std::max(scale, std::fabs(next[c]));
+			}
+			if (scale == 0.0f)
+			{
+				break;
+			}
+			for (c = 0; c < 4; c++)
+			{
+				axis[c] = next[c] / scale;
+			}
+		}
+
+		scale = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+		if (scale > 0.0f)
+		{
+			for (c = 0; c < 4; c++)
+			{
+				axis[c] /= std::sqrt(scale);
+			}
+			for (i = 0; i < 16; i++)
+			{
+				if (!included || included[i])
+				{
+					float t = 0.0f;
+
+					for (c = 0; c < 4; c++)
+					{
+						t += (pixels.channel[c][i] - mean[c]) * axis[c];
+					}
+					low = std::min(low, t);
+					high = std::max(high, t);
+				}
+			}
+		}
+		else
+		{
+			low = high = 0.0f;
+		}
+
+		for (c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * low));
+			endpoints[1][c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * high));
+		}
+	}
+
+	// Least squares endpoints for the picked indices, each index standing for the weight of the
+	// second endpoint in its entry; indices with a negative weight are left out. False when the
+	// picks do not pin both endpoints down.
+	bool FitEndpoints(const Planes& pixels, const uint8_t* indices, const float* weights, float endpoints[2][4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[4] = {}, bx[4] = {}, determinant;
+		unsigned int c, i;
+
+		for (i = 0; i < 16; i++)
+		{
+			float t = weights[indices[i]];
+
+			if (t < 0.0f)
+			{
+				continue;
+			}
+
+			aa += (1.0f - t) * (1.0f - t);
+			ab += (1.0f - t) * t;
+			bb += t * t;
+			for (c = 0; c < 4; c++)
+			{
+				ax[c] += (1.0f - t) * pixels.channel[c][i];
+				bx[c] += t * pixels.channel[c][i];
+			}
+		}
+
+		determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+		{
+			return false;
+		}
+
+		for (c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = std::min(255.0f, std::max(0.0f, (bb * ax[c] - ab * bx[c]) / determinant));
+			endpoints[1][c] = std::min(255.0f, std::max(0.0f, (aa * bx[c] - ab * ax[c]) / determinant));
+		}
+
+		return true;
+	}
+
+	inline int Clamp(int value, int low, int high)
+	{
+		return value < low ? low : (value > high ? high : value);
+	}
+
+	// Bits of a 128 bit BC7 block, least significant first.
+	class BlockBits
+	{
+	public:
+		BlockBits() : m_position(0) { memset(m_bytes, 0, sizeof(m_bytes)); }
+		explicit BlockBits(const uint8_t* block) : m_position(0) { memcpy(m_bytes, block, sizeof(m_bytes)); }
+
+		void Write(uint32_t value, unsigned int count)
+		{
+			for (unsigned int i = 0; i < count; i++, m_position++)
+			{
+				m_bytes[m_position >> 3] |= (uint8_t)(((value >> i) & 1) << (m_position & 7));
+			}
+		}
+
+		uint32_t Read(unsigned int count)
+		{
+			uint32_t value = 0;
+
+			for (unsigned int i = 0; i < count; i++, m_position++)
+			{
+				value |= (uint32_t)((m_bytes[m_position >> 3] >> (m_position & 7)) & 1) << i;
+			}
+
+			return value;
+		}
+
+		const uint8_t* GetBytes() const { return m_bytes; }
+
+	private:
+		uint8_t m_bytes[16];
+		unsigned int m_position;
+	};
+
+	//////////////////////////////////////////////////////////////////// BC1
+
+	struct BC1Result
+	{
+		uint16_t colours[2];
+		uint8_t indices[16];
+		float error;
+	};
+
+	inline uint16_t To565(const float* colour)
+	{
+		int r = Clamp((int)std::lround(colour[0] * 31.0f / 255.0f), 0, 31);
+		int g = Clamp((int)std::lround(colour[1] * 63.0f / 255.0f), 0, 63);
+		int b = Clamp((int)std::lround(colour[2] * 31.0f / 255.0f), 0, 31);
+
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	inline void From565(uint16_t value, int* colour)
+	{
+		int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+
+		colour[0] = (r << 3) | (r >> 2);
+		colour[1] = (g << 2) | (g >> 4);
+		colour[2] = (b << 3) | (b >> 2);
+	}
+
+	// The entries a decoder makes of two 565 colours; the 3 colour mode's fourth is transparent black.
+	void GetBC1Palette(uint16_t colour0, uint16_t colour1, bool threeColourMode, int palette[4][4])
+	{
+		int c;
+
+		From565(colour0, palette[0]);
+		From565(colour1, palette[1]);
+		for (c = 0; c < 3; c++)
+		{
+			if (!threeColourMode)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[0][3] = palette[1][3] = palette[2][3] = 255;
+		palette[3][3] = threeColourMode ? 0 : 255;
+	}
+
+	// Transparent pixels and the 3 colour mode's transparent entry share a value no colour is near,
+	// so FindNearest pairs them at no cost.
+	const float s_transparent = -4096.0f;
+
+	void EvaluateBC1(const Planes& pixels, const float endpoints[2][4], bool threeColourMode, BC1Result& result)
+	{
+		Palette palette;
+		int entries[4][4];
+		unsigned int c, i;
+
+		result.colours[0] = To565(endpoints[0]);
+		result.colours[1] = To565(endpoints[1]);
+
+		// The order of the two colours is what tells a decoder which mode the block is in.
+		if ((result.colours[0] < result.colours[1]) != threeColourMode && result.colours[0] != result.colours[1])
+		{
+			std::swap(result.colours[0], result.colours[1]);
+		}
+
+		GetBC1Palette(result.colours[0], result.colours[1], result.colours[0] <= result.colours[1], entries);
+		memset(&palette, 0, sizeof(palette));
+		palette.count = 4;
+		for (i = 0; i < 4; i++)
+		{
+			for (c = 0; c < 3; c++)
+			{
+				palette.entries.channel[c][i] = (float)entries[i][c];
+			}
+		}
+
+		if (threeColourMode)
+		{
+			for (c = 0; c < 3; c++)
+			{
+				palette.entries.channel[c][3] = s_transparent;
+			}
+		}
+		else if (result.colours[0] == result.colours[1])
+		{
+			// Equal colours decode in the 3 colour mode, where only the first three entries are colours.
+			palette.count = 3;
+			palette.Pad();
+		}
+
+		result.error = FindNearest(pixels, palette, result.indices);
+	}
+
+	//////////////////////////////////////////////////////////////////// BC4
+
+	struct BC4Result
+	{
+		int endpoints[2];
+		uint8_t indices[16];
+		float error;
+	};
+
+	void GetBC4Palette(int endpoint0, int endpoint1, int palette[8])
+	{
+		int i;
+
+		palette[0] = endpoint0;
+		palette[1] = endpoint1;
+		if (endpoint0 > endpoint1)
+		{
+			for (i = 1; i < 7; i++)
+			{
+				palette[i + 1] = ((7 - i) * endpoint0 + i * endpoint1 + 3) / 7;
+			}
+		}
+		else
+		{
+			for (i = 1; i < 5; i++)
+			{
+				palette[i + 1] = ((5 - i) * endpoint0 + i * endpoint1 + 2) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	void EvaluateBC4(const Planes& pixels, int endpoint0, int endpoint1, BC4Result& result)
+	{
+		Palette palette;
+		int entries[8], i;
+
+		GetBC4Palette(endpoint0, endpoint1, entries);
+		memset(&palette, 0, sizeof(palette));
+		palette.count = 8;
+		for (i = 0; i < 8; i++)
+		{
+			palette.entries.channel[0][i] = (float)entries[i];
+		}
+
+		result.endpoints[0] = endpoint0;
+		result.endpoints[1] = endpoint1;
+		result.error = FindNearest(pixels, palette, result.indices);
+	}
+
+	//////////////////////////////////////////////////////////////////// BC7
+
+	struct BC7Result
+	{
+		int endpoints[2][4];	// 7 bits
+		int pbits[2];
+		uint8_t indices[16];
+		float error;
+	};
+
+	void EvaluateBC7(const Planes& pixels, const float endpoints[2][4], BC7Result& result)
+	{
+		BC7Result candidate;
+		Palette palette;
+		int value[2][4], pbits, e, c, i;
+
+		result.error = FLT_MAX;
+		palette.count = 16;
+
+		// Each endpoint's p-bit is the low bit of all four of its channels, so all four pairings are tried.
+		for (pbits = 0; pbits < 4; pbits++)
+		{
+			candidate.pbits[0] = pbits & 1;
+			candidate.pbits[1] = pbits >> 1;
+
+			for (e = 0; e < 2; e++)
+			{
+				for (c = 0; c < 4; c++)
+				{
+					candidate.endpoints[e][c] = Clamp((int)std::lround((endpoints[e][c] - candidate.pbits[e]) * 0.5f), 0, 127);
+					value[e][c] = (candidate.endpoints[e][c] << 1) | candidate.pbits[e];
+				}
+			}
+
+			for (c = 0; c < 4; c++)
+			{
+				for (i = 0; i < 16; i++)
+				{
+					palette.entries.channel[c][i] = (float)(((64 - s_bc7Weights[i]) * value[0][c] + s_bc7Weights[i] * value[1][c] + 32) >> 6);
+				}
+			}
+
+			candidate.error = FindNearest(pixels, palette, candidate.indices);
+			if (candidate.error < result.error)
+			{
+				result = candidate;
+			}
+		}
+	}
+
+	bool IsSrgbOf(uint32_t format, uint32_t unorm, uint32_t srgb)
+	{
+		return format == unorm || format == srgb;
+	}
+
+	bool IsBlockCompressed(uint32_t format)
+	{
+		return (format >= DDS_FORMAT_BC1_UNORM && format <= DDS_FORMAT_BC5_UNORM) || IsSrgbOf(format, DDS_FORMAT_BC7_UNORM, DDS_FORMAT_BC7_UNORM_SRGB);
+	}
+
+	uint32_t GetEncodedBlockBytes(uint32_t format)
+	{
+		if (IsSrgbOf(format, DDS_FORMAT_BC1_UNORM, DDS_FORMAT_BC1_UNORM_SRGB) || format == DDS_FORMAT_BC4_UNORM)
+		{
+			return 8;
+		}
+		if (format == DDS_FORMAT_BC5_UNORM || IsSrgbOf(format, DDS_FORMAT_BC7_UNORM, DDS_FORMAT_BC7_UNORM_SRGB))
+		{
+			return 16;
+		}
+
+		return 0;
+	}
+
+	void EncodeBlock(uint32_t format, const uint8_t* rgba, uint8_t* block)
+	{
+		if (IsSrgbOf(format, DDS_FORMAT_BC1_UNORM, DDS_FORMAT_BC1_UNORM_SRGB))
+		{
+			EncodeBC1Block(rgba, block);
+		}
+		else if (format == DDS_FORMAT_BC4_UNORM)
+		{
+			EncodeBC4Block(rgba, block);
+		}
+		else if (format == DDS_FORMAT_BC5_UNORM)
+		{
+			EncodeBC5Block(rgba, block);
+		}
+		else
+		{
+			EncodeBC7Block(rgba, block);
+		}
+	}
+
+	void EncodeBlockRows(uint32_t format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks, uint32_t firstRow, uint32_t lastRow)
+	{
+		uint32_t blockBytes = GetEncodedBlockBytes(format);
+		uint32_t blocksWide = (width + 3) / 4;
+		uint8_t pixels[64];
+		uint32_t row, column, x, y;
+
+		for (row = firstRow; row < lastRow; row++)
+		{
+			for (column = 0; column < blocksWide; column++)
+			{
+				for (y = 0; y < 4; y++)
+				{
+					for (x = 0; x < 4; x++)
+					{
+						uint32_t sourceX = std::min(column * 4 + x, width - 1);
+						uint32_t sourceY = std::min(row * 4 + y, height - 1);
+
+						memcpy(pixels + (y * 4 + x) * 4, rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+					}
+				}
+
+				EncodeBlock(format, pixels, blocks + ((size_t)row * blocksWide + column) * blockBytes);
+			}
+		}
+	}
+}
+
+void EncodeBC1Block(const uint8_t* rgba, uint8_t* block)
+{
+	static const float fourColourWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	static const float threeColourWeights[4] = { 0.0f, 1.0f, 0.5f, -1.0f };
+	Planes pixels;
+	BC1Result best, candidate;
+	float endpoints[2][4];
+	bool opaque[16], threeColourMode = false;
+	uint32_t indices = 0;
+	int i, iteration;
+
+	LoadPlanes(rgba, 0x7, pixels);
+	for (i = 0; i < 16; i++)
+	{
+		opaque[i] = rgba[i * 4 + 3] >= 128;
+		if (!opaque[i])
+		{
+			threeColourMode = true;
+			pixels.channel[0][i] = pixels.channel[1][i] = pixels.channel[2][i] = s_transparent;
+		}
+	}
+
+	FitAxis(pixels, opaque, endpoints);
+	EvaluateBC1(pixels, endpoints, threeColourMode, best);
+
+	for (iteration = 0; iteration < s_refineIterations; iteration++)
+	{
+		if (!FitEndpoints(pixels, best.indices, threeColourMode ? threeColourWeights : fourColourWeights, endpoints))
+		{
+			break;
+		}
+		EvaluateBC1(pixels, endpoints, threeColourMode, candidate);
+		if (candidate.error >= best.error)
+		{
+			break;
+		}
+		best = candidate;
+	}
+
+	for (i = 0; i < 16; i++)
+	{
+		indices |= (uint32_t)best.indices[i] << (i * 2);
+	}
+
+	block[0] = (uint8_t)best.colours[0];
+	block[1] = (uint8_t)(best.colours[0] >> 8);
+	block[2] = (uint8_t)best.colours[1];
+	block[3] = (uint8_t)(best.colours[1] >> 8);
+	memcpy(block + 4, &indices, sizeof(indices));
+}
+
+void EncodeBC4Block(const uint8_t* rgba, uint8_t* block, unsigned int channel)
+{
+	static const float weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+	Planes pixels;
+	BC4Result best, candidate;
+	float endpoints[2][4];
+	int low = 255, high = 0, innerLow = 255, innerHigh = 0, value, shrink0, shrink1, i;
+	uint64_t indices = 0;
+
+	memset(&pixels, 0, sizeof(pixels));
+	for (i = 0; i < 16; i++)
+	{
+		value = rgba[i * 4 + channel];
+		pixels.channel[0][i] = (float)value;
+		low = std::min(low, value);
+		high = std::max(high, value);
+		if (value != 0 && value != 255)
+		{
+			innerLow = std::min(innerLow, value);
+			innerHigh = std::max(innerHigh, value);
+		}
+	}
+
+	EvaluateBC4(pixels, high, low, best);
+
+	if (low != high)
+	{
+		// The 8 value mode spanning the block, pulled in a little where the extremes are lone pixels.
+		for (shrink0 = 0; shrink0 <= 2; shrink0++)
+		{
+			for (shrink1 = 0; shrink1 <= 2; shrink1++)
+			{
+				if ((shrink0 || shrink1) && high - shrink0 > low + shrink1)
+				{
+					EvaluateBC4(pixels, high - shrink0, low + shrink1, candidate);
+					if (candidate.error < best.error)
+					{
+						best = candidate;
+					}
+				}
+			}
+		}
+
+		if (best.endpoints[0] > best.endpoints[1] && FitEndpoints(pixels, best.indices, weights, endpoints))
+		{
+			int endpoint0 = (int)std::lround(endpoints[0][0]), endpoint1 = (int)std::lround(endpoints[1][0]);
+
+			if (endpoint0 > endpoint1)
+			{
+				EvaluateBC4(pixels, endpoint0, endpoint1, candidate);
+				if (candidate.error < best.error)
+				{
+					best = candidate;
+				}
+			}
+		}
+
+		// The 6 value mode has exact 0 and 255 for blocks that reach them and spends the rest between.
+		if ((low == 0 || high == 255) && innerLow <= innerHigh)
+		{
+			EvaluateBC4(pixels, innerLow, innerHigh, candidate);
+			if (candidate.error < best.error)
+			{
+				best = candidate;
+			}
+		}
+	}
+
+	for (i = 0; i < 16; i++)
+	{
+		indices |= (uint64_t)best.indices[i] << (i * 3);
+	}
+
+	block[0] = (uint8_t)best.endpoints[0];
+	block[1] = (uint8_t)best.endpoints[1];
+	for (i = 0; i < 6; i++)
+	{
+		block[2 + i] = (uint8_t)(indices >> (i * 8));
+	}
+}
+
+void EncodeBC5Block(const uint8_t* rgba, uint8_t* block)
+{
+	EncodeBC4Block(rgba, block, 0);
+	EncodeBC4Block(rgba, block + 8, 1);
+}
+
+void EncodeBC7Block(const uint8_t* rgba, uint8_t* block)
+{
+	float weights[16];
+	Planes pixels;
+	BC7Result best, candidate;
+	BlockBits bits;
+	float endpoints[2][4];
+	int iteration, c, i;
+
+	for (i = 0; i < 16; i++)
+	{
+		weights[i] = s_bc7Weights[i] / 64.0f;
+	}
+
+	LoadPlanes(rgba, 0xf, pixels);
+	FitAxis(pixels, nullptr, endpoints);
+	EvaluateBC7(pixels, endpoints, best);
+
+	for (iteration = 0; iteration < s_refineIterations && best.error > 0.0f; iteration++)
+	{
+		if (!FitEndpoints(pixels, best.indices, weights, endpoints))
+		{
+			break;
+		}
+		EvaluateBC7(pixels, endpoints, candidate);
+		if (candidate.error >= best.error)
+		{
+			break;
+		}
+		best = candidate;
+	}
+
+	// The first pixel's index is stored without its top bit, so it has to be below 8.
+	if (best.indices[0] & 8)
+	{
+		for (c = 0; c < 4; c++)
+		{
+			std::swap(best.endpoints[0][c], best.endpoints[1][c]);
+		}
+		std::swap(best.pbits[0], best.pbits[1]);
+		for (i = 0; i < 16; i++)
+		{
+			best.indices[i] = (uint8_t)(15 - best.indices[i]);
+		}
+	}
+
+	bits.Write(1 << 6, 7);
+	for (c = 0; c < 4; c++)
+	{
+		bits.Write(best.endpoints[0][c], 7);
+		bits.Write(best.endpoints[1][c], 7);
+	}
+	bits.Write(best.pbits[0], 1);
+	bits.Write(best.pbits[1], 1);
+	for (i = 0; i < 16; i++)
+	{
+		bits.Write(best.indices[i], i == 0 ? 3 : 4);
+	}
+
+	memcpy(block, bits.GetBytes(), 16);
+}
+
+void DecodeBC1Block(const uint8_t* block, uint8_t* rgba, bool threeColourMode)
+{
+	uint16_t colour0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t colour1 = (uint16_t)(block[2] | (block[3] << 8));
+	uint32_t indices;
+	int palette[4][4];
+	int i, c;
+
+	memcpy(&indices, block + 4, sizeof(indices));
+
+	// BC2 and BC3 colour blocks are always in the 4 colour mode.
+	GetBC1Palette(colour0, colour1, threeColourMode && colour0 <= colour1, palette);
+
+	for (i = 0; i < 16; i++)
+	{
+		const int* entry = palette[(indices >> (i * 2)) & 3];
+
+		for (c = 0; c < 4; c++)
+		{
+			rgba[i * 4 + c] = (uint8_t)entry[c];
+		}
+	}
+}
+
+void DecodeBC4Block(const uint8_t* block, uint8_t* rgba, unsigned int channel)
+{
+	uint64_t indices = 0;
+	int palette[8], i;
+
+	GetBC4Palette(block[0], block[1], palette);
+	for (i = 0; i < 6; i++)
+	{
+		indices |= (uint64_t)block[2 + i] << (i * 8);
+	}
+
+	for (i = 0; i < 16; i++)
+	{
+		rgba[i * 4 + channel] = (uint8_t)palette[(indices >> (i * 3)) & 7];
+	}
+}
+
+bool DecodeBC7Block(const uint8_t* block, uint8_t* rgba)
+{
+	BlockBits bits(block);
+	int endpoints[2][4], pbits[2], e, c, i;
+
+	if (bits.Read(7) != (1 << 6))
+	{
+		return false;
+	}
+
+	for (c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = (int)bits.Read(7);
+		endpoints[1][c] = (int)bits.Read(7);
+	}
+	pbits[0] = (int)bits.Read(1);
+	pbits[1] = (int)bits.Read(1);
+	for (e = 0; e < 2; e++)
+	{
+		for (c = 0; c < 4; c++)
+		{
+			endpoints[e][c] = (endpoints[e][c] << 1) | pbits[e];
+		}
+	}
+
+	for (i = 0; i < 16; i++)
+	{
+		int weight = s_bc7Weights[bits.Read(i == 0 ? 3 : 4)];
+
+		for (c = 0; c < 4; c++)
+		{
+			rgba[i * 4 + c] = (uint8_t)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+		}
+	}
+
+	return true;
+}
+
+bool CanDecodeTextureFormat(uint32_t format)
+{
+	switch (format)
+	{
+	case DDS_FORMAT_BC1_UNORM: case DDS_FORMAT_BC1_UNORM_SRGB:
+	case DDS_FORMAT_BC2_UNORM: case DDS_FORMAT_BC2_UNORM_SRGB:
+	case DDS_FORMAT_BC3_UNORM: case DDS_FORMAT_BC3_UNORM_SRGB:
+	case DDS_FORMAT_BC4_UNORM: case DDS_FORMAT_BC5_UNORM:
+	case DDS_FORMAT_BC7_UNORM: case DDS_FORMAT_BC7_UNORM_SRGB:
+	case DDS_FORMAT_R8G8B8A8_UNORM: case DDS_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DDS_FORMAT_B8G8R8A8_UNORM: case DDS_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DDS_FORMAT_B8G8R8X8_UNORM:
+	case DDS_FORMAT_R8G8_UNORM: case DDS_FORMAT_R8_UNORM: case DDS_FORMAT_A8_UNORM:
+		return true;
+	}
+
+	return false;
+}
+
+bool CanEncodeTextureFormat(uint32_t format)
+{
+	return GetEncodedBlockBytes(format) != 0;
+}
+
+bool DecodeTextureSurface(uint32_t format, const DdsSurface& surface, uint8_t* rgba)
+{
+	const uint8_t* source = reinterpret_cast<const uint8_t*>(surface.data);
+	uint8_t pixels[64];
+	uint32_t blocksWide = (surface.width + 3) / 4, blocksHigh = (surface.height + 3) / 4;
+	uint32_t row, column, x, y, i;
+
+	if (!CanDecodeTextureFormat(format) || surface.depth != 1)
+	{
+		return false;
+	}
+
+	if (!IsBlockCompressed(format))
+	{
+		for (y = 0; y < surface.height; y++)
+		{
+			const uint8_t* in = source + y * surface.rowPitch;
+			uint8_t* out = rgba + (size_t)y * surface.width * 4;
+
+			for (x = 0; x < surface.width; x++, out += 4)
+			{
+				switch (format)
+				{
+				case DDS_FORMAT_R8G8B8A8_UNORM: case DDS_FORMAT_R8G8B8A8_UNORM_SRGB:
+					memcpy(out, in + x * 4, 4);
+					break;
+				case DDS_FORMAT_B8G8R8A8_UNORM: case DDS_FORMAT_B8G8R8A8_UNORM_SRGB: case DDS_FORMAT_B8G8R8X8_UNORM:
+					out[0] = in[x * 4 + 2];
+					out[1] = in[x * 4 + 1];
+					out[2] = in[x * 4];
+					out[3] = format == DDS_FORMAT_B8G8R8X8_UNORM ? 255 : in[x * 4 + 3];
+					break;
+				case DDS_FORMAT_R8G8_UNORM:
+					out[0] = in[x * 2];
+					out[1] = in[x * 2 + 1];
+					out[2] = 0;
+					out[3] = 255;
+					break;
+				case DDS_FORMAT_R8_UNORM:
+					out[0] = in[x];
+					out[1] = out[2] = 0;
+					out[3] = 255;
+					break;
+				case DDS_FORMAT_A8_UNORM:
+					out[0] = out[1] = out[2] = 0;
+					out[3] = in[x];
+					break;
+				default:
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	for (row = 0; row < blocksHigh; row++)
+	{
+		for (column = 0; column < blocksWide; column++)
+		{
+			const uint8_t* block = source + row * surface.rowPitch;
+
+			for (i = 0; i < 16; i++)
+			{
+				pixels[i * 4] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = 0;
+				pixels[i * 4 + 3] = 255;
+			}
+
+			switch (format)
+			{
+			case DDS_FORMAT_BC1_UNORM: case DDS_FORMAT_BC1_UNORM_SRGB:
+				DecodeBC1Block(block + column * 8, pixels);
+				break;
+			case DDS_FORMAT_BC2_UNORM: case DDS_FORMAT_BC2_UNORM_SRGB:
+				DecodeBC1Block(block + column * 16 + 8, pixels, false);
+				for (i = 0; i < 16; i++)
+				{
+					pixels[i * 4 + 3] = (uint8_t)(((block[column * 16 + i / 2] >> ((i & 1) * 4)) & 15) * 17);
+				}
+				break;
+			case DDS_FORMAT_BC3_UNORM: case DDS_FORMAT_BC3_UNORM_SRGB:
+				DecodeBC1Block(block + column * 16 + 8, pixels, false);
+				DecodeBC4Block(block + column * 16, pixels, 3);
+				break;
+			case DDS_FORMAT_BC4_UNORM:
+				DecodeBC4Block(block + column * 8, pixels, 0);
+				break;
+			case DDS_FORMAT_BC5_UNORM:
+				DecodeBC4Block(block + column * 16, pixels, 0);
+				DecodeBC4Block(block + column * 16 + 8, pixels, 1);
+				break;
+			default:
+				if (!DecodeBC7Block(block + column * 16, pixels))
+				{
+					return false;
+				}
+				break;
+			}
+
+			for (y = 0; y < 4 && row * 4 + y < surface.height; y++)
+			{
+				for (x = 0; x < 4 && column * 4 + x < surface.width; x++)
+				{
+					memcpy(rgba + (((size_t)row * 4 + y) * surface.width + column * 4 + x) * 4, pixels + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+bool EncodeTextureSurface(uint32_t format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks, TaskPool* tasks)
+{
+	uint32_t blocksHigh = (height + 3) / 4;
+	uint32_t row;
+
+	if (!CanEncodeTextureFormat(format) || width == 0 || height == 0)
+	{
+		return false;
+	}
+
+	if (!tasks || blocksHigh <= s_bandRows)
+	{
+		EncodeBlockRows(format, rgba, width, height, blocks, 0, blocksHigh);
+		return true;
+	}
+
+	for (row = 0; row < blocksHigh; row += s_bandRows)
+	{
+		uint32_t lastRow = std::min(row + s_bandRows, blocksHigh);
+
+		tasks->Run([=]() { EncodeBlockRows(format, rgba, width, height, blocks, row, lastRow); });
+	}
+	tasks->Wait();
+
+	return true;
+}
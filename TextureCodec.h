@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureCodec.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TEXTURECODEC_H_
+#define _TEXTURECODEC_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include "DdsImage.h"
+#include "TaskPool.h"
+
+// Block compression of 8 bit RGBA pixels into the BC formats the GPU samples as they are, and
+// decoding of the formats the texture cooker finds in its sources. A block is 4x4 pixels, 64 bytes
+// of RGBA in rows; BC1 and BC4 blocks are 8 bytes, BC5 and BC7 blocks 16.
+//
+// The encoders fit each block's endpoints along its principal axis, pick every pixel's nearest
+// palette entry (four entries at a time with SSE2 where there is SSE2) and refit the endpoints to
+// those picks by least squares while that lowers the error.
+//   BC1  RGB, 565 endpoints and 4 colours; blocks with alpha below 128 use the 3 colour mode, whose
+//        fourth entry is transparent black.
+//   BC4  the red channel, 8 bit endpoints and 8 values, or 6 values plus 0 and 255.
+//   BC5  red and green, each as BC4.
+//   BC7  RGBA in mode 6 only, one subset with 7 bit endpoints, a p-bit each and 16 entries. The
+//        partitioned modes would gain a little more quality for several times the time.
+void EncodeBC1Block(const uint8_t* rgba, uint8_t* block);
+void EncodeBC4Block(const uint8_t* rgba, uint8_t* block, unsigned int channel = 0);
+void EncodeBC5Block(const uint8_t* rgba, uint8_t* block);
+void EncodeBC7Block(const uint8_t* rgba, uint8_t* block);
+
+// BC7 blocks in other modes than 6 are not decoded and come back false.
+void DecodeBC1Block(const uint8_t* block, uint8_t* rgba, bool threeColourMode = true);
+void DecodeBC4Block(const uint8_t* block, uint8_t* rgba, unsigned int channel = 0);
+bool DecodeBC7Block(const uint8_t* block, uint8_t* rgba);
+
+// BC1, BC2, BC3, BC4, BC5, mode 6 BC7 and the 8 bit per channel UNORM formats, sRGB or not.
+bool CanDecodeTextureFormat(uint32_t format);
+// BC1, BC4, BC5 and BC7, sRGB or not.
+bool CanEncodeTextureFormat(uint32_t format);
+
+// One surface to or from width x height RGBA pixels in rows. Channels a format does not store
+// decode as 0, and alpha as 255. Partial blocks at the right and bottom edges are encoded with
+// their last column and row repeated.
+bool DecodeTextureSurface(uint32_t format, const DdsSurface& surface, uint8_t* rgba);
+
+// tasks, when given, encodes bands of block rows on the pool and waits for them; call it from
+// outside the pool's tasks.
+bool EncodeTextureSurface(uint32_t format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks, TaskPool* tasks = nullptr);
+
+#endif
@@ -0,0 +1,333 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureLoader.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "pch.h"
+#include "TextureLoader.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	bool EndsWith(const std::string& name, const char* suffix)
+	{
+		size_t length = strlen(suffix);
+
+		return name.size() >= length && name.compare(name.size() - length, length, suffix) == 0;
+	}
+
+	// Textures the shaders read as data rather than colour, by the same names TextureCooker goes by.
+	bool IsDataTexture(const std::string& name)
+	{
+		size_t slash = name.find_last_of("/\\");
+		std::string file = slash == std::string::npos ? name : name.substr(slash + 1);
+
+		return EndsWith(file, "_normal.dds") || file.compare(0, 5, "alpha") == 0 || file.compare(0, 5, "noise") == 0;
+	}
+
+	// Fills in the levels below the top one for an uncompressed texture that has nothing else, storing
+	// them in levels and pointing image's surfaces at them. The top level is left in the mapping. This
+	// runs on pool tasks, so MipGenerator is given no pool to wait on.
+	bool CompleteMips(const std::string& name, DdsImage& image, std::vector<uint8_t>& levels)
+	{
+		std::vector<DdsSurface> surfaces;
+		std::vector<uint8_t*> pointers;
+		uint32_t mipCount, itemCount, item, level;
+		size_t size, offset;
+
+		mipCount = GetMipLevelCount(image.width, image.height);
+		if (image.mipCount != 1 || mipCount == 1)
+		{
+			return false;
+		}
+
+		switch (image.format)
+		{
+		case DDS_FORMAT_R8G8B8A8_UNORM:
+		case DDS_FORMAT_R8G8B8A8_UNORM_SRGB:
+		case DDS_FORMAT_B8G8R8A8_UNORM:
+		case DDS_FORMAT_B8G8R8A8_UNORM_SRGB:
+		case DDS_FORMAT_B8G8R8X8_UNORM:
+			break;
+		default:
+			return false;
+		}
+
+		// Every level after the first, of every item, in one buffer.
+		itemCount = (uint32_t)image.surfaces.size();
+		surfaces.resize((size_t)itemCount * mipCount);
+		pointers.resize(surfaces.size());
+		size = 0;
+		for (level = 1; level < mipCount; level++)
+		{
+			size += (size_t)std::max(1u, image.width >> level) * std::max(1u, image.height >> level) * 4;
+		}
+		levels.resize(size * itemCount);
+
+		offset = 0;
+		for (item = 0; item < itemCount; item++)
+		{
+			for (level = 0; level < mipCount; level++)
+			{
+				DdsSurface& surface = surfaces[item * mipCount + level];
+
+				if (level == 0)
+				{
+					surface = image.surfaces[item];
+				}
+				else
+				{
+					surface.width = std::max(1u, image.width >> level);
+					surface.height = std::max(1u, image.height >> level);
+					surface.depth = 1;
+					GetDdsSurfacePitch(image.format, surface.width, surface.height, surface.rowPitch, surface.slicePitch);
+					surface.data = reinterpret_cast<const char*>(levels.data() + offset);
+					offset += surface.slicePitch;
+				}
+
+				// The top level is only read, so pointing into the read only mapping is fine.
+				pointers[item * mipCount + level] = reinterpret_cast<uint8_t*>(const_cast<char*>(surface.data));
+			}
+		}
+
+		if (!GenerateMips(pointers.data(), itemCount, image.width, image.height, mipCount, MIP_FILTER_KAISER, !IsDataTexture(name), nullptr))
+		{
+			levels.clear();
+			return false;
+		}
+
+		image.mipCount = mipCount;
+		image.surfaces.swap(surfaces);
+
+		return true;
+	}
+}
+
+bool GetAssetName(const std::wstring& filename, std::string& name)
+{
+	name.clear();
+	name.reserve(filename.size());
+
+	for (wchar_t c : filename)
+	{
+		if (c == 0 || c > 127)
+		{
+			return false;
+		}
+		name.push_back((char)c);
+	}
+
+	return true;
+}
+
+HRESULT CreateTextureFromDds(ID3D11Device* device, const DdsImage& image, uint32_t firstMip, ID3D11ShaderResourceView** texture)
+{
+	D3D11_TEXTURE2D_DESC textureDesc;
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+	std::vector<D3D11_SUBRESOURCE_DATA> initialData;
+	ComPtr<ID3D11Texture2D> resource;
+	uint32_t mipCount, item, level;
+	HRESULT result;
+
+	if (firstMip >= image.mipCount)
+	{
+		return E_INVALIDARG;
+	}
+	mipCount = image.mipCount - firstMip;
+
+	// D3D copies the initial data while creating the texture, so the mapping only has to outlive this call.
+	initialData.resize((size_t)image.arraySize * mipCount);
+	for (item = 0; item < image.arraySize; item++)
+	{
+		for (level = 0; level < mipCount; level++)
+		{
+			const DdsSurface& surface = image.surfaces[item * image.mipCount + firstMip + level];
+			D3D11_SUBRESOURCE_DATA& data = initialData[item * mipCount + level];
+
+			data.pSysMem = surface.data;
+			data.SysMemPitch = (UINT)surface.rowPitch;
+			data.SysMemSlicePitch = (UINT)surface.slicePitch;
+		}
+	}
+
+	ZeroMemory(&textureDesc, sizeof(textureDesc));
+	textureDesc.Width = std::max(1u, image.width >> firstMip);
+	textureDesc.Height = std::max(1u, image.height >> firstMip);
+	textureDesc.MipLevels = mipCount;
+	textureDesc.ArraySize = image.arraySize;
+	textureDesc.Format = (DXGI_FORMAT)image.format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.MiscFlags = image.cube ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+	result = device->CreateTexture2D(&textureDesc, initialData.data(), resource.GetAddressOf());
+	if (FAILED(result))
+	{
+		return result;
+	}
+
+	ZeroMemory(&viewDesc, sizeof(viewDesc));
+	viewDesc.Format = textureDesc.Format;
+	if (image.cube && image.arraySize > 6)
+	{
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+		viewDesc.TextureCubeArray.MipLevels = mipCount;
+		viewDesc.TextureCubeArray.NumCubes = image.arraySize / 6;
+	}
+	else if (image.cube)
+	{
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+		viewDesc.TextureCube.MipLevels = mipCount;
+	}
+	else if (image.arraySize > 1)
+	{
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		viewDesc.Texture2DArray.MipLevels = mipCount;
+		viewDesc.Texture2DArray.ArraySize = image.arraySize;
+	}
+	else
+	{
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		viewDesc.Texture2D.MipLevels = mipCount;
+	}
+
+	return device->CreateShaderResourceView(resource.Get(), &viewDesc, texture);
+}
+
+HRESULT LoadDdsTexture(ID3D11Device* device, const std::wstring& filename, ID3D11ShaderResourceView** texture, bool& fallback, uint64_t& bytes)
+{
+	MappedFile file;
+	DdsImage image;
+	std::vector<uint8_t> levels;
+	std::string name;
+	HRESULT result;
+
+	fallback = false;
+	bytes = 0;
+	if (!GetAssetName(filename, name))
+	{
+		fallback = true;
+		return DirectX::CreateDDSTextureFromFile(device, filename.c_str(), nullptr, texture);
+	}
+	else if (!file.OpenAsset(name.c_str()))
+	{
+		return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+	}
+	else if (ParseDds(file.GetData(), file.GetSize(), image) && image.dimension == DDS_DIMENSION_TEXTURE2D)
+	{
+		CompleteMips(name, image, levels);
+		result = CreateTextureFromDds(device, image, 0, texture);
+		bytes = SUCCEEDED(result) ? file.GetSize() + levels.size() : 0;
+	}
+	else
+	{
+		result = E_FAIL;
+	}
+
+	// DirectXTK converts what ParseDds turns down and picks its own way round what the device
+	// refuses, from the same mapping.
+	if (FAILED(result))
+	{
+		fallback = true;
+		result = DirectX::CreateDDSTextureFromMemory(device, reinterpret_cast<const uint8_t*>(file.GetData()), file.GetSize(), nullptr, texture);
+		bytes = SUCCEEDED(result) ? file.GetSize() : 0;
+	}
+
+	return result;
+}
+
+TextureLoader::TextureLoader()
+{
+	m_device = 0;
+	m_tasks = 0;
+	m_phase = 0;
+}
+
+void TextureLoader::Initialize(ID3D11Device* device, TaskPool& tasks, TaskPhase* phase)
+{
+	m_device = device;
+	m_tasks = &tasks;
+	m_phase = phase;
+	m_requests.clear();
+}
+
+TextureLoader::Handle TextureLoader::Load(const wchar_t* filename, ComPtr<ID3D11ShaderResourceView>* destination)
+{
+	Request* request;
+
+	m_requests.emplace_back();
+	request = &m_requests.back();
+	request->filename = filename;
+	request->destination = destination;
+	request->result = E_PENDING;
+	request->fallback = false;
+	request->bytes = 0;
+	request->milliseconds = 0.0;
+
+	m_tasks->Run([this, request]() { Create(*request); });
+
+	return m_requests.size() - 1;
+}
+
+void TextureLoader::Finish(TextureLoadReport* report)
+{
+	if (report)
+	{
+		report->textureCount = 0;
+		report->failedCount = 0;
+		report->fallbackCount = 0;
+		report->bytes = 0;
+		report->slowestMilliseconds = 0.0;
+		report->slowestFilename.clear();
+	}
+
+	m_tasks->Wait();
+
+	for (Request& request : m_requests)
+	{
+		if (request.destination)
+		{
+			*request.destination = request.texture;
+		}
+
+		if (!report)
+		{
+			continue;
+		}
+
+		report->textureCount++;
+		report->failedCount += FAILED(request.result) ? 1 : 0;
+		report->fallbackCount += request.fallback ? 1 : 0;
+		report->bytes += request.bytes;
+		if (request.milliseconds > report->slowestMilliseconds)
+		{
+			report->slowestMilliseconds = request.milliseconds;
+			report->slowestFilename = request.filename;
+		}
+	}
+}
+
+ID3D11ShaderResourceView* TextureLoader::GetTexture(Handle handle) const
+{
+	return m_requests[handle].texture.Get();
+}
+
+HRESULT TextureLoader::GetResult(Handle handle) const
+{
+	return m_requests[handle].result;
+}
+
+void TextureLoader::Create(Request& request)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	request.result = LoadDdsTexture(m_device, request.filename, request.texture.ReleaseAndGetAddressOf(), request.fallback, request.bytes);
+
+	request.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (m_phase)
+	{
+		m_phase->End();
+	}
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureLoader.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TEXTURELOADER_H_
+#define _TEXTURELOADER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <deque>
+#include <string>
+#include "DdsImage.h"
+#include "TaskPool.h"
+
+struct TextureLoadReport
+{
+	unsigned int textureCount;
+	unsigned int failedCount;
+	unsigned int fallbackCount;		// created by DirectXTK's loader instead, see TextureLoader::Load
+	uint64_t bytes;					// of surface data handed to D3D
+	double slowestMilliseconds;		// the one texture that took longest, mapping to view
+	std::wstring slowestFilename;
+};
+
+// Asset names are plain ASCII; false for anything else, which only DirectXTK's loader opens.
+bool GetAssetName(const std::wstring& filename, std::string& name);
+
+// Creates image's levels from firstMip down as an immutable texture with a view of them all, the
+// initial data pointing straight at image's surfaces.
+HRESULT CreateTextureFromDds(ID3D11Device* device, const DdsImage& image, uint32_t firstMip, ID3D11ShaderResourceView** texture);
+
+// Creates the whole of one .dds texture on the calling thread, the way TextureLoader does. fallback
+// is set when DirectXTK's loader made it and bytes to the surface data handed to D3D.
+HRESULT LoadDdsTexture(ID3D11Device* device, const std::wstring& filename, ID3D11ShaderResourceView** texture, bool& fallback, uint64_t& bytes);
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TextureLoader
+////////////////////////////////////////////////////////////////////////////////
+
+// Creates .dds textures on the task pool, each from its own task: the file, or its asset archive
+// entry, is mapped, its header checked with ParseDds and the texture created with its initial data
+// pointing straight into the mapping, so nothing is copied before D3D does. The device is free
+// threaded, so the textures are created at once and loading takes about as long as the largest.
+//
+// Each Load returns a handle; the texture is in the destination once Finish returns, which is
+// called on the thread that owns the destinations after the pool has been waited on.
+class TextureLoader
+{
+public:
+	typedef size_t Handle;
+
+	TextureLoader();
+
+	// phase, when given, has End called as each texture is created.
+	void Initialize(ID3D11Device* device, TaskPool& tasks, TaskPhase* phase = nullptr);
+
+	// Files DdsImage does not lay out (1D and volume textures, formats needing conversion) and names
+	// that are not plain ASCII go through DirectXTK's loader on the same task instead. Uncompressed
+	// 8 bit RGBA textures that come with only their top level get the rest of the chain built by
+	// MipGenerator on the task first; the cooker builds it offline for everything else.
+	Handle Load(const wchar_t* filename, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* destination = nullptr);
+
+	void Finish(TextureLoadReport* report = nullptr);
+
+	ID3D11ShaderResourceView* GetTexture(Handle handle) const;
+	HRESULT GetResult(Handle handle) const;
+
+private:
+	struct Request
+	{
+		std::wstring filename;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* destination;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture;
+		HRESULT result;
+		bool fallback;
+		uint64_t bytes;
+		double milliseconds;
+	};
+
+	void Create(Request& request);
+
+private:
+	TextureLoader(const TextureLoader&);
+	TextureLoader& operator=(const TextureLoader&);
+
+private:
+	ID3D11Device* m_device;
+	TaskPool* m_tasks;
+	TaskPhase* m_phase;
+	std::deque<Request> m_requests;	// a deque so the tasks' references survive later Loads
+};
+
+#endif
@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureResidency.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "TextureResidency.h"
+
+#include <algorithm>
+
+uint32_t GetTextureTailMip(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t tailSize)
+{
+	uint32_t size = std::max(width, height), mip = 0;
+
+	while (mip + 1 < mipCount && (size >> mip) > tailSize)
+	{
+		mip++;
+	}
+
+	return mip;
+}
+
+uint32_t GetTextureMipForFootprint(uint32_t width, uint32_t height, uint32_t mipCount, float pixelsAcross)
+{
+	uint32_t size = std::max(width, height), mip = 0;
+
+	while (mip + 1 < mipCount && (float)std::max(1u, size >> (mip + 1)) >= pixelsAcross)
+	{
+		mip++;
+	}
+
+	return mip;
+}
+
+TextureResidency::TextureResidency()
+{
+	m_budget = 0;
+	m_resident = 0;
+	m_frame = 0;
+	m_tailSize = 64;
+	m_maxPending = 4;
+	m_pendingCount = 0;
+}
+
+void TextureResidency::Initialize(uint64_t budgetBytes, uint32_t tailSize, uint32_t maxPending)
+{
+	m_textures.clear();
+	m_budget = budgetBytes;
+	m_resident = 0;
+	m_frame = 0;
+	m_tailSize = tailSize;
+	m_maxPending = std::max(1u, maxPending);
+	m_pendingCount = 0;
+}
+
+void TextureResidency::SetBudget(uint64_t budgetBytes)
+{
+	m_budget = budgetBytes;
+}
+
+TextureResidency::Handle TextureResidency::Add(uint32_t width, uint32_t height, uint32_t mipCount, const uint64_t* levelBytes, uint32_t topMip, bool fixed)
+{
+	Texture texture;
+	uint32_t level;
+
+	texture.width = width;
+	texture.height = height;
+	texture.mipCount = std::max(1u, mipCount);
+	texture.tailMip = GetTextureTailMip(width, height, texture.mipCount, m_tailSize);
+	texture.topMip = std::min(topMip, texture.mipCount - 1);
+	texture.targetMip = texture.topMip;
+	texture.wantedMip = texture.topMip;
+	texture.lastUsed = 0;
+	texture.footprint = 0.0f;
+	texture.fixed = fixed;
+	texture.pending = false;
+
+	texture.bytesFrom.resize(texture.mipCount + 1);
+	texture.bytesFrom[texture.mipCount] = 0;
+	for (level = texture.mipCount; level > 0; level--)
+	{
+		texture.bytesFrom[level - 1] = texture.bytesFrom[level] + levelBytes[level - 1];
+	}
+
+	m_textures.push_back(texture);
+	m_resident += GetCharge(m_textures.back());
+
+	return (Handle)(m_textures.size() - 1);
+}
+
+void TextureResidency::BeginFrame()
+{
+	m_frame++;
+}
+
+void TextureResidency::RequestFootprint(Handle texture, float pixelsAcross)
+{
+	Texture& entry = m_textures[texture];
+
+	if (entry.lastUsed != m_frame)
+	{
+		entry.lastUsed = m_frame;
+		entry.footprint = pixelsAcross;
+	}
+	else
+	{
+		entry.footprint = std::max(entry.footprint, pixelsAcross);
+	}
+}
+
+void TextureResidency::Update(std::vector<TextureResidencyChange>& changes)
+{
+	uint64_t available, freeable, need;
+	uint32_t mip;
+	Handle handle, other;
+
+	for (Texture& texture : m_textures)
+	{
+		if (!texture.fixed)
+		{
+			texture.wantedMip = texture.lastUsed == m_frame ?
+				std::min(texture.tailMip, GetTextureMipForFootprint(texture.width, texture.height, texture.mipCount, texture.footprint)) : texture.tailMip;
+		}
+	}
+
+	// A budget lowered below what is held gives the difference back first.
+	if (m_resident > m_budget)
+	{
+		Evict(m_resident - m_budget, (Handle)m_textures.size(), changes);
+	}
+
+	// Textures on screen short of the level they want, the most magnified first: the ones whose top
+	// level has the fewest texels for the pixels it covers.
+	m_order.clear();
+	for (handle = 0; handle < (Handle)m_textures.size(); handle++)
+	{
+		const Texture& texture = m_textures[handle];
+
+		if (!texture.fixed && !texture.pending && texture.lastUsed == m_frame && texture.wantedMip < texture.topMip)
+		{
+			m_order.push_back(handle);
+		}
+	}
+	std::sort(m_order.begin(), m_order.end(), [this](Handle a, Handle b)
+	{
+		const Texture& first = m_textures[a];
+		const Texture& second = m_textures[b];
+
+		return first.footprint / (float)std::max(1u, std::max(first.width, first.height) >> first.topMip) >
+			second.footprint / (float)std::max(1u, std::max(second.width, second.height) >> second.topMip);
+	});
+
+	for (Handle candidate : m_order)
+	{
+		Texture& texture = m_textures[candidate];
+
+		if (m_pendingCount >= m_maxPending)
+		{
+			break;
+		}
+
+		// The finest level short of the one wanted that fits, counting what dropping others would free.
+		available = m_budget > m_resident ? m_budget - m_resident : 0;
+		freeable = 0;
+		for (other = 0; other < (Handle)m_textures.size(); other++)
+		{
+			if (other != candidate)
+			{
+				freeable += GetFreeable(m_textures[other]);
+			}
+		}
+		for (mip = texture.wantedMip; mip < texture.topMip; mip++)
+		{
+			if (texture.bytesFrom[mip] - texture.bytesFrom[texture.topMip] <= available + freeable)
+			{
+				break;
+			}
+		}
+		if (mip == texture.topMip)
+		{
+			continue;
+		}
+
+		need = texture.bytesFrom[mip] - texture.bytesFrom[texture.topMip];
+		if (need > available)
+		{
+			Evict(need - available, candidate, changes);
+		}
+
+		m_resident += need;
+		texture.targetMip = mip;
+		texture.pending = true;
+		m_pendingCount++;
+		changes.push_back({ candidate, mip });
+	}
+}
+
+void TextureResidency::Complete(Handle texture, bool succeeded)
+{
+	Texture& entry = m_textures[texture];
+
+	if (!entry.pending)
+	{
+		return;
+	}
+
+	// A texture that could not be changed keeps what it has for good rather than failing every frame.
+	if (succeeded)
+	{
+		entry.topMip = entry.targetMip;
+	}
+	else
+	{
+		m_resident -= GetCharge(entry);
+		entry.targetMip = entry.topMip;
+		entry.fixed = true;
+		m_resident += GetCharge(entry);
+	}
+
+	entry.pending = false;
+	m_pendingCount--;
+}
+
+uint32_t TextureResidency::GetTopMip(Handle texture) const
+{
+	return m_textures[texture].topMip;
+}
+
+uint32_t TextureResidency::GetWantedMip(Handle texture) const
+{
+	return m_textures[texture].wantedMip;
+}
+
+uint32_t TextureResidency::GetTailMip(Handle texture) const
+{
+	return m_textures[texture].tailMip;
+}
+
+bool TextureResidency::IsPending(Handle texture) const
+{
+	return m_textures[texture].pending;
+}
+
+uint64_t TextureResidency::GetBytes(Handle texture) const
+{
+	return GetCharge(m_textures[texture]);
+}
+
+uint64_t TextureResidency::GetResidentBytes() const
+{
+	return m_resident;
+}
+
+uint64_t TextureResidency::GetBudget() const
+{
+	return m_budget;
+}
+
+uint64_t TextureResidency::GetFrame() const
+{
+	return m_frame;
+}
+
+size_t TextureResidency::GetTextureCount() const
+{
+	return m_textures.size();
+}
+
+// A load counts as the levels it is loading from when it is asked for; a drop as the levels it
+// keeps, as the larger texture goes once the smaller replaces it.
+uint64_t TextureResidency::GetCharge(const Texture& texture) const
+{
+	return texture.bytesFrom[texture.targetMip];
+}
+
+uint64_t TextureResidency::GetFreeable(const Texture& texture) const
+{
+	uint32_t floor = GetFloorMip(texture);
+
+	if (texture.fixed || texture.pending || texture.topMip >= floor)
+	{
+		return 0;
+	}
+
+	return texture.bytesFrom[texture.topMip] - texture.bytesFrom[floor];
+}
+
+// The coarsest top mip a drop may leave: the tail, or for a texture on screen the level it wants.
+uint32_t TextureResidency::GetFloorMip(const Texture& texture) const
+{
+	return texture.lastUsed == m_frame ? texture.wantedMip : texture.tailMip;
+}
+
+// Drops levels from the least recently used textures other than keep, as many from each as it
+// takes, until bytes are freed or nothing else can go. Returns the bytes freed.
+uint64_t TextureResidency::Evict(uint64_t bytes, Handle keep, std::vector<TextureResidencyChange>& changes)
+{
+	std::vector<Handle> victims;
+	uint64_t freed = 0;
+	uint32_t floor, mip;
+	Handle handle;
+
+	for (handle = 0; handle < (Handle)m_textures.size(); handle++)
+	{
+		if (handle != keep && GetFreeable(m_textures[handle]) > 0)
+		{
+			victims.push_back(handle);
+		}
+	}
+	std::sort(victims.begin(), victims.end(), [this](Handle a, Handle b)
+	{
+		const Texture& first = m_textures[a];
+		const Texture& second = m_textures[b];
+
+		if (first.lastUsed != second.lastUsed)
+		{
+			return first.lastUsed < second.lastUsed;
+		}
+		return first.bytesFrom[first.topMip] > second.bytesFrom[second.topMip];
+	});
+
+	for (Handle victim : victims)
+	{
+		Texture& texture = m_textures[victim];
+
+		if (freed >= bytes)
+		{
+			break;
+		}
+
+		floor = GetFloorMip(texture);
+		mip = texture.topMip;
+		while (mip < floor && freed + texture.bytesFrom[texture.topMip] - texture.bytesFrom[mip] < bytes)
+		{
+			mip++;
+		}
+
+		freed += texture.bytesFrom[texture.topMip] - texture.bytesFrom[mip];
+		m_resident -= texture.bytesFrom[texture.topMip] - texture.bytesFrom[mip];
+		texture.targetMip = mip;
+		texture.pending = true;
+		m_pendingCount++;
+		changes.push_back({ victim, mip });
+	}
+
+	return freed;
+}
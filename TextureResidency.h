@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureResidency.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TEXTURERESIDENCY_H_
+#define _TEXTURERESIDENCY_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The largest level of a texture loaded up front: the first at most tailSize texels along its longer
+// side, or the last level when none is that small.
+uint32_t GetTextureTailMip(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t tailSize);
+
+// The level whose texels best match pixelsAcross screen pixels for the texture's longer side: the
+// coarsest with at least that many texels.
+uint32_t GetTextureMipForFootprint(uint32_t width, uint32_t height, uint32_t mipCount, float pixelsAcross);
+
+// Replace texture's levels from topMip down with its levels from topMip down.
+struct TextureResidencyChange
+{
+	uint32_t texture;
+	uint32_t topMip;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TextureResidency
+////////////////////////////////////////////////////////////////////////////////
+
+// Decides which mips of each streamed texture should be in video memory, without touching any; see
+// TextureStreamer for the side that does. A texture holds its levels from its top mip down to the
+// last. Every frame each texture on screen is given its largest footprint, which sets the top mip
+// it wants; Update then asks for the textures short of theirs to be loaded, most magnified first,
+// and when that would take the levels held past the budget drops levels of the least recently used
+// textures to make room. Textures on screen are never dropped below the level they want this frame,
+// so what is in view does not fight over memory, and nothing drops below its tail.
+//
+// A texture being loaded counts as what it is loading from when it is asked for, one being dropped
+// as what it keeps, and either is left alone until Complete. While a change is made both the old
+// and the new texture exist, which maxPending bounds for loads.
+class TextureResidency
+{
+public:
+	typedef uint32_t Handle;
+
+	TextureResidency();
+
+	void Initialize(uint64_t budgetBytes, uint32_t tailSize = 64, uint32_t maxPending = 4);
+	void SetBudget(uint64_t budgetBytes);
+
+	// levelBytes[level] is the size of the level across every array slice or cube face. The texture
+	// starts out holding topMip down. A fixed texture always holds what it starts with; it only
+	// counts against the budget.
+	Handle Add(uint32_t width, uint32_t height, uint32_t mipCount, const uint64_t* levelBytes, uint32_t topMip, bool fixed);
+
+	void BeginFrame();
+
+	// Screen pixels one repeat of the texture covers along its longer side, at its largest this frame.
+	void RequestFootprint(Handle texture, float pixelsAcross);
+
+	// Appends the changes to start, drops first. Each must be answered by Complete.
+	void Update(std::vector<TextureResidencyChange>& changes);
+	void Complete(Handle texture, bool succeeded);
+
+	uint32_t GetTopMip(Handle texture) const;
+	uint32_t GetWantedMip(Handle texture) const;
+	uint32_t GetTailMip(Handle texture) const;
+	bool IsPending(Handle texture) const;
+	uint64_t GetBytes(Handle texture) const;
+	uint64_t GetResidentBytes() const;		// pending changes counted as above
+	uint64_t GetBudget() const;
+	uint64_t GetFrame() const;
+	size_t GetTextureCount() const;
+
+private:
+	struct Texture
+	{
+		uint32_t width, height;
+		uint32_t mipCount;
+		uint32_t tailMip;
+		uint32_t topMip;					// held now
+		uint32_t targetMip;					// held once the pending change completes, topMip when none
+		uint32_t wantedMip;
+		uint64_t lastUsed;					// frame of the last footprint
+		float footprint;
+		bool fixed;
+		bool pending;
+		std::vector<uint64_t> bytesFrom;	// bytesFrom[level], of the levels from level down
+	};
+
+	uint64_t GetCharge(const Texture& texture) const;
+	uint64_t GetFreeable(const Texture& texture) const;
+	uint32_t GetFloorMip(const Texture& texture) const;
+	uint64_t Evict(uint64_t bytes, Handle keep, std::vector<TextureResidencyChange>& changes);
+
+private:
+	std::vector<Texture> m_textures;
+	std::vector<Handle> m_order;		// scratch for Update's sorts
+	uint64_t m_budget;
+	uint64_t m_resident;
+	uint64_t m_frame;
+	uint32_t m_tailSize;
+	uint32_t m_maxPending;
+	uint32_t m_pendingCount;
+};
+
+#endif
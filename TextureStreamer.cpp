@@ -0,0 +1,308 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureStreamer.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "pch.h"
+#include "TextureStreamer.h"
+#include "MappedFile.h"
+
+namespace
+{
+	// A 2D texture with levels below its tail. A block compressed one needs every level that may end
+	// up on top to be a whole number of blocks across.
+	bool CanStream(const DdsImage& image, uint32_t tailMip)
+	{
+		uint32_t level;
+
+		if (image.dimension != DDS_DIMENSION_TEXTURE2D || image.cube || tailMip == 0)
+		{
+			return false;
+		}
+
+		if (IsDdsBlockCompressed(image.format))
+		{
+			for (level = 0; level <= tailMip; level++)
+			{
+				if (((image.width >> level) & 3) != 0 || ((image.height >> level) & 3) != 0 || (image.width >> level) == 0 || (image.height >> level) == 0)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+}
+
+TextureStreamer::TextureStreamer()
+{
+	m_device = 0;
+	m_tasks = 0;
+	m_phase = 0;
+	m_streamingStarted = false;
+	m_budget = 0;
+	m_tailSize = 64;
+	m_loadCount = 0;
+	m_dropCount = 0;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	Shutdown();
+}
+
+void TextureStreamer::Initialize(ID3D11Device* device, TaskPool& tasks, TaskPhase* phase, uint64_t budgetBytes, uint32_t tailSize)
+{
+	Shutdown();
+
+	m_device = device;
+	m_tasks = &tasks;
+	m_phase = phase;
+	m_budget = budgetBytes;
+	m_tailSize = tailSize;
+	m_loadCount = 0;
+	m_dropCount = 0;
+	m_residency.Initialize(budgetBytes, tailSize);
+}
+
+TextureStreamer::Handle TextureStreamer::Load(const wchar_t* filename, bool pinned)
+{
+	Texture* texture;
+
+	m_textures.emplace_back();
+	texture = &m_textures.back();
+	texture->filename = filename;
+	texture->pinned = pinned;
+	texture->streamed = false;
+	texture->fallback = false;
+	texture->width = 0;
+	texture->height = 0;
+	texture->mipCount = 0;
+	texture->topMip = 0;
+	texture->bytes = 0;
+	texture->milliseconds = 0.0;
+	texture->result = E_PENDING;
+	texture->finished = false;
+
+	m_tasks->Run([this, texture]() { Create(*texture); });
+
+	return (Handle)(m_textures.size() - 1);
+}
+
+void TextureStreamer::Finish(TextureLoadReport* report)
+{
+	if (report)
+	{
+		report->textureCount = 0;
+		report->failedCount = 0;
+		report->fallbackCount = 0;
+		report->bytes = 0;
+		report->slowestMilliseconds = 0.0;
+		report->slowestFilename.clear();
+	}
+
+	m_tasks->Wait();
+
+	// Handed to the residency in Load order, so its handles are the same as these.
+	for (Texture& texture : m_textures)
+	{
+		if (texture.streamed)
+		{
+			m_residency.Add(texture.width, texture.height, texture.mipCount, texture.levelBytes.data(), texture.topMip, false);
+		}
+		else
+		{
+			m_residency.Add(1, 1, 1, &texture.bytes, 0, true);
+		}
+
+		if (!report)
+		{
+			continue;
+		}
+
+		report->textureCount++;
+		report->failedCount += FAILED(texture.result) ? 1 : 0;
+		report->fallbackCount += texture.fallback ? 1 : 0;
+		report->bytes += texture.bytes;
+		if (texture.milliseconds > report->slowestMilliseconds)
+		{
+			report->slowestMilliseconds = texture.milliseconds;
+			report->slowestFilename = texture.filename;
+		}
+	}
+
+	// One thread of its own, so recreating a texture never holds up a frame.
+	m_streaming.Initialize(2);
+	m_streamingStarted = true;
+}
+
+void TextureStreamer::Shutdown()
+{
+	if (m_streamingStarted)
+	{
+		m_streaming.Wait();
+		m_streaming.Shutdown();
+		m_streamingStarted = false;
+	}
+
+	m_textures.clear();
+	m_changes.clear();
+	m_residency.Initialize(m_budget, m_tailSize);
+}
+
+void TextureStreamer::SetBudget(uint64_t budgetBytes)
+{
+	m_budget = budgetBytes;
+	m_residency.SetBudget(budgetBytes);
+}
+
+void TextureStreamer::BeginFrame()
+{
+	m_residency.BeginFrame();
+}
+
+void TextureStreamer::RequestFootprint(Handle texture, float pixelsAcross)
+{
+	if (texture < m_residency.GetTextureCount())
+	{
+		m_residency.RequestFootprint(texture, pixelsAcross);
+	}
+}
+
+void TextureStreamer::Update()
+{
+	Handle handle;
+
+	if (!m_streamingStarted)
+	{
+		return;
+	}
+
+	// The old texture goes with its view, once the context is done with it.
+	for (handle = 0; handle < (Handle)m_textures.size(); handle++)
+	{
+		Texture& texture = m_textures[handle];
+
+		if (!m_residency.IsPending(handle) || !texture.finished.load(std::memory_order_acquire))
+		{
+			continue;
+		}
+
+		texture.finished.store(false, std::memory_order_relaxed);
+		if (SUCCEEDED(texture.result))
+		{
+			texture.view.Swap(texture.next);
+		}
+		texture.next.Reset();
+		m_residency.Complete(handle, SUCCEEDED(texture.result));
+		texture.topMip = m_residency.GetTopMip(handle);
+	}
+
+	m_changes.clear();
+	m_residency.Update(m_changes);
+	for (const TextureResidencyChange& change : m_changes)
+	{
+		Texture* texture = &m_textures[change.texture];
+		uint32_t topMip = change.topMip;
+
+		if (topMip < texture->topMip)
+		{
+			m_loadCount++;
+		}
+		else
+		{
+			m_dropCount++;
+		}
+		m_streaming.Run([this, texture, topMip]() { Recreate(*texture, topMip); });
+	}
+}
+
+ID3D11ShaderResourceView* TextureStreamer::Get(Handle texture) const
+{
+	return texture < m_textures.size() ? m_textures[texture].view.Get() : nullptr;
+}
+
+void TextureStreamer::GetStats(TextureStreamStats& stats) const
+{
+	Handle handle;
+
+	stats.textureCount = (unsigned int)m_textures.size();
+	stats.streamedCount = 0;
+	stats.pendingCount = 0;
+	for (handle = 0; handle < (Handle)m_residency.GetTextureCount(); handle++)
+	{
+		stats.streamedCount += m_textures[handle].streamed ? 1 : 0;
+		stats.pendingCount += m_residency.IsPending(handle) ? 1 : 0;
+	}
+	stats.loadCount = m_loadCount;
+	stats.dropCount = m_dropCount;
+	stats.residentBytes = m_residency.GetResidentBytes();
+	stats.budgetBytes = m_residency.GetBudget();
+}
+
+// Runs on the startup pool: the tail of a texture that streams, the whole of any other.
+void TextureStreamer::Create(Texture& texture)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	MappedFile file;
+	DdsImage image;
+	std::string name;
+	uint32_t tailMip, item, level;
+
+	if (!texture.pinned && GetAssetName(texture.filename, name) && file.OpenAsset(name.c_str()) && ParseDds(file.GetData(), file.GetSize(), image))
+	{
+		tailMip = GetTextureTailMip(image.width, image.height, image.mipCount, m_tailSize);
+		if (CanStream(image, tailMip))
+		{
+			texture.result = CreateTextureFromDds(m_device, image, tailMip, texture.view.ReleaseAndGetAddressOf());
+			if (SUCCEEDED(texture.result))
+			{
+				texture.streamed = true;
+				texture.width = image.width;
+				texture.height = image.height;
+				texture.mipCount = image.mipCount;
+				texture.topMip = tailMip;
+				texture.levelBytes.assign(image.mipCount, 0);
+				for (item = 0; item < image.arraySize; item++)
+				{
+					for (level = 0; level < image.mipCount; level++)
+					{
+						texture.levelBytes[level] += image.surfaces[item * image.mipCount + level].slicePitch;
+					}
+				}
+				for (level = tailMip; level < image.mipCount; level++)
+				{
+					texture.bytes += texture.levelBytes[level];
+				}
+			}
+		}
+	}
+	file.Close();
+
+	if (!texture.streamed)
+	{
+		texture.result = LoadDdsTexture(m_device, texture.filename, texture.view.ReleaseAndGetAddressOf(), texture.fallback, texture.bytes);
+	}
+
+	texture.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (m_phase)
+	{
+		m_phase->End();
+	}
+}
+
+// Runs on the streaming thread: the levels from topMip down, mapped again for the purpose.
+void TextureStreamer::Recreate(Texture& texture, uint32_t topMip)
+{
+	MappedFile file;
+	DdsImage image;
+	std::string name;
+
+	texture.result = E_FAIL;
+	if (GetAssetName(texture.filename, name) && file.OpenAsset(name.c_str()) && ParseDds(file.GetData(), file.GetSize(), image) &&
+		image.mipCount == texture.mipCount)
+	{
+		texture.result = CreateTextureFromDds(m_device, image, topMip, texture.next.ReleaseAndGetAddressOf());
+	}
+
+	texture.finished.store(true, std::memory_order_release);
+}
@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureStreamer.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TEXTURESTREAMER_H_
+#define _TEXTURESTREAMER_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+#include "TaskPool.h"
+#include "TextureLoader.h"
+#include "TextureResidency.h"
+
+struct TextureStreamStats
+{
+	unsigned int textureCount;
+	unsigned int streamedCount;		// with levels that come and go, the rest are held whole
+	unsigned int pendingCount;		// being recreated on the streaming thread
+	unsigned int loadCount;			// recreations that added levels, since Finish
+	unsigned int dropCount;			// and that dropped them
+	uint64_t residentBytes;
+	uint64_t budgetBytes;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TextureStreamer
+////////////////////////////////////////////////////////////////////////////////
+
+// Owns the scene's textures and keeps in video memory only the mips what is on screen needs, within
+// a budget; TextureResidency makes the decisions, this carries them out. Load queues a texture on
+// the startup pool like TextureLoader::Load does, but a texture with a mip chain is created from its
+// tail alone, the levels of at most tailSize texels, so startup uploads a small part of the data.
+// Cube maps, textures without mips, ones DirectXTK's loader lays out and ones loaded pinned are
+// created whole and only count against the budget.
+//
+// Every frame the game calls BeginFrame, RequestFootprint for what it draws and then Update, which
+// puts in place the textures the streaming thread has finished and starts the next changes. A D3D11
+// texture cannot gain or lose levels, so a change creates a new texture of the levels from its new
+// top mip on the streaming thread, from the mapped file, and the view is replaced by a later Update.
+// A view from Get stays valid until the next Update.
+class TextureStreamer
+{
+public:
+	typedef uint32_t Handle;
+
+	TextureStreamer();
+	~TextureStreamer();
+
+	// phase, when given, has End called as each texture is created.
+	void Initialize(ID3D11Device* device, TaskPool& tasks, TaskPhase* phase, uint64_t budgetBytes, uint32_t tailSize = 64);
+	Handle Load(const wchar_t* filename, bool pinned = false);
+
+	// Waits for the startup pool and starts the streaming thread.
+	void Finish(TextureLoadReport* report = nullptr);
+	void Shutdown();
+
+	void SetBudget(uint64_t budgetBytes);
+	void BeginFrame();
+	void RequestFootprint(Handle texture, float pixelsAcross);	// see TextureResidency
+	void Update();
+
+	ID3D11ShaderResourceView* Get(Handle texture) const;
+	void GetStats(TextureStreamStats& stats) const;
+
+private:
+	struct Texture
+	{
+		std::wstring filename;
+		bool pinned;
+		bool streamed;
+		bool fallback;
+		uint32_t width, height;
+		uint32_t mipCount;
+		uint32_t topMip;
+		std::vector<uint64_t> levelBytes;			// streamed textures, across every slice
+		uint64_t bytes;								// handed to D3D at startup
+		double milliseconds;
+		HRESULT result;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> next;	// written by the streaming thread
+		std::atomic<bool> finished;					// next and result are ready
+	};
+
+	void Create(Texture& texture);
+	void Recreate(Texture& texture, uint32_t topMip);
+
+private:
+	TextureStreamer(const TextureStreamer&);
+	TextureStreamer& operator=(const TextureStreamer&);
+
+private:
+	ID3D11Device* m_device;
+	TaskPool* m_tasks;
+	TaskPhase* m_phase;
+	TaskPool m_streaming;
+	bool m_streamingStarted;
+	TextureResidency m_residency;
+	std::deque<Texture> m_textures;		// a deque so the tasks' references survive later Loads
+	std::vector<TextureResidencyChange> m_changes;
+	uint64_t m_budget;
+	uint32_t m_tailSize;
+	unsigned int m_loadCount;
+	unsigned int m_dropCount;
+};
+
+#endif
@@ -0,0 +1,660 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: AssetCooker.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Offline cooker for the scene meshes. Parses every .obj once, builds each layout the game
+// draws it with and writes the cooked .mesh blobs the runtime maps instead of parsing, plus a
+// manifest listing what was written.
+//
+//   AssetCooker [-j threads] [-q depth] [-d directory] [-m manifest] [-n] [-l] [-c] [-p] [file.obj ...]
+//
+// Without file arguments the scene's own mesh list is cooked from the directory (default ".").
+// Files named on the command line get the plain, packed normal mapped and shadow layouts. -n skips the vertex cache, overdraw and
+// vertex fetch optimisation, -l the levels of detail, -c the clusters, -p the shadow caster proxies
+// (the shadow layout simplified to half a shadow map texel, see BuildShadowProxy). Scene meshes that are another
+// scene mesh moved rigidly get an .instance record naming it instead of blobs of their own. The .obj
+// files are read in one batch with up to -q reads in flight (32 by default), see AsyncFileReader.h.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include "AsyncFileReader.h"
+#include "CookedMesh.h"
+#include "MeshBuilder.h"
+#include "ObjParser.h"
+
+namespace
+{
+	const unsigned int LAYOUT_PLAIN = 1 << MESH_LAYOUT_PLAIN;
+	const unsigned int LAYOUT_NORMALMAP = 1 << MESH_LAYOUT_NORMALMAP_PACKED;	// what the normal mapped shaders read
+	const unsigned int LAYOUT_SHADOWMAP = 1 << MESH_LAYOUT_SHADOWMAP;
+	const unsigned int LAYOUT_ALL = LAYOUT_PLAIN | LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP;
+
+	struct SceneMesh
+	{
+		const char* filename;
+		unsigned int layouts;
+		bool instanced;		// drawn through its instance transform, so it may share another mesh's buffers
+	};
+
+	// Mirrors the QueueModelVariants calls in Game::CreateDeviceDependentResources. Models with a
+	// normal mapped variant get no plain blob: the game defers that variant and builds it from the
+	// normal mapped vertex buffers (Game::BuildDeferredVariants).
+	const SceneMesh s_sceneMeshes[] =
+	{
+		{ "ground_box.obj", LAYOUT_NORMALMAP, false },
+		{ "mountain1.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "mountain2.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "glacier1.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "glacier2.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "deadwood1.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "deadwood2.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "deadwood3.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "deadwood4.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "deadwood5.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "deadwood6.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "deadwood7.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "deadwood8.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "deadwood9.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "igloo.obj", LAYOUT_PLAIN | LAYOUT_SHADOWMAP, false },
+		{ "crow.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "camp_snow.obj", LAYOUT_PLAIN | LAYOUT_SHADOWMAP, false },
+		{ "camp_stones.obj", LAYOUT_PLAIN | LAYOUT_SHADOWMAP, false },
+		{ "camp_tree_stones.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "camp_deadwood.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, true },
+		{ "ice_border.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "ice.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "estus.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "bf_stones.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "bf_ash.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "bf_skulls.obj", LAYOUT_NORMALMAP | LAYOUT_SHADOWMAP, false },
+		{ "bf_bones.obj", LAYOUT_PLAIN | LAYOUT_SHADOWMAP, false },
+		{ "bf_blade.obj", LAYOUT_PLAIN | LAYOUT_SHADOWMAP, false },
+		{ "bf_hilt.obj", LAYOUT_PLAIN | LAYOUT_SHADOWMAP, false },
+		{ "foliage_deadbush1.obj", LAYOUT_PLAIN, false },
+		{ "foliage_deadbush2.obj", LAYOUT_PLAIN, false },
+		{ "foliage_deadbush3.obj", LAYOUT_PLAIN, false },
+		{ "foliage_fern.obj", LAYOUT_PLAIN, false },
+		{ "foliage_grass1.obj", LAYOUT_PLAIN, true },
+		{ "foliage_grass2.obj", LAYOUT_PLAIN, true },
+		{ "foliage_grass3.obj", LAYOUT_PLAIN, true },
+		{ "foliage_grass4.obj", LAYOUT_PLAIN, true },
+		{ "foliage_grass5.obj", LAYOUT_PLAIN, false },
+		{ "foliage_grass6.obj", LAYOUT_PLAIN, false },
+		{ "foliage_grass7.obj", LAYOUT_PLAIN, false },
+		{ "foliage_grass8.obj", LAYOUT_PLAIN, false },
+		{ "foliage_grass9.obj", LAYOUT_PLAIN, false },
+	};
+
+	const char* s_layoutNames[MESH_LAYOUT_COUNT] = { "plain", "nm32", "sm", "nm" };
+
+	struct CookedLayout
+	{
+		MeshLayout layout;
+		std::string path;
+		unsigned int unrolledVertexCount;
+		unsigned int vertexCount;
+		unsigned int indexCount;
+		unsigned long long rawBytes;	// the blob written without encoding
+		unsigned long long bytes;		// as written
+		double decodeMilliseconds;		// opening the written blob, decoding included
+		MeshCookReport report;
+		std::vector<MeshLod> lods;
+	};
+
+	struct CookJob
+	{
+		std::string filename;
+		unsigned int layouts;
+		bool instanced;		// the game draws it through an instance transform, so it may share an earlier job's blobs
+
+		bool succeeded;
+		std::string error;
+		CookedMeshSource source;
+		double parseMilliseconds;
+		double cookMilliseconds;
+		std::vector<CookedLayout> outputs;
+
+		ObjMesh obj;		// parsed, released once cooked
+		uint64_t instanceKey;
+		int reference;		// job this one is an instance of, -1 when it is cooked itself
+		float transform[16];
+		float instanceError;
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	unsigned long long GetCookedSize(const MeshData& mesh)
+	{
+		CookedMeshHeader header;
+		unsigned long long vertexBytes = (unsigned long long)mesh.vertexCount * mesh.vertexStride;
+		unsigned long long indexBytes = (unsigned long long)mesh.indices.size() * GetIndexSize(mesh.vertexCount);
+		unsigned long long clusterBytes = (unsigned long long)mesh.clusters.size() * sizeof(MeshCluster);
+
+		// Same 16 byte alignment WriteCookedMesh uses between the sections.
+		return ((sizeof(header) + 15) & ~15ull) + ((vertexBytes + 15) & ~15ull) + ((indexBytes + 15) & ~15ull) + clusterBytes;
+	}
+
+	void ParseFile(CookJob& job, const char* data, size_t size)
+	{
+		Clock::time_point start;
+
+		job.succeeded = false;
+		job.parseMilliseconds = 0.0;
+		job.cookMilliseconds = 0.0;
+		job.reference = -1;
+
+		if (!data || !GetCookedMeshSource(job.filename.c_str(), data, size, job.source))
+		{
+			job.error = "cannot open";
+			return;
+		}
+
+		// Files are parsed in parallel already, so each parse stays on its worker.
+		start = Clock::now();
+		if (!ParseObj(data, size, job.obj, 1))
+		{
+			job.error = "parse failed";
+			return;
+		}
+		job.parseMilliseconds = MillisecondsSince(start);
+
+		job.instanceKey = CalculateInstanceKey(job.obj);
+		job.succeeded = true;
+
+		return;
+	}
+
+	// In scene order, so a reference is always loaded before the instances that share it. A
+	// reference has to be cooked itself and have every layout its instances are drawn with.
+	void FindInstances(std::vector<CookJob>& jobs)
+	{
+		size_t job, reference;
+
+		for (job = 0; job < jobs.size(); job++)
+		{
+			if (!jobs[job].succeeded || !jobs[job].instanced)
+			{
+				continue;
+			}
+
+			for (reference = 0; reference < job; reference++)
+			{
+				const CookJob& candidate = jobs[reference];
+
+				if (!candidate.succeeded || candidate.reference >= 0 || candidate.instanceKey != jobs[job].instanceKey ||
+					(jobs[job].layouts & ~candidate.layouts) != 0)
+				{
+					continue;
+				}
+
+				if (FindRigidTransform(candidate.obj, jobs[job].obj, jobs[job].transform, &jobs[job].instanceError))
+				{
+					jobs[job].reference = (int)reference;
+					break;
+				}
+			}
+		}
+
+		return;
+	}
+
+	// Opens a blob just written the way the game does and checks it gives back mesh exactly.
+	bool VerifyCookedMesh(CookedLayout& output, const MeshData& mesh, const CookedMeshSource& source)
+	{
+		CookedMeshFile file;
+		std::vector<unsigned char> indices;
+		unsigned int indexSize;
+		struct stat info;
+		Clock::time_point start;
+
+		if (stat(output.path.c_str(), &info) != 0)
+		{
+			return false;
+		}
+		output.bytes = (unsigned long long)info.st_size;
+
+		start = Clock::now();
+		if (!file.Open(output.path.c_str(), source))
+		{
+			return false;
+		}
+		output.decodeMilliseconds = MillisecondsSince(start);
+
+		indexSize = GetIndexSize(mesh.vertexCount);
+		indices.resize(mesh.indices.size() * indexSize);
+		PackIndices(mesh.indices.data(), mesh.indices.size(), indexSize, indices.data());
+
+		return memcmp(file.GetVertices(), mesh.vertices.data(), mesh.vertices.size()) == 0 &&
+			memcmp(file.GetIndices(), indices.data(), indices.size()) == 0;
+	}
+
+	void CookFile(CookJob& job, const std::vector<CookJob>& jobs, const MeshCookOptions& options, CookedMeshEncoding encoding)
+	{
+		Clock::time_point start;
+		MeshData mesh;
+		int layout;
+
+		if (!job.succeeded)
+		{
+			return;
+		}
+		job.succeeded = false;
+
+		start = Clock::now();
+
+		// An instance gets its record, and blobs left over from before it was one are removed.
+		if (job.reference >= 0)
+		{
+			const CookJob& reference = jobs[job.reference];
+
+			if (!WriteMeshInstance(job.filename.c_str(), job.source, reference.filename.c_str(), reference.source, job.transform))
+			{
+				job.error = "cannot write " + GetMeshInstancePath(job.filename.c_str());
+				return;
+			}
+
+			for (layout = 0; layout < MESH_LAYOUT_COUNT; layout++)
+			{
+				remove(GetCookedMeshPath(job.filename.c_str(), (MeshLayout)layout).c_str());
+			}
+
+			job.cookMilliseconds = MillisecondsSince(start);
+			job.succeeded = true;
+			return;
+		}
+
+		remove(GetMeshInstancePath(job.filename.c_str()).c_str());
+
+		for (layout = 0; layout < MESH_LAYOUT_COUNT; layout++)
+		{
+			CookedLayout output;
+
+			if (!(job.layouts & (1u << layout)))
+			{
+				continue;
+			}
+
+			if (!CookMesh(job.obj, (MeshLayout)layout, options, mesh, &output.report))
+			{
+				job.error = "build failed";
+				return;
+			}
+
+			output.layout = (MeshLayout)layout;
+			output.path = GetCookedMeshPath(job.filename.c_str(), (MeshLayout)layout);
+			output.unrolledVertexCount = mesh.unrolledVertexCount;
+			output.vertexCount = mesh.vertexCount;
+			output.indexCount = (unsigned int)mesh.indices.size();
+			output.rawBytes = GetCookedSize(mesh);
+			output.lods = mesh.lods;
+
+			if (!WriteCookedMesh(output.path.c_str(), mesh, job.source, encoding))
+			{
+				job.error = "cannot write " + output.path;
+				return;
+			}
+
+			if (!VerifyCookedMesh(output, mesh, job.source))
+			{
+				job.error = "cannot read back " + output.path;
+				return;
+			}
+
+			job.outputs.push_back(output);
+		}
+		job.cookMilliseconds = MillisecondsSince(start);
+
+		job.succeeded = true;
+
+		return;
+	}
+
+	// Runs work on every job, taking them in order.
+	template <typename Work>
+	void ForEachJob(std::vector<CookJob>& jobs, const std::vector<size_t>& order, unsigned int threadCount, Work work)
+	{
+		std::vector<std::thread> workers;
+		std::atomic<size_t> next(0);
+		unsigned int i;
+
+		auto worker = [&jobs, &order, &next, &work]()
+		{
+			size_t index;
+			while ((index = next++) < order.size())
+			{
+				work(jobs[order[index]]);
+			}
+		};
+
+		threadCount = std::max(1u, std::min(threadCount, (unsigned int)jobs.size()));
+		for (i = 1; i < threadCount; i++)
+		{
+			workers.push_back(std::thread(worker));
+		}
+		worker();
+
+		for (std::thread& thread : workers)
+		{
+			thread.join();
+		}
+
+		return;
+	}
+
+	void CookAll(std::vector<CookJob>& jobs, const MeshCookOptions& options, CookedMeshEncoding encoding, unsigned int threadCount,
+		unsigned int queueDepth, AsyncReadStats& readStats, bool& readWithIoUring)
+	{
+		TaskPool tasks;
+		AsyncFileReader reader;
+		unsigned int i;
+
+		// Largest files first so one big mesh does not start last and hold up the whole run.
+		std::vector<size_t> order(jobs.size());
+		std::vector<unsigned long long> sizes(jobs.size());
+		for (i = 0; i < jobs.size(); i++)
+		{
+			struct stat info;
+			order[i] = i;
+			sizes[i] = (stat(jobs[i].filename.c_str(), &info) == 0) ? (unsigned long long)info.st_size : 0;
+		}
+		std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+		// Every file is parsed before any is cooked, so duplicates are found across the whole scene.
+		// The files are read in one batch with many reads in flight, each parsed as soon as it is in.
+		tasks.Initialize(std::max(1u, std::min(threadCount, (unsigned int)jobs.size())));
+		reader.Initialize(tasks, queueDepth);
+		for (size_t index : order)
+		{
+			CookJob* job = &jobs[index];
+			reader.Queue(job->filename.c_str(), [job](const char* data, size_t size) { ParseFile(*job, data, size); });
+		}
+		reader.Flush();
+		readStats = reader.GetStats();
+		readWithIoUring = reader.IsUsingIoUring();
+		reader.Shutdown();
+		tasks.Shutdown();
+
+		FindInstances(jobs);
+
+		ForEachJob(jobs, order, threadCount, [&jobs, &options, encoding](CookJob& job) { CookFile(job, jobs, options, encoding); });
+
+		for (CookJob& job : jobs)
+		{
+			job.obj.Clear();
+		}
+
+		return;
+	}
+
+	bool WriteManifest(const char* path, const std::vector<CookJob>& jobs)
+	{
+		FILE* file;
+
+		file = fopen(path, "w");
+		if (!file)
+		{
+			return false;
+		}
+
+		fprintf(file, "# AssetCooker mesh manifest, cooked mesh version %u\n", COOKED_MESH_VERSION);
+		fprintf(file, "# source source_size source_mtime source_hash layout cooked unrolled_vertices vertices indices cooked_size\n");
+		fprintf(file, "# an instance of another mesh lists its record as layout \"instance\"\n");
+
+		for (const CookJob& job : jobs)
+		{
+			if (!job.succeeded)
+			{
+				continue;
+			}
+
+			if (job.reference >= 0)
+			{
+				fprintf(file, "%s %llu %lld %016llx instance %s 0 0 0 %llu\n", job.filename.c_str(),
+					(unsigned long long)job.source.size, (long long)job.source.modifiedTime, (unsigned long long)job.source.hash,
+					GetMeshInstancePath(job.filename.c_str()).c_str(), (unsigned long long)sizeof(MeshInstanceRecord));
+			}
+
+			for (const CookedLayout& output : job.outputs)
+			{
+				fprintf(file, "%s %llu %lld %016llx %s %s %u %u %u %llu\n", job.filename.c_str(),
+					(unsigned long long)job.source.size, (long long)job.source.modifiedTime, (unsigned long long)job.source.hash,
+					s_layoutNames[output.layout], output.path.c_str(), output.unrolledVertexCount, output.vertexCount, output.indexCount, output.bytes);
+			}
+		}
+
+		return fclose(file) == 0;
+	}
+
+	void PrintUsage()
+	{
+		fprintf(stderr, "usage: AssetCooker [-j threads] [-q depth] [-d directory] [-m manifest] [-n] [-l] [-c] [-p] [-r | -u] [file.obj ...]\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<CookJob> jobs;
+	MeshCookOptions options;
+	CookedMeshEncoding encoding = COOKED_MESH_COMPRESSED;
+	std::string directory = ".";
+	std::string manifest;
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	unsigned int queueDepth = 32;
+	AsyncReadStats readStats;
+	bool readWithIoUring = false;
+	unsigned long long totalSource = 0, totalCooked = 0, totalRaw = 0, totalStored = 0;
+	double totalDecode = 0.0;
+	Clock::time_point start;
+	int failures = 0, instances = 0;
+	int i;
+
+	options.optimize = true;
+	options.generateLods = true;
+	options.buildClusters = true;
+	options.shadowProxyError = MESH_SHADOW_PROXY_ERROR;
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((!strcmp(argv[i], "-j") || !strcmp(argv[i], "-q") || !strcmp(argv[i], "-d") || !strcmp(argv[i], "-m")) && i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "-j"))
+		{
+			threadCount = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-q"))
+		{
+			queueDepth = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-d"))
+		{
+			directory = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-m"))
+		{
+			manifest = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-n"))
+		{
+			options.optimize = false;
+		}
+		else if (!strcmp(argv[i], "-l"))
+		{
+			options.generateLods = false;
+		}
+		else if (!strcmp(argv[i], "-c"))
+		{
+			options.buildClusters = false;
+		}
+		else if (!strcmp(argv[i], "-p"))
+		{
+			options.shadowProxyError = 0.0f;
+		}
+		else if (!strcmp(argv[i], "-r"))
+		{
+			encoding = COOKED_MESH_RAW;
+		}
+		else if (!strcmp(argv[i], "-u"))
+		{
+			encoding = COOKED_MESH_ENCODED;
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			CookJob job;
+			job.filename = argv[i];
+			job.layouts = LAYOUT_ALL;
+			job.instanced = false;
+			jobs.push_back(job);
+		}
+	}
+
+	if (jobs.empty())
+	{
+		for (const SceneMesh& mesh : s_sceneMeshes)
+		{
+			CookJob job;
+			job.filename = directory + "/" + mesh.filename;
+			job.layouts = mesh.layouts;
+			job.instanced = mesh.instanced;
+			jobs.push_back(job);
+		}
+	}
+
+	if (manifest.empty())
+	{
+		manifest = directory + "/meshes.manifest";
+	}
+
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+
+	start = Clock::now();
+	CookAll(jobs, options, encoding, threadCount, queueDepth, readStats, readWithIoUring);
+	double wallMilliseconds = MillisecondsSince(start);
+
+	printf("%-40s %12s %9s %9s %12s\n", "source", "obj bytes", "parse ms", "cook ms", "cooked bytes");
+	printf("    %-6s %-26s %-16s %-16s %-36s %s\n", "layout", "vertices (weld reduction)", "ACMR", "ATVR", "bytes raw -> stored (decode ms)",
+		"max quantization error");
+	printf("           %s\n", "triangles per level of detail (max error in model units)");
+	for (const CookJob& job : jobs)
+	{
+		unsigned long long cooked = 0;
+
+		if (!job.succeeded)
+		{
+			printf("%-40s FAILED: %s\n", job.filename.c_str(), job.error.c_str());
+			failures++;
+			continue;
+		}
+
+		for (const CookedLayout& output : job.outputs)
+		{
+			cooked += output.bytes;
+			totalRaw += output.rawBytes;
+			totalStored += output.bytes;
+			totalDecode += output.decodeMilliseconds;
+		}
+
+		if (job.reference >= 0)
+		{
+			cooked = sizeof(MeshInstanceRecord);
+			instances++;
+		}
+
+		totalSource += job.source.size;
+		totalCooked += cooked;
+
+		printf("%-40s %12llu %9.2f %9.2f %12llu\n", job.filename.c_str(), (unsigned long long)job.source.size,
+			job.parseMilliseconds, job.cookMilliseconds, cooked);
+
+		if (job.reference >= 0)
+		{
+			printf("    instance of %s, translation %.3f %.3f %.3f, max error %.6f\n", jobs[job.reference].filename.c_str(),
+				job.transform[12], job.transform[13], job.transform[14], job.instanceError);
+		}
+
+		for (const CookedLayout& output : job.outputs)
+		{
+			char weld[64], size[64];
+
+			snprintf(weld, sizeof(weld), "%u -> %u (%.2fx)", output.unrolledVertexCount, output.vertexCount,
+				output.vertexCount ? (double)output.unrolledVertexCount / output.vertexCount : 0.0);
+			snprintf(size, sizeof(size), "%llu -> %llu (%.2f)", output.rawBytes, output.bytes, output.decodeMilliseconds);
+
+			if (options.optimize)
+			{
+				const MeshOptimizeReport& report = output.report.optimize;
+				printf("    %-6s %-26s %5.3f -> %5.3f   %5.3f -> %5.3f   %-36s", s_layoutNames[output.layout], weld,
+					report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr, size);
+			}
+			else
+			{
+				printf("    %-6s %-26s %-16s %-16s %-36s", s_layoutNames[output.layout], weld, "", "", size);
+			}
+
+			if (output.layout == MESH_LAYOUT_NORMALMAP_PACKED)
+			{
+				const QuantizationError& error = output.report.quantization;
+				printf(" position %.5f uv %.6f normal %.3f tangent %.3f binormal %.2f deg", error.position, error.texture,
+					error.normalDegrees, error.tangentDegrees, error.binormalDegrees);
+			}
+			if (output.layout == MESH_LAYOUT_SHADOWMAP && options.shadowProxyError > 0.0f)
+			{
+				const ShadowProxyReport& proxy = output.report.shadowProxy;
+				printf(" proxy %u -> %u triangles, %u -> %u vertices, error %.4f", proxy.sourceTriangleCount,
+					output.lods.empty() ? output.indexCount / 3 : output.lods[0].indexCount / 3, proxy.sourceVertexCount, output.vertexCount, proxy.error);
+			}
+			printf("\n");
+
+			if (output.lods.size() > 1 || (output.lods.size() == 1 && output.lods[0].clusterCount > 0))
+			{
+				printf("           ");
+				for (const MeshLod& lod : output.lods)
+				{
+					printf(" %u (%.4f, %u clusters)", lod.indexCount / 3, lod.error, lod.clusterCount);
+				}
+				printf("\n");
+			}
+		}
+	}
+
+	printf("%d files (%d instances), %llu obj bytes -> %llu cooked bytes, %.2f ms on %u threads\n", (int)jobs.size() - failures,
+		instances, totalSource, totalCooked, wallMilliseconds, std::max(1u, std::min(threadCount, (unsigned int)jobs.size())));
+	printf("read %u .obj files, %.1f MB in %.2f ms (%.0f MB/s) through %s, queue depth up to %u, %.1f on average\n", readStats.fileCount,
+		readStats.bytes / (1024.0 * 1024.0), readStats.milliseconds, readStats.milliseconds > 0.0 ? readStats.bytes / (readStats.milliseconds * 1e3) : 0.0,
+		readWithIoUring ? "io_uring" : "reader threads", readStats.maxQueueDepth, readStats.averageQueueDepth);
+	printf("mesh blobs %llu bytes raw -> %llu stored (%.2fx), read back in %.2f ms of one thread each (%.2f GB/s)\n", totalRaw, totalStored,
+		totalStored ? (double)totalRaw / totalStored : 0.0, totalDecode, totalDecode > 0.0 ? totalRaw / (totalDecode * 1e6) : 0.0);
+
+	if (!WriteManifest(manifest.c_str(), jobs))
+	{
+		fprintf(stderr, "cannot write manifest %s\n", manifest.c_str());
+		return 1;
+	}
+
+	return failures ? 1 : 0;
+}
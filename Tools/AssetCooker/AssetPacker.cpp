@@ -0,0 +1,244 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: AssetPacker.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Packs everything the game loads by name into the one archive it maps at startup (see
+// AssetArchive.h). Run it from the folder holding the assets once AssetCooker has cooked the
+// meshes.
+//
+//   AssetPacker [-d directory] [-o archive] [-s] [file ...]
+//
+// Without file arguments every cooked .mesh and .instance, .dds, .spritefont and .obj in the
+// directory (default ".") is packed, in that order, which is roughly the order the game reads them
+// in; the .obj files are only read when their blobs are out of date, so they go last. Compiled
+// shaders are not packed: the game build writes them into the folder, and an archived copy would
+// hide the one just built. -s stores
+// every entry as it is. The archive (default directory/assets.pak) is read back once written: every
+// entry is checked against the file it came from, and reading all of them through the archive is
+// timed against opening each file.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "MappedFile.h"
+
+namespace
+{
+	const char* s_packedExtensions[] = { ".instance", ".mesh", ".dds", ".spritefont", ".obj" };
+
+	typedef std::chrono::steady_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Position of the file's extension in s_packedExtensions, or -1 when it is not packed.
+	int GetPackOrder(const std::string& name)
+	{
+		int i;
+
+		for (i = 0; i < (int)(sizeof(s_packedExtensions) / sizeof(s_packedExtensions[0])); i++)
+		{
+			size_t length = strlen(s_packedExtensions[i]);
+
+			if (name.size() > length && name.compare(name.size() - length, length, s_packedExtensions[i]) == 0)
+			{
+				return i;
+			}
+		}
+
+		return -1;
+	}
+
+	bool ListAssets(const std::string& directory, std::vector<AssetArchiveInput>& inputs)
+	{
+		std::vector<std::pair<int, std::string>> names;
+		std::error_code error;
+
+		for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory, error))
+		{
+			std::string name = file.path().filename().string();
+			int order = GetPackOrder(name);
+
+			if (order >= 0 && file.is_regular_file())
+			{
+				names.push_back(std::make_pair(order, name));
+			}
+		}
+
+		if (error)
+		{
+			return false;
+		}
+
+		std::sort(names.begin(), names.end());
+
+		for (const std::pair<int, std::string>& name : names)
+		{
+			AssetArchiveInput input;
+			input.name = name.second;
+			input.path = directory + "/" + name.second;
+			inputs.push_back(input);
+		}
+
+		return true;
+	}
+
+	// Milliseconds spent reading entries stored as they are, used in place, and compressed ones.
+	struct ReadTimes
+	{
+		double stored;
+		double compressed;
+	};
+
+	// Hashes every entry through the archive, as the game's loaders see it, and checks it is the
+	// file it was packed from. The same hash over each file opened on its own is the baseline.
+	bool VerifyArchive(const char* path, const std::vector<AssetArchiveInput>& inputs, ReadTimes& archiveTimes, ReadTimes& looseTimes)
+	{
+		std::vector<bool> compressed(inputs.size(), false);
+		Clock::time_point start;
+		uint64_t checksum = 0;
+		bool matches = true;
+		size_t i;
+
+		memset(&archiveTimes, 0, sizeof(archiveTimes));
+		memset(&looseTimes, 0, sizeof(looseTimes));
+
+		start = Clock::now();
+		if (!MountAssetArchive(path))
+		{
+			return false;
+		}
+		archiveTimes.stored += MillisecondsSince(start);
+
+		for (i = 0; i < inputs.size(); i++)
+		{
+			const AssetArchiveEntry* entry;
+			MappedFile file;
+			bool read;
+
+			start = Clock::now();
+			entry = GetMountedAssetArchive()->Find(inputs[i].name.c_str());
+			read = entry && file.OpenAsset(inputs[i].name.c_str()) && HashAssetBytes(file.GetData(), file.GetSize()) == entry->hash;
+			compressed[i] = entry && (entry->flags & ASSET_ENTRY_COMPRESSED);
+			(compressed[i] ? archiveTimes.compressed : archiveTimes.stored) += MillisecondsSince(start);
+
+			if (!read)
+			{
+				fprintf(stderr, "%s does not read back as packed\n", inputs[i].name.c_str());
+				matches = false;
+			}
+		}
+		UnmountAssetArchive();
+
+		for (i = 0; i < inputs.size(); i++)
+		{
+			MappedFile file;
+
+			start = Clock::now();
+			if (file.Open(inputs[i].path.c_str()))
+			{
+				checksum ^= HashAssetBytes(file.GetData(), file.GetSize());
+			}
+			(compressed[i] ? looseTimes.compressed : looseTimes.stored) += MillisecondsSince(start);
+		}
+
+		// Keeps the baseline's hashing from being optimised away.
+		return matches && checksum != 1;
+	}
+
+	void PrintUsage()
+	{
+		fprintf(stderr, "usage: AssetPacker [-d directory] [-o archive] [-s] [file ...]\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<AssetArchiveInput> inputs;
+	AssetArchiveReport report;
+	std::string directory = ".";
+	std::string archive;
+	bool compress = true;
+	Clock::time_point start;
+	ReadTimes archiveTimes, looseTimes;
+	double packMilliseconds;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((!strcmp(argv[i], "-d") || !strcmp(argv[i], "-o")) && i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "-d"))
+		{
+			directory = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-o"))
+		{
+			archive = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-s"))
+		{
+			compress = false;
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			AssetArchiveInput input;
+			input.name = argv[i];
+			input.path = argv[i];
+			inputs.push_back(input);
+		}
+	}
+
+	if (inputs.empty() && !ListAssets(directory, inputs))
+	{
+		fprintf(stderr, "cannot list %s\n", directory.c_str());
+		return 1;
+	}
+
+	if (archive.empty())
+	{
+		archive = directory + "/assets.pak";
+	}
+
+	start = Clock::now();
+	if (!WriteAssetArchive(archive.c_str(), inputs, compress, &report))
+	{
+		fprintf(stderr, "cannot pack %s\n", archive.c_str());
+		return 1;
+	}
+	packMilliseconds = MillisecondsSince(start);
+
+	printf("packed %u files (%u compressed) into %s in %.0f ms: %.1f MB -> %.1f MB stored, %.1f MB with table and padding\n",
+		report.entryCount, report.compressedCount, archive.c_str(), packMilliseconds,
+		report.inputBytes / (1024.0 * 1024.0), report.storedBytes / (1024.0 * 1024.0), report.archiveBytes / (1024.0 * 1024.0));
+
+	if (!VerifyArchive(archive.c_str(), inputs, archiveTimes, looseTimes))
+	{
+		fprintf(stderr, "%s failed to read back\n", archive.c_str());
+		return 1;
+	}
+
+	printf("read back %u stored entries in %.1f ms through the archive, %.1f ms opening each file\n",
+		report.entryCount - report.compressedCount, archiveTimes.stored, looseTimes.stored);
+	printf("read back %u compressed entries in %.1f ms through the archive, %.1f ms opening each file\n",
+		report.compressedCount, archiveTimes.compressed, looseTimes.compressed);
+
+	return 0;
+}
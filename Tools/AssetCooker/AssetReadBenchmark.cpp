@@ -0,0 +1,269 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: AssetReadBenchmark.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Times reading the whole asset set, every .obj, cooked .mesh and .instance, .cso, .dds and
+// .spritefont in the directory (default "."), three ways: one file after the other with blocking
+// reads, the way the loaders used to, then through AsyncFileReader with reader threads and with
+// io_uring, up to -q reads in flight (32 by default). Each way is timed cold, with the files
+// dropped from the page cache first, then warm, the best of three more runs.
+//
+//   AssetReadBenchmark [-d directory] [-q depth] [-j threads]
+//
+// Dropping the cache asks the kernel to forget the files' clean pages (POSIX_FADV_DONTNEED),
+// which needs no privileges but is only a hint; cold numbers close to the warm ones mean it was
+// ignored.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "AsyncFileReader.h"
+
+namespace
+{
+	const char* s_assetExtensions[] = { ".obj", ".mesh", ".instance", ".cso", ".dds", ".spritefont" };
+
+	const int s_warmRuns = 3;
+
+	enum ReadMode
+	{
+		READ_BLOCKING,
+		READ_THREADS,
+		READ_IO_URING,
+	};
+
+	const char* s_modeNames[] = { "blocking, one file at a time", "reader threads", "io_uring" };
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct ReadResult
+	{
+		bool succeeded;
+		uint64_t bytes;
+		double milliseconds;
+		unsigned int maxQueueDepth;
+		double averageQueueDepth;
+	};
+
+	bool IsAsset(const std::string& name)
+	{
+		for (const char* extension : s_assetExtensions)
+		{
+			size_t length = strlen(extension);
+
+			if (name.size() > length && name.compare(name.size() - length, length, extension) == 0)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool ListAssets(const std::string& directory, std::vector<std::string>& files)
+	{
+		std::error_code error;
+
+		for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory, error))
+		{
+			if (file.is_regular_file() && IsAsset(file.path().filename().string()))
+			{
+				files.push_back(directory + "/" + file.path().filename().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+
+		return !error && !files.empty();
+	}
+
+	void DropFromCache(const std::vector<std::string>& files)
+	{
+		for (const std::string& path : files)
+		{
+			int file = open(path.c_str(), O_RDONLY);
+
+			if (file >= 0)
+			{
+				fdatasync(file);
+				posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+				close(file);
+			}
+		}
+	}
+
+	// The old path: open, size and read each file to the end into a buffer of its own, as
+	// DX::ReadData does, before starting the next.
+	ReadResult ReadBlocking(const std::vector<std::string>& files)
+	{
+		ReadResult result;
+		Clock::time_point start = Clock::now();
+
+		memset(&result, 0, sizeof(result));
+		result.succeeded = true;
+
+		for (const std::string& path : files)
+		{
+			FILE* file = fopen(path.c_str(), "rb");
+			std::vector<char> buffer;
+			long size;
+
+			if (!file)
+			{
+				result.succeeded = false;
+				continue;
+			}
+
+			fseek(file, 0, SEEK_END);
+			size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+
+			buffer.resize((size_t)std::max(size, 1L));
+			if (size > 0 && fread(buffer.data(), (size_t)size, 1, file) != 1)
+			{
+				result.succeeded = false;
+			}
+			fclose(file);
+
+			result.bytes += (uint64_t)std::max(size, 0L);
+		}
+
+		result.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		result.maxQueueDepth = 1;
+		result.averageQueueDepth = 1.0;
+
+		return result;
+	}
+
+	ReadResult ReadBatched(AsyncFileReader& reader, const std::vector<std::string>& files)
+	{
+		ReadResult result;
+		std::atomic<uint64_t> handed(0);
+		Clock::time_point start;
+
+		memset(&result, 0, sizeof(result));
+
+		// The completions only count what they were handed; parsing would hide the reads.
+		start = Clock::now();
+		for (const std::string& path : files)
+		{
+			reader.Queue(path.c_str(), [&handed](const char*, size_t size) { handed += size; });
+		}
+		result.succeeded = reader.Flush();
+		result.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		result.bytes = handed;
+		result.maxQueueDepth = reader.GetStats().maxQueueDepth;
+		result.averageQueueDepth = reader.GetStats().averageQueueDepth;
+
+		return result;
+	}
+
+	void PrintResult(const char* mode, const char* temperature, const ReadResult& result)
+	{
+		printf("%-30s %-5s %9.2f ms %9.0f MB/s   queue depth up to %u, %.1f on average\n", mode, temperature, result.milliseconds,
+			result.milliseconds > 0.0 ? result.bytes / (result.milliseconds * 1e3) : 0.0, result.maxQueueDepth, result.averageQueueDepth);
+	}
+
+	void PrintUsage()
+	{
+		fprintf(stderr, "usage: AssetReadBenchmark [-d directory] [-q depth] [-j threads]\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	std::string directory = ".";
+	unsigned int queueDepth = 32;
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	uint64_t totalBytes = 0;
+	int mode, run, i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((!strcmp(argv[i], "-d") || !strcmp(argv[i], "-q") || !strcmp(argv[i], "-j")) && i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "-d"))
+		{
+			directory = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-q"))
+		{
+			queueDepth = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-j"))
+		{
+			threadCount = (unsigned int)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (!ListAssets(directory, files))
+	{
+		fprintf(stderr, "no assets in %s\n", directory.c_str());
+		return 1;
+	}
+
+	for (const std::string& path : files)
+	{
+		totalBytes += std::filesystem::file_size(path);
+	}
+	printf("%u files, %.1f MB\n", (unsigned int)files.size(), totalBytes / (1024.0 * 1024.0));
+
+	// A reader is set up once per mode and keeps its buffer between runs, as a loader would.
+	for (mode = READ_BLOCKING; mode <= READ_IO_URING; mode++)
+	{
+		TaskPool tasks;
+		AsyncFileReader reader;
+		ReadResult cold, warm, best;
+
+		tasks.Initialize(threadCount);
+		reader.Initialize(tasks, queueDepth, mode == READ_IO_URING);
+		if (mode == READ_IO_URING && !reader.IsUsingIoUring())
+		{
+			printf("%-30s not available\n", s_modeNames[mode]);
+			continue;
+		}
+
+		DropFromCache(files);
+		cold = (mode == READ_BLOCKING) ? ReadBlocking(files) : ReadBatched(reader, files);
+
+		for (run = 0; run < s_warmRuns; run++)
+		{
+			warm = (mode == READ_BLOCKING) ? ReadBlocking(files) : ReadBatched(reader, files);
+			if (run == 0 || warm.milliseconds < best.milliseconds)
+			{
+				best = warm;
+			}
+		}
+
+		if (!cold.succeeded || !best.succeeded)
+		{
+			printf("%-30s failed to read every file\n", s_modeNames[mode]);
+			continue;
+		}
+
+		PrintResult(s_modeNames[mode], "cold", cold);
+		PrintResult(s_modeNames[mode], "warm", best);
+	}
+
+	return 0;
+}
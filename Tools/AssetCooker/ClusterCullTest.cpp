@@ -0,0 +1,366 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: ClusterCullTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Checks the facing test of CullClusters against the rasterizer on every .obj in the directory
+// (default "."), clustered in the plain and the shadow map layouts. Each mesh is looked at from
+// around its bounding sphere through the matrices SimpleMath builds (right handed look at, and
+// perspective or orthographic off centre projections), and every cluster the facing test drops
+// but the frustum keeps must hold only triangles the matching rasterizer state drops as well:
+// CLUSTER_FACING_BACK against the states the game draws with, which drop clockwise triangles
+// (CommonStates::CullClockwise, and the shadow pass's D3D11_CULL_FRONT with FrontCounterClockwise
+// FALSE), and CLUSTER_FACING_FRONT against the default state, which drops counter clockwise ones.
+// Winding is taken from the homogeneous clip coordinates in double precision.
+//
+//   ClusterCullTest [directory]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "MeshClusterizer.h"
+#include "TestHelpers.h"
+
+namespace
+{
+	// The parts of D3D11_RASTERIZER_DESC that decide which triangles are dropped.
+	enum CullMode
+	{
+		CULL_FRONT,
+		CULL_BACK
+	};
+
+	struct RasterizerCull
+	{
+		CullMode cullMode;
+		bool frontCounterClockwise;
+		ClusterFacing facing;	// the clusters CullClusters should drop under it
+		const char* name;
+	};
+
+	const RasterizerCull s_rasterizerCulls[] =
+	{
+		{ CULL_FRONT, false, CLUSTER_FACING_BACK, "cull clockwise" },
+		{ CULL_BACK, false, CLUSTER_FACING_FRONT, "cull counter clockwise" },
+	};
+
+	// Row vector matrices, m[row * 4 + column], as SimpleMath stores them.
+	struct Matrix
+	{
+		float m[16];
+	};
+
+	void Multiply(const Matrix& a, const Matrix& b, Matrix& result)
+	{
+		int row, column, k;
+
+		for (row = 0; row < 4; row++)
+		{
+			for (column = 0; column < 4; column++)
+			{
+				float sum = 0.0f;
+				for (k = 0; k < 4; k++)
+				{
+					sum += a.m[row * 4 + k] * b.m[k * 4 + column];
+				}
+				result.m[row * 4 + column] = sum;
+			}
+		}
+	}
+
+	void Normalize(float v[3])
+	{
+		float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+
+	void Cross(const float a[3], const float b[3], float result[3])
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	// XMMatrixLookAtRH.
+	void LookAt(const float eye[3], const float at[3], const float up[3], Matrix& view)
+	{
+		float x[3], y[3], z[3];
+		int i;
+
+		for (i = 0; i < 3; i++)
+		{
+			z[i] = eye[i] - at[i];
+		}
+		Normalize(z);
+		Cross(up, z, x);
+		Normalize(x);
+		Cross(z, x, y);
+
+		memset(view.m, 0, sizeof(view.m));
+		for (i = 0; i < 3; i++)
+		{
+			view.m[i * 4 + 0] = x[i];
+			view.m[i * 4 + 1] = y[i];
+			view.m[i * 4 + 2] = z[i];
+		}
+		view.m[12] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+		view.m[13] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+		view.m[14] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+		view.m[15] = 1.0f;
+	}
+
+	// XMMatrixPerspectiveFovRH.
+	void Perspective(float fovY, float aspect, float nearZ, float farZ, Matrix& projection)
+	{
+		float height = 1.0f / tanf(fovY * 0.5f);
+		float range = farZ / (nearZ - farZ);
+
+		memset(projection.m, 0, sizeof(projection.m));
+		projection.m[0] = height / aspect;
+		projection.m[5] = height;
+		projection.m[10] = range;
+		projection.m[11] = -1.0f;
+		projection.m[14] = range * nearZ;
+	}
+
+	// XMMatrixOrthographicOffCenterRH.
+	void Orthographic(float left, float right, float bottom, float top, float nearZ, float farZ, Matrix& projection)
+	{
+		float range = 1.0f / (nearZ - farZ);
+
+		memset(projection.m, 0, sizeof(projection.m));
+		projection.m[0] = 2.0f / (right - left);
+		projection.m[5] = 2.0f / (top - bottom);
+		projection.m[10] = range;
+		projection.m[12] = (left + right) / (left - right);
+		projection.m[13] = (top + bottom) / (bottom - top);
+		projection.m[14] = range * nearZ;
+		projection.m[15] = 1.0f;
+	}
+
+	void Transform(const float p[3], const Matrix& matrix, double clip[4])
+	{
+		int column;
+
+		for (column = 0; column < 4; column++)
+		{
+			clip[column] = (double)p[0] * matrix.m[column] + (double)p[1] * matrix.m[4 + column] + (double)p[2] * matrix.m[8 + column] +
+				matrix.m[12 + column];
+		}
+	}
+
+	// Whether the rasterizer draws nothing of the triangle. The determinant of the clip x, y and w
+	// is twice the triangle's area on screen, y up, times the three w, for the part of it in front
+	// of the eye: positive is counter clockwise as seen. A triangle seen edge on, to within the
+	// rounding of the transform, covers no pixels.
+	bool IsDropped(const RasterizerCull& state, const double clip[3][4])
+	{
+		const double edgeOnArea = 1e-9;
+		double determinant = clip[0][0] * (clip[1][1] * clip[2][3] - clip[1][3] * clip[2][1]) -
+			clip[0][1] * (clip[1][0] * clip[2][3] - clip[1][3] * clip[2][0]) +
+			clip[0][3] * (clip[1][0] * clip[2][1] - clip[1][1] * clip[2][0]);
+		bool clockwise = determinant < 0.0;
+		bool front = (clockwise != state.frontCounterClockwise);
+
+		if (fabs(determinant) <= edgeOnArea * fabs(clip[0][3] * clip[1][3] * clip[2][3]))
+		{
+			return true;
+		}
+
+		return (state.cullMode == CULL_FRONT) ? front : !front;
+	}
+
+	const float* GetPosition(const MeshData& mesh, unsigned int vertex)
+	{
+		return reinterpret_cast<const float*>(mesh.vertices.data() + (size_t)vertex * mesh.vertexStride);
+	}
+
+	struct CullCounts
+	{
+		size_t views;
+		size_t tested;		// clusters inside the frustum with a cone worth testing
+		size_t dropped;		// of those, dropped for facing away
+	};
+
+	// Checks every cluster the facing test drops in one view. Returns false at the first one
+	// holding a triangle the rasterizer would draw.
+	bool CheckView(const MeshData& mesh, const Matrix& viewProjection, const float eye[3], const float direction[3], bool orthographic,
+		const char* what, CullCounts& counts)
+	{
+		ClusterCullView view, frustumOnly;
+		double clip[3][4];
+		size_t cluster, index;
+		int state, corner;
+
+		ExtractFrustumPlanes(viewProjection.m, view.planes);
+		view.orthographic = orthographic;
+		memcpy(view.eye, eye, sizeof(view.eye));
+		memcpy(view.direction, direction, sizeof(view.direction));
+		frustumOnly = view;
+		frustumOnly.facing = CLUSTER_FACING_NONE;
+		counts.views++;
+
+		for (cluster = 0; cluster < mesh.clusters.size(); cluster++)
+		{
+			const MeshCluster& bounds = mesh.clusters[cluster];
+
+			if (!IsClusterVisible(bounds, frustumOnly) || bounds.coneCutoff >= 1.0f)
+			{
+				continue;
+			}
+			counts.tested++;
+
+			for (state = 0; state < (int)(sizeof(s_rasterizerCulls) / sizeof(s_rasterizerCulls[0])); state++)
+			{
+				view.facing = s_rasterizerCulls[state].facing;
+				if (IsClusterVisible(bounds, view))
+				{
+					continue;
+				}
+				counts.dropped++;
+
+				for (index = bounds.indexOffset; index < (size_t)bounds.indexOffset + bounds.indexCount; index += 3)
+				{
+					for (corner = 0; corner < 3; corner++)
+					{
+						Transform(GetPosition(mesh, mesh.indices[index + corner]), viewProjection, clip[corner]);
+					}
+
+					if (!IsDropped(s_rasterizerCulls[state], clip))
+					{
+						printf("    %s, %s: cluster %zu is dropped but its triangle %zu is drawn\n", what, s_rasterizerCulls[state].name, cluster,
+							index / 3);
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// Looks at the mesh from 26 directions around its bounding sphere, through a perspective
+	// projection from close by and an orthographic one like the shadow map's.
+	bool CheckViews(const MeshData& mesh, const char* what, CullCounts& counts)
+	{
+		const float yUp[3] = { 0.0f, 1.0f, 0.0f };
+		const float zUp[3] = { 0.0f, 0.0f, 1.0f };
+		const float* center = mesh.boundsCenter;
+		float radius = std::max(mesh.boundsRadius, 1e-3f);
+		float eye[3], direction[3];
+		Matrix view, projection, viewProjection;
+		int x, y, z, i;
+
+		for (x = -1; x <= 1; x++)
+		{
+			for (y = -1; y <= 1; y++)
+			{
+				for (z = -1; z <= 1; z++)
+				{
+					float away[3] = { (float)x, (float)y, (float)z };
+
+					if (x == 0 && y == 0 && z == 0)
+					{
+						continue;
+					}
+					Normalize(away);
+
+					for (i = 0; i < 3; i++)
+					{
+						eye[i] = center[i] + away[i] * radius * 2.5f;
+						direction[i] = -away[i];
+					}
+					LookAt(eye, center, (x == 0 && z == 0) ? zUp : yUp, view);
+
+					Perspective(1.0f, 16.0f / 9.0f, radius * 0.1f, radius * 10.0f, projection);
+					Multiply(view, projection, viewProjection);
+					if (!CheckView(mesh, viewProjection, eye, direction, false, what, counts))
+					{
+						return false;
+					}
+
+					Orthographic(-radius, radius, -radius, radius, 0.0f, radius * 5.0f, projection);
+					Multiply(view, projection, viewProjection);
+					if (!CheckView(mesh, viewProjection, eye, direction, true, what, counts))
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const MeshLayout layouts[] = { MESH_LAYOUT_PLAIN, MESH_LAYOUT_SHADOWMAP };
+	const char* layoutNames[] = { "plain", "shadow map" };
+	std::vector<std::string> files;
+	std::string directory = argc > 1 ? argv[1] : ".";
+	ObjMesh obj;
+	MeshData mesh;
+	CullCounts counts, total;
+	int failures = 0, layout;
+	bool passed;
+
+	if (!ListSceneFiles(directory, files))
+	{
+		return 1;
+	}
+
+	memset(&total, 0, sizeof(total));
+
+	for (const std::string& file : files)
+	{
+		std::string name = GetSceneFileName(file);
+
+		if (!LoadObjFile(file.c_str(), obj))
+		{
+			printf("%-32s FAILED to parse\n", name.c_str());
+			failures++;
+			continue;
+		}
+
+		memset(&counts, 0, sizeof(counts));
+		passed = true;
+		for (layout = 0; layout < 2 && passed; layout++)
+		{
+			passed = BuildMesh(obj, layouts[layout], mesh);
+			if (!passed)
+			{
+				printf("    %s does not build\n", layoutNames[layout]);
+				break;
+			}
+
+			BuildClusters(mesh);
+			passed = CheckViews(mesh, layoutNames[layout], counts);
+		}
+
+		printf("%-32s %s %6zu clusters tested in %zu views, %6zu dropped for facing\n", name.c_str(), passed ? "ok    " : "FAILED", counts.tested,
+			counts.views, counts.dropped);
+		failures += passed ? 0 : 1;
+		total.tested += counts.tested;
+		total.dropped += counts.dropped;
+	}
+
+	printf("%d of %d meshes cull clusters only where the rasterizer drops every triangle (%zu of %zu tested clusters dropped)\n",
+		(int)files.size() - failures, (int)files.size(), total.dropped, total.tested);
+
+	// A facing test that never drops anything would pass the checks above.
+	if (total.dropped == 0)
+	{
+		printf("no cluster was ever dropped for facing: FAILED\n");
+		return 1;
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,282 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: CookedMeshTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Writes a cooked mesh in every encoding and checks CookedMeshFile::Open gives back the arrays it
+// was cooked from, then that it refuses the blob once any part of it is corrupt: cut short, from
+// another version or revision of the .obj, or with a header whose counts, sizes, offsets or ranges
+// do not fit the blob. The mesh is the smallest .obj in the directory (default ".") that cooks
+// into several levels of detail and clusters, in the packed normal mapped layout.
+//
+//   CookedMeshTest [directory]
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "CookedMesh.h"
+#include "ObjParser.h"
+
+namespace
+{
+	typedef void (*Corruption)(std::vector<unsigned char>& blob);
+
+	struct CorruptionCase
+	{
+		const char* name;
+		Corruption corrupt;
+	};
+
+	const CookedMeshSource s_source = { 123456, 1500000000, 0x0123456789ABCDEFull };
+
+	CookedMeshHeader& Header(std::vector<unsigned char>& blob)
+	{
+		return *reinterpret_cast<CookedMeshHeader*>(blob.data());
+	}
+
+	MeshCluster& LastCluster(std::vector<unsigned char>& blob)
+	{
+		const CookedMeshHeader& header = Header(blob);
+
+		return reinterpret_cast<MeshCluster*>(blob.data() + header.clusterOffset)[header.clusterCount - 1];
+	}
+
+	// Every case leaves the rest of the blob as written, so each is the only thing wrong with it.
+	const CorruptionCase s_corruptions[] =
+	{
+		{ "empty", [](std::vector<unsigned char>& blob) { blob.clear(); } },
+		{ "shorter than its header", [](std::vector<unsigned char>& blob) { blob.resize(sizeof(CookedMeshHeader) - 1); } },
+		{ "last byte cut off", [](std::vector<unsigned char>& blob) { blob.pop_back(); } },
+		{ "magic", [](std::vector<unsigned char>& blob) { Header(blob).magic ^= 1; } },
+		{ "version", [](std::vector<unsigned char>& blob) { Header(blob).version++; } },
+		{ "source size", [](std::vector<unsigned char>& blob) { Header(blob).source.size++; } },
+		{ "source time", [](std::vector<unsigned char>& blob) { Header(blob).source.modifiedTime++; } },
+		{ "source hash", [](std::vector<unsigned char>& blob) { Header(blob).source.hash ^= 1; } },
+		{ "layout", [](std::vector<unsigned char>& blob) { Header(blob).layout = MESH_LAYOUT_COUNT; } },
+		{ "vertex stride", [](std::vector<unsigned char>& blob) { Header(blob).vertexStride += 4; } },
+		{ "index size", [](std::vector<unsigned char>& blob) { Header(blob).indexSize = 6 - Header(blob).indexSize; } },
+		{ "encoding", [](std::vector<unsigned char>& blob) { Header(blob).encoding = COOKED_MESH_COMPRESSED + 1; } },
+		{ "vertex count one more", [](std::vector<unsigned char>& blob) { Header(blob).vertexCount++; } },
+		{ "vertex count huge", [](std::vector<unsigned char>& blob) { Header(blob).vertexCount = 0xFFFFFFF0u; } },
+		{ "index count three more", [](std::vector<unsigned char>& blob) { Header(blob).indexCount += 3; } },
+		{ "index count huge", [](std::vector<unsigned char>& blob) { Header(blob).indexCount = 0xFFFFFFF0u; } },
+		{ "vertex offset in the header", [](std::vector<unsigned char>& blob) { Header(blob).vertexOffset = 0; } },
+		{ "vertex bytes one short", [](std::vector<unsigned char>& blob) { Header(blob).vertexBytes--; } },
+		{ "vertex bytes wrapping", [](std::vector<unsigned char>& blob) { Header(blob).vertexBytes = 0 - Header(blob).vertexOffset; } },
+		{ "index bytes one short", [](std::vector<unsigned char>& blob) { Header(blob).indexBytes--; } },
+		{ "index bytes wrapping", [](std::vector<unsigned char>& blob) { Header(blob).indexBytes = 0 - Header(blob).indexOffset; } },
+		{ "index offset past the end", [](std::vector<unsigned char>& blob) { Header(blob).indexOffset = blob.size(); } },
+		{ "cluster offset wrapping", [](std::vector<unsigned char>& blob) { Header(blob).clusterOffset = 0 - (uint64_t)Header(blob).clusterCount * sizeof(MeshCluster); } },
+		{ "cluster count one more", [](std::vector<unsigned char>& blob) { Header(blob).clusterCount++; } },
+		{ "level count", [](std::vector<unsigned char>& blob) { Header(blob).lodCount = MESH_MAX_LODS + 1; } },
+		{ "level past the indices", [](std::vector<unsigned char>& blob) { Header(blob).lods[Header(blob).lodCount - 1].indexCount += 3; } },
+		{ "level of part triangles", [](std::vector<unsigned char>& blob) { Header(blob).lods[0].indexCount--; } },
+		{ "level past the clusters", [](std::vector<unsigned char>& blob) { Header(blob).lods[Header(blob).lodCount - 1].clusterCount++; } },
+		{ "cluster past the indices", [](std::vector<unsigned char>& blob) { LastCluster(blob).indexCount += 3; } },
+		{ "cluster of part triangles", [](std::vector<unsigned char>& blob) { LastCluster(blob).indexCount--; } },
+		{ "bounds radius", [](std::vector<unsigned char>& blob) { Header(blob).boundsRadius = NAN; } },
+	};
+
+	const char* GetEncodingName(CookedMeshEncoding encoding)
+	{
+		return encoding == COOKED_MESH_RAW ? "raw" : encoding == COOKED_MESH_ENCODED ? "encoded" : "compressed";
+	}
+
+	bool ReadBlob(const std::string& path, std::vector<unsigned char>& blob)
+	{
+		FILE* file;
+		long size;
+		bool read;
+
+		file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+
+		fseek(file, 0, SEEK_END);
+		size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		blob.resize(size > 0 ? (size_t)size : 0);
+		read = blob.empty() || fread(blob.data(), blob.size(), 1, file) == 1;
+		fclose(file);
+
+		return read;
+	}
+
+	bool WriteBlob(const std::string& path, const std::vector<unsigned char>& blob)
+	{
+		FILE* file;
+		bool written;
+
+		file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			return false;
+		}
+
+		written = blob.empty() || fwrite(blob.data(), blob.size(), 1, file) == 1;
+		written = (fclose(file) == 0) && written;
+
+		return written;
+	}
+
+	// The blob opens and gives back exactly the arrays, levels and clusters of mesh.
+	bool SameAsCooked(CookedMeshFile& file, const MeshData& mesh)
+	{
+		const CookedMeshHeader& header = file.GetHeader();
+		const unsigned char* indices = static_cast<const unsigned char*>(file.GetIndices());
+		unsigned int index;
+		size_t i;
+
+		if (header.vertexCount != mesh.vertexCount || header.indexCount != mesh.indices.size() || header.lodCount != mesh.lods.size() ||
+			header.clusterCount != mesh.clusters.size())
+		{
+			return false;
+		}
+
+		if (memcmp(file.GetVertices(), mesh.vertices.data(), (size_t)mesh.vertexCount * mesh.vertexStride) != 0 ||
+			memcmp(header.lods, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod)) != 0 ||
+			memcmp(file.GetClusters(), mesh.clusters.data(), mesh.clusters.size() * sizeof(MeshCluster)) != 0)
+		{
+			return false;
+		}
+
+		for (i = 0; i < mesh.indices.size(); i++)
+		{
+			if (header.indexSize == 2)
+			{
+				uint16_t narrow;
+				memcpy(&narrow, indices + i * 2, 2);
+				index = narrow;
+			}
+			else
+			{
+				memcpy(&index, indices + i * 4, 4);
+			}
+
+			if (index != mesh.indices[i])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// The smallest .obj that cooks into more than one level and more than one cluster.
+	bool CookTestMesh(const std::string& directory, MeshData& mesh, std::string& name)
+	{
+		std::vector<std::filesystem::path> files;
+		std::error_code error;
+		MeshCookOptions options;
+		ObjMesh obj;
+
+		for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory, error))
+		{
+			if (file.is_regular_file() && file.path().extension() == ".obj")
+			{
+				files.push_back(file.path());
+			}
+		}
+		std::sort(files.begin(), files.end(), [](const std::filesystem::path& a, const std::filesystem::path& b)
+		{
+			return std::filesystem::file_size(a) < std::filesystem::file_size(b);
+		});
+
+		options.optimize = true;
+		options.generateLods = true;
+		options.buildClusters = true;
+		options.shadowProxyError = 0.0f;
+
+		for (const std::filesystem::path& file : files)
+		{
+			if (LoadObjFile(file.string().c_str(), obj) && CookMesh(obj, MESH_LAYOUT_NORMALMAP_PACKED, options, mesh, 0) &&
+				mesh.lods.size() > 1 && mesh.clusters.size() > 1)
+			{
+				name = file.filename().string();
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const CookedMeshEncoding encodings[] = { COOKED_MESH_RAW, COOKED_MESH_ENCODED, COOKED_MESH_COMPRESSED };
+	std::string directory = argc > 1 ? argv[1] : ".";
+	std::string name, path, corruptPath;
+	std::vector<unsigned char> written, blob;
+	std::error_code error;
+	CookedMeshFile file;
+	MeshData mesh;
+	int failures = 0, rejected;
+
+	if (!CookTestMesh(directory, mesh, name))
+	{
+		fprintf(stderr, "no .obj in %s cooks into levels of detail and clusters\n", directory.c_str());
+		return 1;
+	}
+
+	path = (std::filesystem::temp_directory_path() / "CookedMeshTest.mesh").string();
+	corruptPath = (std::filesystem::temp_directory_path() / "CookedMeshTest.corrupt.mesh").string();
+	printf("%s: %u vertices, %zu indices, %zu levels, %zu clusters\n", name.c_str(), mesh.vertexCount, mesh.indices.size(), mesh.lods.size(),
+		mesh.clusters.size());
+
+	for (CookedMeshEncoding encoding : encodings)
+	{
+		if (!WriteCookedMesh(path.c_str(), mesh, s_source, encoding) || !ReadBlob(path, written))
+		{
+			printf("%-12s FAILED to write\n", GetEncodingName(encoding));
+			failures++;
+			continue;
+		}
+
+		// Written back by hand first, so a refusal below is down to the corruption and not the copy.
+		if (!WriteBlob(corruptPath, written) || !file.Open(corruptPath.c_str(), s_source) || !SameAsCooked(file, mesh))
+		{
+			printf("%-12s FAILED: the blob as written does not open to the cooked mesh\n", GetEncodingName(encoding));
+			failures++;
+			continue;
+		}
+		file.Close();
+
+		rejected = 0;
+		for (const CorruptionCase& corruption : s_corruptions)
+		{
+			blob = written;
+			corruption.corrupt(blob);
+
+			if (!WriteBlob(corruptPath, blob))
+			{
+				printf("%-12s FAILED to write the %s case\n", GetEncodingName(encoding), corruption.name);
+				failures++;
+			}
+			else if (file.Open(corruptPath.c_str(), s_source))
+			{
+				printf("%-12s FAILED: opened with a corrupt %s\n", GetEncodingName(encoding), corruption.name);
+				file.Close();
+				failures++;
+			}
+			else
+			{
+				rejected++;
+			}
+		}
+
+		printf("%-12s opens to the cooked mesh, refuses %d of %d corruptions\n", GetEncodingName(encoding), rejected,
+			(int)(sizeof(s_corruptions) / sizeof(s_corruptions[0])));
+	}
+
+	std::filesystem::remove(path, error);
+	std::filesystem::remove(corruptPath, error);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,349 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshBuilderTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Checks WeldMesh on every .obj in the directory (default ".") in each float layout: the built
+// mesh is unrolled back into one vertex per index and welded again, which has to give the same
+// triangles with every vertex kept once, numbered in the order the vertices come, and welding
+// that a second time must change nothing. Hand made meshes cover what the scene may not: values
+// equal as floats but not as bits, and meshes of one repeated vertex or none.
+//
+// The index packing is checked the same way: packing a mesh's indices in their own storage has to
+// give the bytes PackIndices writes elsewhere, and unpacking them the indices again, for the scene
+// meshes and for every short count and the largest 16 bit values.
+//
+//   MeshBuilderTest [directory]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "TestHelpers.h"
+
+namespace
+{
+	// One vertex per index, in index order, as BuildMesh has it before welding.
+	void Unroll(const MeshData& mesh, MeshData& unrolled)
+	{
+		size_t i;
+
+		unrolled.Clear();
+		unrolled.layout = mesh.layout;
+		unrolled.vertexStride = mesh.vertexStride;
+		unrolled.vertexCount = (unsigned int)mesh.indices.size();
+		unrolled.unrolledVertexCount = unrolled.vertexCount;
+		unrolled.vertices.resize(mesh.indices.size() * mesh.vertexStride);
+
+		for (i = 0; i < mesh.indices.size(); i++)
+		{
+			memcpy(&unrolled.vertices[i * mesh.vertexStride], &mesh.vertices[(size_t)mesh.indices[i] * mesh.vertexStride], mesh.vertexStride);
+			unrolled.indices.push_back((unsigned int)i);
+		}
+	}
+
+	// Whether every index of welded draws the same bytes as the same index of original.
+	bool SameTriangles(const MeshData& welded, const MeshData& original)
+	{
+		const unsigned int stride = original.vertexStride;
+		size_t i;
+
+		if (welded.indices.size() != original.indices.size() || welded.vertexStride != stride)
+		{
+			return false;
+		}
+
+		for (i = 0; i < original.indices.size(); i++)
+		{
+			if (welded.indices[i] >= welded.vertexCount ||
+				memcmp(&welded.vertices[(size_t)welded.indices[i] * stride], &original.vertices[(size_t)original.indices[i] * stride], stride) != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Whether no two vertices of mesh are bit-identical.
+	bool AllDistinct(const MeshData& mesh)
+	{
+		const unsigned int stride = mesh.vertexStride;
+		std::vector<unsigned int> order(mesh.vertexCount);
+		unsigned int i;
+
+		for (i = 0; i < mesh.vertexCount; i++)
+		{
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&mesh, stride](unsigned int a, unsigned int b)
+		{
+			return memcmp(&mesh.vertices[(size_t)a * stride], &mesh.vertices[(size_t)b * stride], stride) < 0;
+		});
+
+		for (i = 1; i < mesh.vertexCount; i++)
+		{
+			if (memcmp(&mesh.vertices[(size_t)order[i - 1] * stride], &mesh.vertices[(size_t)order[i] * stride], stride) == 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Welds an unrolled copy of mesh and checks the result. Returns the welded vertex count, or 0 on failure.
+	unsigned int CheckWeld(const MeshData& mesh, const char* what)
+	{
+		MeshData welded, again;
+
+		Unroll(mesh, welded);
+		WeldMesh(welded);
+
+		if (!SameTriangles(welded, mesh))
+		{
+			printf("    %s: welding changed the triangles\n", what);
+			return 0;
+		}
+		if (welded.vertices.size() != (size_t)welded.vertexCount * welded.vertexStride || !AllDistinct(welded))
+		{
+			printf("    %s: welding left identical vertices apart\n", what);
+			return 0;
+		}
+		if (!InFirstUseOrder(welded))
+		{
+			printf("    %s: welded vertices are not in first use order\n", what);
+			return 0;
+		}
+
+		again = welded;
+		WeldMesh(again);
+		if (again.vertexCount != welded.vertexCount || again.indices != welded.indices || again.vertices != welded.vertices)
+		{
+			printf("    %s: welding a welded mesh changed it\n", what);
+			return 0;
+		}
+
+		return welded.vertexCount;
+	}
+
+	// Packs a copy of indices in place and compares it with PackIndices, then unpacks it again.
+	bool CheckIndexPacking(const std::vector<unsigned int>& indices, unsigned int indexSize)
+	{
+		std::vector<unsigned int> inPlace = indices;
+		std::vector<unsigned char> packed(indices.size() * indexSize + 1);
+
+		PackIndices(indices.data(), indices.size(), indexSize, packed.data());
+		PackIndicesInPlace(inPlace.data(), inPlace.size(), indexSize);
+		if (!indices.empty() && memcmp(inPlace.data(), packed.data(), indices.size() * indexSize) != 0)
+		{
+			return false;
+		}
+
+		UnpackIndicesInPlace(inPlace.data(), inPlace.size(), indexSize);
+
+		return inPlace == indices;
+	}
+
+	bool CheckIndexPackingCases()
+	{
+		std::vector<unsigned int> indices;
+		uint32_t random = 1;
+		unsigned int count, i;
+		int failures = 0;
+
+		if (GetIndexSize(0) != 2 || GetIndexSize(0x10000) != 2 || GetIndexSize(0x10001) != 4)
+		{
+			printf("    index size: 16 bit indices do not address exactly 65536 vertices\n");
+			failures++;
+		}
+
+		// Every count up to a few cache lines, where the packed and unpacked ranges overlap the most,
+		// with values up to 0xFFFF.
+		for (count = 0; count <= 70; count++)
+		{
+			indices.resize(count);
+			for (i = 0; i < count; i++)
+			{
+				random = random * 1664525u + 1013904223u;
+				indices[i] = (i % 5 == 0) ? 0xFFFFu : (random >> 16);
+			}
+
+			if (!CheckIndexPacking(indices, 2) || !CheckIndexPacking(indices, 4))
+			{
+				printf("    %u indices do not pack and unpack in place\n", count);
+				failures++;
+			}
+		}
+
+		// 32 bit indices are left exactly as they are.
+		indices.assign({ 0x10000u, 0xFFFFFFFFu, 7u });
+		if (!CheckIndexPacking(indices, 4))
+		{
+			printf("    32 bit indices changed\n");
+			failures++;
+		}
+
+		printf("%-32s %s\n", "in place index packing", failures ? "FAILED" : "ok");
+
+		return failures == 0;
+	}
+
+	void SetPlainVertex(MeshData& mesh, unsigned int index, float x, float y, float z, float u, float v, float nx, float ny, float nz)
+	{
+		MeshVertex& vertex = mesh.GetVertices<MeshVertex>()[index];
+
+		vertex.position[0] = x;
+		vertex.position[1] = y;
+		vertex.position[2] = z;
+		vertex.texture[0] = u;
+		vertex.texture[1] = v;
+		vertex.normal[0] = nx;
+		vertex.normal[1] = ny;
+		vertex.normal[2] = nz;
+	}
+
+	void MakePlainMesh(MeshData& mesh, unsigned int vertexCount)
+	{
+		unsigned int i;
+
+		mesh.Clear();
+		mesh.layout = MESH_LAYOUT_PLAIN;
+		mesh.vertexStride = sizeof(MeshVertex);
+		mesh.vertexCount = vertexCount;
+		mesh.unrolledVertexCount = vertexCount;
+		mesh.vertices.assign((size_t)vertexCount * sizeof(MeshVertex), 0);
+		for (i = 0; i < vertexCount; i++)
+		{
+			mesh.indices.push_back(i);
+		}
+	}
+
+	// Hand made unrolled meshes, welded directly, with the vertex count each should come to.
+	bool CheckCornerCases()
+	{
+		MeshData mesh;
+		const float nan = std::nanf("");
+		int failures = 0;
+		unsigned int i;
+
+		// 0 and -0 compare equal as floats but are different vertices; the same NaN is one vertex.
+		MakePlainMesh(mesh, 6);
+		SetPlainVertex(mesh, 0, 0.0f, 1.0f, 2.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f);
+		SetPlainVertex(mesh, 1, -0.0f, 1.0f, 2.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f);
+		SetPlainVertex(mesh, 2, 0.0f, 1.0f, 2.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f);
+		SetPlainVertex(mesh, 3, nan, 1.0f, 2.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f);
+		SetPlainVertex(mesh, 4, nan, 1.0f, 2.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f);
+		SetPlainVertex(mesh, 5, 0.0f, 1.0f, 2.0f, 0.5f, 0.5f, 0.0f, 0.0f, -0.0f);
+		WeldMesh(mesh);
+		if (mesh.vertexCount != 4 || mesh.indices != std::vector<unsigned int>({ 0, 1, 0, 2, 2, 3 }))
+		{
+			printf("    signed zeros and NaNs: %u vertices\n", mesh.vertexCount);
+			failures++;
+		}
+
+		// A vertex repeated many times, and every one the same but for the last byte of the normal.
+		MakePlainMesh(mesh, 3000);
+		for (i = 0; i < mesh.vertexCount; i++)
+		{
+			SetPlainVertex(mesh, i, 1.0f, 2.0f, 3.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f);
+		}
+		WeldMesh(mesh);
+		if (mesh.vertexCount != 1 || mesh.indices != std::vector<unsigned int>(3000, 0))
+		{
+			printf("    one repeated vertex: %u vertices\n", mesh.vertexCount);
+			failures++;
+		}
+
+		MakePlainMesh(mesh, 3000);
+		for (i = 0; i < mesh.vertexCount; i++)
+		{
+			SetPlainVertex(mesh, i, 1.0f, 2.0f, 3.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f);
+			mesh.vertices[(size_t)i * sizeof(MeshVertex) + sizeof(MeshVertex) - 1] = (unsigned char)(i % 7);
+		}
+		if (CheckWeld(mesh, "vertices apart by one byte") != 7)
+		{
+			failures++;
+		}
+
+		MakePlainMesh(mesh, 0);
+		WeldMesh(mesh);
+		if (mesh.vertexCount != 0 || !mesh.indices.empty())
+		{
+			printf("    empty mesh: %u vertices\n", mesh.vertexCount);
+			failures++;
+		}
+
+		printf("%-32s %s\n", "weld corner cases", failures ? "FAILED" : "ok");
+
+		return failures == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const MeshLayout layouts[] = { MESH_LAYOUT_PLAIN, MESH_LAYOUT_NORMALMAP, MESH_LAYOUT_SHADOWMAP };
+	const char* layoutNames[] = { "plain", "normal mapped", "shadow map" };
+	std::vector<std::string> files;
+	std::string directory = argc > 1 ? argv[1] : ".";
+	ObjMesh obj;
+	MeshData mesh;
+	unsigned int counts[3];
+	int failures = 0, layout;
+	bool passed;
+
+	if (!ListSceneFiles(directory, files))
+	{
+		return 1;
+	}
+
+	failures += CheckCornerCases() ? 0 : 1;
+	failures += CheckIndexPackingCases() ? 0 : 1;
+
+	for (const std::string& file : files)
+	{
+		std::string name = GetSceneFileName(file);
+
+		if (!LoadObjFile(file.c_str(), obj))
+		{
+			printf("%-32s FAILED to parse\n", name.c_str());
+			failures++;
+			continue;
+		}
+
+		passed = true;
+		for (layout = 0; layout < 3; layout++)
+		{
+			counts[layout] = 0;
+			if (!BuildMesh(obj, layouts[layout], mesh))
+			{
+				printf("    %s: does not build\n", layoutNames[layout]);
+			}
+			else
+			{
+				counts[layout] = CheckWeld(mesh, layoutNames[layout]);
+				if (!CheckIndexPacking(mesh.indices, GetIndexSize(mesh.vertexCount)))
+				{
+					printf("    %s: indices do not pack and unpack in place\n", layoutNames[layout]);
+					counts[layout] = 0;
+				}
+			}
+
+			// Only the normal mapped layout changes its vertices after welding, so the others weld to what BuildMesh made.
+			if (counts[layout] == 0 || (layouts[layout] != MESH_LAYOUT_NORMALMAP && counts[layout] != mesh.vertexCount))
+			{
+				passed = false;
+			}
+		}
+
+		printf("%-32s %s %u corners welded to %u plain, %u normal mapped, %u shadow map vertices\n", name.c_str(), passed ? "ok    " : "FAILED",
+			mesh.unrolledVertexCount, counts[0], counts[1], counts[2]);
+		failures += passed ? 0 : 1;
+	}
+
+	return failures ? 1 : 0;
+}
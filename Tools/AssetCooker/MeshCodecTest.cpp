@@ -0,0 +1,337 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshCodecTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Round trips bytes through the block compressor and mesh arrays through the MeshCodec streams,
+// and checks both refuse what they cannot decode exactly. The compressor gets hand made buffers
+// (empty, single bytes, long runs, repeats just inside and past its window, noise) and every .obj
+// in the directory (default ".") as it is on disk; each has to come back byte for byte, and fail
+// when cut short or asked for a byte more or less. The codec gets the vertices of every mesh in
+// each float layout and the packed one and the indices at both widths, compressed and not; each
+// has to decode to the same bytes and fail on a wrong count, kind, width or size, cut short, or
+// with a header claiming more than it holds, without sizing anything from that claim. Random byte
+// flips in both must decode or fail, never crash; run under a sanitizer to catch stray reads.
+//
+//   MeshCodecTest [directory]
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Compressor.h"
+#include "MeshBuilder.h"
+#include "MeshCodec.h"
+#include "MeshQuantizer.h"
+#include "TestHelpers.h"
+
+namespace
+{
+	const int s_flipTrials = 64;
+
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+
+		return state >> 8;
+	}
+
+	bool ReadFileBytes(const std::string& path, std::vector<unsigned char>& bytes)
+	{
+		FILE* file;
+		long size;
+		bool read;
+
+		file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+
+		fseek(file, 0, SEEK_END);
+		size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		bytes.resize(size > 0 ? (size_t)size : 0);
+		read = bytes.empty() || fread(bytes.data(), bytes.size(), 1, file) == 1;
+		fclose(file);
+
+		return read;
+	}
+
+	// Compresses data, decompresses it back, and tries it cut short, with the wrong size and with
+	// bytes flipped. Incompressible data has to be reported as such and nothing else checked.
+	bool CheckCompressor(const std::vector<unsigned char>& data, const char* name, bool print)
+	{
+		std::vector<unsigned char> compressed, decoded, flipped;
+		uint32_t random = 7;
+		size_t compressedSize;
+		const char* failure = 0;
+		int trial;
+
+		compressedSize = CompressBlock(data.data(), data.size(), compressed);
+		if (compressedSize == 0)
+		{
+			if (!compressed.empty())
+			{
+				failure = "wrote to out though it did not compress";
+			}
+		}
+		else if (compressedSize != compressed.size() || compressedSize >= data.size())
+		{
+			failure = "reported a size that is not what it wrote, or no smaller than the data";
+		}
+		else
+		{
+			// One spare byte past the end to catch a write past decodedSize.
+			decoded.assign(data.size() + 1, 0xA5);
+			if (!DecompressBlock(compressed.data(), compressed.size(), decoded.data(), data.size()) ||
+				memcmp(decoded.data(), data.data(), data.size()) != 0 || decoded[data.size()] != 0xA5)
+			{
+				failure = "did not decompress to the data";
+			}
+			else if (DecompressBlock(compressed.data(), compressed.size() - 1, decoded.data(), data.size()))
+			{
+				failure = "decompressed a block with its last byte cut off";
+			}
+			else if (DecompressBlock(compressed.data(), compressed.size(), decoded.data(), data.size() - 1) ||
+				DecompressBlock(compressed.data(), compressed.size(), decoded.data(), data.size() + 1))
+			{
+				failure = "decompressed to a size other than the data's";
+			}
+
+			for (trial = 0; trial < s_flipTrials && !failure; trial++)
+			{
+				flipped = compressed;
+				flipped[NextRandom(random) % flipped.size()] ^= (unsigned char)(1 + NextRandom(random) % 255);
+				DecompressBlock(flipped.data(), flipped.size(), decoded.data(), data.size());
+			}
+		}
+
+		if (print || failure)
+		{
+			printf("%-32s %s %zu bytes -> %zu\n", name, failure ? "FAILED" : "ok    ", data.size(), compressedSize ? compressedSize : data.size());
+		}
+		if (failure)
+		{
+			printf("    compressor %s\n", failure);
+		}
+
+		return failure == 0;
+	}
+
+	bool CheckCompressorCases()
+	{
+		std::vector<unsigned char> data;
+		uint32_t random = 1;
+		size_t i;
+		int failures = 0;
+
+		data.clear();
+		failures += CheckCompressor(data, "empty", true) ? 0 : 1;
+
+		data.assign(1, 42);
+		failures += CheckCompressor(data, "one byte", true) ? 0 : 1;
+
+		// Runs that need length bytes, and one whose extra length is exactly 255.
+		data.assign(100000, 0);
+		failures += CheckCompressor(data, "100000 zeros", true) ? 0 : 1;
+		data.assign(4 + 15 + 255, 9);
+		data.insert(data.begin(), 1);
+		failures += CheckCompressor(data, "run with a 255 length byte", true) ? 0 : 1;
+
+		// Periods that exercise every match copy: overlapping ones under 8 bytes apart and wider ones.
+		for (size_t period : { 2, 3, 7, 8, 9, 17, 31 })
+		{
+			char name[64];
+
+			data.resize(5000);
+			for (i = 0; i < data.size(); i++)
+			{
+				data[i] = (unsigned char)((i % period) * 37 + 11);
+			}
+			snprintf(name, sizeof(name), "period %zu", period);
+			failures += CheckCompressor(data, name, true) ? 0 : 1;
+		}
+
+		// Noise with a block repeated at the edge of the 64 KB window and one past it.
+		data.resize(200000);
+		for (i = 0; i < data.size(); i++)
+		{
+			data[i] = (unsigned char)NextRandom(random);
+		}
+		failures += CheckCompressor(data, "noise", true) ? 0 : 1;
+		memcpy(&data[100000], &data[100000 - 65535], 1000);
+		memcpy(&data[150000], &data[150000 - 65536], 1000);
+		failures += CheckCompressor(data, "repeats at the window edge", true) ? 0 : 1;
+
+		// Literal runs of every length around the 15 that needs a length byte, between matches.
+		data.clear();
+		for (i = 0; i < 40; i++)
+		{
+			size_t literal;
+
+			for (literal = 0; literal < i; literal++)
+			{
+				data.push_back((unsigned char)NextRandom(random));
+			}
+			data.insert(data.end(), 24, (unsigned char)i);
+		}
+		failures += CheckCompressor(data, "literal runs 0 to 39", true) ? 0 : 1;
+
+		return failures == 0;
+	}
+
+	// Encodes count elements of stride bytes as a vertex stream, or count indices when indexSize is
+	// not 0, and checks it decodes exactly and refuses everything it should.
+	bool CheckStream(const void* elements, size_t count, unsigned int stride, unsigned int channelSize, unsigned int indexSize, bool compress,
+		const char** failure)
+	{
+		const bool indices = indexSize != 0;
+		const unsigned int outputSize = indices ? indexSize : stride;
+		std::vector<unsigned char> stream, flipped, decoded, scratch, expected;
+		MeshStreamHeader header;
+		uint32_t random = 3;
+		size_t i;
+		int trial;
+
+		if (indices)
+		{
+			EncodeIndexStream(static_cast<const unsigned int*>(elements), count, indexSize, compress, stream);
+			expected.resize(count * indexSize);
+			PackIndices(static_cast<const unsigned int*>(elements), count, indexSize, expected.data());
+		}
+		else
+		{
+			EncodeVertexStream(elements, count, stride, channelSize, compress, stream);
+			expected.assign(static_cast<const unsigned char*>(elements), static_cast<const unsigned char*>(elements) + count * stride);
+		}
+
+		auto decode = [&](const std::vector<unsigned char>& data, size_t size, size_t decodeCount, unsigned int width)
+		{
+			decoded.assign(decodeCount * outputSize + 1, 0xA5);
+			return indices ? DecodeIndexStream(data.data(), size, decodeCount, width, decoded.data(), scratch) :
+				DecodeVertexStream(data.data(), size, decodeCount, width, decoded.data(), scratch);
+		};
+
+		if (!decode(stream, stream.size(), count, outputSize) || memcmp(decoded.data(), expected.data(), expected.size()) != 0 ||
+			decoded[expected.size()] != 0xA5)
+		{
+			*failure = "does not decode to what was encoded";
+			return false;
+		}
+		if (decode(stream, stream.size() - 1, count, outputSize))
+		{
+			*failure = "decodes with its last byte cut off";
+			return false;
+		}
+		if (decode(stream, stream.size(), count + 1, outputSize) || (count > 0 && decode(stream, stream.size(), count - 1, outputSize)))
+		{
+			*failure = "decodes to another count";
+			return false;
+		}
+		if (decode(stream, stream.size(), count, indices ? 6 - indexSize : stride + channelSize))
+		{
+			*failure = "decodes at another width";
+			return false;
+		}
+		if (indices ? DecodeVertexStream(stream.data(), stream.size(), count, indexSize, decoded.data(), scratch) :
+			DecodeIndexStream(stream.data(), stream.size(), count, 4, decoded.data(), scratch))
+		{
+			*failure = "decodes as the other kind of stream";
+			return false;
+		}
+
+		// A header claiming far more than the stream holds fails before scratch is sized from it.
+		flipped = stream;
+		memcpy(&header, flipped.data(), sizeof(header));
+		header.filteredSize = 0xFFFFFFF0u;
+		header.flags = MESH_STREAM_COMPRESSED;
+		memcpy(flipped.data(), &header, sizeof(header));
+		scratch.clear();
+		scratch.shrink_to_fit();
+		if (decode(flipped, flipped.size(), count, outputSize) || scratch.capacity() > expected.size())
+		{
+			*failure = "sizes its scratch from a corrupt header";
+			return false;
+		}
+
+		for (trial = 0; trial < s_flipTrials; trial++)
+		{
+			flipped = stream;
+			i = sizeof(MeshStreamHeader) + (flipped.size() > sizeof(MeshStreamHeader) ? NextRandom(random) % (flipped.size() - sizeof(MeshStreamHeader)) : 0);
+			if (i < flipped.size())
+			{
+				flipped[i] ^= (unsigned char)(1 + NextRandom(random) % 255);
+				decode(flipped, flipped.size(), count, outputSize);
+			}
+		}
+
+		return true;
+	}
+
+	// Every array of mesh, compressed and not; the indices at their upload width and at 32 bits.
+	bool CheckMesh(const MeshData& mesh, const char* what)
+	{
+		const unsigned int channelSize = GetVertexChannelSize(mesh.layout);
+		const unsigned int indexSize = GetIndexSize(mesh.vertexCount);
+		const char* failure = 0;
+		int compress;
+
+		for (compress = 0; compress < 2; compress++)
+		{
+			if (!CheckStream(mesh.vertices.data(), mesh.vertexCount, mesh.vertexStride, channelSize, 0, compress != 0, &failure) ||
+				!CheckStream(mesh.indices.data(), mesh.indices.size(), sizeof(unsigned int), 0, indexSize, compress != 0, &failure) ||
+				(indexSize != 4 && !CheckStream(mesh.indices.data(), mesh.indices.size(), sizeof(unsigned int), 0, 4, compress != 0, &failure)))
+			{
+				printf("    %s%s stream %s\n", what, compress ? " compressed" : "", failure);
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const MeshLayout layouts[] = { MESH_LAYOUT_PLAIN, MESH_LAYOUT_NORMALMAP, MESH_LAYOUT_SHADOWMAP, MESH_LAYOUT_NORMALMAP_PACKED };
+	const char* layoutNames[] = { "plain", "normal mapped", "shadow map", "packed" };
+	std::vector<std::string> files;
+	std::vector<unsigned char> bytes;
+	std::string directory = argc > 1 ? argv[1] : ".";
+	ObjMesh obj;
+	MeshData mesh;
+	int failures = 0, layout;
+	bool passed;
+
+	if (!ListSceneFiles(directory, files))
+	{
+		return 1;
+	}
+
+	failures += CheckCompressorCases() ? 0 : 1;
+
+	for (const std::string& file : files)
+	{
+		std::string name = GetSceneFileName(file);
+
+		passed = ReadFileBytes(file, bytes) && CheckCompressor(bytes, name.c_str(), false) && LoadObjFile(file.c_str(), obj);
+		for (layout = 0; layout < 4 && passed; layout++)
+		{
+			passed = BuildMesh(obj, layouts[layout] == MESH_LAYOUT_NORMALMAP_PACKED ? MESH_LAYOUT_NORMALMAP : layouts[layout], mesh) &&
+				(layouts[layout] != MESH_LAYOUT_NORMALMAP_PACKED || QuantizeMesh(mesh));
+			if (!passed)
+			{
+				printf("    %s does not build\n", layoutNames[layout]);
+			}
+			passed = passed && CheckMesh(mesh, layoutNames[layout]);
+		}
+
+		printf("%-32s %s compressed and every layout's arrays encoded\n", name.c_str(), passed ? "ok    " : "FAILED");
+		failures += passed ? 0 : 1;
+	}
+
+	return failures ? 1 : 0;
+}
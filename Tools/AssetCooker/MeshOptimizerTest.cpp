@@ -0,0 +1,275 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshOptimizerTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Checks that the optimiser only reorders: on every .obj in the directory (default ".") the
+// vertex cache, overdraw and vertex fetch passes, one after another and through OptimizeMesh,
+// have to leave the same triangles, each with its winding, drawing the same vertices. The cache
+// pass must not make the simulated cache do worse, the overdraw pass may only give back what its
+// threshold allows, and the fetch pass has to put the vertices in first use order. Hand made
+// index buffers cover degenerate triangles, a vertex shared by hundreds of triangles, vertices
+// nothing uses and an empty mesh.
+//
+//   MeshOptimizerTest [directory]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "MeshOptimizer.h"
+#include "TestHelpers.h"
+
+namespace
+{
+	struct Triangle
+	{
+		unsigned int corner[3];
+
+		bool operator<(const Triangle& other) const
+		{
+			return std::lexicographical_compare(corner, corner + 3, other.corner, other.corner + 3);
+		}
+
+		bool operator==(const Triangle& other) const
+		{
+			return memcmp(corner, other.corner, sizeof(corner)) == 0;
+		}
+	};
+
+	// The triangles of an index buffer, each turned to its smallest rotation so the winding is kept
+	// whatever corner it starts at, sorted.
+	void GetTriangles(const std::vector<unsigned int>& indices, std::vector<Triangle>& triangles)
+	{
+		Triangle rotation;
+		size_t i;
+		int first;
+
+		triangles.resize(indices.size() / 3);
+		for (i = 0; i < triangles.size(); i++)
+		{
+			const unsigned int* corners = &indices[i * 3];
+
+			for (first = 0; first < 3; first++)
+			{
+				rotation.corner[0] = corners[first];
+				rotation.corner[1] = corners[(first + 1) % 3];
+				rotation.corner[2] = corners[(first + 2) % 3];
+				if (first == 0 || rotation < triangles[i])
+				{
+					triangles[i] = rotation;
+				}
+			}
+		}
+		std::sort(triangles.begin(), triangles.end());
+	}
+
+	bool SameTriangles(const std::vector<unsigned int>& a, const std::vector<unsigned int>& b)
+	{
+		std::vector<Triangle> first, second;
+
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+
+		GetTriangles(a, first);
+		GetTriangles(b, second);
+
+		return first == second;
+	}
+
+	// The indices of optimised rewritten to the vertices of original they draw, which has no two
+	// vertices alike; false when a vertex of optimised is not one of original's.
+	bool MapToOriginal(const MeshData& optimised, const MeshData& original, std::vector<unsigned int>& indices)
+	{
+		const unsigned int stride = original.vertexStride;
+		std::map<std::string, unsigned int> lookup;
+		std::map<std::string, unsigned int>::const_iterator found;
+		unsigned int i;
+
+		for (i = 0; i < original.vertexCount; i++)
+		{
+			lookup[std::string((const char*)&original.vertices[(size_t)i * stride], stride)] = i;
+		}
+
+		indices.resize(optimised.indices.size());
+		for (i = 0; i < (unsigned int)optimised.indices.size(); i++)
+		{
+			if (optimised.indices[i] >= optimised.vertexCount)
+			{
+				return false;
+			}
+
+			found = lookup.find(std::string((const char*)&optimised.vertices[(size_t)optimised.indices[i] * stride], stride));
+			if (found == lookup.end())
+			{
+				return false;
+			}
+			indices[i] = found->second;
+		}
+
+		return true;
+	}
+
+	// Runs the passes one at a time on a copy of mesh, then OptimizeMesh on another, and checks each.
+	bool CheckOptimize(const MeshData& mesh, const char* name, bool print)
+	{
+		const float overdrawThreshold = 1.05f;
+		MeshData optimised = mesh, whole = mesh;
+		std::vector<unsigned int> cached, drawn;
+		VertexCacheStats before, afterCache, afterOverdraw;
+		MeshOptimizeReport report;
+		const char* failure = 0;
+
+		before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertexCount);
+
+		OptimizeVertexCache(optimised.indices.data(), optimised.indices.size(), optimised.vertexCount);
+		afterCache = AnalyzeVertexCache(optimised.indices.data(), optimised.indices.size(), optimised.vertexCount);
+		cached = optimised.indices;
+
+		OptimizeOverdraw(optimised.indices.data(), optimised.indices.size(), optimised.vertices.data(), optimised.vertexCount, optimised.vertexStride,
+			overdrawThreshold);
+		afterOverdraw = AnalyzeVertexCache(optimised.indices.data(), optimised.indices.size(), optimised.vertexCount);
+		drawn = optimised.indices;
+
+		OptimizeVertexFetch(optimised);
+		OptimizeMesh(whole, &report);
+
+		if (!SameTriangles(cached, mesh.indices))
+		{
+			failure = "the vertex cache pass changed the triangles";
+		}
+		else if (!mesh.indices.empty() && afterCache.acmr > before.acmr)
+		{
+			failure = "the vertex cache pass made the cache do worse";
+		}
+		else if (!SameTriangles(drawn, mesh.indices))
+		{
+			failure = "the overdraw pass changed the triangles";
+		}
+		else if (afterOverdraw.acmr > afterCache.acmr * overdrawThreshold + 1e-5f)
+		{
+			failure = "the overdraw pass gave back more than its threshold";
+		}
+		else if (optimised.indices.size() != drawn.size() || !MapToOriginal(optimised, mesh, cached) || cached != drawn)
+		{
+			failure = "the vertex fetch pass changed what is drawn";
+		}
+		else if (!InFirstUseOrder(optimised) || optimised.vertices.size() != (size_t)optimised.vertexCount * optimised.vertexStride)
+		{
+			failure = "the vertex fetch pass did not leave the vertices in first use order";
+		}
+		else if (!MapToOriginal(whole, mesh, cached) || !SameTriangles(cached, mesh.indices) || !InFirstUseOrder(whole))
+		{
+			failure = "OptimizeMesh changed the triangles";
+		}
+
+		if (print || failure)
+		{
+			printf("%-32s %s %zu triangles, ACMR %.3f -> %.3f, overdraw pass %.3f, OptimizeMesh %.3f\n", name, failure ? "FAILED" : "ok    ",
+				mesh.indices.size() / 3, before.acmr, afterCache.acmr, afterOverdraw.acmr, report.after.acmr);
+		}
+		if (failure)
+		{
+			printf("    %s\n", failure);
+		}
+
+		return failure == 0;
+	}
+
+	void MakeMesh(MeshData& mesh, unsigned int vertexCount, const std::vector<unsigned int>& indices)
+	{
+		MeshVertexSM* vertices;
+		unsigned int i;
+
+		mesh.Clear();
+		mesh.layout = MESH_LAYOUT_SHADOWMAP;
+		mesh.vertexStride = sizeof(MeshVertexSM);
+		mesh.vertexCount = vertexCount;
+		mesh.unrolledVertexCount = (unsigned int)indices.size();
+		mesh.vertices.resize((size_t)vertexCount * sizeof(MeshVertexSM));
+		mesh.indices = indices;
+
+		// Distinct points on a spiral, so overdraw sorting has facings to work with.
+		vertices = mesh.GetVertices<MeshVertexSM>();
+		for (i = 0; i < vertexCount; i++)
+		{
+			vertices[i].position[0] = cosf((float)i * 0.7f) * (1.0f + (float)i * 0.01f);
+			vertices[i].position[1] = sinf((float)i * 0.7f) * (1.0f + (float)i * 0.01f);
+			vertices[i].position[2] = (float)(i % 5) * 0.1f;
+		}
+	}
+
+	bool CheckCornerCases()
+	{
+		std::vector<unsigned int> indices;
+		MeshData mesh;
+		unsigned int i;
+		int failures = 0;
+
+		// Degenerate triangles mixed in with real ones.
+		indices = { 0, 1, 2, 2, 2, 3, 1, 1, 1, 3, 2, 1, 4, 4, 0, 0, 4, 3 };
+		MakeMesh(mesh, 5, indices);
+		failures += CheckOptimize(mesh, "degenerate triangles", true) ? 0 : 1;
+
+		// A fan of 600 triangles round one vertex, far past any valence the scoring expects.
+		indices.clear();
+		for (i = 0; i < 600; i++)
+		{
+			indices.push_back(0);
+			indices.push_back(1 + i);
+			indices.push_back(1 + (i + 1) % 600);
+		}
+		MakeMesh(mesh, 601, indices);
+		failures += CheckOptimize(mesh, "600 triangle fan", true) ? 0 : 1;
+
+		// Vertices no triangle uses, before, between and after the ones drawn.
+		indices = { 3, 5, 7, 7, 5, 9, 9, 5, 3 };
+		MakeMesh(mesh, 12, indices);
+		failures += CheckOptimize(mesh, "unused vertices", true) ? 0 : 1;
+
+		indices.clear();
+		MakeMesh(mesh, 0, indices);
+		failures += CheckOptimize(mesh, "empty mesh", true) ? 0 : 1;
+
+		return failures == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	std::string directory = argc > 1 ? argv[1] : ".";
+	ObjMesh obj;
+	MeshData mesh;
+	int failures = 0;
+
+	if (!ListSceneFiles(directory, files))
+	{
+		return 1;
+	}
+
+	failures += CheckCornerCases() ? 0 : 1;
+
+	// The plain layout, whose welded vertices are all distinct, so the fetch pass can be followed by value.
+	for (const std::string& file : files)
+	{
+		std::string name = GetSceneFileName(file);
+
+		if (!BuildSceneMesh(file, MESH_LAYOUT_PLAIN, obj, mesh))
+		{
+			printf("%-32s FAILED to build\n", name.c_str());
+			failures++;
+			continue;
+		}
+
+		failures += CheckOptimize(mesh, name.c_str(), true) ? 0 : 1;
+	}
+
+	return failures ? 1 : 0;
+}
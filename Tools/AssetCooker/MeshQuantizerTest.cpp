@@ -0,0 +1,286 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshQuantizerTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Round trips normal mapped vertices through the 20 byte packed layout on the CPU and fails when
+// any decodes further from the float vertex than MeshQuantizer.h allows. Every .obj in the directory
+// (default ".") is built in the float normal mapped layout, quantized and unpacked vertex by vertex.
+// A hand made mesh covers the octahedral corner cases the scene may not: both poles, the axes, the
+// equator and the fold of the lower hemisphere onto the corners of the square.
+//
+//   MeshQuantizerTest [directory]
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "MeshQuantizer.h"
+#include "ObjParser.h"
+#include "TestHelpers.h"
+
+namespace
+{
+	// The bound MeshQuantizer.h gives 16 bit octahedral normals and tangents.
+	const float s_maxAngleDegrees = 0.005f;
+
+	struct RoundTripError
+	{
+		float position;		// as a share of what is allowed, see Allowance
+		float texture;
+		float normalDegrees;
+		float tangentDegrees;
+		unsigned int flippedBinormals;
+	};
+
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void Cross(const float a[3], const float b[3], float result[3])
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	bool Normalize(float v[3])
+	{
+		float length = sqrtf(Dot(v, v));
+
+		if (!(length > FLT_MIN) || !std::isfinite(length))
+		{
+			return false;
+		}
+
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+
+		return true;
+	}
+
+	// In double and through the sine as well, acosf alone cannot tell angles under a few hundredths of a degree apart.
+	float AngleDegrees(const float a[3], const float b[3])
+	{
+		double cross[3], sine, cosine;
+
+		cross[0] = (double)a[1] * b[2] - (double)a[2] * b[1];
+		cross[1] = (double)a[2] * b[0] - (double)a[0] * b[2];
+		cross[2] = (double)a[0] * b[1] - (double)a[1] * b[0];
+		sine = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+		cosine = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+
+		return (float)(atan2(sine, cosine) * (180.0 / 3.14159265358979));
+	}
+
+	// Error of a decoded value as a share of half a quantization step, plus the rounding of the floats
+	// it goes through: a mesh far from the origin has coordinates coarser than its steps.
+	float Allowance(float decoded, float original, float scale, float bias)
+	{
+		float magnitude = std::max(fabsf(original), std::max(fabsf(bias), fabsf(bias + scale)));
+		float allowed = scale * 0.5f / 65535.0f + 2.0f * FLT_EPSILON * magnitude;
+
+		return allowed > 0.0f ? fabsf(decoded - original) / allowed : (decoded == original ? 0.0f : FLT_MAX);
+	}
+
+	// Packs a copy of mesh, a float normal mapped mesh, and compares every vertex with what it decodes to.
+	bool RoundTrip(const MeshData& mesh, RoundTripError& error)
+	{
+		MeshData packed = mesh;
+		const MeshVertexNM* original = mesh.GetVertices<MeshVertexNM>();
+		unsigned int i;
+		int axis;
+
+		memset(&error, 0, sizeof(error));
+		if (!QuantizeMesh(packed) || packed.vertexStride != sizeof(MeshVertexNMPacked) || packed.vertexCount != mesh.vertexCount)
+		{
+			return false;
+		}
+
+		for (i = 0; i < mesh.vertexCount; i++)
+		{
+			const MeshVertexNM& source = original[i];
+			const MeshQuantization& quantization = packed.quantization;
+			MeshVertexNM decoded;
+			float normal[3], tangent[3], frame[3], binormal[3], along;
+
+			UnpackVertex(packed.GetVertices<MeshVertexNMPacked>()[i], quantization, decoded);
+
+			for (axis = 0; axis < 3; axis++)
+			{
+				error.position = std::max(error.position, Allowance(decoded.position[axis], source.position[axis], quantization.positionScale[axis], quantization.positionBias[axis]));
+			}
+			for (axis = 0; axis < 2; axis++)
+			{
+				error.texture = std::max(error.texture, Allowance(decoded.texture[axis], source.texture[axis], quantization.textureScale[axis], quantization.textureBias[axis]));
+			}
+
+			// The normal as given, the tangent with its part along the normal taken out, as QuantizeMesh
+			// encodes them. Frames without a usable normal or tangent have nothing to compare with.
+			memcpy(normal, source.normal, sizeof(normal));
+			memcpy(tangent, source.tangent, sizeof(tangent));
+			if (!Normalize(normal))
+			{
+				continue;
+			}
+			error.normalDegrees = std::max(error.normalDegrees, AngleDegrees(decoded.normal, normal));
+
+			along = Dot(normal, tangent);
+			for (axis = 0; axis < 3; axis++)
+			{
+				tangent[axis] -= normal[axis] * along;
+			}
+			if (!Normalize(tangent))
+			{
+				continue;
+			}
+			error.tangentDegrees = std::max(error.tangentDegrees, AngleDegrees(decoded.tangent, tangent));
+
+			// The handedness survives whenever the binormal is clearly on one side of the frame.
+			Cross(normal, tangent, frame);
+			memcpy(binormal, source.binormal, sizeof(binormal));
+			if (Normalize(binormal) && fabsf(Dot(frame, binormal)) > 0.1f && (Dot(frame, binormal) > 0.0f) != (Dot(decoded.binormal, frame) > 0.0f))
+			{
+				error.flippedBinormals++;
+			}
+		}
+
+		return true;
+	}
+
+	bool WithinBounds(const RoundTripError& error)
+	{
+		return error.position <= 1.0f && error.texture <= 1.0f && error.normalDegrees <= s_maxAngleDegrees &&
+			error.tangentDegrees <= s_maxAngleDegrees && error.flippedBinormals == 0;
+	}
+
+	void SetVertex(MeshVertexNM& vertex, float x, float y, float z, const float normal[3], const float tangent[3], float handedness)
+	{
+		float n[3], t[3];
+		float along;
+		int axis;
+
+		memcpy(n, normal, sizeof(n));
+		memcpy(t, tangent, sizeof(t));
+		Normalize(n);
+		along = Dot(n, t);
+		for (axis = 0; axis < 3; axis++)
+		{
+			t[axis] -= n[axis] * along;
+		}
+		Normalize(t);
+
+		vertex.position[0] = x;
+		vertex.position[1] = y;
+		vertex.position[2] = z;
+		vertex.texture[0] = x * 0.25f;
+		vertex.texture[1] = 1.0f - z * 0.25f;
+		memcpy(vertex.normal, n, sizeof(n));
+		memcpy(vertex.tangent, t, sizeof(t));
+		Cross(n, t, vertex.binormal);
+		for (axis = 0; axis < 3; axis++)
+		{
+			vertex.binormal[axis] *= handedness;
+		}
+	}
+
+	// One vertex per normal, each with a tangent off one of the other axes and alternating handedness.
+	void BuildCornerCases(MeshData& mesh)
+	{
+		const float s = 0.57735027f;
+		const float h = 0.70710678f;
+		const float e = 1e-4f;
+		const float normals[][3] =
+		{
+			{ 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },				// the poles: the centre and the corners of the square
+			{ 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+			{ e, 0.0f, -1.0f }, { -e, 0.0f, -1.0f }, { 0.0f, e, -1.0f }, { 0.0f, -e, -1.0f },	// either side of the fold at -Z
+			{ e, e, -1.0f }, { -e, -e, -1.0f }, { e, -e, -1.0f }, { -e, e, -1.0f },
+			{ h, 0.0f, -h }, { -h, 0.0f, -h }, { 0.0f, h, -h }, { 0.0f, -h, -h },
+			{ s, s, -s }, { -s, s, -s }, { s, -s, -s }, { -s, -s, -s },	// the middle of each folded triangle
+			{ s, s, s }, { -s, -s, s },
+			{ h, h, e }, { h, h, -e }, { -h, h, -e }, { h, -h, -e },		// the equator, the edge of the square
+			{ 1.0f, 0.0f, -e }, { 0.0f, -1.0f, -e },
+		};
+		const float xAxis[3] = { 1.0f, 0.0f, 0.0f };
+		const float yAxis[3] = { 0.0f, 1.0f, 0.0f };
+		MeshVertexNM* vertices;
+		unsigned int count = (unsigned int)(sizeof(normals) / sizeof(normals[0])), i;
+
+		mesh.Clear();
+		mesh.layout = MESH_LAYOUT_NORMALMAP;
+		mesh.vertexStride = sizeof(MeshVertexNM);
+		mesh.vertexCount = count;
+		mesh.unrolledVertexCount = count;
+		mesh.vertices.resize((size_t)count * sizeof(MeshVertexNM));
+		vertices = mesh.GetVertices<MeshVertexNM>();
+
+		for (i = 0; i < count; i++)
+		{
+			const float* tangent = fabsf(normals[i][0]) < 0.9f ? xAxis : yAxis;
+			SetVertex(vertices[i], (float)(i % 5) - 2.0f, (float)(i / 5) * 0.5f, (float)(i % 3), normals[i], tangent, (i & 1) ? -1.0f : 1.0f);
+		}
+
+		for (i = 0; i + 2 < count; i += 3)
+		{
+			mesh.indices.push_back(i);
+			mesh.indices.push_back(i + 1);
+			mesh.indices.push_back(i + 2);
+		}
+	}
+
+	bool Report(const char* name, bool packed, const RoundTripError& error)
+	{
+		bool passed = packed && WithinBounds(error);
+
+		printf("%-32s %s position %.3f uv %.3f of allowed, normal %.5f tangent %.5f deg, %u flipped binormals\n", name,
+			passed ? "ok    " : "FAILED", error.position, error.texture, error.normalDegrees, error.tangentDegrees, error.flippedBinormals);
+
+		return passed;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	std::string directory = argc > 1 ? argv[1] : ".";
+	RoundTripError roundTrip;
+	ObjMesh obj;
+	MeshData mesh;
+	int failures = 0;
+	bool packed;
+
+	if (!ListSceneFiles(directory, files))
+	{
+		return 1;
+	}
+
+	BuildCornerCases(mesh);
+	packed = RoundTrip(mesh, roundTrip);
+	failures += Report("octahedral corner cases", packed, roundTrip) ? 0 : 1;
+
+	for (const std::string& file : files)
+	{
+		std::string name = GetSceneFileName(file);
+
+		if (!BuildSceneMesh(file, MESH_LAYOUT_NORMALMAP, obj, mesh))
+		{
+			printf("%-32s FAILED to build\n", name.c_str());
+			failures++;
+			continue;
+		}
+
+		packed = RoundTrip(mesh, roundTrip);
+		failures += Report(name.c_str(), packed, roundTrip) ? 0 : 1;
+	}
+
+	printf("bounds: half a step of each position and uv range plus float rounding, %.3f degrees for normals and tangents\n", s_maxAngleDegrees);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,436 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MeshSimplifierTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Checks BuildShadowProxy on every .obj in the directory (default ".") in the shadow map layout at
+// MESH_SHADOW_PROXY_ERROR: the error it returns has to be within the bound, and every vertex of
+// the input within that error of the proxy's triangles, measured here in doubles. The proxy may
+// not gain triangles, its vertices have to be input vertices, each used and in first use order,
+// and it keeps no levels or clusters. Hand made height fields cover a flat grid, which has to come
+// down to little more than its locked border at no error, bumps taller than the bound, and a
+// bound of 0, which must leave the mesh as it is.
+//
+//   MeshSimplifierTest [directory]
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "MeshSimplifier.h"
+#include "TestHelpers.h"
+
+namespace
+{
+	// Cells along the longest side of a mesh's bounds, fewer when the error bound is coarser.
+	const int s_gridCells = 64;
+
+	// The triangles of a mesh binned into a uniform grid, each into every cell it comes within
+	// reach of, so all the triangles within reach of a point are in the point's own cell.
+	struct TriangleGrid
+	{
+		double origin[3];
+		double cellSize;
+		int cells[3];
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> triangles;
+	};
+
+	const float* GetPosition(const MeshData& mesh, unsigned int vertex)
+	{
+		return reinterpret_cast<const float*>(&mesh.vertices[(size_t)vertex * mesh.vertexStride]);
+	}
+
+	int GetCell(const TriangleGrid& grid, double value, int axis)
+	{
+		return std::min(std::max((int)floor((value - grid.origin[axis]) / grid.cellSize), 0), grid.cells[axis] - 1);
+	}
+
+	void BuildGrid(const MeshData& mesh, double reach, TriangleGrid& grid)
+	{
+		double low[3], high[3], extent = 0.0;
+		std::vector<unsigned int> fill;
+		size_t triangle;
+		int axis, first[3], last[3], x, y, z, pass;
+		unsigned int vertex;
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			low[axis] = DBL_MAX;
+			high[axis] = -DBL_MAX;
+		}
+		for (vertex = 0; vertex < mesh.vertexCount; vertex++)
+		{
+			for (axis = 0; axis < 3; axis++)
+			{
+				low[axis] = std::min(low[axis], (double)GetPosition(mesh, vertex)[axis]);
+				high[axis] = std::max(high[axis], (double)GetPosition(mesh, vertex)[axis]);
+			}
+		}
+		for (axis = 0; axis < 3; axis++)
+		{
+			low[axis] = mesh.vertexCount ? low[axis] : 0.0;
+			high[axis] = mesh.vertexCount ? high[axis] : 0.0;
+			extent = std::max(extent, high[axis] - low[axis]);
+		}
+
+		grid.cellSize = std::max(std::max(extent / s_gridCells, reach), 1e-6);
+		for (axis = 0; axis < 3; axis++)
+		{
+			grid.origin[axis] = low[axis];
+			grid.cells[axis] = (int)((high[axis] - low[axis]) / grid.cellSize) + 1;
+		}
+
+		// Counted on the first pass, filled on the second.
+		grid.offsets.assign((size_t)grid.cells[0] * grid.cells[1] * grid.cells[2] + 1, 0);
+		for (pass = 0; pass < 2; pass++)
+		{
+			if (pass == 1)
+			{
+				for (size_t cell = 1; cell < grid.offsets.size(); cell++)
+				{
+					grid.offsets[cell] += grid.offsets[cell - 1];
+				}
+				grid.triangles.resize(grid.offsets.back());
+				fill.assign(grid.offsets.begin(), grid.offsets.end() - 1);
+			}
+
+			for (triangle = 0; triangle < mesh.indices.size() / 3; triangle++)
+			{
+				for (axis = 0; axis < 3; axis++)
+				{
+					double a = GetPosition(mesh, mesh.indices[triangle * 3 + 0])[axis];
+					double b = GetPosition(mesh, mesh.indices[triangle * 3 + 1])[axis];
+					double c = GetPosition(mesh, mesh.indices[triangle * 3 + 2])[axis];
+
+					first[axis] = GetCell(grid, std::min(std::min(a, b), c) - reach, axis);
+					last[axis] = GetCell(grid, std::max(std::max(a, b), c) + reach, axis);
+				}
+
+				for (z = first[2]; z <= last[2]; z++)
+				{
+					for (y = first[1]; y <= last[1]; y++)
+					{
+						for (x = first[0]; x <= last[0]; x++)
+						{
+							size_t cell = ((size_t)z * grid.cells[1] + y) * grid.cells[0] + x;
+
+							if (pass == 0)
+							{
+								grid.offsets[cell + 1]++;
+							}
+							else
+							{
+								grid.triangles[fill[cell]++] = (unsigned int)triangle;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Squared distance from p to the nearest point of triangle abc, found by the region of the
+	// triangle's plane p projects into (Ericson, Real-Time Collision Detection 5.1.5).
+	double DistanceSquared(const double p[3], const double a[3], const double b[3], const double c[3])
+	{
+		double ab[3], ac[3], ap[3], bp[3], cp[3], nearest[3], d1, d2, d3, d4, d5, d6, va, vb, vc, v, w, sum;
+		int axis;
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			ab[axis] = b[axis] - a[axis];
+			ac[axis] = c[axis] - a[axis];
+			ap[axis] = p[axis] - a[axis];
+			bp[axis] = p[axis] - b[axis];
+			cp[axis] = p[axis] - c[axis];
+		}
+
+		auto dot = [](const double* x, const double* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+		auto along = [&](const double* from, const double* direction, double t)
+		{
+			for (axis = 0; axis < 3; axis++)
+			{
+				nearest[axis] = from[axis] + direction[axis] * t;
+			}
+		};
+
+		d1 = dot(ab, ap);
+		d2 = dot(ac, ap);
+		d3 = dot(ab, bp);
+		d4 = dot(ac, bp);
+		d5 = dot(ab, cp);
+		d6 = dot(ac, cp);
+		vc = d1 * d4 - d3 * d2;
+		vb = d5 * d2 - d1 * d6;
+		va = d3 * d6 - d5 * d4;
+
+		if (d1 <= 0.0 && d2 <= 0.0)
+		{
+			along(a, ab, 0.0);
+		}
+		else if (d3 >= 0.0 && d4 <= d3)
+		{
+			along(b, ab, 0.0);
+		}
+		else if (d6 >= 0.0 && d5 <= d6)
+		{
+			along(c, ab, 0.0);
+		}
+		else if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+		{
+			along(a, ab, d1 / (d1 - d3));
+		}
+		else if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+		{
+			along(a, ac, d2 / (d2 - d6));
+		}
+		else if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+		{
+			double bc[3] = { c[0] - b[0], c[1] - b[1], c[2] - b[2] };
+			along(b, bc, (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		}
+		else
+		{
+			sum = va + vb + vc;
+			v = sum > 0.0 ? vb / sum : 0.0;
+			w = sum > 0.0 ? vc / sum : 0.0;
+			for (axis = 0; axis < 3; axis++)
+			{
+				nearest[axis] = a[axis] + ab[axis] * v + ac[axis] * w;
+			}
+		}
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			nearest[axis] -= p[axis];
+		}
+
+		return dot(nearest, nearest);
+	}
+
+	// The furthest any vertex of source is from the triangles of proxy, or DBL_MAX once one is out
+	// of reach of them all.
+	double FarthestFromSurface(const MeshData& source, const MeshData& proxy, double reach)
+	{
+		TriangleGrid grid;
+		double farthest = 0.0, nearest, p[3], corners[3][3];
+		unsigned int vertex, i;
+		size_t cell;
+		int axis, corner;
+
+		BuildGrid(proxy, reach, grid);
+
+		for (vertex = 0; vertex < source.vertexCount; vertex++)
+		{
+			for (axis = 0; axis < 3; axis++)
+			{
+				p[axis] = GetPosition(source, vertex)[axis];
+			}
+
+			cell = ((size_t)GetCell(grid, p[2], 2) * grid.cells[1] + GetCell(grid, p[1], 1)) * grid.cells[0] + GetCell(grid, p[0], 0);
+			nearest = DBL_MAX;
+			for (i = grid.offsets[cell]; i < grid.offsets[cell + 1]; i++)
+			{
+				for (corner = 0; corner < 3; corner++)
+				{
+					for (axis = 0; axis < 3; axis++)
+					{
+						corners[corner][axis] = GetPosition(proxy, proxy.indices[grid.triangles[i] * 3 + corner])[axis];
+					}
+				}
+				nearest = std::min(nearest, DistanceSquared(p, corners[0], corners[1], corners[2]));
+			}
+
+			if (nearest > reach * reach)
+			{
+				return DBL_MAX;
+			}
+			farthest = std::max(farthest, sqrt(nearest));
+		}
+
+		return farthest;
+	}
+
+	// Every vertex of proxy is, byte for byte, a vertex of source.
+	bool FromSource(const MeshData& proxy, const MeshData& source)
+	{
+		std::set<std::string> vertices;
+		unsigned int i;
+
+		for (i = 0; i < source.vertexCount; i++)
+		{
+			vertices.insert(std::string((const char*)GetPosition(source, i), source.vertexStride));
+		}
+
+		for (i = 0; i < proxy.vertexCount; i++)
+		{
+			if (vertices.find(std::string((const char*)GetPosition(proxy, i), proxy.vertexStride)) == vertices.end())
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Builds the proxy of a copy of source and checks it. maxTriangles, when not 0, is how many
+	// triangles the proxy may keep at most.
+	bool CheckProxy(const MeshData& source, float maxError, size_t maxTriangles, const char* name)
+	{
+		// The simplifier and this test measure the same distances, only rounded apart.
+		const double tolerance = 1e-5;
+		MeshData proxy = source;
+		double farthest = 0.0;
+		const char* failure = 0;
+		char distance[32];
+		float error;
+
+		error = BuildShadowProxy(proxy, maxError);
+
+		if (maxError <= 0.0f)
+		{
+			if (error != 0.0f || proxy.indices != source.indices || proxy.vertices != source.vertices)
+			{
+				failure = "changed the mesh with a bound of 0";
+			}
+		}
+		else if (!(error >= 0.0f && error <= maxError))
+		{
+			failure = "returned an error past the bound";
+		}
+		else if (proxy.indices.size() > source.indices.size() || proxy.indices.size() % 3 != 0)
+		{
+			failure = "gained triangles";
+		}
+		else if (maxTriangles != 0 && proxy.indices.size() / 3 > maxTriangles)
+		{
+			failure = "kept more triangles than it needs";
+		}
+		else if (!proxy.lods.empty() || !proxy.clusters.empty())
+		{
+			failure = "kept levels or clusters";
+		}
+		else if (!FromSource(proxy, source))
+		{
+			failure = "has a vertex that is not one of the input's";
+		}
+		else if (!InFirstUseOrder(proxy) || proxy.vertices.size() != (size_t)proxy.vertexCount * proxy.vertexStride)
+		{
+			failure = "kept vertices it does not use, or not in first use order";
+		}
+		else if ((farthest = FarthestFromSurface(source, proxy, maxError)) > error + tolerance)
+		{
+			failure = "left an input vertex further from it than the error";
+		}
+
+		if (farthest == DBL_MAX)
+		{
+			snprintf(distance, sizeof(distance), "past %.4f", maxError);
+		}
+		else
+		{
+			snprintf(distance, sizeof(distance), "%.4f", farthest);
+		}
+		printf("%-32s %s %zu -> %zu triangles, %u -> %u vertices, error %.4f, farthest %s\n", name, failure ? "FAILED" : "ok    ",
+			source.indices.size() / 3, proxy.indices.size() / 3, source.vertexCount, proxy.vertexCount, error, distance);
+		if (failure)
+		{
+			printf("    the proxy %s\n", failure);
+		}
+
+		return failure == 0;
+	}
+
+	// A size by size grid of unit squares in the shadow map layout, raised by amplitude along a
+	// product of sines.
+	void MakeHeightField(MeshData& mesh, unsigned int size, float amplitude)
+	{
+		MeshVertexSM* vertices;
+		unsigned int x, z, corner;
+
+		mesh.Clear();
+		mesh.layout = MESH_LAYOUT_SHADOWMAP;
+		mesh.vertexStride = sizeof(MeshVertexSM);
+		mesh.vertexCount = (size + 1) * (size + 1);
+		mesh.vertices.resize((size_t)mesh.vertexCount * sizeof(MeshVertexSM));
+
+		vertices = mesh.GetVertices<MeshVertexSM>();
+		for (z = 0; z <= size; z++)
+		{
+			for (x = 0; x <= size; x++)
+			{
+				vertices[z * (size + 1) + x].position[0] = (float)x;
+				vertices[z * (size + 1) + x].position[1] = amplitude * sinf((float)x * 0.4f) * sinf((float)z * 0.3f);
+				vertices[z * (size + 1) + x].position[2] = (float)z;
+			}
+		}
+
+		for (z = 0; z < size; z++)
+		{
+			for (x = 0; x < size; x++)
+			{
+				corner = z * (size + 1) + x;
+				mesh.indices.insert(mesh.indices.end(), { corner, corner + size + 1, corner + 1, corner + 1, corner + size + 1, corner + size + 2 });
+			}
+		}
+		mesh.unrolledVertexCount = (unsigned int)mesh.indices.size();
+	}
+
+	bool CheckCornerCases()
+	{
+		const unsigned int size = 16;
+		MeshData mesh;
+		int failures = 0;
+
+		// The open border stays where it is and nothing inside is needed: a polygon of 4 * size
+		// corners takes 4 * size - 2 triangles, given a few more for the order collapses come in.
+		MakeHeightField(mesh, size, 0.0f);
+		failures += CheckProxy(mesh, MESH_SHADOW_PROXY_ERROR, 6 * size, "flat grid") ? 0 : 1;
+
+		MakeHeightField(mesh, size * 2, 1.0f);
+		failures += CheckProxy(mesh, MESH_SHADOW_PROXY_ERROR, 0, "bumps past the bound") ? 0 : 1;
+
+		MakeHeightField(mesh, size, 1.0f);
+		failures += CheckProxy(mesh, 0.0f, 0, "bound of 0") ? 0 : 1;
+
+		return failures == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	std::string directory = argc > 1 ? argv[1] : ".";
+	ObjMesh obj;
+	MeshData mesh;
+	int failures = 0;
+
+	if (!ListSceneFiles(directory, files))
+	{
+		return 1;
+	}
+
+	failures += CheckCornerCases() ? 0 : 1;
+
+	for (const std::string& file : files)
+	{
+		std::string name = GetSceneFileName(file);
+
+		if (!BuildSceneMesh(file, MESH_LAYOUT_SHADOWMAP, obj, mesh))
+		{
+			printf("%-32s FAILED to build\n", name.c_str());
+			failures++;
+			continue;
+		}
+
+		failures += CheckProxy(mesh, MESH_SHADOW_PROXY_ERROR, 0, name.c_str()) ? 0 : 1;
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: MipBenchmark.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Times building full mip chains with MipGenerator on 2048x2048 and 4096x4096 RGBA textures, with
+// each filter, gamma correct and not, on one thread and on -j threads (one per hardware thread by
+// default). The textures are generated, a mix of smooth gradients and per pixel noise, so the
+// numbers do not depend on what is on disk. Each case is the best of -r runs (3 by default).
+//
+//   MipBenchmark [-j threads] [-r runs]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "MipGenerator.h"
+#include "TaskPool.h"
+
+namespace
+{
+	const uint32_t s_sizes[] = { 2048, 4096 };
+
+	const char* s_filterNames[] = { "box", "kaiser" };
+
+	typedef std::chrono::steady_clock Clock;
+
+	// Every level of one texture, level 0 filled in.
+	struct Chain
+	{
+		std::vector<std::vector<uint8_t>> levels;
+		std::vector<uint8_t*> pointers;
+	};
+
+	void MakeChain(uint32_t size, Chain& chain)
+	{
+		uint32_t levelCount = GetMipLevelCount(size, size), level, x, y;
+		uint32_t seed = 12345;
+
+		chain.levels.resize(levelCount);
+		chain.pointers.resize(levelCount);
+		for (level = 0; level < levelCount; level++)
+		{
+			uint32_t levelSize = std::max(1u, size >> level);
+
+			chain.levels[level].resize((size_t)levelSize * levelSize * 4);
+			chain.pointers[level] = chain.levels[level].data();
+		}
+
+		for (y = 0; y < size; y++)
+		{
+			for (x = 0; x < size; x++)
+			{
+				uint8_t* pixel = &chain.levels[0][((size_t)y * size + x) * 4];
+
+				seed = seed * 1664525u + 1013904223u;
+				pixel[0] = (uint8_t)(128.0f + 100.0f * std::sin(x * 0.01f) * std::cos(y * 0.013f) + (float)(seed >> 28));
+				pixel[1] = (uint8_t)(x * 255 / size);
+				pixel[2] = (uint8_t)(y * 255 / size);
+				pixel[3] = (uint8_t)(seed >> 24);
+			}
+		}
+	}
+
+	double Time(Chain& chain, uint32_t size, MipFilter filter, bool gammaCorrect, TaskPool* tasks, int runs)
+	{
+		double best = 0.0;
+		int run;
+
+		for (run = 0; run < runs; run++)
+		{
+			Clock::time_point start = Clock::now();
+			double milliseconds;
+
+			GenerateMips(chain.pointers.data(), 1, size, size, (uint32_t)chain.pointers.size(), filter, gammaCorrect, tasks);
+			milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (run == 0 || milliseconds < best)
+			{
+				best = milliseconds;
+			}
+		}
+
+		return best;
+	}
+
+	void PrintUsage()
+	{
+		fprintf(stderr, "usage: MipBenchmark [-j threads] [-r runs]\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+	int runs = 3, filter, gamma, i;
+	TaskPool tasks;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "-j"))
+		{
+			threadCount = std::max(1, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "-r"))
+		{
+			runs = std::max(1, atoi(argv[++i]));
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	tasks.Initialize(threadCount);
+
+	for (uint32_t size : s_sizes)
+	{
+		Chain chain;
+
+		MakeChain(size, chain);
+		for (filter = MIP_FILTER_BOX; filter <= MIP_FILTER_KAISER; filter++)
+		{
+			for (gamma = 1; gamma >= 0; gamma--)
+			{
+				double single = Time(chain, size, (MipFilter)filter, gamma != 0, nullptr, runs);
+				double pooled = Time(chain, size, (MipFilter)filter, gamma != 0, &tasks, runs);
+				double megapixels = (double)size * size / 1e6;
+
+				printf("%4ux%-4u %-6s %-8s 1 thread %8.1f ms %6.1f Mpixels/s   %u threads %8.1f ms %6.1f Mpixels/s\n", size, size,
+					s_filterNames[filter], gamma ? "gamma" : "linear", single, megapixels / (single * 1e-3), threadCount, pooled,
+					megapixels / (pooled * 1e-3));
+			}
+		}
+	}
+
+	tasks.Shutdown();
+
+	return 0;
+}
@@ -0,0 +1,293 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: ObjParserTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Checks ObjParser against a copy of the fscanf loader it replaced (ModelClass::LoadModel before the
+// mapped parser), on every .obj in the directory (default "."). Each file is parsed on one thread
+// and split into chunks on -j threads; positions, texture coordinates and normals have to match the
+// reference bit for bit and every face index has to be the reference's, made zero based. With -t
+// both loaders are also timed on each file, best of -r runs (3 by default), from the page cache.
+//
+//   ObjParserTest [-t] [-j threads] [-r runs] [directory]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ObjParser.h"
+#include "TestHelpers.h"
+
+namespace
+{
+	// What the old loader kept: the floats as read and the face indices still one based.
+	struct ReferenceObj
+	{
+		std::vector<ObjMesh::Float3> positions;
+		std::vector<ObjMesh::Float2> texCoords;
+		std::vector<ObjMesh::Float3> normals;
+		std::vector<unsigned int> faces;
+	};
+
+	// The old loader with fscanf_s swapped for fscanf. It read three corners per face and skipped
+	// the rest as unknown words (skybox.obj has quads); here those words are fanned into triangles
+	// the way ObjParser does it instead.
+	bool LoadReferenceObj(const char* filename, ReferenceObj& obj)
+	{
+		FILE* file;
+		char lineHeader[128];
+		unsigned int corner[3], fan[9];
+		size_t last;
+		int matches;
+
+		obj.positions.clear();
+		obj.texCoords.clear();
+		obj.normals.clear();
+		obj.faces.clear();
+
+		file = fopen(filename, "r");
+		if (!file)
+		{
+			return false;
+		}
+
+		while (fscanf(file, "%127s", lineHeader) != EOF)
+		{
+			if (strcmp(lineHeader, "v") == 0)
+			{
+				ObjMesh::Float3 vertex;
+				fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
+				obj.positions.push_back(vertex);
+			}
+			else if (strcmp(lineHeader, "vt") == 0)
+			{
+				ObjMesh::Float2 uv;
+				fscanf(file, "%f %f\n", &uv.x, &uv.y);
+				obj.texCoords.push_back(uv);
+			}
+			else if (strcmp(lineHeader, "vn") == 0)
+			{
+				ObjMesh::Float3 normal;
+				fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+				obj.normals.push_back(normal);
+			}
+			else if (strcmp(lineHeader, "f") == 0)
+			{
+				unsigned int face[9];
+				matches = fscanf(file, "%u/%u/%u %u/%u/%u %u/%u/%u\n", &face[0], &face[1], &face[2],
+					&face[3], &face[4], &face[5], &face[6], &face[7], &face[8]);
+				if (matches != 9)
+				{
+					fclose(file);
+					return false;
+				}
+				obj.faces.insert(obj.faces.end(), face, face + 9);
+			}
+			else if (!obj.faces.empty() && sscanf(lineHeader, "%u/%u/%u", &corner[0], &corner[1], &corner[2]) == 3)
+			{
+				// Another corner of the last face: the fan's first corner, the last one and this.
+				last = obj.faces.size() - 9;
+				memcpy(fan, &obj.faces[last], 3 * sizeof(unsigned int));
+				memcpy(fan + 3, &obj.faces[last + 6], 3 * sizeof(unsigned int));
+				memcpy(fan + 6, corner, 3 * sizeof(unsigned int));
+				obj.faces.insert(obj.faces.end(), fan, fan + 9);
+			}
+		}
+
+		fclose(file);
+
+		return true;
+	}
+
+	template <typename T>
+	bool SameFloats(const char* what, const std::vector<T>& parsed, const std::vector<T>& reference)
+	{
+		size_t i;
+
+		if (parsed.size() != reference.size())
+		{
+			printf("    %s: %zu, reference %zu\n", what, parsed.size(), reference.size());
+			return false;
+		}
+
+		for (i = 0; i < parsed.size(); i++)
+		{
+			if (memcmp(&parsed[i], &reference[i], sizeof(T)) != 0)
+			{
+				printf("    %s %zu differs from the reference\n", what, i);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool SameMesh(const ObjMesh& mesh, const ReferenceObj& reference)
+	{
+		size_t i;
+
+		if (!SameFloats("position", mesh.positions, reference.positions) || !SameFloats("texture coordinate", mesh.texCoords, reference.texCoords) ||
+			!SameFloats("normal", mesh.normals, reference.normals))
+		{
+			return false;
+		}
+
+		if (mesh.faces.size() != reference.faces.size())
+		{
+			printf("    face indices: %zu, reference %zu\n", mesh.faces.size(), reference.faces.size());
+			return false;
+		}
+
+		for (i = 0; i < mesh.faces.size(); i++)
+		{
+			if (mesh.faces[i] + 1 != reference.faces[i])
+			{
+				printf("    face index %zu is %u, reference %u\n", i, mesh.faces[i] + 1, reference.faces[i]);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// A comment after a face holding slashes of its own must not add corners to the face.
+	bool ParsesFaceComment()
+	{
+		const char text[] =
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+			"vt 0 0\nvt 1 0\nvt 0 1\n"
+			"vn 0 0 1\nvn 0 0 1\nvn 0 0 1\n"
+			"f 1/1/1 2/2/2 3/3/3 # a/b/c\n";
+		const unsigned int expected[9] = { 0, 0, 0, 1, 1, 1, 2, 2, 2 };
+		ObjMesh mesh;
+
+		if (!ParseObj(text, sizeof(text) - 1, mesh, 1))
+		{
+			printf("    the face is rejected\n");
+			return false;
+		}
+
+		if (mesh.faces.size() != 9 || memcmp(mesh.faces.data(), expected, sizeof(expected)) != 0)
+		{
+			printf("    %zu face indices, expected one triangle\n", mesh.faces.size());
+			return false;
+		}
+
+		return true;
+	}
+
+	void PrintUsage()
+	{
+		fprintf(stderr, "usage: ObjParserTest [-t] [-j threads] [-r runs] [directory]\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	std::string directory = ".";
+	ObjMesh mesh;
+	ReferenceObj reference;
+	unsigned int threadCount = std::max(2u, std::thread::hardware_concurrency());
+	unsigned int runs = 3;
+	bool timing = false;
+	bool commentParsed;
+	double referenceTotal = 0.0, serialTotal = 0.0, parallelTotal = 0.0;
+	int failures = 0;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((!strcmp(argv[i], "-j") || !strcmp(argv[i], "-r")) && i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "-t"))
+		{
+			timing = true;
+		}
+		else if (!strcmp(argv[i], "-j"))
+		{
+			threadCount = std::max(2, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "-r"))
+		{
+			runs = std::max(1, atoi(argv[++i]));
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			directory = argv[i];
+		}
+	}
+
+	if (!ListSceneFiles(directory, files))
+	{
+		return 1;
+	}
+
+	commentParsed = ParsesFaceComment();
+	if (!commentParsed)
+	{
+		printf("face with a trailing comment: FAILED\n");
+	}
+
+	if (timing)
+	{
+		printf("%-40s %12s %12s %12s %9s\n", "file", "fscanf ms", "1 thread ms", "threads ms", "speedup");
+	}
+
+	for (const std::string& file : files)
+	{
+		const char* name = file.c_str();
+		bool same;
+
+		if (!LoadReferenceObj(name, reference))
+		{
+			printf("%s: the reference loader cannot read it\n", name);
+			failures++;
+			continue;
+		}
+
+		same = LoadObjFile(name, mesh, 1) && SameMesh(mesh, reference);
+		same = same && LoadObjFile(name, mesh, threadCount) && SameMesh(mesh, reference);
+		if (!same)
+		{
+			printf("%s: FAILED\n", name);
+			failures++;
+			continue;
+		}
+
+		if (timing)
+		{
+			double referenceMilliseconds = Time(runs, [&]() { LoadReferenceObj(name, reference); });
+			double serialMilliseconds = Time(runs, [&]() { LoadObjFile(name, mesh, 1); });
+			double parallelMilliseconds = Time(runs, [&]() { LoadObjFile(name, mesh, threadCount); });
+
+			referenceTotal += referenceMilliseconds;
+			serialTotal += serialMilliseconds;
+			parallelTotal += parallelMilliseconds;
+			printf("%-40s %12.2f %12.2f %12.2f %8.1fx\n", GetSceneFileName(file).c_str(), referenceMilliseconds,
+				serialMilliseconds, parallelMilliseconds, referenceMilliseconds / std::max(1e-6, std::min(serialMilliseconds, parallelMilliseconds)));
+		}
+	}
+
+	if (timing)
+	{
+		printf("%-40s %12.2f %12.2f %12.2f %8.1fx\n", "total", referenceTotal, serialTotal, parallelTotal,
+			referenceTotal / std::max(1e-6, std::min(serialTotal, parallelTotal)));
+	}
+
+	printf("%d of %d .obj files match the fscanf loader\n", (int)files.size() - failures, (int)files.size());
+
+	return (failures || !commentParsed) ? 1 : 0;
+}
@@ -0,0 +1,631 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TangentTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Checks CalculateModelVectors, with each kernel set the CPU runs, on every .obj in the directory
+// (default ".") against a plain double precision version of the same sums: angle weighted face
+// frames per welded vertex, made orthonormal around the normal. Each mesh is welded in the plain
+// layout and given zero tangents, which is what BuildMesh hands the pass. Every index has to draw
+// the position, texture and normal it did, only vertices with faces of both texture handedness may
+// be split and none may be left with both, every frame has to be orthonormal with the binormal on
+// the summed binormal's side, the tangent has to be within half a degree of the reference wherever
+// the sum is not close to cancelling, and a second pass must change nothing. Hand made meshes cover
+// degenerate and collinear texture coordinates, degenerate triangles, a missing normal, a mirrored
+// seam and every count of triangles past the last group of sixteen.
+//
+// With -t the SSE2, AVX2 and AVX-512 kernels are also timed against the scalar ones, best of -r runs
+// (5 by default), and the widest has to be at least 4x faster over all the meshes. The flat one face
+// at a time pass ModelClass ran on the unrolled vertices before (CalculateModelVectors and
+// CalculateTangentBinormal at the baseline) is timed alongside for comparison.
+//
+//   TangentTest [-t] [-r runs] [directory]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "TestHelpers.h"
+
+namespace
+{
+	const double s_pi = 3.14159265358979323846;
+
+	// What -t asks of the widest kernels over the scalar ones.
+	const double s_targetSpeedup = 4.0;
+
+	const MeshSimd s_simds[] = { MESH_SIMD_SCALAR, MESH_SIMD_SSE2, MESH_SIMD_AVX2, MESH_SIMD_AVX512 };
+	const char* const s_simdNames[] = { "scalar", "sse2", "avx2", "avx512" };
+	const int s_simdCount = 4;
+
+	// The reference sums of one vertex, and the total angle they were weighted by.
+	struct ReferenceSum
+	{
+		double tangent[3];
+		double binormal[3];
+		double weight;
+	};
+
+	double Dot(const double* a, const double* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void Cross(const double* a, const double* b, double* result)
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	double Length(const double* a)
+	{
+		return sqrt(Dot(a, a));
+	}
+
+	double Angle(const double* a, const double* b)
+	{
+		return acos(std::max(-1.0, std::min(1.0, Dot(a, b) / (Length(a) * Length(b)))));
+	}
+
+	// The side of a triangle's texture space area as the pass sees it, in floats: 1 positive, 2
+	// negative, 0 none.
+	int GetSide(const MeshVertexNM* vertices, const unsigned int* corners)
+	{
+		const float* t0 = vertices[corners[0]].texture;
+		const float* t1 = vertices[corners[1]].texture;
+		const float* t2 = vertices[corners[2]].texture;
+		float du1 = t1[0] - t0[0], dv1 = t1[1] - t0[1], du2 = t2[0] - t0[0], dv2 = t2[1] - t0[1];
+		float area = du1 * dv2 - du2 * dv1;
+
+		return (area > 0.0f) ? 1 : (area < 0.0f) ? 2 : 0;
+	}
+
+	// The pass's input: a plain mesh's welded vertices with zero tangents.
+	void MakeNormalMapped(const MeshData& plain, MeshData& mesh)
+	{
+		unsigned int i;
+
+		mesh.Clear();
+		mesh.layout = MESH_LAYOUT_NORMALMAP;
+		mesh.vertexStride = sizeof(MeshVertexNM);
+		mesh.vertexCount = plain.vertexCount;
+		mesh.unrolledVertexCount = plain.unrolledVertexCount;
+		mesh.indices = plain.indices;
+		mesh.vertices.assign((size_t)plain.vertexCount * sizeof(MeshVertexNM), 0);
+		for (i = 0; i < plain.vertexCount; i++)
+		{
+			memcpy(&mesh.vertices[(size_t)i * sizeof(MeshVertexNM)], &plain.vertices[(size_t)i * sizeof(MeshVertex)], sizeof(MeshVertex));
+		}
+	}
+
+	// The same sums in doubles, over the vertices the pass left.
+	void SumReference(const MeshData& mesh, std::vector<ReferenceSum>& sums)
+	{
+		const MeshVertexNM* vertices = mesh.GetVertices<MeshVertexNM>();
+		const double tiny = 1e-20;
+		double edges[3][3], du1, dv1, du2, dv2, area, sign, tangent[3], binormal[3], tLength, bLength, angles[3];
+		size_t face;
+		int corner, axis;
+
+		sums.assign(mesh.vertexCount, ReferenceSum());
+		for (face = 0; face < mesh.indices.size() / 3; face++)
+		{
+			const unsigned int* corners = &mesh.indices[face * 3];
+			const MeshVertexNM& a = vertices[corners[0]];
+			const MeshVertexNM& b = vertices[corners[1]];
+			const MeshVertexNM& c = vertices[corners[2]];
+
+			for (axis = 0; axis < 3; axis++)
+			{
+				edges[0][axis] = (double)b.position[axis] - a.position[axis];
+				edges[1][axis] = (double)c.position[axis] - a.position[axis];
+				edges[2][axis] = (double)c.position[axis] - b.position[axis];
+			}
+			du1 = (double)b.texture[0] - a.texture[0];
+			dv1 = (double)b.texture[1] - a.texture[1];
+			du2 = (double)c.texture[0] - a.texture[0];
+			dv2 = (double)c.texture[1] - a.texture[1];
+			area = du1 * dv2 - du2 * dv1;
+			sign = (area < 0.0) ? -1.0 : 1.0;
+
+			for (axis = 0; axis < 3; axis++)
+			{
+				tangent[axis] = (dv2 * edges[0][axis] - dv1 * edges[1][axis]) * sign;
+				binormal[axis] = (du1 * edges[1][axis] - du2 * edges[0][axis]) * sign;
+			}
+			tLength = Length(tangent);
+			bLength = Length(binormal);
+			if (fabs(area) <= tiny || tLength * tLength <= tiny || bLength * bLength <= tiny || Dot(edges[0], edges[0]) <= tiny ||
+				Dot(edges[1], edges[1]) <= tiny || Dot(edges[2], edges[2]) <= tiny)
+			{
+				continue;
+			}
+
+			angles[0] = Angle(edges[0], edges[1]);
+			angles[1] = s_pi - Angle(edges[0], edges[2]);
+			angles[2] = Angle(edges[1], edges[2]);
+			for (corner = 0; corner < 3; corner++)
+			{
+				ReferenceSum& sum = sums[corners[corner]];
+
+				for (axis = 0; axis < 3; axis++)
+				{
+					sum.tangent[axis] += tangent[axis] / tLength * angles[corner];
+					sum.binormal[axis] += binormal[axis] / bLength * angles[corner];
+				}
+				sum.weight += angles[corner];
+			}
+		}
+	}
+
+	// The checks of the header on a mesh the pass made from input. Returns the vertices split, or
+	// -1 on failure, and the furthest a tangent is from the reference in degrees.
+	int CheckFrames(const MeshData& input, const MeshData& mesh, MeshSimd simd, const char* what, double& worstDegrees)
+	{
+		const MeshVertexNM* before = input.GetVertices<MeshVertexNM>();
+		const MeshVertexNM* vertices = mesh.GetVertices<MeshVertexNM>();
+		std::vector<ReferenceSum> sums;
+		std::vector<int> sides;
+		MeshData again;
+		double normal[3], tangent[3], binormal[3], cross[3], expected[3], along, length, degrees;
+		unsigned int i, split;
+		int axis, side;
+
+		if (mesh.indices.size() != input.indices.size() || mesh.vertexCount < input.vertexCount ||
+			mesh.vertices.size() != (size_t)mesh.vertexCount * sizeof(MeshVertexNM))
+		{
+			printf("    %s: %u vertices, %zu indices from %u and %zu\n", what, mesh.vertexCount, mesh.indices.size(), input.vertexCount,
+				input.indices.size());
+			return -1;
+		}
+
+		for (i = 0; i < (unsigned int)mesh.indices.size(); i++)
+		{
+			if (mesh.indices[i] >= mesh.vertexCount || memcmp(&vertices[mesh.indices[i]], &before[input.indices[i]], sizeof(MeshVertex)) != 0)
+			{
+				printf("    %s: index %u no longer draws its vertex\n", what, i);
+				return -1;
+			}
+		}
+
+		// Split exactly the vertices with faces of both handedness, and leave none.
+		sides.assign(input.vertexCount, 0);
+		for (i = 0; i + 3 <= (unsigned int)input.indices.size(); i += 3)
+		{
+			side = GetSide(before, &input.indices[i]);
+			sides[input.indices[i]] |= side;
+			sides[input.indices[i + 1]] |= side;
+			sides[input.indices[i + 2]] |= side;
+		}
+		split = (unsigned int)std::count(sides.begin(), sides.end(), 3);
+		sides.assign(mesh.vertexCount, 0);
+		for (i = 0; i + 3 <= (unsigned int)mesh.indices.size(); i += 3)
+		{
+			side = GetSide(vertices, &mesh.indices[i]);
+			sides[mesh.indices[i]] |= side;
+			sides[mesh.indices[i + 1]] |= side;
+			sides[mesh.indices[i + 2]] |= side;
+		}
+		if (mesh.vertexCount != input.vertexCount + split || std::count(sides.begin(), sides.end(), 3) != 0)
+		{
+			printf("    %s: %u vertices split, %u have faces of both handedness\n", what, mesh.vertexCount - input.vertexCount, split);
+			return -1;
+		}
+
+		SumReference(mesh, sums);
+		worstDegrees = 0.0;
+		for (i = 0; i < mesh.vertexCount; i++)
+		{
+			const ReferenceSum& sum = sums[i];
+
+			for (axis = 0; axis < 3; axis++)
+			{
+				normal[axis] = vertices[i].normal[axis];
+				tangent[axis] = vertices[i].tangent[axis];
+				binormal[axis] = vertices[i].binormal[axis];
+			}
+
+			length = Length(normal);
+			if (length * length < 1e-12)
+			{
+				normal[0] = 0.0;
+				normal[1] = 1.0;
+				normal[2] = 0.0;
+			}
+			else
+			{
+				for (axis = 0; axis < 3; axis++)
+				{
+					normal[axis] /= length;
+				}
+			}
+
+			// Unit tangent across the normal, and the binormal their cross product either way round.
+			Cross(normal, tangent, cross);
+			if (!(fabs(Length(tangent) - 1.0) < 1e-4 && fabs(Dot(normal, tangent)) < 1e-4 && fabs(Length(binormal) - 1.0) < 1e-4 &&
+				fabs(fabs(Dot(cross, binormal)) - 1.0) < 1e-4))
+			{
+				printf("    %s: vertex %u has no orthonormal frame: tangent %g %g %g, binormal %g %g %g\n", what, i, tangent[0], tangent[1], tangent[2],
+					binormal[0], binormal[1], binormal[2]);
+				return -1;
+			}
+
+			// Where the summed tangent is a fair part of the weight behind it, it is a direction and
+			// the pass has to find the same one; shorter sums nearly cancelled and are only checked above.
+			along = Dot(normal, sum.tangent);
+			for (axis = 0; axis < 3; axis++)
+			{
+				expected[axis] = sum.tangent[axis] - normal[axis] * along;
+			}
+			if (Length(expected) > 0.05 * sum.weight && sum.weight > 0.0)
+			{
+				degrees = Angle(tangent, expected) * 180.0 / s_pi;
+				worstDegrees = std::max(worstDegrees, degrees);
+				if (degrees > 0.5)
+				{
+					printf("    %s: vertex %u tangent is %.3f degrees from the reference\n", what, i, degrees);
+					return -1;
+				}
+			}
+
+			if (fabs(Dot(cross, sum.binormal)) > 0.05 * sum.weight && Dot(binormal, sum.binormal) < 0.0)
+			{
+				printf("    %s: vertex %u binormal is not on the summed binormal's side\n", what, i);
+				return -1;
+			}
+		}
+
+		again = mesh;
+		CalculateModelVectors(again, simd);
+		if (again.vertexCount != mesh.vertexCount || again.indices != mesh.indices || again.vertices != mesh.vertices)
+		{
+			printf("    %s: a second pass changed the mesh\n", what);
+			return -1;
+		}
+
+		return (int)split;
+	}
+
+	// Runs the pass with every kernel set on a hand made mesh, given as positions, texture
+	// coordinates and normals per vertex and triangles over them. Returns what CheckFrames does, or
+	// -1 if the kernel sets split differently.
+	int CheckHandMade(const std::vector<MeshVertex>& vertices, const std::vector<unsigned int>& indices, const char* what)
+	{
+		MeshData plain, input, mesh;
+		double worstDegrees;
+		int split = 0, simd, result;
+
+		plain.vertexCount = (unsigned int)vertices.size();
+		plain.unrolledVertexCount = (unsigned int)indices.size();
+		plain.vertices.resize(vertices.size() * sizeof(MeshVertex));
+		if (!vertices.empty())
+		{
+			memcpy(plain.vertices.data(), vertices.data(), plain.vertices.size());
+		}
+		plain.indices = indices;
+
+		MakeNormalMapped(plain, input);
+		for (simd = 0; simd < s_simdCount; simd++)
+		{
+			if (!IsMeshSimdSupported(s_simds[simd]))
+			{
+				continue;
+			}
+
+			mesh = input;
+			CalculateModelVectors(mesh, s_simds[simd]);
+			result = CheckFrames(input, mesh, s_simds[simd], what, worstDegrees);
+			if (result < 0 || (simd > 0 && result != split))
+			{
+				printf("    %s: %s kernels failed\n", what, s_simdNames[simd]);
+				return -1;
+			}
+			split = result;
+		}
+
+		return split;
+	}
+
+	bool CheckCornerCases()
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<unsigned int> indices;
+		MeshVertex quad[4] =
+		{
+			{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+			{ { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+			{ { 1.0f, 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } },
+			{ { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } },
+		};
+		unsigned int count, i;
+		int failures = 0;
+
+		// Every texture coordinate the same: nothing to sum, so any frame around the normal.
+		vertices.assign(quad, quad + 4);
+		for (MeshVertex& vertex : vertices)
+		{
+			vertex.texture[0] = vertex.texture[1] = 0.5f;
+		}
+		indices = { 0, 1, 2, 0, 2, 3 };
+		failures += CheckHandMade(vertices, indices, "degenerate texture coordinates") == 0 ? 0 : 1;
+
+		// Texture coordinates exactly on a line: no texture space area, and no handedness either.
+		vertices.assign(quad, quad + 4);
+		for (MeshVertex& vertex : vertices)
+		{
+			vertex.texture[1] = vertex.texture[0];
+		}
+		failures += CheckHandMade(vertices, indices, "collinear texture coordinates") == 0 ? 0 : 1;
+
+		// A triangle with two corners in one place and one with all three on a line, beside a real one.
+		vertices.assign(quad, quad + 4);
+		vertices.push_back(vertices[1]);
+		vertices.back().texture[1] = 0.5f;
+		vertices.push_back(vertices[0]);
+		vertices.back().position[0] = 2.0f;
+		vertices.back().texture[0] = 0.25f;
+		indices = { 0, 1, 2, 0, 1, 4, 0, 1, 5 };
+		failures += CheckHandMade(vertices, indices, "degenerate triangles") == 0 ? 0 : 1;
+
+		// No normal to build the frame around.
+		vertices.assign(quad, quad + 4);
+		for (MeshVertex& vertex : vertices)
+		{
+			vertex.normal[2] = 0.0f;
+		}
+		indices = { 0, 1, 2, 0, 2, 3 };
+		failures += CheckHandMade(vertices, indices, "zero normals") == 0 ? 0 : 1;
+
+		// A seam where the texture is mirrored: the two shared corners have to be split.
+		vertices.assign(quad, quad + 4);
+		vertices.push_back(vertices[1]);
+		vertices.back().position[0] = 2.0f;
+		vertices.back().texture[0] = 0.0f;
+		vertices.push_back(vertices[2]);
+		vertices.back().position[0] = 2.0f;
+		vertices.back().texture[0] = 0.0f;
+		indices = { 0, 1, 2, 0, 2, 3, 1, 4, 5, 1, 5, 2 };
+		if (CheckHandMade(vertices, indices, "mirrored seam") != 2)
+		{
+			printf("    mirrored seam: the shared corners were not split\n");
+			failures++;
+		}
+
+		// A strip of every length past the groups of four, eight and sixteen the kernels work in.
+		for (count = 1; count <= 17; count++)
+		{
+			vertices.clear();
+			indices.clear();
+			for (i = 0; i < count + 2; i++)
+			{
+				MeshVertex vertex = { { (float)(i / 2), (float)(i % 2), 0.1f * (float)(i % 3) }, { 0.5f * (float)(i / 2), (float)(i % 2) }, { 0.0f, 0.0f, 1.0f } };
+
+				vertices.push_back(vertex);
+			}
+			for (i = 0; i < count; i++)
+			{
+				indices.push_back(i);
+				indices.push_back((i % 2) ? i + 2 : i + 1);
+				indices.push_back((i % 2) ? i + 1 : i + 2);
+			}
+			failures += CheckHandMade(vertices, indices, "strip") >= 0 ? 0 : 1;
+		}
+
+		printf("%-32s %s\n", "tangent corner cases", failures ? "FAILED" : "ok");
+
+		return failures == 0;
+	}
+
+	// The pass ModelClass ran before welding, on the unrolled vertices: each face's frame from its
+	// own corners, divided by its texture space area, given to all three.
+	void CalculateFlatTangents(MeshVertexNM* vertices, size_t vertexCount)
+	{
+		float vector1[3], vector2[3], tuVector[2], tvVector[2], tangent[3], binormal[3], den, length;
+		size_t index;
+		int axis, corner;
+
+		for (index = 0; index + 3 <= vertexCount; index += 3)
+		{
+			const MeshVertexNM& vertex1 = vertices[index];
+			const MeshVertexNM& vertex2 = vertices[index + 1];
+			const MeshVertexNM& vertex3 = vertices[index + 2];
+
+			for (axis = 0; axis < 3; axis++)
+			{
+				vector1[axis] = vertex2.position[axis] - vertex1.position[axis];
+				vector2[axis] = vertex3.position[axis] - vertex1.position[axis];
+			}
+			tuVector[0] = vertex2.texture[0] - vertex1.texture[0];
+			tvVector[0] = vertex2.texture[1] - vertex1.texture[1];
+			tuVector[1] = vertex3.texture[0] - vertex1.texture[0];
+			tvVector[1] = vertex3.texture[1] - vertex1.texture[1];
+
+			den = 1.0f / (tuVector[0] * tvVector[1] - tuVector[1] * tvVector[0]);
+			for (axis = 0; axis < 3; axis++)
+			{
+				tangent[axis] = (tvVector[1] * vector1[axis] - tvVector[0] * vector2[axis]) * den;
+				binormal[axis] = (tuVector[0] * vector2[axis] - tuVector[1] * vector1[axis]) * den;
+			}
+
+			length = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+			for (axis = 0; axis < 3; axis++)
+			{
+				tangent[axis] = tangent[axis] / length;
+			}
+			length = sqrtf(binormal[0] * binormal[0] + binormal[1] * binormal[1] + binormal[2] * binormal[2]);
+			for (axis = 0; axis < 3; axis++)
+			{
+				binormal[axis] = binormal[axis] / length;
+			}
+
+			for (corner = 0; corner < 3; corner++)
+			{
+				memcpy(vertices[index + corner].tangent, tangent, sizeof(tangent));
+				memcpy(vertices[index + corner].binormal, binormal, sizeof(binormal));
+			}
+		}
+	}
+
+	void PrintUsage()
+	{
+		fprintf(stderr, "usage: TangentTest [-t] [-r runs] [directory]\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	std::vector<MeshVertexNM> unrolled;
+	std::string directory = ".";
+	ObjMesh obj;
+	MeshData plain, input, mesh;
+	unsigned int runs = 5;
+	bool timing = false;
+	double flatTotal = 0.0, totals[s_simdCount] = {}, speedup = 0.0;
+	int failures = 0, split, widest = 0, simd, i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-r") && i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "-t"))
+		{
+			timing = true;
+		}
+		else if (!strcmp(argv[i], "-r"))
+		{
+			runs = std::max(1, atoi(argv[++i]));
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			directory = argv[i];
+		}
+	}
+
+	if (!ListSceneFiles(directory, files))
+	{
+		return 1;
+	}
+
+	for (simd = 0; simd < s_simdCount; simd++)
+	{
+		widest = IsMeshSimdSupported(s_simds[simd]) ? simd : widest;
+	}
+
+	failures += CheckCornerCases() ? 0 : 1;
+
+	for (const std::string& file : files)
+	{
+		std::string name = GetSceneFileName(file);
+		std::string line;
+		double flatMilliseconds, milliseconds[s_simdCount], worstDegrees, degrees, once;
+		char text[64];
+		size_t corner;
+		unsigned int run;
+		bool failed = false;
+
+		if (!BuildSceneMesh(file, MESH_LAYOUT_PLAIN, obj, plain))
+		{
+			printf("%-32s FAILED to build\n", name.c_str());
+			failures++;
+			continue;
+		}
+
+		MakeNormalMapped(plain, input);
+		split = 0;
+		worstDegrees = 0.0;
+		for (simd = 0; simd <= widest && !failed; simd++)
+		{
+			if (!IsMeshSimdSupported(s_simds[simd]))
+			{
+				continue;
+			}
+
+			mesh = input;
+			CalculateModelVectors(mesh, s_simds[simd]);
+			i = CheckFrames(input, mesh, s_simds[simd], name.c_str(), degrees);
+			if (i < 0 || (simd > 0 && i != split))
+			{
+				printf("    %s: %s kernels failed\n", name.c_str(), s_simdNames[simd]);
+				failed = true;
+			}
+			split = i;
+			worstDegrees = std::max(worstDegrees, degrees);
+		}
+
+		if (failed)
+		{
+			printf("%-32s FAILED\n", name.c_str());
+			failures++;
+			continue;
+		}
+
+		if (!timing)
+		{
+			printf("%-32s ok     %zu triangles, %u vertices, %d split, tangents within %.3f degrees\n", name.c_str(), input.indices.size() / 3,
+				input.vertexCount, split, worstDegrees);
+			continue;
+		}
+
+		unrolled.resize(input.indices.size());
+		for (corner = 0; corner < input.indices.size(); corner++)
+		{
+			unrolled[corner] = input.GetVertices<MeshVertexNM>()[input.indices[corner]];
+		}
+		flatMilliseconds = Time(runs, []() {}, [&]() { CalculateFlatTangents(unrolled.data(), unrolled.size()); });
+		flatTotal += flatMilliseconds;
+
+		// The kernel sets take turns within each run, so whatever the machine is doing meanwhile
+		// slows them alike.
+		for (run = 0; run < runs; run++)
+		{
+			for (simd = 0; simd <= widest; simd++)
+			{
+				if (IsMeshSimdSupported(s_simds[simd]))
+				{
+					once = Time(1, [&]() { mesh = input; }, [&]() { CalculateModelVectors(mesh, s_simds[simd]); });
+					milliseconds[simd] = (run == 0) ? once : std::min(milliseconds[simd], once);
+				}
+			}
+		}
+
+		for (simd = 0; simd <= widest; simd++)
+		{
+			if (!IsMeshSimdSupported(s_simds[simd]))
+			{
+				continue;
+			}
+
+			totals[simd] += milliseconds[simd];
+			snprintf(text, sizeof(text), simd ? ", %s %.3f ms %.2fx" : ", %s %.3f ms", s_simdNames[simd], milliseconds[simd],
+				milliseconds[0] / std::max(1e-6, milliseconds[simd]));
+			line += text;
+		}
+		printf("%-32s ok     %zu triangles, flat %.3f ms%s\n", name.c_str(), input.indices.size() / 3, flatMilliseconds, line.c_str());
+	}
+
+	if (timing)
+	{
+		speedup = totals[0] / std::max(1e-6, totals[widest]);
+		printf("%-32s flat %.2f ms, scalar %.2f ms, %s %.2f ms, %.2fx\n", "total", flatTotal, totals[0], s_simdNames[widest], totals[widest], speedup);
+		printf("%-32s %s     %s kernels %.2fx the scalar ones, target %.0fx\n", "speedup", (speedup >= s_targetSpeedup) ? "ok" : "FAILED",
+			s_simdNames[widest], speedup, s_targetSpeedup);
+		failures += (speedup >= s_targetSpeedup) ? 0 : 1;
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TestHelpers.h
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _TESTHELPERS_H_
+#define _TESTHELPERS_H_
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "MeshBuilder.h"
+
+// What the cooker tests share: the scene files they run over, loading one of them, the vertex
+// numbering the builders promise and a best of runs timer.
+
+typedef std::chrono::steady_clock TestClock;
+
+// Every .obj in directory, sorted so the output is the same on every file system. Says so on
+// stderr and returns false when there are none.
+inline bool ListSceneFiles(const std::string& directory, std::vector<std::string>& files)
+{
+	std::error_code error;
+
+	files.clear();
+	for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory, error))
+	{
+		if (file.is_regular_file() && file.path().extension() == ".obj")
+		{
+			files.push_back(file.path().string());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	if (files.empty())
+	{
+		fprintf(stderr, "no .obj files in %s\n", directory.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+inline std::string GetSceneFileName(const std::string& file)
+{
+	return std::filesystem::path(file).filename().string();
+}
+
+// Parses file and builds it in layout.
+inline bool BuildSceneMesh(const std::string& file, MeshLayout layout, ObjMesh& obj, MeshData& mesh)
+{
+	return LoadObjFile(file.c_str(), obj) && BuildMesh(obj, layout, mesh);
+}
+
+// Every vertex used, numbered in the order the indices first reach it: each index is at most
+// one past the largest before it.
+inline bool InFirstUseOrder(const MeshData& mesh)
+{
+	unsigned int next = 0;
+
+	for (unsigned int index : mesh.indices)
+	{
+		if (index > next)
+		{
+			return false;
+		}
+		next = std::max(next, index + 1);
+	}
+
+	return next == mesh.vertexCount;
+}
+
+inline double MillisecondsSince(TestClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(TestClock::now() - start).count();
+}
+
+// Best of runs, in milliseconds; prepare is not timed.
+template <typename Prepare, typename Run>
+double Time(unsigned int runs, Prepare prepare, Run run)
+{
+	double best = 0.0, milliseconds;
+	unsigned int i;
+	TestClock::time_point start;
+
+	for (i = 0; i < runs; i++)
+	{
+		prepare();
+		start = TestClock::now();
+		run();
+		milliseconds = MillisecondsSince(start);
+		best = (i == 0) ? milliseconds : std::min(best, milliseconds);
+	}
+
+	return best;
+}
+
+template <typename Run>
+double Time(unsigned int runs, Run run)
+{
+	return Time(runs, []() {}, run);
+}
+
+#endif
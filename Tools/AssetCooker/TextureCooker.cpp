@@ -0,0 +1,511 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureCooker.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Re-encodes the scene's .dds textures into the block compressed format that suits what each one is
+// sampled for (see TextureCodec.h):
+//   *_normal.dds      BC5, x and y only; the pixel shaders rebuild z
+//   alpha*.dds        BC4, the red channel the fire shader takes its transparency from
+//   noise*.dds        BC5, the two channels the fire shader distorts x and y by
+//   anything else     BC7, or with -bc1 BC1 when it has no alpha; BC1 sources stay BC1
+// keeping sRGB sources sRGB and every cube face they have. Sources without a full mip chain get one
+// built from their largest level (see MipGenerator.h), with a Kaiser filter unless -m says box, or
+// -m none keeps the mips they have; colour textures are filtered gamma correct. Run it from the
+// folder holding the textures, before AssetPacker.
+//
+//   TextureCooker [-d directory] [-j threads] [-bc1] [-m kaiser|box|none] [-f] [file ...]
+//
+// The first run keeps each original next to its replacement as name.dds.orig, and later runs encode
+// from that, so running it again never compresses twice. Textures already in the format they would
+// be encoded to are left alone (-f encodes them again anyway), as are sources that are not 2D
+// textures or that are in formats TextureCodec does not decode. Each texture's PSNR is measured
+// against its decoded source, over the channels its role uses.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DdsImage.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "TaskPool.h"
+#include "TextureCodec.h"
+
+namespace
+{
+	enum TextureRole
+	{
+		ROLE_COLOUR,
+		ROLE_NORMAL,
+		ROLE_MASK,
+		ROLE_NOISE,
+	};
+
+	const char* s_roleNames[] = { "colour", "normal", "mask", "noise" };
+
+	const char* s_originalSuffix = ".orig";
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct CookOptions
+	{
+		bool preferBC1;
+		bool force;
+		bool generateMips;
+		MipFilter mipFilter;
+	};
+
+	struct CookTotals
+	{
+		unsigned int cooked;
+		unsigned int skipped;
+		unsigned int failed;
+		uint64_t sourceBytes;
+		uint64_t cookedBytes;
+		uint64_t pixels;
+		double milliseconds;
+	};
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool EndsWith(const std::string& name, const char* suffix)
+	{
+		size_t length = strlen(suffix);
+
+		return name.size() >= length && name.compare(name.size() - length, length, suffix) == 0;
+	}
+
+	TextureRole GetRole(const std::string& path)
+	{
+		std::string name = std::filesystem::path(path).filename().string();
+
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+
+		if (EndsWith(name, "_normal.dds"))
+		{
+			return ROLE_NORMAL;
+		}
+		if (name.compare(0, 5, "alpha") == 0)
+		{
+			return ROLE_MASK;
+		}
+		if (name.compare(0, 5, "noise") == 0)
+		{
+			return ROLE_NOISE;
+		}
+
+		return ROLE_COLOUR;
+	}
+
+	bool IsSrgb(uint32_t format)
+	{
+		return format == DDS_FORMAT_R8G8B8A8_UNORM_SRGB || format == DDS_FORMAT_BC1_UNORM_SRGB || format == DDS_FORMAT_BC2_UNORM_SRGB ||
+			format == DDS_FORMAT_BC3_UNORM_SRGB || format == DDS_FORMAT_B8G8R8A8_UNORM_SRGB || format == DDS_FORMAT_BC7_UNORM_SRGB;
+	}
+
+	uint32_t GetCookedFormat(TextureRole role, uint32_t sourceFormat, bool hasAlpha, const CookOptions& options)
+	{
+		switch (role)
+		{
+		case ROLE_NORMAL:
+		case ROLE_NOISE:
+			return DDS_FORMAT_BC5_UNORM;
+		case ROLE_MASK:
+			return DDS_FORMAT_BC4_UNORM;
+		default:
+			break;
+		}
+
+		// A BC1 source stays BC1, BC7 would double its size for no detail it still has.
+		if ((options.preferBC1 && !hasAlpha) || sourceFormat == DDS_FORMAT_BC1_UNORM || sourceFormat == DDS_FORMAT_BC1_UNORM_SRGB)
+		{
+			return IsSrgb(sourceFormat) ? DDS_FORMAT_BC1_UNORM_SRGB : DDS_FORMAT_BC1_UNORM;
+		}
+
+		return IsSrgb(sourceFormat) ? DDS_FORMAT_BC7_UNORM_SRGB : DDS_FORMAT_BC7_UNORM;
+	}
+
+	// Channels the role's shaders read, for the PSNR.
+	unsigned int GetChannelMask(TextureRole role, bool hasAlpha)
+	{
+		switch (role)
+		{
+		case ROLE_NORMAL:
+		case ROLE_NOISE:
+			return 0x3;
+		case ROLE_MASK:
+			return 0x1;
+		default:
+			return hasAlpha ? 0xf : 0x7;
+		}
+	}
+
+	const char* GetFormatName(uint32_t format)
+	{
+		switch (format)
+		{
+		case DDS_FORMAT_BC1_UNORM: return "BC1";
+		case DDS_FORMAT_BC1_UNORM_SRGB: return "BC1 sRGB";
+		case DDS_FORMAT_BC2_UNORM: return "BC2";
+		case DDS_FORMAT_BC2_UNORM_SRGB: return "BC2 sRGB";
+		case DDS_FORMAT_BC3_UNORM: return "BC3";
+		case DDS_FORMAT_BC3_UNORM_SRGB: return "BC3 sRGB";
+		case DDS_FORMAT_BC4_UNORM: return "BC4";
+		case DDS_FORMAT_BC5_UNORM: return "BC5";
+		case DDS_FORMAT_BC7_UNORM: return "BC7";
+		case DDS_FORMAT_BC7_UNORM_SRGB: return "BC7 sRGB";
+		case DDS_FORMAT_R8G8B8A8_UNORM: return "RGBA8";
+		case DDS_FORMAT_R8G8B8A8_UNORM_SRGB: return "RGBA8 sRGB";
+		case DDS_FORMAT_B8G8R8A8_UNORM: return "BGRA8";
+		case DDS_FORMAT_B8G8R8A8_UNORM_SRGB: return "BGRA8 sRGB";
+		case DDS_FORMAT_B8G8R8X8_UNORM: return "BGRX8";
+		case DDS_FORMAT_R8G8_UNORM: return "RG8";
+		case DDS_FORMAT_R8_UNORM: return "R8";
+		case DDS_FORMAT_A8_UNORM: return "A8";
+		default: return "other";
+		}
+	}
+
+	bool ListTextures(const std::string& directory, std::vector<std::string>& files)
+	{
+		std::error_code error;
+
+		for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory, error))
+		{
+			if (file.is_regular_file() && EndsWith(file.path().filename().string(), ".dds"))
+			{
+				files.push_back(directory + "/" + file.path().filename().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+
+		return !error && !files.empty();
+	}
+
+	// The format and mip count of the texture at path, DDS_FORMAT_UNKNOWN when it does not parse.
+	uint32_t GetFileFormat(const std::string& path, uint32_t& mipCount)
+	{
+		MappedFile file;
+		DdsImage image;
+
+		mipCount = 0;
+		if (!file.Open(path.c_str()) || !ParseDds(file.GetData(), file.GetSize(), image))
+		{
+			return DDS_FORMAT_UNKNOWN;
+		}
+
+		mipCount = image.mipCount;
+		return image.format;
+	}
+
+	double GetPsnr(double squaredError, uint64_t samples)
+	{
+		if (samples == 0 || squaredError == 0.0)
+		{
+			return INFINITY;
+		}
+
+		return 10.0 * std::log10(255.0 * 255.0 / (squaredError / (double)samples));
+	}
+
+	void PrintSkipped(const std::string& path, const char* reason)
+	{
+		printf("%-34s skipped, %s\n", std::filesystem::path(path).filename().string().c_str(), reason);
+	}
+
+	bool CookTexture(const std::string& path, const CookOptions& options, TaskPool& tasks, CookTotals& totals)
+	{
+		std::string originalPath = path + s_originalSuffix;
+		std::string temporaryPath = path + ".tmp";
+		bool hasOriginal = std::filesystem::exists(originalPath);
+		std::string sourcePath = hasOriginal ? originalPath : path;
+		Clock::time_point start = Clock::now();
+		TextureRole role = GetRole(path);
+		MappedFile source;
+		DdsImage sourceImage, cookedImage;
+		std::vector<std::vector<uint8_t>> pixels;
+		std::vector<uint8_t> cooked, decoded;
+		uint32_t cookedFormat, mipCount, fileMipCount, itemCount, item, level;
+		unsigned int channelMask;
+		double squaredError = 0.0, milliseconds;
+		uint64_t samples = 0, sourceBytes;
+		bool hasAlpha = false;
+		size_t offset, i, j;
+
+		if (!source.Open(sourcePath.c_str()) || !ParseDds(source.GetData(), source.GetSize(), sourceImage))
+		{
+			PrintSkipped(path, "not a texture DdsImage lays out");
+			totals.skipped++;
+			return true;
+		}
+		if (sourceImage.dimension != DDS_DIMENSION_TEXTURE2D)
+		{
+			PrintSkipped(path, "not a 2D texture");
+			totals.skipped++;
+			return true;
+		}
+		if (!CanDecodeTextureFormat(sourceImage.format))
+		{
+			PrintSkipped(path, "its format is not one TextureCodec decodes");
+			totals.skipped++;
+			return true;
+		}
+
+		// Every surface decoded, and whether any pixel of the largest mip is not opaque.
+		pixels.resize(sourceImage.surfaces.size());
+		for (i = 0; i < sourceImage.surfaces.size(); i++)
+		{
+			const DdsSurface& surface = sourceImage.surfaces[i];
+
+			pixels[i].resize((size_t)surface.width * surface.height * 4);
+			if (!DecodeTextureSurface(sourceImage.format, surface, pixels[i].data()))
+			{
+				PrintSkipped(path, "BC7 blocks in modes TextureCodec does not decode");
+				totals.skipped++;
+				return true;
+			}
+			if (i % sourceImage.mipCount == 0)
+			{
+				for (j = 3; j < pixels[i].size() && !hasAlpha; j += 4)
+				{
+					hasAlpha = pixels[i][j] != 255;
+				}
+			}
+		}
+
+		cookedFormat = GetCookedFormat(role, sourceImage.format, hasAlpha, options);
+		channelMask = GetChannelMask(role, hasAlpha);
+		mipCount = options.generateMips ? GetMipLevelCount(sourceImage.width, sourceImage.height) : sourceImage.mipCount;
+		if (!options.force && ((!hasOriginal && sourceImage.format == cookedFormat && sourceImage.mipCount == mipCount) ||
+			(hasOriginal && GetFileFormat(path, fileMipCount) == cookedFormat && fileMipCount == mipCount)))
+		{
+			PrintSkipped(path, hasOriginal ? "already cooked" : "already in the format it would be cooked to");
+			totals.skipped++;
+			return true;
+		}
+
+		// The rest of the chain filtered from each item's largest level, when the source stops short.
+		cookedImage = sourceImage;
+		cookedImage.format = cookedFormat;
+		if (mipCount > sourceImage.mipCount)
+		{
+			std::vector<std::vector<uint8_t>> chain;
+			std::vector<uint8_t*> levels;
+
+			itemCount = (uint32_t)(sourceImage.surfaces.size() / sourceImage.mipCount);
+			chain.resize((size_t)itemCount * mipCount);
+			levels.resize(chain.size());
+			cookedImage.mipCount = mipCount;
+			cookedImage.surfaces.resize(chain.size());
+			for (item = 0; item < itemCount; item++)
+			{
+				for (level = 0; level < mipCount; level++)
+				{
+					DdsSurface& surface = cookedImage.surfaces[item * mipCount + level];
+
+					surface.width = std::max(1u, sourceImage.width >> level);
+					surface.height = std::max(1u, sourceImage.height >> level);
+					surface.depth = 1;
+					if (level == 0)
+					{
+						chain[item * mipCount].swap(pixels[item * sourceImage.mipCount]);
+					}
+					else
+					{
+						chain[item * mipCount + level].resize((size_t)surface.width * surface.height * 4);
+					}
+					levels[item * mipCount + level] = chain[item * mipCount + level].data();
+				}
+			}
+
+			GenerateMips(levels.data(), itemCount, sourceImage.width, sourceImage.height, mipCount, options.mipFilter, role == ROLE_COLOUR, &tasks);
+			pixels.swap(chain);
+		}
+
+		// Encode every surface into one buffer laid out as the file stores them.
+		offset = 0;
+		for (i = 0; i < cookedImage.surfaces.size(); i++)
+		{
+			DdsSurface& surface = cookedImage.surfaces[i];
+
+			GetDdsSurfacePitch(cookedFormat, surface.width, surface.height, surface.rowPitch, surface.slicePitch);
+			offset += surface.slicePitch;
+		}
+		cooked.resize(offset);
+
+		offset = 0;
+		for (i = 0; i < cookedImage.surfaces.size(); i++)
+		{
+			DdsSurface& surface = cookedImage.surfaces[i];
+
+			EncodeTextureSurface(cookedFormat, pixels[i].data(), surface.width, surface.height, cooked.data() + offset, &tasks);
+			surface.data = reinterpret_cast<const char*>(cooked.data() + offset);
+			offset += surface.slicePitch;
+		}
+
+		// Decoded back and compared, over the channels the shaders read.
+		for (i = 0; i < cookedImage.surfaces.size(); i++)
+		{
+			const DdsSurface& surface = cookedImage.surfaces[i];
+
+			decoded.resize(pixels[i].size());
+			DecodeTextureSurface(cookedFormat, surface, decoded.data());
+			for (j = 0; j < decoded.size(); j++)
+			{
+				if (channelMask & (1u << (j & 3)))
+				{
+					double difference = (double)decoded[j] - (double)pixels[i][j];
+
+					squaredError += difference * difference;
+					samples++;
+				}
+			}
+			totals.pixels += (uint64_t)surface.width * surface.height;
+		}
+
+		sourceBytes = source.GetSize();
+		source.Close();
+
+		if (!WriteDds(temporaryPath.c_str(), cookedImage))
+		{
+			fprintf(stderr, "could not write %s\n", temporaryPath.c_str());
+			totals.failed++;
+			return false;
+		}
+
+		// Renamed over the original only once the replacement is complete; the original moves aside
+		// first time round.
+		{
+			std::error_code error;
+
+			if (!hasOriginal)
+			{
+				std::filesystem::rename(path, originalPath, error);
+			}
+			if (!error)
+			{
+				std::filesystem::rename(temporaryPath, path, error);
+			}
+			if (error)
+			{
+				fprintf(stderr, "could not replace %s: %s\n", path.c_str(), error.message().c_str());
+				totals.failed++;
+				return false;
+			}
+		}
+
+		milliseconds = MillisecondsSince(start);
+		totals.cooked++;
+		totals.sourceBytes += sourceBytes;
+		totals.cookedBytes += std::filesystem::file_size(path);
+		totals.milliseconds += milliseconds;
+
+		printf("%-34s %-6s %-10s -> %-8s %5ux%-5u %2u mips %s %9.1f KB -> %8.1f KB %7.2f dB %8.1f ms\n",
+			std::filesystem::path(path).filename().string().c_str(), s_roleNames[role], GetFormatName(sourceImage.format), GetFormatName(cookedFormat),
+			sourceImage.width, sourceImage.height, cookedImage.mipCount, sourceImage.cube ? "cube" : "    ", sourceBytes / 1024.0,
+			std::filesystem::file_size(path) / 1024.0, GetPsnr(squaredError, samples), milliseconds);
+
+		return true;
+	}
+
+	void PrintUsage()
+	{
+		fprintf(stderr, "usage: TextureCooker [-d directory] [-j threads] [-bc1] [-m kaiser|box|none] [-f] [file ...]\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	std::string directory = ".";
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	CookOptions options;
+	CookTotals totals;
+	TaskPool tasks;
+	bool succeeded = true;
+	int i;
+
+	memset(&options, 0, sizeof(options));
+	memset(&totals, 0, sizeof(totals));
+	options.generateMips = true;
+	options.mipFilter = MIP_FILTER_KAISER;
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((!strcmp(argv[i], "-d") || !strcmp(argv[i], "-j") || !strcmp(argv[i], "-m")) && i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "-d"))
+		{
+			directory = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-j"))
+		{
+			threadCount = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-bc1"))
+		{
+			options.preferBC1 = true;
+		}
+		else if (!strcmp(argv[i], "-m"))
+		{
+			i++;
+			options.generateMips = strcmp(argv[i], "none") != 0;
+			if (!strcmp(argv[i], "box"))
+			{
+				options.mipFilter = MIP_FILTER_BOX;
+			}
+			else if (options.generateMips && strcmp(argv[i], "kaiser"))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "-f"))
+		{
+			options.force = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			files.push_back(argv[i]);
+		}
+	}
+
+	if (files.empty() && !ListTextures(directory, files))
+	{
+		fprintf(stderr, "no .dds files in %s\n", directory.c_str());
+		return 1;
+	}
+
+	tasks.Initialize(threadCount);
+	for (const std::string& path : files)
+	{
+		succeeded = CookTexture(path, options, tasks, totals) && succeeded;
+	}
+	tasks.Shutdown();
+
+	printf("%u textures cooked, %u skipped, %u failed: %.1f MB -> %.1f MB (%.1fx smaller), %.0f ms, %.1f Mpixels/s on %u threads\n",
+		totals.cooked, totals.skipped, totals.failed, totals.sourceBytes / (1024.0 * 1024.0), totals.cookedBytes / (1024.0 * 1024.0),
+		totals.cookedBytes ? (double)totals.sourceBytes / (double)totals.cookedBytes : 0.0, totals.milliseconds,
+		totals.milliseconds > 0.0 ? totals.pixels / (totals.milliseconds * 1e3) : 0.0, std::max(1u, threadCount));
+
+	return succeeded ? 0 : 1;
+}
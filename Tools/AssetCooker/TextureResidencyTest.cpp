@@ -0,0 +1,460 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: TextureResidencyTest.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+// Drives TextureResidency with synthetic textures and camera footprints, completing its changes a
+// few frames late the way TextureStreamer does, and fails when it breaks what TextureResidency.h
+// promises. After every Update:
+//   - what it counts as resident matches the changes it asked for and stays within the budget,
+//   - no texture is changed while a change is pending and no more than maxPending loads are,
+//   - nothing loads past the level it wants, drops below its tail or, on screen, below the level
+//     it wants this frame,
+//   - no texture is loaded back within a few frames of being dropped while it wants the same level.
+// Once the camera stands still the changes stop, and every texture on screen that is short of the
+// level it wants could not get its next level even by dropping everything that may be dropped.
+//
+//   TextureResidencyTest
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "TextureResidency.h"
+
+namespace
+{
+	typedef TextureResidency::Handle Handle;
+
+	const uint32_t s_tailSize = 64;
+	const uint32_t s_maxPending = 4;
+	const uint64_t s_thrashFrames = 30;		// a reload this soon after a drop, wanting the same level, is thrash
+	const uint32_t s_settleFrames = 120;
+	const uint32_t s_steadyFrames = 60;
+
+	struct SceneTexture
+	{
+		uint32_t width, height;
+		uint32_t mipCount;
+		std::vector<uint64_t> levelBytes;
+		std::vector<uint64_t> bytesFrom;	// bytesFrom[level], of the levels from level down
+		bool fixed;
+	};
+
+	struct PendingChange
+	{
+		Handle texture;
+		uint64_t due;
+		bool load;
+	};
+
+	struct Simulation
+	{
+		TextureResidency residency;
+		std::vector<SceneTexture> textures;
+		std::vector<PendingChange> pending;
+		std::vector<TextureResidencyChange> changes;
+		std::vector<uint64_t> charge;			// what each texture should count as, from the changes seen
+		std::vector<uint64_t> droppedFrame;
+		std::vector<uint32_t> wantedWhenDropped;
+		uint32_t random;
+		uint32_t loads, drops, thrash;
+		double peakShare;					// of the budget at the time
+		int failures;
+	};
+
+	void Fail(Simulation& simulation, const char* what, Handle texture)
+	{
+		if (simulation.failures++ < 8)
+		{
+			printf("    frame %llu, texture %u: %s\n", (unsigned long long)simulation.residency.GetFrame(), texture, what);
+		}
+	}
+
+	uint32_t NextRandom(Simulation& simulation)
+	{
+		simulation.random = simulation.random * 1664525u + 1013904223u;
+
+		return simulation.random >> 16;
+	}
+
+	// Block compressed at a byte a texel, in 4x4 blocks.
+	void MakeTexture(SceneTexture& texture, uint32_t width, uint32_t height, bool fixed)
+	{
+		uint32_t level;
+
+		texture.width = width;
+		texture.height = height;
+		texture.mipCount = 1;
+		while ((std::max(width, height) >> texture.mipCount) > 0)
+		{
+			texture.mipCount++;
+		}
+		texture.fixed = fixed;
+
+		texture.levelBytes.resize(texture.mipCount);
+		for (level = 0; level < texture.mipCount; level++)
+		{
+			texture.levelBytes[level] = (uint64_t)std::max(1u, ((width >> level) + 3) / 4) * std::max(1u, ((height >> level) + 3) / 4) * 16;
+		}
+
+		texture.bytesFrom.resize(texture.mipCount + 1);
+		texture.bytesFrom[texture.mipCount] = 0;
+		for (level = texture.mipCount; level > 0; level--)
+		{
+			texture.bytesFrom[level - 1] = texture.bytesFrom[level] + texture.levelBytes[level - 1];
+		}
+	}
+
+	// Adds the textures to the residency, the streamed ones holding their tails and the fixed ones everything.
+	void Start(Simulation& simulation, uint64_t budget)
+	{
+		size_t i;
+		uint32_t topMip;
+
+		simulation.residency.Initialize(budget, s_tailSize, s_maxPending);
+		simulation.pending.clear();
+		simulation.charge.assign(simulation.textures.size(), 0);
+		simulation.droppedFrame.assign(simulation.textures.size(), 0);
+		simulation.wantedWhenDropped.assign(simulation.textures.size(), 0);
+		simulation.random = 12345;
+		simulation.loads = 0;
+		simulation.drops = 0;
+		simulation.thrash = 0;
+		simulation.peakShare = 0.0;
+		simulation.failures = 0;
+
+		for (i = 0; i < simulation.textures.size(); i++)
+		{
+			const SceneTexture& texture = simulation.textures[i];
+
+			topMip = texture.fixed ? 0 : GetTextureTailMip(texture.width, texture.height, texture.mipCount, s_tailSize);
+			simulation.residency.Add(texture.width, texture.height, texture.mipCount, texture.levelBytes.data(), topMip, texture.fixed);
+			simulation.charge[i] = texture.bytesFrom[topMip];
+		}
+	}
+
+	bool IsPending(const Simulation& simulation, Handle texture)
+	{
+		for (const PendingChange& change : simulation.pending)
+		{
+			if (change.texture == texture)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// One frame: the loads and drops that are due complete, the camera's footprints (0 for a texture
+	// off screen) are given, Update runs and what it asks for is checked. Returns the changes asked for.
+	size_t Frame(Simulation& simulation, const std::vector<float>& footprints)
+	{
+		TextureResidency& residency = simulation.residency;
+		uint64_t frame, resident = 0;
+		size_t i, loading = 0;
+		uint32_t topMip, wantedMip;
+		Handle texture;
+
+		residency.BeginFrame();
+		frame = residency.GetFrame();
+
+		for (i = 0; i < simulation.pending.size();)
+		{
+			if (simulation.pending[i].due <= frame)
+			{
+				residency.Complete(simulation.pending[i].texture, true);
+				simulation.pending[i] = simulation.pending.back();
+				simulation.pending.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		for (texture = 0; texture < (Handle)footprints.size(); texture++)
+		{
+			if (footprints[texture] > 0.0f)
+			{
+				residency.RequestFootprint(texture, footprints[texture]);
+			}
+		}
+
+		simulation.changes.clear();
+		residency.Update(simulation.changes);
+
+		for (const TextureResidencyChange& change : simulation.changes)
+		{
+			texture = change.texture;
+			topMip = residency.GetTopMip(texture);
+			wantedMip = residency.GetWantedMip(texture);
+
+			if (texture >= simulation.textures.size() || simulation.textures[texture].fixed)
+			{
+				Fail(simulation, "a fixed or unknown texture is changed", texture);
+				continue;
+			}
+			if (IsPending(simulation, texture))
+			{
+				Fail(simulation, "changed again before its last change completed", texture);
+			}
+			if (change.topMip == topMip)
+			{
+				Fail(simulation, "changed to the level it holds", texture);
+			}
+			else if (change.topMip < topMip)
+			{
+				simulation.loads++;
+				if (change.topMip < wantedMip)
+				{
+					Fail(simulation, "loaded past the level it wants", texture);
+				}
+				if (frame - simulation.droppedFrame[texture] <= s_thrashFrames && simulation.droppedFrame[texture] != 0 &&
+					wantedMip == simulation.wantedWhenDropped[texture])
+				{
+					simulation.thrash++;
+					Fail(simulation, "loaded back soon after a drop, wanting the same level", texture);
+				}
+			}
+			else
+			{
+				simulation.drops++;
+				simulation.droppedFrame[texture] = frame;
+				simulation.wantedWhenDropped[texture] = wantedMip;
+				if (change.topMip > residency.GetTailMip(texture))
+				{
+					Fail(simulation, "dropped below its tail", texture);
+				}
+				if (footprints[texture] > 0.0f && change.topMip > wantedMip)
+				{
+					Fail(simulation, "dropped below the level it wants while on screen", texture);
+				}
+			}
+
+			simulation.charge[texture] = simulation.textures[texture].bytesFrom[change.topMip];
+			simulation.pending.push_back({ texture, frame + 1 + NextRandom(simulation) % 3, change.topMip < topMip });
+		}
+
+		for (const PendingChange& change : simulation.pending)
+		{
+			loading += change.load ? 1 : 0;
+		}
+		if (loading > s_maxPending)
+		{
+			Fail(simulation, "more loads pending than maxPending", (Handle)loading);
+		}
+
+		for (i = 0; i < simulation.charge.size(); i++)
+		{
+			resident += simulation.charge[i];
+		}
+		if (resident != residency.GetResidentBytes())
+		{
+			Fail(simulation, "resident bytes do not add up to the changes asked for", 0);
+		}
+		if (residency.GetResidentBytes() > residency.GetBudget())
+		{
+			Fail(simulation, "over budget", 0);
+		}
+		simulation.peakShare = std::max(simulation.peakShare, (double)residency.GetResidentBytes() / (double)std::max<uint64_t>(1, residency.GetBudget()));
+
+		return simulation.changes.size();
+	}
+
+	// What dropping texture to the coarsest level allowed would free: down to the level it wants when
+	// on screen, its tail otherwise.
+	uint64_t GetFreeable(const Simulation& simulation, Handle texture, bool onScreen)
+	{
+		const TextureResidency& residency = simulation.residency;
+		const SceneTexture& entry = simulation.textures[texture];
+		uint32_t floor = onScreen ? residency.GetWantedMip(texture) : residency.GetTailMip(texture);
+
+		if (entry.fixed || residency.IsPending(texture) || residency.GetTopMip(texture) >= floor)
+		{
+			return 0;
+		}
+
+		return entry.bytesFrom[residency.GetTopMip(texture)] - entry.bytesFrom[floor];
+	}
+
+	// Lets the changes for a still camera run out, then checks none follow and that every texture on
+	// screen short of the level it wants is short because its next level does not fit.
+	void Settle(Simulation& simulation, const std::vector<float>& footprints)
+	{
+		const TextureResidency& residency = simulation.residency;
+		uint64_t available, freeable, next;
+		uint32_t frame, topMip;
+		size_t changes = 0;
+		Handle texture, other;
+
+		for (frame = 0; frame < s_settleFrames; frame++)
+		{
+			Frame(simulation, footprints);
+		}
+		for (frame = 0; frame < s_steadyFrames; frame++)
+		{
+			changes += Frame(simulation, footprints);
+		}
+		if (changes > 0 || !simulation.pending.empty())
+		{
+			Fail(simulation, "still changing with the camera standing still", 0);
+			return;
+		}
+
+		available = residency.GetBudget() > residency.GetResidentBytes() ? residency.GetBudget() - residency.GetResidentBytes() : 0;
+		for (texture = 0; texture < (Handle)footprints.size(); texture++)
+		{
+			topMip = residency.GetTopMip(texture);
+			if (footprints[texture] <= 0.0f || simulation.textures[texture].fixed || topMip <= residency.GetWantedMip(texture))
+			{
+				continue;
+			}
+
+			freeable = 0;
+			for (other = 0; other < (Handle)footprints.size(); other++)
+			{
+				if (other != texture)
+				{
+					freeable += GetFreeable(simulation, other, footprints[other] > 0.0f);
+				}
+			}
+
+			next = simulation.textures[texture].levelBytes[topMip - 1];
+			if (next <= available + freeable)
+			{
+				Fail(simulation, "short of the level it wants though its next level would fit", texture);
+			}
+		}
+	}
+
+	bool Report(const char* name, const Simulation& simulation)
+	{
+		bool passed = simulation.failures == 0;
+
+		printf("%-28s %s %llu frames, %u loads, %u drops, %u thrash, peak %.1f%% of the budget\n", name, passed ? "ok    " : "FAILED",
+			(unsigned long long)simulation.residency.GetFrame(), simulation.loads, simulation.drops, simulation.thrash, simulation.peakShare * 100.0);
+
+		return passed;
+	}
+
+	// A corridor of textures a metre apart, sizes and repeats varied, walked down and back with the
+	// camera looking ahead, then stood still part way. The budget holds under a third of every chain.
+	void WalkFootprints(float camera, float direction, const std::vector<float>& repeats, std::vector<float>& footprints)
+	{
+		const float viewDistance = 12.0f;
+		const float screenPixels = 1920.0f;
+		size_t i;
+		float distance;
+
+		for (i = 0; i < footprints.size(); i++)
+		{
+			distance = ((float)i - camera) * direction;
+			footprints[i] = (distance > 0.25f && distance <= viewDistance) ? screenPixels * repeats[i] / distance : 0.0f;
+		}
+	}
+
+	bool RunWalk()
+	{
+		const uint32_t sizes[][2] = { { 512, 512 }, { 1024, 1024 }, { 2048, 1024 }, { 2048, 2048 }, { 4096, 4096 }, { 1024, 512 } };
+		const float step = 0.04f;
+		const Handle count = 48;
+		Simulation simulation;
+		std::vector<float> repeats, footprints;
+		uint64_t total = 0;
+		float camera;
+		Handle i, closest;
+
+		simulation.textures.resize(count + 2);
+		for (i = 0; i < count; i++)
+		{
+			MakeTexture(simulation.textures[i], sizes[i % 6][0], sizes[i % 6][1], false);
+			repeats.push_back((i % 3 == 0) ? 2.0f : (i % 3 == 1) ? 1.0f : 0.5f);
+			total += simulation.textures[i].bytesFrom[0];
+		}
+		// Two textures that are never streamed, off screen as far as the residency knows.
+		MakeTexture(simulation.textures[count], 256, 256, true);
+		MakeTexture(simulation.textures[count + 1], 512, 512, true);
+		repeats.resize(count + 2, 0.0f);
+		footprints.resize(count + 2, 0.0f);
+
+		Start(simulation, total * 3 / 10);
+
+		for (camera = -2.0f; camera < (float)count; camera += step)
+		{
+			WalkFootprints(camera, 1.0f, repeats, footprints);
+			Frame(simulation, footprints);
+		}
+		for (; camera > -2.0f; camera -= step)
+		{
+			WalkFootprints(camera, -1.0f, repeats, footprints);
+			Frame(simulation, footprints);
+		}
+
+		camera = 20.3f;
+		WalkFootprints(camera, 1.0f, repeats, footprints);
+		Settle(simulation, footprints);
+
+		// The nearest texture in view, the most magnified of its size, has what it wants.
+		closest = (Handle)21;
+		if (simulation.residency.GetTopMip(closest) != simulation.residency.GetWantedMip(closest))
+		{
+			Fail(simulation, "the nearest texture does not have the level it wants", closest);
+		}
+
+		return Report("corridor walk", simulation);
+	}
+
+	// Two 4096 textures both wanting their top level, with room for one. The more magnified gets it
+	// and the other the next level down; swapped, the other takes it back without either dropping
+	// below what it wants; a lower budget then drops only what is off its floor.
+	bool RunContention()
+	{
+		Simulation simulation;
+		std::vector<float> footprints(2);
+		uint64_t budget;
+		const Handle first = 0, second = 1;
+
+		simulation.textures.resize(2);
+		MakeTexture(simulation.textures[first], 4096, 4096, false);
+		MakeTexture(simulation.textures[second], 4096, 4096, false);
+		budget = simulation.textures[first].bytesFrom[0] + simulation.textures[second].bytesFrom[1] + 4096;
+		Start(simulation, budget);
+
+		footprints[first] = 4096.0f;
+		footprints[second] = 3000.0f;
+		Settle(simulation, footprints);
+		if (simulation.residency.GetTopMip(first) != 0 || simulation.residency.GetTopMip(second) != 1)
+		{
+			Fail(simulation, "the more magnified texture does not hold its top level", first);
+		}
+
+		footprints[first] = 100.0f;
+		footprints[second] = 4096.0f;
+		Settle(simulation, footprints);
+		if (simulation.residency.GetTopMip(second) != 0 || simulation.residency.GetTopMip(first) > simulation.residency.GetWantedMip(first))
+		{
+			Fail(simulation, "the budget did not move to the more magnified texture", second);
+		}
+
+		simulation.residency.SetBudget(simulation.textures[second].bytesFrom[0] + simulation.textures[first].bytesFrom[simulation.residency.GetWantedMip(first)]);
+		Settle(simulation, footprints);
+		if (simulation.residency.GetTopMip(second) != 0 || simulation.residency.GetTopMip(first) != simulation.residency.GetWantedMip(first))
+		{
+			Fail(simulation, "a lower budget did not drop the less magnified texture to the level it wants", first);
+		}
+
+		return Report("two textures, room for one", simulation);
+	}
+}
+
+int main()
+{
+	int failures = 0;
+
+	failures += RunWalk() ? 0 : 1;
+	failures += RunContention() ? 0 : 1;
+
+	return failures ? 1 : 0;
+}
@@ -134,6 +134,10 @@ float4 main(InputType input) : SV_TARGET
     
     // Expand the range of the normal value from (0, +1) to (-1, +1).
     bumpMap = (bumpMap * 2.0f) - 1.0f;
+    
+    // Rebuild z from x and y, which is all a BC5 normal map stores; for the unit normals of an RGB
+    // normal map it is the z that was stored.
+    bumpMap.z = sqrt(saturate(1.0f - dot(bumpMap.xy, bumpMap.xy)));
 
     // Calculate the normal from the data in the normal map.
     bumpNormal = (bumpMap.x * input.tangent) + (bumpMap.y * input.binormal) + (bumpMap.z * input.normal);
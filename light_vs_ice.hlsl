@@ -31,14 +31,7 @@ cbuffer LightViewBuffer
     matrix lightProjection;
 };
 
-struct InputType
-{
-    float4 position : POSITION;
-    float2 tex : TEXCOORD0;
-    float3 normal : NORMAL;
-    float3 tangent : TANGENT;
-    float3 binormal : BINORMAL;
-};
+#include "packed_vertex.hlsli"
 
 struct OutputType
 {
@@ -54,8 +47,9 @@ struct OutputType
     float4 refractionPosition : TEXCOORD5;
 };
 
-OutputType main(InputType input)
+OutputType main(PackedInputType packedInput)
 {
+    InputType input = DecodeVertex(packedInput);
     OutputType output;
     matrix viewProjectWorld;
     int i;
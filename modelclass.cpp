@@ -10,9 +10,24 @@ ModelClass::ModelClass()
 {
 	m_vertexBuffer = 0;
 	m_indexBuffer = 0;
+	m_quantizationBuffer = 0;
 	normalMapping = false;
 	shadowMapping = false;
-
+	optimizeMesh = true;
+	generateLods = true;
+	lodPixelError = 1.0f;
+	buildClusters = true;
+	shadowProxyError = MESH_SHADOW_PROXY_ERROR;
+	cullClusters = true;
+	cookedEncoding = COOKED_MESH_RAW;
+	m_vertexCount = 0;
+	m_indexCount = 0;
+	m_lodCount = 0;
+	m_indexFormat = DXGI_FORMAT_R32_UINT;
+	memset(&m_quantization, 0, sizeof(m_quantization));
+	m_boundingBox = DirectX::BoundingBox(DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+	m_boundingSphere = DirectX::BoundingSphere(DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f);
+	m_instanceTransform = DirectX::SimpleMath::Matrix::Identity;
 }
 ModelClass::~ModelClass()
 {
@@ -20,29 +35,259 @@ ModelClass::~ModelClass()
 
 bool ModelClass::InitializeBox(ID3D11Device* device, float xwidth, float yheight, float zdepth)
 {
-	GeometricPrimitive::CreateBox(preFabVertices, preFabIndices, DirectX::SimpleMath::Vector3(xwidth, yheight, zdepth), false);
-	m_vertexCount = preFabVertices.size();
-	m_indexCount = preFabIndices.size();
+	std::vector<VertexPositionNormalTexture> boxVertices;
+	std::vector<uint16_t> boxIndices;
+	ObjMesh box;
+	size_t i;
+
+	GeometricPrimitive::CreateBox(boxVertices, boxIndices, DirectX::SimpleMath::Vector3(xwidth, yheight, zdepth), false);
+
+	// Feed the box through the same path as a parsed .obj so every layout is available.
+	box.positions.resize(boxVertices.size());
+	box.texCoords.resize(boxVertices.size());
+	box.normals.resize(boxVertices.size());
+	for (i = 0; i < boxVertices.size(); i++)
+	{
+		box.positions[i] = { boxVertices[i].position.x, boxVertices[i].position.y, boxVertices[i].position.z };
+		box.texCoords[i] = { boxVertices[i].textureCoordinate.x, boxVertices[i].textureCoordinate.y };
+		box.normals[i] = { boxVertices[i].normal.x, boxVertices[i].normal.y, boxVertices[i].normal.z };
+	}
 
-	bool result;
-	// Initialize the vertex and index buffers.
-	result = InitializeBuffers(device);
-	if (!result)
+	box.faces.reserve(boxIndices.size() * 3);
+	for (i = 0; i < boxIndices.size(); i++)
+	{
+		box.faces.push_back(boxIndices[i]);
+		box.faces.push_back(boxIndices[i]);
+		box.faces.push_back(boxIndices[i]);
+	}
+
+	if (!InitializeModel(device, box))
 	{
 		return false;
 	}
+
+	// Boxes are cheap to build, they are never cooked.
+	ReleaseMeshData();
+
 	return true;
 }
 
 bool ModelClass::InitializeModel(ID3D11Device* device, char* filename)
 {
-	LoadModel(filename);
-	if (normalMapping)
+	CookedMeshSource source;
+	ObjMesh mesh;
+
+	if (!GetCookedMeshSource(filename, source))
+	{
+		return false;
+	}
+
+	if (InitializeCooked(device, filename, source))
+	{
+		return true;
+	}
+
+	// Map the file and parse it in place into the position, texture coordinate, normal and face arrays.
+	if (!LoadObjFile(filename, mesh))
+	{
+		return false;
+	}
+
+	if (!InitializeModel(device, mesh))
+	{
+		return false;
+	}
+
+	// Failing to cook only costs the next run a parse.
+	SaveCooked(filename, source);
+	ReleaseMeshData();
+
+	return true;
+}
+
+bool ModelClass::InitializeModel(ID3D11Device* device, const ObjMesh& mesh)
+{
+	unsigned int indexSize;
+	bool result;
+
+	if (!LoadModel(mesh))
+	{
+		return false;
+	}
+
+	// Most meshes address fewer than 65536 vertices once welded, upload those with 16 bit indices.
+	// They are narrowed in place for the upload and widened again for SaveCooked.
+	indexSize = GetIndexSize(m_mesh.vertexCount);
+	PackIndicesInPlace(m_mesh.indices.data(), m_mesh.indices.size(), indexSize);
+	result = InitializeBuffers(device, m_mesh.vertices.data(), m_mesh.indices.data(), indexSize, m_mesh.quantization);
+	UnpackIndicesInPlace(m_mesh.indices.data(), m_mesh.indices.size(), indexSize);
+
+	return result;
+}
+
+bool ModelClass::InitializeCooked(ID3D11Device* device, const char* filename, const CookedMeshSource& source)
+{
+	CookedMeshFile file;
+
+	if (!file.Open(GetCookedMeshPath(filename, GetLayout()).c_str(), source))
+	{
+		return false;
+	}
+
+	const CookedMeshHeader& header = file.GetHeader();
+	if (header.layout != (uint32_t)GetLayout())
+	{
+		return false;
+	}
+
+	m_mesh.Clear();
+	m_vertexCount = header.vertexCount;
+	m_indexCount = header.indexCount;
+	SetBounds(header.boundsMin, header.boundsMax, header.boundsCenter, header.boundsRadius);
+	SetLods(header.lods, header.lodCount, file.GetClusters(), header.clusterCount);
+
+	// The buffers are created straight from the mapping; it is unmapped when file goes out of scope.
+	return InitializeBuffers(device, file.GetVertices(), file.GetIndices(), header.indexSize, header.quantization);
+}
+
+bool ModelClass::InitializeInstance(const ModelClass& reference, const DirectX::SimpleMath::Matrix& transform)
+{
+	// Only an uploaded model of the same layout can be drawn from in this model's passes.
+	if (!reference.m_vertexBuffer || !reference.m_indexBuffer || reference.GetLayout() != GetLayout())
+	{
+		return false;
+	}
+
+	// Each model releases its own references on shutdown, whichever goes first.
+	m_vertexBuffer = reference.m_vertexBuffer;
+	m_vertexBuffer->AddRef();
+	m_indexBuffer = reference.m_indexBuffer;
+	m_indexBuffer->AddRef();
+	m_quantizationBuffer = reference.m_quantizationBuffer;
+	if (m_quantizationBuffer)
 	{
-		CalculateModelVectors(); // Calculate the tangent and binormal vectors for the model.
+		m_quantizationBuffer->AddRef();
 	}
-	InitializeBuffers(device);
-	return false;
+
+	m_mesh.Clear();
+	m_vertexCount = reference.m_vertexCount;
+	m_indexCount = reference.m_indexCount;
+	m_indexFormat = reference.m_indexFormat;
+	m_quantization = reference.m_quantization;
+	m_boundingBox = reference.m_boundingBox;
+	m_boundingSphere = reference.m_boundingSphere;
+	SetLods(reference.m_lods, reference.m_lodCount, reference.m_clusters.data(), (unsigned int)reference.m_clusters.size());
+	m_instanceTransform = reference.m_instanceTransform * transform;
+
+	return true;
+}
+
+bool ModelClass::InitializeVariant(ID3D11DeviceContext* deviceContext, const ModelClass& source)
+{
+	D3D11_BUFFER_DESC stagingBufferDesc, vertexBufferDesc;
+	D3D11_SUBRESOURCE_DATA vertexData;
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	ID3D11Device* device;
+	ID3D11Buffer* stagingBuffer;
+	std::vector<unsigned char> vertices;
+	HRESULT result;
+	bool converted;
+
+	if (!source.m_vertexBuffer || !source.m_indexBuffer)
+	{
+		return false;
+	}
+
+	// The source kept no CPU copy once uploaded, so its vertices are copied back from the GPU. Map waits
+	// for the copy, which is why variants are left to the first pass that draws them.
+	deviceContext->GetDevice(&device);
+
+	stagingBufferDesc.Usage = D3D11_USAGE_STAGING;
+	stagingBufferDesc.ByteWidth = GetVertexStride(source.GetLayout()) * source.m_vertexCount;
+	stagingBufferDesc.BindFlags = 0;
+	stagingBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingBufferDesc.MiscFlags = 0;
+	stagingBufferDesc.StructureByteStride = 0;
+
+	stagingBuffer = 0;
+	result = device->CreateBuffer(&stagingBufferDesc, nullptr, &stagingBuffer);
+	if(FAILED(result))
+	{
+		device->Release();
+		return false;
+	}
+
+	converted = false;
+	deviceContext->CopyResource(stagingBuffer, source.m_vertexBuffer);
+	result = deviceContext->Map(stagingBuffer, 0, D3D11_MAP_READ, 0, &mapped);
+	if(SUCCEEDED(result))
+	{
+		vertices.resize((size_t)GetVertexStride(GetLayout()) * source.m_vertexCount);
+		converted = ConvertVertices(mapped.pData, source.m_vertexCount, source.GetLayout(), source.m_quantization, GetLayout(), vertices.data());
+		deviceContext->Unmap(stagingBuffer, 0);
+	}
+	stagingBuffer->Release();
+
+	if (converted)
+	{
+		vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		vertexBufferDesc.ByteWidth = (UINT)vertices.size();
+		vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vertexBufferDesc.CPUAccessFlags = 0;
+		vertexBufferDesc.MiscFlags = 0;
+		vertexBufferDesc.StructureByteStride = 0;
+
+		vertexData.pSysMem = vertices.data();
+		vertexData.SysMemPitch = 0;
+		vertexData.SysMemSlicePitch = 0;
+
+		result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_vertexBuffer);
+		converted = SUCCEEDED(result);
+	}
+	device->Release();
+
+	if (!converted)
+	{
+		return false;
+	}
+
+	// Same vertices in the same order, so the indices, levels of detail and clusters are the source's.
+	m_indexBuffer = source.m_indexBuffer;
+	m_indexBuffer->AddRef();
+
+	m_mesh.Clear();
+	m_vertexCount = source.m_vertexCount;
+	m_indexCount = source.m_indexCount;
+	m_indexFormat = source.m_indexFormat;
+	m_boundingBox = source.m_boundingBox;
+	m_boundingSphere = source.m_boundingSphere;
+	SetLods(source.m_lods, source.m_lodCount, source.m_clusters.data(), (unsigned int)source.m_clusters.size());
+	m_instanceTransform = source.m_instanceTransform;
+
+	return true;
+}
+
+bool ModelClass::SaveCooked(const char* filename, const CookedMeshSource& source)
+{
+	if (m_mesh.vertexCount == 0 || m_mesh.layout != GetLayout())
+	{
+		return false;
+	}
+
+	return WriteCookedMesh(GetCookedMeshPath(filename, GetLayout()).c_str(), m_mesh, source, cookedEncoding);
+}
+
+size_t ModelClass::ReleaseMeshData()
+{
+	size_t bytes;
+
+	bytes = m_mesh.vertices.capacity() * sizeof(unsigned char) + m_mesh.indices.capacity() * sizeof(unsigned int) +
+		m_mesh.lods.capacity() * sizeof(MeshLod) + m_mesh.clusters.capacity() * sizeof(MeshCluster);
+
+	// Clear keeps the capacity, a fresh mesh does not.
+	m_mesh = MeshData();
+
+	return bytes;
 }
 
 void ModelClass::Shutdown()
@@ -62,152 +307,191 @@ void ModelClass::Render(ID3D11DeviceContext* deviceContext)
 {
 	// Put the vertex and index buffers on the graphics pipeline to prepare them for drawing.
 	RenderBuffers(deviceContext);
-	deviceContext->DrawIndexed(m_indexCount, 0, 0);
+	deviceContext->DrawIndexed(m_lods[0].indexCount, m_lods[0].indexOffset, 0);
 
 	return;
 }
 
 
-int ModelClass::GetIndexCount()
+void ModelClass::Render(ID3D11DeviceContext* deviceContext, const DirectX::SimpleMath::Matrix& world, const DirectX::SimpleMath::Matrix& view, const DirectX::SimpleMath::Matrix& projection)
 {
-	return m_indexCount;
-}
-
-
-bool ModelClass::InitializeBuffers(ID3D11Device* device)
-{	
-	VertexType* vertices;
-	VertexTypeNM* verticesNM;
-	VertexTypeSM* verticesSM;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-    D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	HRESULT result;
-	int i;
-
-	// Create the vertex arrays (only one will be used)
-	vertices = new VertexType[m_vertexCount];
-	if(!vertices)
+	const MeshLod& lod = m_lods[SelectLod(deviceContext, world, view, projection)];
+	DirectX::SimpleMath::Matrix worldView, worldViewProjection, viewToModel;
+	DirectX::SimpleMath::Vector3 eye, direction;
+	ClusterCullView cullView;
+	size_t rangeCount, range;
+
+	// Every level lives in the same index buffer, only the range drawn changes.
+	if (!cullClusters || lod.clusterCount == 0)
 	{
-		return false;
+		RenderBuffers(deviceContext);
+		deviceContext->DrawIndexed(lod.indexCount, lod.indexOffset, 0);
+		return;
 	}
 
-	verticesNM = new VertexTypeNM[m_vertexCount];
-	if (!verticesNM)
+	// The clusters are tested in model space: the frustum is pulled back through world * view * projection
+	// and the eye, or the viewing direction of an orthographic projection, through the inverse of world * view.
+	worldView = world * view;
+	worldViewProjection = worldView * projection;
+	ExtractFrustumPlanes(&worldViewProjection._11, cullView.planes);
+	viewToModel = worldView.Invert();
+	cullView.orthographic = (projection._34 == 0.0f);
+	eye = DirectX::SimpleMath::Vector3::Transform(DirectX::SimpleMath::Vector3::Zero, viewToModel);
+	direction = DirectX::SimpleMath::Vector3::TransformNormal(DirectX::SimpleMath::Vector3::Forward, viewToModel);
+	direction.Normalize();
+	memcpy(cullView.eye, &eye.x, sizeof(cullView.eye));
+	memcpy(cullView.direction, &direction.x, sizeof(cullView.direction));
+
+	// Every pass drops clockwise triangles: CullClockwise, and the shadow map pass's D3D11_CULL_FRONT with
+	// FrontCounterClockwise FALSE. The meshes wind counter clockwise outwards, so in the shadow map pass too
+	// the clusters facing away from the eye, there the light, are the ones thrown away.
+	cullView.facing = CLUSTER_FACING_BACK;
+
+	rangeCount = CullClusters(&m_clusters[lod.clusterOffset], lod.clusterCount, cullView, m_drawRanges.data());
+	if (rangeCount == 0)
 	{
-		return false;
+		return;
 	}
 
-	verticesSM = new VertexTypeSM[m_vertexCount];
-	if (!verticesSM)
+	RenderBuffers(deviceContext);
+	for (range = 0; range < rangeCount; range++)
 	{
-		return false;
+		deviceContext->DrawIndexed(m_drawRanges[range].indexCount, m_drawRanges[range].indexOffset, 0);
 	}
 
-	// Create the index array.
-	indices = new unsigned long[m_indexCount];
-	if(!indices)
+	return;
+}
+
+
+int ModelClass::GetIndexCount()
+{
+	return m_indexCount;
+}
+
+
+const DirectX::BoundingBox& ModelClass::GetBoundingBox() const
+{
+	return m_boundingBox;
+}
+
+
+const DirectX::BoundingSphere& ModelClass::GetBoundingSphere() const
+{
+	return m_boundingSphere;
+}
+
+
+const DirectX::SimpleMath::Matrix& ModelClass::GetInstanceTransform() const
+{
+	return m_instanceTransform;
+}
+
+
+MeshLayout ModelClass::GetLayout() const
+{
+	if (normalMapping)
 	{
-		return false;
+		return MESH_LAYOUT_NORMALMAP_PACKED;
 	}
-	
-	// Load the vertex array and index array with data from the pre-fab
-	if (!normalMapping)
-	{				
-		if (!shadowMapping)
-		{
-			for (i = 0; i < m_vertexCount; i++)
-			{
-				vertices[i].position = DirectX::SimpleMath::Vector3(preFabVertices[i].position.x, preFabVertices[i].position.y, preFabVertices[i].position.z);
-				vertices[i].texture = DirectX::SimpleMath::Vector2(preFabVertices[i].textureCoordinate.x, preFabVertices[i].textureCoordinate.y);
-				vertices[i].normal = DirectX::SimpleMath::Vector3(preFabVertices[i].normal.x, preFabVertices[i].normal.y, preFabVertices[i].normal.z);
-			}
-		}
-		else
-		{
-			for (i = 0; i < m_vertexCount; i++)
-			{
-				verticesSM[i].position = DirectX::SimpleMath::Vector3(preFabVerticesSM[i].position.x, preFabVerticesSM[i].position.y, preFabVerticesSM[i].position.z);				
-			}
-		}
-	}
-	else
+	if (shadowMapping)
 	{
-		for (i = 0; i < m_vertexCount; i++)
-		{
-			verticesNM[i].position = DirectX::SimpleMath::Vector3(preFabVerticesNM[i].position.x, preFabVerticesNM[i].position.y, preFabVerticesNM[i].position.z);
-			verticesNM[i].texture = DirectX::SimpleMath::Vector2(preFabVerticesNM[i].textureCoordinate.x, preFabVerticesNM[i].textureCoordinate.y);
-			verticesNM[i].normal = DirectX::SimpleMath::Vector3(preFabVerticesNM[i].normal.x, preFabVerticesNM[i].normal.y, preFabVerticesNM[i].normal.z);
-			verticesNM[i].tangent = DirectX::SimpleMath::Vector3(preFabVerticesNM[i].tangent.x, preFabVerticesNM[i].tangent.y, preFabVerticesNM[i].tangent.z);
-			verticesNM[i].binormal = DirectX::SimpleMath::Vector3(preFabVerticesNM[i].binormal.x, preFabVerticesNM[i].binormal.y, preFabVerticesNM[i].binormal.z);
-		}
+		return MESH_LAYOUT_SHADOWMAP;
 	}
+	return MESH_LAYOUT_PLAIN;
+}
 
-	for (i = 0; i < m_indexCount; i++)
-	{
-		indices[i] = preFabIndices[i];
-	}
 
-	// Set up the description of the static vertex buffer.
-    vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	if (!normalMapping)
+unsigned int ModelClass::SelectLod(ID3D11DeviceContext* deviceContext, const DirectX::SimpleMath::Matrix& world, const DirectX::SimpleMath::Matrix& view, const DirectX::SimpleMath::Matrix& projection) const
+{
+	D3D11_VIEWPORT viewport;
+	UINT viewportCount;
+	DirectX::SimpleMath::Matrix worldView;
+	DirectX::SimpleMath::Vector3 center;
+	float scale, radius, distance, pixelsPerUnit;
+	unsigned int level;
+
+	if (m_lodCount <= 1)
 	{
-		if (!shadowMapping)
-		{
-			vertexBufferDesc.ByteWidth = sizeof(VertexType) * m_vertexCount;
-		}
-		else
-		{
-			vertexBufferDesc.ByteWidth = sizeof(VertexTypeSM) * m_vertexCount;
-		}
+		return 0;
 	}
-	else
+
+	// Errors are measured in pixels of whatever is being rendered to: the back buffer, the shadow map or the mini-map.
+	viewportCount = 1;
+	deviceContext->RSGetViewports(&viewportCount, &viewport);
+	if (viewportCount == 0)
 	{
-		vertexBufferDesc.ByteWidth = sizeof(VertexTypeNM) * m_vertexCount;
+		return 0;
 	}
 
-    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vertexBufferDesc.CPUAccessFlags = 0;
-    vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
+	// Bounding sphere of the model in view space, scaled like the model.
+	worldView = world * view;
+	center = DirectX::SimpleMath::Vector3::Transform(DirectX::SimpleMath::Vector3(m_boundingSphere.Center), worldView);
+	scale = std::max(worldView.Right().Length(), std::max(worldView.Up().Length(), worldView.Backward().Length()));
+	radius = m_boundingSphere.Radius * scale;
 
-	// Give the subresource structure a pointer to the vertex data.
-	if (!normalMapping)
+	// Pixels one model unit covers at the nearest point of the sphere. An orthographic
+	// projection (the shadow map's) covers the same everywhere.
+	pixelsPerUnit = projection._22 * viewport.Height * 0.5f * scale;
+	if (projection._34 != 0.0f)
 	{
-		if (!shadowMapping)
+		distance = center.Length() - radius;
+		if (distance <= 0.0f)
 		{
-			vertexData.pSysMem = vertices;
-		}
-		else
-		{
-			vertexData.pSysMem = verticesSM;
+			return 0;
 		}
+		pixelsPerUnit /= distance;
 	}
-	else
+
+	// The coarsest level that still looks like the full detail mesh.
+	for (level = m_lodCount - 1; level > 0; level--)
 	{
-		vertexData.pSysMem = verticesNM;
+		if (m_lods[level].error * pixelsPerUnit <= lodPixelError)
+		{
+			return level;
+		}
 	}
 
+	return 0;
+}
+
+
+bool ModelClass::InitializeBuffers(ID3D11Device* device, const void* vertices, const void* indices, unsigned int indexSize, const MeshQuantization& quantization)
+{
+	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc, quantizationBufferDesc;
+	D3D11_SUBRESOURCE_DATA vertexData, indexData, quantizationData;
+	QuantizationBufferType quantizationBuffer;
+	HRESULT result;
+
+	// Set up the description of the static vertex buffer.
+	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	vertexBufferDesc.ByteWidth = GetVertexStride(GetLayout()) * m_vertexCount;
+	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vertexBufferDesc.CPUAccessFlags = 0;
+	vertexBufferDesc.MiscFlags = 0;
+	vertexBufferDesc.StructureByteStride = 0;
+
+	// Give the subresource structure a pointer to the vertex data, already in this model's layout.
+	vertexData.pSysMem = vertices;
 	vertexData.SysMemPitch = 0;
 	vertexData.SysMemSlicePitch = 0;
 
 	// Now create the vertex buffer.
-    result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_vertexBuffer);
+	result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_vertexBuffer);
 	if(FAILED(result))
 	{
 		return false;
 	}
 
 	// Set up the description of the static index buffer.
-    indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    indexBufferDesc.ByteWidth = sizeof(unsigned long) * m_indexCount;
-    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    indexBufferDesc.CPUAccessFlags = 0;
-    indexBufferDesc.MiscFlags = 0;
+	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	indexBufferDesc.ByteWidth = indexSize * m_indexCount;
+	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	indexBufferDesc.CPUAccessFlags = 0;
+	indexBufferDesc.MiscFlags = 0;
 	indexBufferDesc.StructureByteStride = 0;
 
 	// Give the subresource structure a pointer to the index data.
-    indexData.pSysMem = indices;
+	indexData.pSysMem = indices;
 	indexData.SysMemPitch = 0;
 	indexData.SysMemSlicePitch = 0;
 
@@ -218,16 +502,34 @@ bool ModelClass::InitializeBuffers(ID3D11Device* device)
 		return false;
 	}
 
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete [] vertices;
-	delete [] verticesNM;
-	delete [] verticesSM;
-	vertices = 0;
-	verticesNM = 0;
-	verticesSM = 0;
+	// RenderBuffers binds the index buffer with the width it was created with.
+	m_indexFormat = (indexSize == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	m_quantization = quantization;
 
-	delete [] indices;
-	indices = 0;
+	// Packed vertices need the mesh's dequantization constants in the vertex shader.
+	if (GetLayout() == MESH_LAYOUT_NORMALMAP_PACKED)
+	{
+		quantizationBuffer.positionScale = DirectX::SimpleMath::Vector4(quantization.positionScale[0], quantization.positionScale[1], quantization.positionScale[2], 0.0f);
+		quantizationBuffer.positionBias = DirectX::SimpleMath::Vector4(quantization.positionBias[0], quantization.positionBias[1], quantization.positionBias[2], 0.0f);
+		quantizationBuffer.textureScaleBias = DirectX::SimpleMath::Vector4(quantization.textureScale[0], quantization.textureScale[1], quantization.textureBias[0], quantization.textureBias[1]);
+
+		quantizationBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		quantizationBufferDesc.ByteWidth = sizeof(QuantizationBufferType);
+		quantizationBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		quantizationBufferDesc.CPUAccessFlags = 0;
+		quantizationBufferDesc.MiscFlags = 0;
+		quantizationBufferDesc.StructureByteStride = 0;
+
+		quantizationData.pSysMem = &quantizationBuffer;
+		quantizationData.SysMemPitch = 0;
+		quantizationData.SysMemSlicePitch = 0;
+
+		result = device->CreateBuffer(&quantizationBufferDesc, &quantizationData, &m_quantizationBuffer);
+		if(FAILED(result))
+		{
+			return false;
+		}
+	}
 
 	return true;
 }
@@ -235,6 +537,13 @@ bool ModelClass::InitializeBuffers(ID3D11Device* device)
 
 void ModelClass::ShutdownBuffers()
 {
+	// Release the quantization constant buffer.
+	if(m_quantizationBuffer)
+	{
+		m_quantizationBuffer->Release();
+		m_quantizationBuffer = 0;
+	}
+
 	// Release the index buffer.
 	if(m_indexBuffer)
 	{
@@ -259,28 +568,20 @@ void ModelClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
 	unsigned int offset;
 
 	// Set vertex buffer stride and offset.
-	if (!normalMapping)
-	{
-		if (!shadowMapping)
-		{
-			stride = sizeof(VertexType);
-		}
-		else
-		{
-			stride = sizeof(VertexTypeSM);
-		}
-	}
-	else
-	{
-		stride = sizeof(VertexTypeNM);
-	}
+	stride = GetVertexStride(GetLayout());
 	offset = 0;
     
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
 	deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
 
     // Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	deviceContext->IASetIndexBuffer(m_indexBuffer, m_indexFormat, 0);
+
+	// Slot 4 is free in every vertex shader, the packed vertex decode reads it.
+	if (m_quantizationBuffer)
+	{
+		deviceContext->VSSetConstantBuffers(4, 1, &m_quantizationBuffer);
+	}
 
     // Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
 	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -289,297 +590,70 @@ void ModelClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
 }
 
 
-bool ModelClass::LoadModel(char* filename)
+bool ModelClass::LoadModel(const ObjMesh& mesh)
 {
-	std::vector<XMFLOAT3> verts;
-	std::vector<XMFLOAT3> norms;
-	std::vector<XMFLOAT2> texCs;
-	std::vector<unsigned int> faces;
+	MeshCookOptions options;
+
+	// Mountains, glaciers and the snow are drawn in up to three passes, fewer vertex shader runs pay off in each.
+	options.optimize = optimizeMesh;
+	options.generateLods = generateLods;
+	options.buildClusters = buildClusters;
+	options.shadowProxyError = shadowProxyError;
 
-	FILE* file;// = fopen(filename, "r");
-	errno_t err;
-	err = fopen_s(&file, filename, "r");
-	if (err != 0)
-		//if (file == NULL)
+	// "Unroll" the loaded obj information into a list of triangles in this model's layout.
+	if (!CookMesh(mesh, GetLayout(), options, m_mesh, 0))
 	{
 		return false;
 	}
 
-	while (true)
-	{
-		char lineHeader[128];
+	m_vertexCount = m_mesh.vertexCount;
+	m_indexCount = (int)m_mesh.indices.size();
+	SetBounds(m_mesh.boundsMin, m_mesh.boundsMax, m_mesh.boundsCenter, m_mesh.boundsRadius);
+	SetLods(m_mesh.lods.data(), (unsigned int)m_mesh.lods.size(), m_mesh.clusters.data(), (unsigned int)m_mesh.clusters.size());
 
-		// Read first word of the line
-		int res = fscanf_s(file, "%s", lineHeader, sizeof(lineHeader));
-		if (res == EOF)
-		{
-			break; // exit loop
-		}
-		else // Parse
-		{
-			if (strcmp(lineHeader, "v") == 0) // Vertex
-			{
-				XMFLOAT3 vertex;
-				fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-				verts.push_back(vertex);
-			}
-			else if (strcmp(lineHeader, "vt") == 0) // Tex Coord
-			{
-				XMFLOAT2 uv;
-				fscanf_s(file, "%f %f\n", &uv.x, &uv.y);
-				texCs.push_back(uv);
-			}
-			else if (strcmp(lineHeader, "vn") == 0) // Normal
-			{
-				XMFLOAT3 normal;
-				fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-				norms.push_back(normal);
-			}
-			else if (strcmp(lineHeader, "f") == 0) // Face
-			{
-				unsigned int face[9];
-				int matches = fscanf_s(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &face[0], &face[1], &face[2],
-					&face[3], &face[4], &face[5],
-					&face[6], &face[7], &face[8]);
-				if (matches != 9)
-				{
-					// Parser error, or not triangle faces
-					return false;
-				}
-
-				for (int i = 0; i < 9; i++)
-				{
-					faces.push_back(face[i]);
-				}
-
-
-			}
-		}
-	}
+	return true;
+}
 
-	int vIndex = 0, nIndex = 0, tIndex = 0;
-	int numFaces = (int)faces.size() / 9;
 
-	//// Create the model using the vertex count that was read in.
-	m_vertexCount = numFaces * 3;
-//	model = new ModelType[vertexCount];
+void ModelClass::SetLods(const MeshLod* lods, unsigned int lodCount, const MeshCluster* clusters, unsigned int clusterCount)
+{
+	// The clusters are tested every draw, so they are kept even when the rest of the mesh is not.
+	m_clusters.assign(clusters, clusters + clusterCount);
+	m_drawRanges.resize(clusterCount);
 
-	// "Unroll" the loaded obj information into a list of triangles.
-	
-	if (!normalMapping)
+	// A mesh without levels of detail is its own only level.
+	m_lodCount = std::min(lodCount, MESH_MAX_LODS);
+	if (m_lodCount == 0)
 	{
-		if (!shadowMapping)
-		{
-			for (int f = 0; f < (int)faces.size(); f += 3)
-			{
-				VertexPositionNormalTexture tempVertex;
-				tempVertex.position.x = verts[(faces[f + 0] - 1)].x;
-				tempVertex.position.y = verts[(faces[f + 0] - 1)].y;
-				tempVertex.position.z = verts[(faces[f + 0] - 1)].z;
-
-				tempVertex.textureCoordinate.x = texCs[(faces[f + 1] - 1)].x;
-				tempVertex.textureCoordinate.y = texCs[(faces[f + 1] - 1)].y;
-
-				tempVertex.normal.x = norms[(faces[f + 2] - 1)].x;
-				tempVertex.normal.y = norms[(faces[f + 2] - 1)].y;
-				tempVertex.normal.z = norms[(faces[f + 2] - 1)].z;
-
-				//increase index count
-				preFabVertices.push_back(tempVertex);
-
-				int tempIndex;
-				tempIndex = vIndex;
-				preFabIndices.push_back(tempIndex);
-				vIndex++;
-			}
-		}
-		else
-		{
-			for (int f = 0; f < (int)faces.size(); f += 3)
-			{
-				VertexPosition tempVertex;
-				tempVertex.position.x = verts[(faces[f + 0] - 1)].x;
-				tempVertex.position.y = verts[(faces[f + 0] - 1)].y;
-				tempVertex.position.z = verts[(faces[f + 0] - 1)].z;
-				
-				//increase index count
-				preFabVerticesSM.push_back(tempVertex);
-
-				int tempIndex;
-				tempIndex = vIndex;
-				preFabIndices.push_back(tempIndex);
-				vIndex++;
-			}
-		}
-	}
-	else
-	{
-		for (int f = 0; f < (int)faces.size(); f += 3)
-		{
-			VertexPositionNormalTextureTangentBinormal tempVertex;
-			tempVertex.position.x = verts[(faces[f + 0] - 1)].x;
-			tempVertex.position.y = verts[(faces[f + 0] - 1)].y;
-			tempVertex.position.z = verts[(faces[f + 0] - 1)].z;
-
-			tempVertex.textureCoordinate.x = texCs[(faces[f + 1] - 1)].x;
-			tempVertex.textureCoordinate.y = texCs[(faces[f + 1] - 1)].y;
-
-			tempVertex.normal.x = norms[(faces[f + 2] - 1)].x;
-			tempVertex.normal.y = norms[(faces[f + 2] - 1)].y;
-			tempVertex.normal.z = norms[(faces[f + 2] - 1)].z;
-
-			//tangent and binormals will be calculated later
-			tempVertex.tangent.x = 0;
-			tempVertex.tangent.y = 0;
-			tempVertex.tangent.z = 0;
-
-			tempVertex.binormal.x = 0;
-			tempVertex.binormal.y = 0;
-			tempVertex.binormal.z = 0;
-
-			//increase index count
-			preFabVerticesNM.push_back(tempVertex);
-
-			int tempIndex;
-			tempIndex = vIndex;
-			preFabIndices.push_back(tempIndex);
-			vIndex++;
-		}
+		memset(&m_lods[0], 0, sizeof(m_lods[0]));
+		m_lods[0].indexCount = m_indexCount;
+		m_lodCount = 1;
+		return;
 	}
-	m_indexCount = vIndex;
 
-	verts.clear();
-	norms.clear();
-	texCs.clear();
-	faces.clear();
-	return true;
-}
+	memcpy(m_lods, lods, m_lodCount * sizeof(MeshLod));
 
-
-void ModelClass::ReleaseModel()
-{
 	return;
 }
 
 
-void ModelClass::CalculateModelVectors()
+void ModelClass::SetBounds(const float boundsMin[3], const float boundsMax[3], const float boundsCenter[3], float boundsRadius)
 {
-	int faceCount, i, index;
-	TempVertexType vertex1, vertex2, vertex3;
-	VectorType tangent, binormal;
-
-
-	// Calculate the number of faces in the model.
-	faceCount = m_vertexCount / 3;
-
-	// Initialize the index to the model data.
-	index = 0;
-
-	// Go through all the faces and calculate the the tangent and binormal vectors.
-	for (i = 0; i < faceCount; i++)
-	{
-		// Get the three vertices for this face from the model and add to our array with tangents and binormals
-		vertex1.x = preFabVerticesNM[index].position.x;
-		vertex1.y = preFabVerticesNM[index].position.y;
-		vertex1.z = preFabVerticesNM[index].position.z;
-		vertex1.tu = preFabVerticesNM[index].textureCoordinate.x;
-		vertex1.tv = preFabVerticesNM[index].textureCoordinate.y;
-		index++;
-
-		vertex2.x = preFabVerticesNM[index].position.x;
-		vertex2.y = preFabVerticesNM[index].position.y;
-		vertex2.z = preFabVerticesNM[index].position.z;
-		vertex2.tu = preFabVerticesNM[index].textureCoordinate.x;
-		vertex2.tv = preFabVerticesNM[index].textureCoordinate.y;
-		index++;
-
-		vertex3.x = preFabVerticesNM[index].position.x;
-		vertex3.y = preFabVerticesNM[index].position.y;
-		vertex3.z = preFabVerticesNM[index].position.z;
-		vertex3.tu = preFabVerticesNM[index].textureCoordinate.x;
-		vertex3.tv = preFabVerticesNM[index].textureCoordinate.y;
-		index++;
-
-		// Calculate the tangent and binormal of that face.
-		CalculateTangentBinormal(vertex1, vertex2, vertex3, tangent, binormal);
-
-		// Store the tangent and binormal for this face back in the model structure.
-		preFabVerticesNM[index - 1].tangent.x = tangent.x;
-		preFabVerticesNM[index - 1].tangent.y = tangent.y;
-		preFabVerticesNM[index - 1].tangent.z = tangent.z;
-		preFabVerticesNM[index - 1].binormal.x = binormal.x;
-		preFabVerticesNM[index - 1].binormal.y = binormal.y;
-		preFabVerticesNM[index - 1].binormal.z = binormal.z;
-
-		preFabVerticesNM[index - 2].tangent.x = tangent.x;
-		preFabVerticesNM[index - 2].tangent.y = tangent.y;
-		preFabVerticesNM[index - 2].tangent.z = tangent.z;
-		preFabVerticesNM[index - 2].binormal.x = binormal.x;
-		preFabVerticesNM[index - 2].binormal.y = binormal.y;
-		preFabVerticesNM[index - 2].binormal.z = binormal.z;
-
-		preFabVerticesNM[index - 3].tangent.x = tangent.x;
-		preFabVerticesNM[index - 3].tangent.y = tangent.y;
-		preFabVerticesNM[index - 3].tangent.z = tangent.z;
-		preFabVerticesNM[index - 3].binormal.x = binormal.x;
-		preFabVerticesNM[index - 3].binormal.y = binormal.y;
-		preFabVerticesNM[index - 3].binormal.z = binormal.z;
-	}
+	DirectX::BoundingBox::CreateFromPoints(m_boundingBox, DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3*>(boundsMin)),
+		DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3*>(boundsMax)));
+	m_boundingSphere.Center = DirectX::XMFLOAT3(boundsCenter[0], boundsCenter[1], boundsCenter[2]);
+	m_boundingSphere.Radius = boundsRadius;
 
 	return;
 }
 
-void ModelClass::CalculateTangentBinormal(TempVertexType vertex1, TempVertexType vertex2, TempVertexType vertex3, VectorType& tangent, VectorType& binormal)
-{
-	float vector1[3], vector2[3];
-	float tuVector[2], tvVector[2];
-	float den;
-	float length;
-
-
-	// Calculate the two vectors for this face.
-	vector1[0] = vertex2.x - vertex1.x;
-	vector1[1] = vertex2.y - vertex1.y;
-	vector1[2] = vertex2.z - vertex1.z;
-
-	vector2[0] = vertex3.x - vertex1.x;
-	vector2[1] = vertex3.y - vertex1.y;
-	vector2[2] = vertex3.z - vertex1.z;
-
-	// Calculate the tu and tv texture space vectors.
-	tuVector[0] = vertex2.tu - vertex1.tu;
-	tvVector[0] = vertex2.tv - vertex1.tv;
-
-	tuVector[1] = vertex3.tu - vertex1.tu;
-	tvVector[1] = vertex3.tv - vertex1.tv;
-
-	// Calculate the denominator of the tangent/binormal equation.
-	den = 1.0f / (tuVector[0] * tvVector[1] - tuVector[1] * tvVector[0]);
-
-	// Calculate the cross products and multiply by the coefficient to get the tangent and binormal.
-	tangent.x = (tvVector[1] * vector1[0] - tvVector[0] * vector2[0]) * den;
-	tangent.y = (tvVector[1] * vector1[1] - tvVector[0] * vector2[1]) * den;
-	tangent.z = (tvVector[1] * vector1[2] - tvVector[0] * vector2[2]) * den;
 
-	binormal.x = (tuVector[0] * vector2[0] - tuVector[1] * vector1[0]) * den;
-	binormal.y = (tuVector[0] * vector2[1] - tuVector[1] * vector1[1]) * den;
-	binormal.z = (tuVector[0] * vector2[2] - tuVector[1] * vector1[2]) * den;
-
-	// Calculate the length of this normal.
-	length = sqrt((tangent.x * tangent.x) + (tangent.y * tangent.y) + (tangent.z * tangent.z));
-
-	// Normalize the normal and then store it
-	tangent.x = tangent.x / length;
-	tangent.y = tangent.y / length;
-	tangent.z = tangent.z / length;
-
-	// Calculate the length of this normal.
-	length = sqrt((binormal.x * binormal.x) + (binormal.y * binormal.y) + (binormal.z * binormal.z));
-
-	// Normalize the normal and then store it
-	binormal.x = binormal.x / length;
-	binormal.y = binormal.y / length;
-	binormal.z = binormal.z / length;
+void ModelClass::ReleaseModel()
+{
+	ReleaseMeshData();
+	m_clusters.clear();
+	m_drawRanges.clear();
+	m_instanceTransform = DirectX::SimpleMath::Matrix::Identity;
 
 	return;
-}
\ No newline at end of file
+}
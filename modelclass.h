@@ -9,6 +9,10 @@
 // INCLUDES //
 //////////////
 #include "pch.h"
+#include "ObjParser.h"
+#include "MeshBuilder.h"
+#include "CookedMesh.h"
+#include "MeshClusterizer.h"
 //#include <d3dx10math.h>
 //#include <fstream>
 //using namespace std;
@@ -22,37 +26,12 @@ using namespace DirectX;
 class ModelClass
 {
 private:
-	struct VertexType
+	// Dequantization constants of the packed normal mapped layout, bound to VS register b4.
+	struct QuantizationBufferType
 	{
-		DirectX::SimpleMath::Vector3 position;
-		DirectX::SimpleMath::Vector2 texture;
-		DirectX::SimpleMath::Vector3 normal;
-	};
-	
-	struct VertexTypeNM
-	{
-		DirectX::SimpleMath::Vector3 position;
-		DirectX::SimpleMath::Vector2 texture;
-		DirectX::SimpleMath::Vector3 normal;
-		DirectX::SimpleMath::Vector3 tangent;
-		DirectX::SimpleMath::Vector3 binormal;
-	};
-
-	struct VertexTypeSM
-	{
-		DirectX::SimpleMath::Vector3 position;		
-	};
-
-	struct TempVertexType
-	{
-		float x, y, z;
-		float tu, tv;
-		float nx, ny, nz;
-	};
-
-	struct VectorType
-	{
-		float x, y, z;
+		DirectX::SimpleMath::Vector4 positionScale;
+		DirectX::SimpleMath::Vector4 positionBias;
+		DirectX::SimpleMath::Vector4 textureScaleBias;
 	};
 
 public:
@@ -60,36 +39,62 @@ public:
 	~ModelClass();
 
 	bool InitializeBox(ID3D11Device*, float xwidth, float yheight, float zdepth);
-	bool InitializeModel(ID3D11Device* device, char* filename);
+	bool InitializeModel(ID3D11Device* device, char* filename);		// Uses the cooked mesh if it is current, otherwise parses the .obj and cooks it
+	bool InitializeModel(ID3D11Device* device, const ObjMesh& mesh);	// Builds this variant's layout from an already parsed mesh
+	bool InitializeCooked(ID3D11Device* device, const char* filename, const CookedMeshSource& source);	// Uploads straight from the mapped cooked mesh
+	bool InitializeInstance(const ModelClass& reference, const DirectX::SimpleMath::Matrix& transform);	// Shares the reference's buffers, drawn through transform
+	bool InitializeVariant(ID3D11DeviceContext* deviceContext, const ModelClass& source);	// Builds this layout from another uploaded layout of the same mesh, read back from its vertex buffer; shares its indices
+	bool SaveCooked(const char* filename, const CookedMeshSource& source);	// Needs the CPU copy InitializeModel keeps
+	size_t ReleaseMeshData();	// Frees the CPU copy of the vertices and indices once uploaded and cooked, returns the bytes freed
 	void Shutdown();
-	void Render(ID3D11DeviceContext*);
+	void Render(ID3D11DeviceContext*);	// Full detail
+	void Render(ID3D11DeviceContext*, const DirectX::SimpleMath::Matrix& world, const DirectX::SimpleMath::Matrix& view, const DirectX::SimpleMath::Matrix& projection);	// Level of detail picked from the projected size, clusters outside the view skipped. world includes the instance transform, like the shader's
 	
 	int GetIndexCount();
+	MeshLayout GetLayout() const;
+	const DirectX::BoundingBox& GetBoundingBox() const;			// Model space of the buffers, before the instance transform, computed on load
+	const DirectX::BoundingSphere& GetBoundingSphere() const;	// Model space of the buffers, before the instance transform, computed on load
+	const DirectX::SimpleMath::Matrix& GetInstanceTransform() const;	// Identity unless the buffers are another model's; goes in front of the world matrix
+	unsigned int SelectLod(ID3D11DeviceContext*, const DirectX::SimpleMath::Matrix& world, const DirectX::SimpleMath::Matrix& view, const DirectX::SimpleMath::Matrix& projection) const;
 
 	bool normalMapping;
 	bool shadowMapping;
+	bool optimizeMesh;	// Reorder for vertex cache, overdraw and vertex fetch when building from an .obj
+	bool generateLods;	// Simplify into levels of detail when building from an .obj
+	float lodPixelError;	// Largest error, in pixels of the current viewport, a coarser level may show
+	bool buildClusters;	// Split into cullable clusters when building from an .obj
+	float shadowProxyError;	// Model units the shadow map layout may be simplified by when building from an .obj, 0 for none
+	bool cullClusters;	// Skip clusters outside the frustum or facing away when drawing
+	CookedMeshEncoding cookedEncoding;	// How SaveCooked stores the vertices and indices, raw so warm loads upload from the mapping
 
 
 private:
-	bool InitializeBuffers(ID3D11Device*);
+	bool InitializeBuffers(ID3D11Device*, const void* vertices, const void* indices, unsigned int indexSize, const MeshQuantization& quantization);
 	void ShutdownBuffers();
 	void RenderBuffers(ID3D11DeviceContext*);
-	bool LoadModel(char*);
-
-	void CalculateModelVectors();
-	void CalculateTangentBinormal(TempVertexType, TempVertexType, TempVertexType, VectorType&, VectorType&);
+	bool LoadModel(const ObjMesh&);
+	void SetLods(const MeshLod* lods, unsigned int lodCount, const MeshCluster* clusters, unsigned int clusterCount);
+	void SetBounds(const float boundsMin[3], const float boundsMax[3], const float boundsCenter[3], float boundsRadius);
 
 	void ReleaseModel();
 
 private:
 	ID3D11Buffer *m_vertexBuffer, *m_indexBuffer;
-	int m_vertexCount, m_indexCount;
-
-	//arrays for our generated objects Made by directX
-	std::vector<VertexPositionNormalTexture> preFabVertices;
-	std::vector<VertexPositionNormalTextureTangentBinormal> preFabVerticesNM;
-	std::vector<VertexPosition> preFabVerticesSM;
-	std::vector<uint16_t> preFabIndices;
+	ID3D11Buffer *m_quantizationBuffer;
+	int m_vertexCount, m_indexCount;	// m_indexCount covers every level of detail
+	MeshLod m_lods[MESH_MAX_LODS];
+	unsigned int m_lodCount;
+	std::vector<MeshCluster> m_clusters;
+	std::vector<MeshDrawRange> m_drawRanges;	// Scratch for the clusters that survive culling
+	DXGI_FORMAT m_indexFormat;
+	MeshQuantization m_quantization;	// of the vertex buffer, only set for the packed layout
+	DirectX::BoundingBox m_boundingBox;
+	DirectX::BoundingSphere m_boundingSphere;
+	DirectX::SimpleMath::Matrix m_instanceTransform;
+
+	// Vertices and indices in this model's layout, built from an .obj and kept until ReleaseMeshData.
+	// Empty when loaded from a cooked mesh or shared from another model.
+	MeshData m_mesh;
 
 };
 
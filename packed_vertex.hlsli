@@ -0,0 +1,52 @@
+// Packed normal mapped vertex
+// Decodes MeshVertexNMPacked (MeshBuilder.h) back into the float vertex the light shaders expect:
+// 16 bit positions and texture coordinates over the mesh's range, octahedral normal and tangent,
+// binormal rebuilt from its handedness.
+
+// Set per model by ModelClass::RenderBuffers.
+cbuffer VertexQuantizationBuffer : register(b4)
+{
+    float4 positionScale;
+    float4 positionBias;
+    float4 textureScaleBias;
+};
+
+struct PackedInputType
+{
+    float4 position : POSITION;
+    float2 tex : TEXCOORD0;
+    float2 normal : NORMAL;
+    float2 tangent : TANGENT;
+};
+
+struct InputType
+{
+    float4 position;
+    float2 tex;
+    float3 normal;
+    float3 tangent;
+    float3 binormal;
+};
+
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 v = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = saturate(-v.z);
+    v.xy += (v.xy >= 0.0f) ? -t : t;
+    return normalize(v);
+}
+
+InputType DecodeVertex(PackedInputType packed)
+{
+    InputType input;
+
+    input.position = float4(packed.position.xyz * positionScale.xyz + positionBias.xyz, 1.0f);
+    input.tex = packed.tex * textureScaleBias.xy + textureScaleBias.zw;
+    input.normal = DecodeOctahedral(packed.normal);
+    input.tangent = DecodeOctahedral(packed.tangent);
+
+    // w holds the binormal sign as 0 or 1.
+    input.binormal = cross(input.normal, input.tangent) * (packed.position.w * 2.0f - 1.0f);
+
+    return input;
+}